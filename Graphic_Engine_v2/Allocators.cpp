@@ -0,0 +1,479 @@
+#include "Allocators.h"
+#include "Platform.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static std::atomic<unsigned long long> s_heapAllocations(0);
+static std::atomic<unsigned long long> s_heapFrees(0);
+
+/************************************************************************/
+/* HEAP COUNTERS                                                        */
+/* Every new and delete of the program goes through these, so the      */
+/* allocations a frame or a load makes can be counted.                  */
+/************************************************************************/
+static void* CountedAllocate(size_t size)
+{
+	s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+static void CountedFree(void* memory)
+{
+	if (memory)
+	{
+		s_heapFrees.fetch_add(1, std::memory_order_relaxed);
+		free(memory);
+	}
+}
+
+void* operator new(size_t size)
+{
+	void* memory = CountedAllocate(size);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	void* memory = CountedAllocate(size);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return CountedAllocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete(void* memory, size_t /*size*/) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete[](void* memory, size_t /*size*/) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	CountedFree(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	CountedFree(memory);
+}
+
+void* AlignedAlloc(size_t size, size_t alignment)
+{
+	void* memory;
+
+#ifdef _WIN32
+	memory = _aligned_malloc(size, alignment);
+#else
+	if (posix_memalign(&memory, alignment, size) != 0)
+	{
+		memory = nullptr;
+	}
+#endif
+
+	if (memory)
+	{
+		s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	return memory;
+}
+
+void AlignedFree(void* memory)
+{
+	if (!memory)
+	{
+		return;
+	}
+
+	s_heapFrees.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+/************************************************************************/
+/* ALIGNED HEAP COUNTERS                                                */
+/* Types aligned past the default alignment of new go through these     */
+/* once the compiler supports them, so they are counted as well.        */
+/************************************************************************/
+#ifdef __cpp_aligned_new
+static void* CountedAlignedAllocate(size_t size, std::align_val_t alignment)
+{
+	return AlignedAlloc(size ? size : 1, std::max((size_t)alignment, sizeof(void*)));
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* memory = CountedAlignedAllocate(size, alignment);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void* memory = CountedAlignedAllocate(size, alignment);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAlignedAllocate(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	return CountedAlignedAllocate(size, alignment);
+}
+
+void operator delete(void* memory, std::align_val_t /*alignment*/) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t /*alignment*/) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete(void* memory, size_t /*size*/, std::align_val_t /*alignment*/) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete[](void* memory, size_t /*size*/, std::align_val_t /*alignment*/) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete(void* memory, std::align_val_t /*alignment*/, const std::nothrow_t&) noexcept
+{
+	AlignedFree(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t /*alignment*/, const std::nothrow_t&) noexcept
+{
+	AlignedFree(memory);
+}
+#endif
+
+void GetHeapStatistics(HeapStatistics& statistics)
+{
+	statistics.allocations = s_heapAllocations.load(std::memory_order_relaxed);
+	statistics.frees = s_heapFrees.load(std::memory_order_relaxed);
+}
+
+//Moves a pointer forward to the next multiple of a power of two.
+static unsigned char* AlignPointer(unsigned char* pointer, size_t alignment)
+{
+	return (unsigned char*)(((uintptr_t)pointer + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+LinearAllocatorClass::LinearAllocatorClass()
+{
+	m_memory = nullptr;
+	m_capacity = 0;
+	m_used = 0;
+	m_peak = 0;
+	m_allocations = 0;
+	m_failedAllocations = 0;
+}
+
+LinearAllocatorClass::LinearAllocatorClass(const LinearAllocatorClass &)
+{
+}
+
+
+LinearAllocatorClass::~LinearAllocatorClass()
+{
+}
+
+//Allocates the block the memory is handed out from.
+bool LinearAllocatorClass::Initialize(size_t capacity)
+{
+	m_memory = (unsigned char*)AlignedAlloc(capacity, 64);
+	if (!m_memory)
+	{
+		return false;
+	}
+
+	m_capacity = capacity;
+	m_used = 0;
+	m_peak = 0;
+	m_allocations = 0;
+	m_failedAllocations = 0;
+
+	return true;
+}
+
+void LinearAllocatorClass::Shutdown()
+{
+	AlignedFree(m_memory);
+	m_memory = nullptr;
+	m_capacity = 0;
+	m_used = 0;
+}
+
+/*
+ *	Allocate()
+ *	brief: Takes memory from the block.
+ *	param alignment: A power of two. Smaller than ALLOCATOR_ALIGNMENT gives ALLOCATOR_ALIGNMENT.
+ *	return: The memory, or null if it doesn't fit in what is left.
+ */
+void* LinearAllocatorClass::Allocate(size_t size, size_t alignment)
+{
+	unsigned char* memory;
+
+	alignment = std::max(alignment, ALLOCATOR_ALIGNMENT);
+	memory = AlignPointer(m_memory + m_used, alignment);
+	if (!m_memory || (size_t)(memory - m_memory) + size > m_capacity)
+	{
+		m_failedAllocations++;
+		return nullptr;
+	}
+
+	m_used = (size_t)(memory - m_memory) + size;
+	m_peak = std::max(m_peak, m_used);
+	m_allocations++;
+
+	return memory;
+}
+
+//The position of the allocator, to free back to it later.
+size_t LinearAllocatorClass::GetMarker()
+{
+	return m_used;
+}
+
+//Frees everything allocated since the marker was taken.
+void LinearAllocatorClass::FreeToMarker(size_t marker)
+{
+	m_used = std::min(marker, m_used);
+}
+
+void LinearAllocatorClass::Reset()
+{
+	m_used = 0;
+}
+
+void LinearAllocatorClass::GetStatistics(AllocatorStatistics& statistics)
+{
+	statistics.allocations = m_allocations;
+	statistics.failedAllocations = m_failedAllocations;
+	statistics.usedBytes = m_used;
+	statistics.peakBytes = m_peak;
+	statistics.capacity = m_capacity;
+}
+
+FrameAllocatorClass::FrameAllocatorClass()
+{
+	m_blocks[0] = nullptr;
+	m_blocks[1] = nullptr;
+	m_blockUsed[0] = 0;
+	m_blockUsed[1] = 0;
+	m_capacity = 0;
+	m_chunks = nullptr;
+	m_threadCount = 0;
+	m_lastUsed = 0;
+	m_peak = 0;
+}
+
+FrameAllocatorClass::FrameAllocatorClass(const FrameAllocatorClass &)
+{
+}
+
+
+FrameAllocatorClass::~FrameAllocatorClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Allocates the two blocks and the chunks of every thread.
+ *	param threadCount: Threads that allocate, numbered from 0 like the ones of the job system.
+ *	param capacity: Bytes a frame can allocate between all of its threads.
+ */
+bool FrameAllocatorClass::Initialize(unsigned int threadCount, size_t capacity)
+{
+	m_blocks[0] = (unsigned char*)AlignedAlloc(capacity, 64);
+	m_blocks[1] = (unsigned char*)AlignedAlloc(capacity, 64);
+	m_chunks = (ThreadChunk*)AlignedAlloc(sizeof(ThreadChunk) * threadCount * 2, 64);
+	if (!m_blocks[0] || !m_blocks[1] || !m_chunks)
+	{
+		return false;
+	}
+
+	//The memory is raw, so the chunks and their atomics are constructed in it.
+	for (unsigned int i = 0; i < threadCount * 2; i++)
+	{
+		new (&m_chunks[i]) ThreadChunk();
+		m_chunks[i].current = nullptr;
+		m_chunks[i].end = nullptr;
+		m_chunks[i].allocations.store(0);
+		m_chunks[i].failedAllocations.store(0);
+	}
+
+	m_capacity = capacity;
+	m_threadCount = threadCount;
+	m_blockUsed[0] = 0;
+	m_blockUsed[1] = 0;
+	m_lastUsed = 0;
+	m_peak = 0;
+
+	return true;
+}
+
+void FrameAllocatorClass::Shutdown()
+{
+	for (unsigned int i = 0; i < m_threadCount * 2; i++)
+	{
+		m_chunks[i].~ThreadChunk();
+	}
+	AlignedFree(m_chunks);
+	m_chunks = nullptr;
+	AlignedFree(m_blocks[1]);
+	m_blocks[1] = nullptr;
+	AlignedFree(m_blocks[0]);
+	m_blocks[0] = nullptr;
+	m_capacity = 0;
+	m_threadCount = 0;
+}
+
+/*
+ *	Allocate()
+ *	brief: Takes memory that stays valid until EndFrame() is called for the frame. A thread can only allocate with
+ *		   its own index.
+ *	param frame: The frame the memory is for. Only it and the next one can be allocating at the same time.
+ *	param alignment: A power of two. Smaller than ALLOCATOR_ALIGNMENT gives ALLOCATOR_ALIGNMENT.
+ *	return: The memory, or null if the frame has used its whole block.
+ */
+void* FrameAllocatorClass::Allocate(unsigned long long frame, unsigned int threadIndex, size_t size, size_t alignment)
+{
+	unsigned int block;
+	unsigned char* memory;
+	size_t chunkSize, offset;
+
+	if (threadIndex >= m_threadCount)
+	{
+		return nullptr;
+	}
+
+	block = (unsigned int)(frame & 1);
+	ThreadChunk& chunk = m_chunks[threadIndex * 2 + block];
+
+	alignment = std::max(alignment, ALLOCATOR_ALIGNMENT);
+	memory = AlignPointer(chunk.current, alignment);
+	if (!chunk.current || memory + size > chunk.end)
+	{
+		//Take a new chunk from the block, big enough for this allocation. What is left of the old one is wasted.
+		chunkSize = std::max(FRAME_ALLOCATOR_CHUNK, size + alignment);
+		offset = m_blockUsed[block].fetch_add(chunkSize, std::memory_order_relaxed);
+		if (offset + chunkSize > m_capacity)
+		{
+			chunk.failedAllocations.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		chunk.current = m_blocks[block] + offset;
+		chunk.end = chunk.current + chunkSize;
+		memory = AlignPointer(chunk.current, alignment);
+	}
+
+	chunk.current = memory + size;
+	chunk.allocations.fetch_add(1, std::memory_order_relaxed);
+
+	return memory;
+}
+
+/*
+ *	EndFrame()
+ *	brief: Frees at once everything allocated for a frame, for the frame after the next one. Nothing can be
+ *		   allocating for the frame anymore.
+ */
+void FrameAllocatorClass::EndFrame(unsigned long long frame)
+{
+	unsigned int block;
+	size_t used;
+
+	block = (unsigned int)(frame & 1);
+	used = std::min(m_blockUsed[block].load(), m_capacity);
+	m_lastUsed = used;
+	m_peak = std::max(m_peak.load(), used);
+
+	m_blockUsed[block] = 0;
+	for (unsigned int i = 0; i < m_threadCount; i++)
+	{
+		m_chunks[i * 2 + block].current = nullptr;
+		m_chunks[i * 2 + block].end = nullptr;
+	}
+}
+
+//Frees the memory of every frame, including the ones that were never ended. No thread can be allocating.
+void FrameAllocatorClass::Reset()
+{
+	for (unsigned int block = 0; block < 2; block++)
+	{
+		m_blockUsed[block] = 0;
+		for (unsigned int i = 0; i < m_threadCount; i++)
+		{
+			m_chunks[i * 2 + block].current = nullptr;
+			m_chunks[i * 2 + block].end = nullptr;
+		}
+	}
+}
+
+void FrameAllocatorClass::GetStatistics(AllocatorStatistics& statistics)
+{
+	statistics.allocations = 0;
+	statistics.failedAllocations = 0;
+	for (unsigned int i = 0; i < m_threadCount * 2; i++)
+	{
+		statistics.allocations += m_chunks[i].allocations.load(std::memory_order_relaxed);
+		statistics.failedAllocations += m_chunks[i].failedAllocations.load(std::memory_order_relaxed);
+	}
+
+	statistics.usedBytes = m_lastUsed;
+	statistics.peakBytes = m_peak;
+	statistics.capacity = m_capacity;
+}
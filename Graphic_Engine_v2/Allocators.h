@@ -0,0 +1,118 @@
+#pragma once
+
+#ifndef ALLOCATORS
+#define ALLOCATORS
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include <atomic>
+#include <cstddef>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const size_t ALLOCATOR_ALIGNMENT = 16;				//Of every allocation unless a larger one is asked for.
+const size_t FRAME_ALLOCATOR_CHUNK = 64 * 1024;		//Bytes a thread takes from the frame at a time.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//Allocations from the heap since the program started, through new, delete (aligned or not) and AlignedAlloc().
+struct HeapStatistics
+{
+	unsigned long long allocations;
+	unsigned long long frees;
+};
+
+struct AllocatorStatistics
+{
+	unsigned long long allocations;
+	unsigned long long failedAllocations;	//That didn't fit in the memory left.
+	size_t			   usedBytes;			//Now, or by the last frame ended for the frame allocator.
+	size_t			   peakBytes;
+	size_t			   capacity;
+};
+
+/*
+ *	LinearAllocatorClass
+ *	brief: Hands out memory from a block allocated once, moving a pointer forward. Nothing is freed on its own;
+ *		   GetMarker() remembers the position and FreeToMarker() frees everything allocated after it at once, so
+ *		   it works as a scratch stack for the data a load only needs until it is done. Only one thread can use it.
+ */
+class LinearAllocatorClass
+{
+public:
+	LinearAllocatorClass();
+	LinearAllocatorClass(const LinearAllocatorClass&);
+	~LinearAllocatorClass();
+
+	bool Initialize(size_t capacity);
+	void Shutdown();
+
+	void* Allocate(size_t size, size_t alignment);
+	size_t GetMarker();
+	void FreeToMarker(size_t marker);
+	void Reset();
+
+	void GetStatistics(AllocatorStatistics& statistics);
+
+private:
+	unsigned char*		m_memory;
+	size_t				m_capacity;
+	size_t				m_used;
+	size_t				m_peak;
+	unsigned long long	m_allocations;
+	unsigned long long	m_failedAllocations;
+};
+
+/*
+ *	FrameAllocatorClass
+ *	brief: Memory that lives for a frame, for the data a frame makes and throws away. There are two blocks that
+ *		   frames use in turns, so the memory of a frame is still there while the next one is being made, and a
+ *		   block is reset whole when its frame ends. Every thread moves its own pointer through chunks it takes
+ *		   from the block with an atomic add, so threads don't wait for each other.
+ */
+class FrameAllocatorClass
+{
+private:
+	//The chunk a thread is allocating from in one of the blocks, alone in its cache line.
+	struct alignas(64) ThreadChunk
+	{
+		unsigned char*					current;
+		unsigned char*					end;
+		std::atomic<unsigned long long> allocations;
+		std::atomic<unsigned long long> failedAllocations;
+	};
+
+public:
+	FrameAllocatorClass();
+	FrameAllocatorClass(const FrameAllocatorClass&);
+	~FrameAllocatorClass();
+
+	bool Initialize(unsigned int threadCount, size_t capacity);
+	void Shutdown();
+
+	void* Allocate(unsigned long long frame, unsigned int threadIndex, size_t size, size_t alignment);
+	void EndFrame(unsigned long long frame);
+	void Reset();
+
+	void GetStatistics(AllocatorStatistics& statistics);
+
+private:
+	unsigned char*		m_blocks[2];
+	std::atomic<size_t> m_blockUsed[2];
+	size_t				m_capacity;			//Of each block.
+	ThreadChunk*		m_chunks;			//Two per thread, one for each block.
+	unsigned int		m_threadCount;
+	std::atomic<size_t> m_lastUsed;			//Bytes the threads took from the block of the last frame ended.
+	std::atomic<size_t> m_peak;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+void GetHeapStatistics(HeapStatistics& statistics);
+
+#endif
@@ -0,0 +1,803 @@
+#include "BVHClass.h"
+#include "Platform.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cfloat>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned int BVH_NO_PARENT = 0xffffffff;
+static const unsigned int BVH_SAH_MAX_DEPTH = 32;	//Deeper nodes are split at the median, so the stacks below can't overflow.
+static const unsigned int BVH_STACK_SIZE = 64;
+static const unsigned int BVH_ALL_PLANES = 0x3f;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//The six frustum planes as a structure of arrays, padded to eight with planes every box is inside of.
+struct PlaneSet
+{
+	float x[8];
+	float y[8];
+	float z[8];
+	float w[8];
+};
+
+enum BoxTestResult
+{
+	BOX_OUTSIDE,
+	BOX_INTERSECTS,
+	BOX_INSIDE
+};
+
+//Orders objects by the center of their box along an axis.
+struct CentroidLess
+{
+	CentroidLess(const float* centroids, unsigned int axis) : centroids(centroids), axis(axis) {}
+
+	bool operator()(unsigned int a, unsigned int b) const
+	{
+		return centroids[a * 3 + axis] < centroids[b * 3 + axis];
+	}
+
+	const float*	   centroids;
+	const unsigned int axis;
+};
+
+/*	Tests a box against the planes in planeMask. The planes the box is fully inside of are taken out of the mask,
+	since nothing inside the box can cross them either.															*/
+typedef BoxTestResult (*BoxTestFunction)(const PlaneSet& planes, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax,
+										 unsigned int& planeMask);
+
+/************************************************************************/
+/* KERNELS                                                              */
+/************************************************************************/
+static BoxTestResult BoxTestScalar(const PlaneSet& planes, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax,
+								   unsigned int& planeMask)
+{
+	float center[3], extent[3], distance, radius;
+
+	center[0] = (boxMin.x + boxMax.x) * 0.5f;
+	center[1] = (boxMin.y + boxMax.y) * 0.5f;
+	center[2] = (boxMin.z + boxMax.z) * 0.5f;
+	extent[0] = (boxMax.x - boxMin.x) * 0.5f;
+	extent[1] = (boxMax.y - boxMin.y) * 0.5f;
+	extent[2] = (boxMax.z - boxMin.z) * 0.5f;
+
+	for (int plane = 0; plane < 6; plane++)
+	{
+		if (!(planeMask & (1 << plane)))
+		{
+			continue;
+		}
+
+		distance = planes.x[plane] * center[0] + planes.y[plane] * center[1] + planes.z[plane] * center[2] + planes.w[plane];
+		radius = fabsf(planes.x[plane]) * extent[0] + fabsf(planes.y[plane]) * extent[1] + fabsf(planes.z[plane]) * extent[2];
+
+		if (distance + radius < 0.0f)
+		{
+			return BOX_OUTSIDE;
+		}
+		if (distance - radius >= 0.0f)
+		{
+			planeMask &= ~(1 << plane);
+		}
+	}
+
+	return planeMask ? BOX_INTERSECTS : BOX_INSIDE;
+}
+
+#ifdef SIMD_X86
+
+//4 planes at once, in two steps.
+static BoxTestResult BoxTestSSE2(const PlaneSet& planes, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax,
+								 unsigned int& planeMask)
+{
+	__m128 centerX, centerY, centerZ, extentX, extentY, extentZ, distance, radius, signMask, half, zero;
+	int outside = 0, inside = 0;
+
+	half = _mm_set1_ps(0.5f);
+	signMask = _mm_set1_ps(-0.0f);
+	zero = _mm_setzero_ps();
+	centerX = _mm_set1_ps((boxMin.x + boxMax.x) * 0.5f);
+	centerY = _mm_set1_ps((boxMin.y + boxMax.y) * 0.5f);
+	centerZ = _mm_set1_ps((boxMin.z + boxMax.z) * 0.5f);
+	extentX = _mm_mul_ps(_mm_set1_ps(boxMax.x - boxMin.x), half);
+	extentY = _mm_mul_ps(_mm_set1_ps(boxMax.y - boxMin.y), half);
+	extentZ = _mm_mul_ps(_mm_set1_ps(boxMax.z - boxMin.z), half);
+
+	for (int i = 0; i < 8; i += 4)
+	{
+		const __m128 x = _mm_loadu_ps(planes.x + i);
+		const __m128 y = _mm_loadu_ps(planes.y + i);
+		const __m128 z = _mm_loadu_ps(planes.z + i);
+
+		distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, centerX), _mm_mul_ps(y, centerY)),
+							  _mm_add_ps(_mm_mul_ps(z, centerZ), _mm_loadu_ps(planes.w + i)));
+		radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, x), extentX),
+									   _mm_mul_ps(_mm_andnot_ps(signMask, y), extentY)),
+							_mm_mul_ps(_mm_andnot_ps(signMask, z), extentZ));
+
+		outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), zero)) << i;
+		inside |= _mm_movemask_ps(_mm_cmpge_ps(_mm_sub_ps(distance, radius), zero)) << i;
+	}
+
+	if (outside & planeMask)
+	{
+		return BOX_OUTSIDE;
+	}
+
+	planeMask &= ~inside;
+	return planeMask ? BOX_INTERSECTS : BOX_INSIDE;
+}
+
+//All the planes at once.
+SIMD_TARGET_AVX2 static BoxTestResult BoxTestAVX2(const PlaneSet& planes, const XMFLOAT3& boxMin, const XMFLOAT3& boxMax,
+												  unsigned int& planeMask)
+{
+	__m256 x, y, z, distance, radius, signMask, half, zero;
+	int outside, inside;
+
+	half = _mm256_set1_ps(0.5f);
+	signMask = _mm256_set1_ps(-0.0f);
+	zero = _mm256_setzero_ps();
+	x = _mm256_loadu_ps(planes.x);
+	y = _mm256_loadu_ps(planes.y);
+	z = _mm256_loadu_ps(planes.z);
+
+	distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps((boxMin.x + boxMax.x) * 0.5f)),
+										   _mm256_mul_ps(y, _mm256_set1_ps((boxMin.y + boxMax.y) * 0.5f))),
+							 _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps((boxMin.z + boxMax.z) * 0.5f)),
+										   _mm256_loadu_ps(planes.w)));
+	radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, x),
+													   _mm256_mul_ps(_mm256_set1_ps(boxMax.x - boxMin.x), half)),
+										 _mm256_mul_ps(_mm256_andnot_ps(signMask, y),
+													   _mm256_mul_ps(_mm256_set1_ps(boxMax.y - boxMin.y), half))),
+						   _mm256_mul_ps(_mm256_andnot_ps(signMask, z),
+										 _mm256_mul_ps(_mm256_set1_ps(boxMax.z - boxMin.z), half)));
+
+	outside = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+	inside = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(distance, radius), zero, _CMP_GE_OQ));
+
+	if (outside & planeMask)
+	{
+		return BOX_OUTSIDE;
+	}
+
+	planeMask &= ~inside;
+	return planeMask ? BOX_INTERSECTS : BOX_INSIDE;
+}
+
+#endif
+
+static BoxTestFunction SelectBoxTest(SimdLevel level)
+{
+	switch (level)
+	{
+#ifdef SIMD_X86
+	//Six planes fit in eight lanes, so wider registers have nothing to add.
+	case SIMD_LEVEL_AVX512:
+	case SIMD_LEVEL_AVX2:
+		return BoxTestAVX2;
+	case SIMD_LEVEL_SSE2:
+		return BoxTestSSE2;
+#endif
+	default:
+		return BoxTestScalar;
+	}
+}
+
+static SimdLevel	   g_supportedLevel = DetectSimdLevel();
+static SimdLevel	   g_bvhLevel = g_supportedLevel;
+static BoxTestFunction g_boxTest = SelectBoxTest(g_bvhLevel);
+
+/************************************************************************/
+/* FUNCTIONS                                                            */
+/************************************************************************/
+
+//Half the surface area of a box, which is all the heuristic needs to compare them.
+static float HalfArea(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax)
+{
+	const float x = boxMax.x - boxMin.x, y = boxMax.y - boxMin.y, z = boxMax.z - boxMin.z;
+
+	return x * y + y * z + z * x;
+}
+
+static void GrowBox(XMFLOAT3& boxMin, XMFLOAT3& boxMax, const XMFLOAT3& otherMin, const XMFLOAT3& otherMax)
+{
+	boxMin = XMFLOAT3(std::min(boxMin.x, otherMin.x), std::min(boxMin.y, otherMin.y), std::min(boxMin.z, otherMin.z));
+	boxMax = XMFLOAT3(std::max(boxMax.x, otherMax.x), std::max(boxMax.y, otherMax.y), std::max(boxMax.z, otherMax.z));
+}
+
+//Distance along the ray to where it enters the box, or FLT_MAX if it misses it.
+static float IntersectBox(const XMFLOAT3& origin, const XMFLOAT3& inverseDirection, const XMFLOAT3& boxMin,
+						  const XMFLOAT3& boxMax, float maxDistance)
+{
+	float nearX, farX, nearY, farY, nearZ, farZ, enter, leave;
+
+	nearX = (boxMin.x - origin.x) * inverseDirection.x;
+	farX = (boxMax.x - origin.x) * inverseDirection.x;
+	nearY = (boxMin.y - origin.y) * inverseDirection.y;
+	farY = (boxMax.y - origin.y) * inverseDirection.y;
+	nearZ = (boxMin.z - origin.z) * inverseDirection.z;
+	farZ = (boxMax.z - origin.z) * inverseDirection.z;
+
+	enter = std::max(std::max(std::min(nearX, farX), std::min(nearY, farY)), std::max(std::min(nearZ, farZ), 0.0f));
+	leave = std::min(std::min(std::max(nearX, farX), std::max(nearY, farY)), std::min(std::max(nearZ, farZ), maxDistance));
+
+	return enter <= leave ? enter : FLT_MAX;
+}
+
+BVHClass::BVHClass()
+{
+	m_nodes = nullptr;
+	m_parents = nullptr;
+	m_objectOrder = nullptr;
+	m_objectLeaves = nullptr;
+	m_objectMin = nullptr;
+	m_objectMax = nullptr;
+	m_objectCount = 0;
+	m_nodeCount = 0;
+	m_capacity = 0;
+	m_buildCost = 0.0f;
+	m_visitedNodes = 0;
+}
+
+BVHClass::BVHClass(const BVHClass &)
+{
+}
+
+
+BVHClass::~BVHClass()
+{
+}
+
+/*
+ *	Build()
+ *	brief: Builds the tree over the boxes of the objects. The object numbers are their positions in the stream.
+ *	param bounds: The world space boxes of the objects; the radius is not used.
+ */
+bool BVHClass::Build(const BoundsStream& bounds, unsigned int objectCount)
+{
+	//The arrays are only reallocated when the tree grows.
+	if (objectCount > m_capacity)
+	{
+		Shutdown();
+
+		m_nodes = (BVHNode*)AlignedAlloc(sizeof(BVHNode) * (2 * objectCount - 1), 64);
+		m_parents = new unsigned int[2 * objectCount - 1];
+		m_objectOrder = new unsigned int[objectCount];
+		m_objectLeaves = new unsigned int[objectCount];
+		m_objectMin = new XMFLOAT3[objectCount];
+		m_objectMax = new XMFLOAT3[objectCount];
+		if (!m_nodes)
+		{
+			Shutdown();
+			return false;
+		}
+		m_capacity = objectCount;
+	}
+
+	m_objectCount = objectCount;
+	for (unsigned int i = 0; i < objectCount; i++)
+	{
+		m_objectMin[i] = XMFLOAT3(bounds.centerX[i] - bounds.extentX[i], bounds.centerY[i] - bounds.extentY[i],
+								  bounds.centerZ[i] - bounds.extentZ[i]);
+		m_objectMax[i] = XMFLOAT3(bounds.centerX[i] + bounds.extentX[i], bounds.centerY[i] + bounds.extentY[i],
+								  bounds.centerZ[i] + bounds.extentZ[i]);
+	}
+
+	BuildTree();
+	return true;
+}
+
+void BVHClass::Shutdown()
+{
+	if (m_nodes)
+	{
+		AlignedFree(m_nodes);
+		m_nodes = nullptr;
+	}
+	delete[] m_parents;
+	m_parents = nullptr;
+	delete[] m_objectOrder;
+	m_objectOrder = nullptr;
+	delete[] m_objectLeaves;
+	m_objectLeaves = nullptr;
+	delete[] m_objectMin;
+	m_objectMin = nullptr;
+	delete[] m_objectMax;
+	m_objectMax = nullptr;
+
+	m_objectCount = 0;
+	m_nodeCount = 0;
+	m_capacity = 0;
+}
+
+/*
+ *	MoveObject()
+ *	brief: Changes the box of one object and grows or shrinks the nodes above it. It is cheap, so it suits a few
+ *		   objects moving; when most of them do, Refit() is faster.
+ *	param center: The new world space center of the box.
+ *	param extent: Half the size of the box along each axis.
+ */
+void BVHClass::MoveObject(unsigned int object, const XMFLOAT3& center, const XMFLOAT3& extent)
+{
+	unsigned int node;
+
+	m_objectMin[object] = XMFLOAT3(center.x - extent.x, center.y - extent.y, center.z - extent.z);
+	m_objectMax[object] = XMFLOAT3(center.x + extent.x, center.y + extent.y, center.z + extent.z);
+
+	node = m_objectLeaves[object];
+	SetLeafBounds(node);
+	for (node = m_parents[node]; node != BVH_NO_PARENT; node = m_parents[node])
+	{
+		UpdateFromChildren(node);
+	}
+}
+
+/*
+ *	Refit()
+ *	brief: Takes the new boxes of every object and fits the nodes to them, from the leaves up, keeping the shape of
+ *		   the tree. If the objects have moved so much that the tree is BVH_REBUILD_RATIO times worse than when it was
+ *		   built, it is built again.
+ *	param bounds: The world space boxes of the same objects the tree was built with.
+ *	return: True if the tree was rebuilt.
+ */
+bool BVHClass::Refit(const BoundsStream& bounds)
+{
+	for (unsigned int i = 0; i < m_objectCount; i++)
+	{
+		m_objectMin[i] = XMFLOAT3(bounds.centerX[i] - bounds.extentX[i], bounds.centerY[i] - bounds.extentY[i],
+								  bounds.centerZ[i] - bounds.extentZ[i]);
+		m_objectMax[i] = XMFLOAT3(bounds.centerX[i] + bounds.extentX[i], bounds.centerY[i] + bounds.extentY[i],
+								  bounds.centerZ[i] + bounds.extentZ[i]);
+	}
+
+	//Children are always stored after their parent, so walking backwards updates them first.
+	for (unsigned int node = m_nodeCount; node-- > 0;)
+	{
+		if (m_nodes[node].objectCount)
+		{
+			SetLeafBounds(node);
+		}
+		else
+		{
+			UpdateFromChildren(node);
+		}
+	}
+
+	if (ComputeCost() > m_buildCost * BVH_REBUILD_RATIO)
+	{
+		BuildTree();
+		return true;
+	}
+	return false;
+}
+
+/*
+ *	Cull()
+ *	brief: Finds the objects in the view of the frustum. Subtrees outside of a plane are skipped whole, and the
+ *		   planes a node is inside of are not tested again below it, so subtrees fully in the view are taken
+ *		   without testing them. The counts are added to the statistics of the frustum.
+ *	param visibleObjects: Receives the numbers of the visible objects. It must have room for all of them.
+ *	return: The number of visible objects.
+ */
+unsigned int BVHClass::Cull(FrustumClass* frustum, unsigned int* visibleObjects)
+{
+	unsigned int stack[BVH_STACK_SIZE], masks[BVH_STACK_SIZE];
+	XMFLOAT4 frustumPlanes[6];
+	PlaneSet planes;
+	unsigned int stackSize = 0, visibleCount = 0, node, mask, objectMask, first, last;
+	BoxTestResult result;
+
+	m_visitedNodes = 0;
+	if (m_objectCount == 0)
+	{
+		frustum->AddCullingStatistics(0, 0);
+		return 0;
+	}
+
+	frustum->GetPlanes(frustumPlanes);
+	for (int i = 0; i < 8; i++)
+	{
+		planes.x[i] = i < 6 ? frustumPlanes[i].x : 0.0f;
+		planes.y[i] = i < 6 ? frustumPlanes[i].y : 0.0f;
+		planes.z[i] = i < 6 ? frustumPlanes[i].z : 0.0f;
+		planes.w[i] = i < 6 ? frustumPlanes[i].w : 1.0f;
+	}
+
+	stack[stackSize] = 0;
+	masks[stackSize++] = BVH_ALL_PLANES;
+	while (stackSize)
+	{
+		node = stack[--stackSize];
+		mask = masks[stackSize];
+
+		m_visitedNodes++;
+		result = g_boxTest(planes, m_nodes[node].boundsMin, m_nodes[node].boundsMax, mask);
+		if (result == BOX_OUTSIDE)
+		{
+			continue;
+		}
+
+		if (result == BOX_INSIDE)
+		{
+			//The objects of a subtree are together in the object order, from its leftmost leaf to its rightmost one.
+			for (first = node; !m_nodes[first].objectCount; first++)
+			{
+			}
+			for (last = node; !m_nodes[last].objectCount; last = m_nodes[last].index)
+			{
+			}
+
+			memcpy(visibleObjects + visibleCount, m_objectOrder + m_nodes[first].index,
+				   sizeof(unsigned int) * (m_nodes[last].index + m_nodes[last].objectCount - m_nodes[first].index));
+			visibleCount += m_nodes[last].index + m_nodes[last].objectCount - m_nodes[first].index;
+			continue;
+		}
+
+		if (m_nodes[node].objectCount)
+		{
+			for (unsigned int i = 0; i < m_nodes[node].objectCount; i++)
+			{
+				const unsigned int object = m_objectOrder[m_nodes[node].index + i];
+
+				objectMask = mask;
+				if (m_nodes[node].objectCount == 1 || g_boxTest(planes, m_objectMin[object], m_objectMax[object], objectMask) != BOX_OUTSIDE)
+				{
+					visibleObjects[visibleCount++] = object;
+				}
+			}
+			continue;
+		}
+
+		//The left child goes on top, to be tested next.
+		stack[stackSize] = m_nodes[node].index;
+		masks[stackSize++] = mask;
+		stack[stackSize] = node + 1;
+		masks[stackSize++] = mask;
+	}
+
+	frustum->AddCullingStatistics(visibleCount, m_objectCount - visibleCount);
+	return visibleCount;
+}
+
+/*
+ *	IntersectRay()
+ *	brief: Finds the first object box hit by a ray, to pick objects. The nearer child is visited first, and subtrees
+ *		   farther than the closest hit so far are skipped.
+ *	param direction: The direction of the ray; it doesn't need to be normalized, distances are in its length.
+ *	param maxDistance: How far along the ray to look.
+ *	param object: Receives the number of the object hit.
+ *	param distance: Receives where the ray enters its box, 0 if it starts inside.
+ *	return: False if the ray doesn't hit any object.
+ */
+bool BVHClass::IntersectRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, unsigned int& object,
+							float& distance)
+{
+	unsigned int stack[BVH_STACK_SIZE];
+	unsigned int stackSize = 0, node, nearChild, farChild;
+	float nearDistance, farDistance, objectDistance;
+	XMFLOAT3 inverseDirection;
+	bool bHit = false;
+
+	if (m_objectCount == 0)
+	{
+		return false;
+	}
+
+	//Axes the ray is parallel to get infinities, which the slab test handles.
+	inverseDirection = XMFLOAT3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+	distance = maxDistance;
+
+	if (IntersectBox(origin, inverseDirection, m_nodes[0].boundsMin, m_nodes[0].boundsMax, distance) == FLT_MAX)
+	{
+		return false;
+	}
+
+	stack[stackSize++] = 0;
+	while (stackSize)
+	{
+		node = stack[--stackSize];
+
+		if (m_nodes[node].objectCount)
+		{
+			for (unsigned int i = 0; i < m_nodes[node].objectCount; i++)
+			{
+				const unsigned int candidate = m_objectOrder[m_nodes[node].index + i];
+
+				objectDistance = IntersectBox(origin, inverseDirection, m_objectMin[candidate], m_objectMax[candidate], distance);
+				if (objectDistance != FLT_MAX && (!bHit || objectDistance < distance))
+				{
+					distance = objectDistance;
+					object = candidate;
+					bHit = true;
+				}
+			}
+			continue;
+		}
+
+		nearChild = node + 1;
+		farChild = m_nodes[node].index;
+		nearDistance = IntersectBox(origin, inverseDirection, m_nodes[nearChild].boundsMin, m_nodes[nearChild].boundsMax, distance);
+		farDistance = IntersectBox(origin, inverseDirection, m_nodes[farChild].boundsMin, m_nodes[farChild].boundsMax, distance);
+		if (farDistance < nearDistance)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearDistance, farDistance);
+		}
+
+		if (farDistance != FLT_MAX)
+		{
+			stack[stackSize++] = farChild;
+		}
+		if (nearDistance != FLT_MAX)
+		{
+			stack[stackSize++] = nearChild;
+		}
+	}
+
+	return bHit;
+}
+
+unsigned int BVHClass::GetObjectCount()
+{
+	return m_objectCount;
+}
+
+unsigned int BVHClass::GetNodeCount()
+{
+	return m_nodeCount;
+}
+
+//Expected cost of a query with the surface area heuristic, in box tests.
+float BVHClass::GetCost()
+{
+	return ComputeCost();
+}
+
+//Nodes tested by the last Cull(), to see how much of the tree it had to walk.
+unsigned int BVHClass::GetVisitedNodes()
+{
+	return m_visitedNodes;
+}
+
+void BVHClass::BuildTree()
+{
+	float* centroids;
+
+	m_nodeCount = 0;
+	if (m_objectCount == 0)
+	{
+		m_buildCost = 0.0f;
+		return;
+	}
+
+	centroids = new float[m_objectCount * 3];
+	for (unsigned int i = 0; i < m_objectCount; i++)
+	{
+		m_objectOrder[i] = i;
+		centroids[i * 3 + 0] = (m_objectMin[i].x + m_objectMax[i].x) * 0.5f;
+		centroids[i * 3 + 1] = (m_objectMin[i].y + m_objectMax[i].y) * 0.5f;
+		centroids[i * 3 + 2] = (m_objectMin[i].z + m_objectMax[i].z) * 0.5f;
+	}
+
+	BuildNode(0, m_objectCount, BVH_NO_PARENT, 0, centroids);
+
+	delete[] centroids;
+	m_buildCost = ComputeCost();
+}
+
+/*
+ *	BuildNode()
+ *	brief: Builds the subtree over a range of the object order, splitting it where the surface area heuristic says
+ *		   is cheapest among BVH_SAH_BINS candidates per axis. The range is reordered to the order of the leaves.
+ *	param centroids: The center of the box of every object.
+ *	return: The index of the node.
+ */
+unsigned int BVHClass::BuildNode(unsigned int first, unsigned int count, unsigned int parent, unsigned int depth,
+								 const float* centroids)
+{
+	unsigned int binCounts[BVH_SAH_BINS], leftCount, bestAxis = 3, bestSplit = 0, node, bin, i, j;
+	XMFLOAT3 binMin[BVH_SAH_BINS], binMax[BVH_SAH_BINS], boxMin, boxMax;
+	float centroidMin[3], centroidMax[3], rightArea[BVH_SAH_BINS], cost, bestCost, scale;
+	const float* centroid;
+
+	node = m_nodeCount++;
+	m_parents[node] = parent;
+
+	//Bounds of the objects and of their centers.
+	m_nodes[node].boundsMin = m_objectMin[m_objectOrder[first]];
+	m_nodes[node].boundsMax = m_objectMax[m_objectOrder[first]];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		centroidMin[axis] = centroidMax[axis] = centroids[m_objectOrder[first] * 3 + axis];
+	}
+	for (i = first + 1; i < first + count; i++)
+	{
+		GrowBox(m_nodes[node].boundsMin, m_nodes[node].boundsMax, m_objectMin[m_objectOrder[i]], m_objectMax[m_objectOrder[i]]);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			centroidMin[axis] = std::min(centroidMin[axis], centroids[m_objectOrder[i] * 3 + axis]);
+			centroidMax[axis] = std::max(centroidMax[axis], centroids[m_objectOrder[i] * 3 + axis]);
+		}
+	}
+
+	if (count <= BVH_MAX_LEAF_OBJECTS)
+	{
+		m_nodes[node].index = first;
+		m_nodes[node].objectCount = count;
+		for (i = first; i < first + count; i++)
+		{
+			m_objectLeaves[m_objectOrder[i]] = node;
+		}
+		return node;
+	}
+
+	//Cost of every split relative to the area of the node, left area * left count + right area * right count.
+	bestCost = FLT_MAX;
+	if (depth < BVH_SAH_MAX_DEPTH)
+	{
+		for (unsigned int axis = 0; axis < 3; axis++)
+		{
+			if (centroidMax[axis] <= centroidMin[axis])
+			{
+				continue;
+			}
+
+			scale = BVH_SAH_BINS / (centroidMax[axis] - centroidMin[axis]);
+			for (bin = 0; bin < BVH_SAH_BINS; bin++)
+			{
+				binCounts[bin] = 0;
+				binMin[bin] = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+				binMax[bin] = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			}
+			for (i = first; i < first + count; i++)
+			{
+				bin = std::min((unsigned int)((centroids[m_objectOrder[i] * 3 + axis] - centroidMin[axis]) * scale), BVH_SAH_BINS - 1);
+				binCounts[bin]++;
+				GrowBox(binMin[bin], binMax[bin], m_objectMin[m_objectOrder[i]], m_objectMax[m_objectOrder[i]]);
+			}
+
+			//Areas right of every split from one sweep, then the costs from a sweep the other way.
+			boxMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			boxMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (bin = BVH_SAH_BINS - 1; bin > 0; bin--)
+			{
+				GrowBox(boxMin, boxMax, binMin[bin], binMax[bin]);
+				rightArea[bin] = HalfArea(boxMin, boxMax);
+			}
+
+			boxMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+			boxMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			leftCount = 0;
+			for (bin = 1; bin < BVH_SAH_BINS; bin++)
+			{
+				GrowBox(boxMin, boxMax, binMin[bin - 1], binMax[bin - 1]);
+				leftCount += binCounts[bin - 1];
+				if (leftCount == 0 || leftCount == count)
+				{
+					continue;
+				}
+
+				cost = HalfArea(boxMin, boxMax) * leftCount + rightArea[bin] * (count - leftCount);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = bin;
+				}
+			}
+		}
+	}
+
+	if (bestAxis < 3)
+	{
+		//Objects in the bins left of the split go first.
+		scale = BVH_SAH_BINS / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		i = first;
+		j = first + count;
+		while (i < j)
+		{
+			centroid = centroids + m_objectOrder[i] * 3;
+			bin = std::min((unsigned int)((centroid[bestAxis] - centroidMin[bestAxis]) * scale), BVH_SAH_BINS - 1);
+			if (bin < bestSplit)
+			{
+				i++;
+			}
+			else
+			{
+				std::swap(m_objectOrder[i], m_objectOrder[--j]);
+			}
+		}
+		leftCount = i - first;
+	}
+	else
+	{
+		//Too deep, or every center is in the same place: split at the median of the widest axis.
+		bestAxis = 0;
+		for (unsigned int axis = 1; axis < 3; axis++)
+		{
+			if (centroidMax[axis] - centroidMin[axis] > centroidMax[bestAxis] - centroidMin[bestAxis])
+			{
+				bestAxis = axis;
+			}
+		}
+
+		leftCount = count / 2;
+		std::nth_element(m_objectOrder + first, m_objectOrder + first + leftCount, m_objectOrder + first + count,
+						 CentroidLess(centroids, bestAxis));
+	}
+
+	//The left child has to be built first to be the next node.
+	BuildNode(first, leftCount, node, depth + 1, centroids);
+	m_nodes[node].index = BuildNode(first + leftCount, count - leftCount, node, depth + 1, centroids);
+	m_nodes[node].objectCount = 0;
+
+	return node;
+}
+
+void BVHClass::SetLeafBounds(unsigned int node)
+{
+	BVHNode& leaf = m_nodes[node];
+
+	leaf.boundsMin = m_objectMin[m_objectOrder[leaf.index]];
+	leaf.boundsMax = m_objectMax[m_objectOrder[leaf.index]];
+	for (unsigned int i = 1; i < leaf.objectCount; i++)
+	{
+		GrowBox(leaf.boundsMin, leaf.boundsMax, m_objectMin[m_objectOrder[leaf.index + i]], m_objectMax[m_objectOrder[leaf.index + i]]);
+	}
+}
+
+void BVHClass::UpdateFromChildren(unsigned int node)
+{
+	m_nodes[node].boundsMin = m_nodes[node + 1].boundsMin;
+	m_nodes[node].boundsMax = m_nodes[node + 1].boundsMax;
+	GrowBox(m_nodes[node].boundsMin, m_nodes[node].boundsMax, m_nodes[m_nodes[node].index].boundsMin,
+			m_nodes[m_nodes[node].index].boundsMax);
+}
+
+//Every node is tested as often as the ray or view hits it, which is proportional to its area.
+float BVHClass::ComputeCost()
+{
+	float cost = 0.0f, rootArea;
+
+	if (m_nodeCount == 0)
+	{
+		return 0.0f;
+	}
+
+	for (unsigned int node = 0; node < m_nodeCount; node++)
+	{
+		cost += HalfArea(m_nodes[node].boundsMin, m_nodes[node].boundsMax) * (1.0f + m_nodes[node].objectCount);
+	}
+
+	rootArea = HalfArea(m_nodes[0].boundsMin, m_nodes[0].boundsMax);
+	return rootArea > 0.0f ? cost / rootArea : (float)m_nodeCount;
+}
+
+SimdLevel GetBVHSimdLevel()
+{
+	return g_bvhLevel;
+}
+
+/*
+ *	SetBVHSimdLevel()
+ *	brief: Forces the box test of a narrower instruction set, to compare them. It must not be called while culling.
+ *	return: False if the CPU doesn't support that instruction set.
+ */
+bool SetBVHSimdLevel(SimdLevel level)
+{
+	if (level > g_supportedLevel)
+	{
+		return false;
+	}
+
+	g_bvhLevel = level;
+	g_boxTest = SelectBoxTest(level);
+	return true;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef BVH_CLASS
+#define BVH_CLASS
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "SimdSupport.h"
+#include "FrustumClass.h"
+#include <DirectXMath.h>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int BVH_MAX_LEAF_OBJECTS = 4;	//Leaves hold up to this many objects.
+const unsigned int BVH_SAH_BINS = 16;			//Candidate splits per axis when building.
+const float		   BVH_REBUILD_RATIO = 2.0f;	//How much worse the tree may get by refitting before it is rebuilt.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*	A node of the tree, 32 bytes so two share a cache line. The nodes are stored depth first, so the left child of
+	an inner node is always the next one and only the right one needs an index.										*/
+struct BVHNode
+{
+	XMFLOAT3	 boundsMin;
+	unsigned int index;			//Leaves: first object in the object order. Inner nodes: the right child.
+	XMFLOAT3	 boundsMax;
+	unsigned int objectCount;	//0 for inner nodes.
+};
+
+/*
+ *	BVHClass
+ *	brief: Bounding volume hierarchy over the world space boxes of the objects of a scene, to cull them or find the
+ *		   one under a ray without testing every object. It is built with the surface area heuristic and refitted
+ *		   when objects move, and rebuilt when refitting has made it too loose.
+ */
+class BVHClass
+{
+public:
+	BVHClass();
+	BVHClass(const BVHClass&);
+	~BVHClass();
+
+	bool Build(const BoundsStream& bounds, unsigned int objectCount);
+	void Shutdown();
+
+	void MoveObject(unsigned int object, const XMFLOAT3& center, const XMFLOAT3& extent);
+	bool Refit(const BoundsStream& bounds);
+
+	unsigned int Cull(FrustumClass* frustum, unsigned int* visibleObjects);
+	bool IntersectRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, unsigned int& object,
+					  float& distance);
+
+	unsigned int GetObjectCount();
+	unsigned int GetNodeCount();
+	float GetCost();
+	unsigned int GetVisitedNodes();
+
+private:
+	void BuildTree();
+	unsigned int BuildNode(unsigned int first, unsigned int count, unsigned int parent, unsigned int depth,
+						   const float* centroids);
+	void SetLeafBounds(unsigned int node);
+	void UpdateFromChildren(unsigned int node);
+	float ComputeCost();
+
+private:
+	BVHNode*	  m_nodes;			//Aligned to a cache line.
+	unsigned int* m_parents;		//Parent of every node, for refitting from a single leaf.
+	unsigned int* m_objectOrder;	//Objects in leaf order.
+	unsigned int* m_objectLeaves;	//Leaf of every object.
+	XMFLOAT3*	  m_objectMin;		//World space box of every object.
+	XMFLOAT3*	  m_objectMax;
+	unsigned int  m_objectCount, m_nodeCount, m_capacity;
+	float		  m_buildCost;		//SAH cost right after building, to know when a rebuild pays off.
+	unsigned int  m_visitedNodes;	//Nodes tested by the last Cull().
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+SimdLevel GetBVHSimdLevel();
+bool SetBVHSimdLevel(SimdLevel level);
+
+#endif
@@ -0,0 +1,313 @@
+#include "BatchRenderer.h"
+#include "FrameWriter.h"
+#include "GraphicsClass.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+typedef std::chrono::steady_clock BatchClock;
+
+struct CameraKey
+{
+	float	 frame;
+	XMFLOAT3 position;
+	XMFLOAT3 rotation;
+};
+
+//What a job file asks for.
+struct BatchJob
+{
+	std::string			   modelFilename;
+	int					   width;
+	int					   height;
+	unsigned int		   frameCount;
+	RenderBackend		   backend;
+	std::string			   outputPattern;
+	FrameFileFormat		   format;
+	std::vector<CameraKey> cameraPath;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+/*
+ *	ReadBatchJob()
+ *	brief: Reads the settings of a job file, described with RunBatchRender(), and sorts the keys of the camera.
+ *	param error: Receives what is wrong with the file if it can't be used.
+ */
+static bool ReadBatchJob(const char* filename, BatchJob& job, std::string& error)
+{
+	std::ifstream fin;
+	std::string line, name, value;
+	CameraKey key;
+	int lineNumber;
+
+	job.modelFilename.clear();
+	job.width = 0;
+	job.height = 0;
+	job.frameCount = 0;
+	job.backend = RENDER_BACKEND;
+	job.outputPattern.clear();
+	job.format = FRAME_FILE_PNG;
+	job.cameraPath.clear();
+
+	fin.open(filename);
+	if (!fin)
+	{
+		error = std::string("can't open ") + filename;
+		return false;
+	}
+
+	for (lineNumber = 1; std::getline(fin, line); lineNumber++)
+	{
+		std::istringstream tokens(line.substr(0, line.find('#')));
+		if (!(tokens >> name))
+		{
+			continue;
+		}
+
+		if (name == "model")
+		{
+			tokens >> job.modelFilename;
+		}
+		else if (name == "size")
+		{
+			tokens >> job.width >> job.height;
+		}
+		else if (name == "frames")
+		{
+			tokens >> job.frameCount;
+		}
+		else if (name == "backend" && tokens >> value)
+		{
+			if (value == "software") job.backend = RENDER_BACKEND_SOFTWARE;
+			else if (value == "hardware") job.backend = RENDER_BACKEND_HARDWARE;
+			else tokens.setstate(std::ios::failbit);
+		}
+		else if (name == "output")
+		{
+			tokens >> job.outputPattern;
+		}
+		else if (name == "format" && tokens >> value)
+		{
+			if (value == "png") job.format = FRAME_FILE_PNG;
+			else if (value == "raw") job.format = FRAME_FILE_RAW;
+			else if (value == "lz4") job.format = FRAME_FILE_LZ4;
+			else if (value == "exr") job.format = FRAME_FILE_EXR;
+			else tokens.setstate(std::ios::failbit);
+		}
+		else if (name == "camera")
+		{
+			tokens >> key.frame >> key.position.x >> key.position.y >> key.position.z >> key.rotation.x >>
+				key.rotation.y >> key.rotation.z;
+			job.cameraPath.push_back(key);
+		}
+		else
+		{
+			tokens.setstate(std::ios::failbit);
+		}
+
+		if (tokens.fail())
+		{
+			error = std::string(filename) + ":" + std::to_string(lineNumber) + ": can't read \"" + line + "\"";
+			return false;
+		}
+	}
+
+	if (job.width <= 0 || job.height <= 0 || job.frameCount == 0 || job.outputPattern.empty())
+	{
+		error = std::string(filename) + ": size, frames and output are needed";
+		return false;
+	}
+
+	std::stable_sort(job.cameraPath.begin(), job.cameraPath.end(),
+					 [](const CameraKey& a, const CameraKey& b) { return a.frame < b.frame; });
+	return true;
+}
+
+//Where the camera is at a frame, in a straight line between the keys around it. Without keys it stays at the start.
+static void SampleCameraPath(const std::vector<CameraKey>& path, float frame, XMFLOAT3& position, XMFLOAT3& rotation)
+{
+	unsigned int next;
+	float t;
+
+	if (path.empty())
+	{
+		position = XMFLOAT3(0.0f, 0.0f, -5.0f);
+		rotation = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return;
+	}
+
+	for (next = 0; next < path.size() && path[next].frame <= frame; next++)
+	{
+	}
+	if (next == 0 || next == path.size())
+	{
+		position = path[next == 0 ? 0 : next - 1].position;
+		rotation = path[next == 0 ? 0 : next - 1].rotation;
+		return;
+	}
+
+	const CameraKey& a = path[next - 1];
+	const CameraKey& b = path[next];
+	t = (frame - a.frame) / (b.frame - a.frame);
+	position = XMFLOAT3(a.position.x + (b.position.x - a.position.x) * t, a.position.y + (b.position.y - a.position.y) * t,
+						a.position.z + (b.position.z - a.position.z) * t);
+	rotation = XMFLOAT3(a.rotation.x + (b.rotation.x - a.rotation.x) * t, a.rotation.y + (b.rotation.y - a.rotation.y) * t,
+						a.rotation.z + (b.rotation.z - a.rotation.z) * t);
+}
+
+//Hands the oldest frame read back to the writer.
+static bool WriteReadback(RenderDevice* device, RenderReadback* readback, bool wait, FrameWriterClass* writer,
+						  double& readbackSeconds, bool& bWritten)
+{
+	BatchClock::time_point start;
+	ReadbackImage image;
+	bool bResult;
+
+	start = BatchClock::now();
+	bWritten = device->MapReadback(readback, wait, image);
+	readbackSeconds += std::chrono::duration<double>(BatchClock::now() - start).count();
+	if (!bWritten)
+	{
+		return true;
+	}
+
+	bResult = writer->WriteFrame(image);
+	device->UnmapReadback(readback);
+	return bResult;
+}
+
+bool RunBatchRender(const char* commandLine, const char* reportFilename)
+{
+	BatchJob job;
+	GraphicsClass* graphics;
+	FrameWriterClass* writer;
+	RenderDevice* device;
+	RenderTarget* target;
+	RenderReadback* readback;
+	RenderTargetDesc targetDesc;
+	FrameWriterStatistics writerStatistics;
+	BatchClock::time_point start, frameStart;
+	std::ofstream fout;
+	std::string filename, error;
+	XMFLOAT3 position, rotation;
+	const char* arguments;
+	double seconds, renderSeconds, readbackSeconds;
+	unsigned int frame;
+	bool bResult, bWritten;
+
+	fout.open(reportFilename);
+	if (!fout)
+	{
+		return false;
+	}
+
+	arguments = strstr(commandLine, BATCH_SWITCH);
+	arguments = arguments ? arguments + strlen(BATCH_SWITCH) : "";
+	std::istringstream(arguments) >> filename;
+
+	if (!ReadBatchJob(filename.c_str(), job, error))
+	{
+		fout << "Batch: " << error << "\n";
+		return false;
+	}
+
+	graphics = new GraphicsClass();
+	writer = new FrameWriterClass();
+	device = nullptr;
+	target = nullptr;
+	readback = nullptr;
+
+	//The scene renders into a target of its own, read back a few frames late so the device never waits for the copy.
+	bResult = graphics->Initialize(job.width, job.height, NULL, job.backend,
+								   job.modelFilename.empty() ? nullptr : job.modelFilename.c_str());
+	if (bResult)
+	{
+		device = graphics->GetRenderDevice();
+		targetDesc.width = job.width;
+		targetDesc.height = job.height;
+		targetDesc.format = RENDER_TARGET_FORMAT_RGBA8;
+		bResult = device->CreateRenderTarget(targetDesc, &target) &&
+				  device->CreateReadback(target, BATCH_READBACK_DEPTH, &readback);
+	}
+	if (!bResult)
+	{
+		fout << "Batch: could not create the renderer\n";
+	}
+	else if (!writer->Initialize(job.outputPattern.c_str(), job.format, BATCH_WRITER_FRAMES, 0, BATCH_UNBUFFERED_WRITES))
+	{
+		fout << "Batch: could not write " << job.outputPattern << "\n";
+		bResult = false;
+	}
+	else
+	{
+		device->SetRenderTarget(target);
+
+		renderSeconds = 0.0;
+		readbackSeconds = 0.0;
+		start = BatchClock::now();
+		for (frame = 0; frame < job.frameCount && bResult; frame++)
+		{
+			SampleCameraPath(job.cameraPath, (float)frame, position, rotation);
+			graphics->SetCamera(position, rotation);
+
+			frameStart = BatchClock::now();
+			bResult = graphics->Frame();
+			renderSeconds += std::chrono::duration<double>(BatchClock::now() - frameStart).count();
+
+			//Only waits for a copy when the ring is full, and then writes whatever else is done.
+			while (bResult && !device->QueueReadback(readback, frame))
+			{
+				bResult = WriteReadback(device, readback, true, writer, readbackSeconds, bWritten);
+			}
+			for (bWritten = true; bResult && bWritten;)
+			{
+				bResult = WriteReadback(device, readback, false, writer, readbackSeconds, bWritten);
+			}
+		}
+		for (bWritten = true; bResult && bWritten;)
+		{
+			bResult = WriteReadback(device, readback, true, writer, readbackSeconds, bWritten);
+		}
+		bResult = writer->Flush() && bResult;
+		seconds = std::chrono::duration<double>(BatchClock::now() - start).count();
+
+		device->SetRenderTarget(nullptr);
+		writer->GetStatistics(writerStatistics);
+
+		fout << "Batch: " << filename << ", " << frame << " frames of " << job.width << "x" << job.height << " to "
+			 << job.outputPattern << (bResult ? "" : ", FAILED") << "\n";
+		fout << std::fixed << std::setprecision(2) << "  frames per second:     " << writerStatistics.framesWritten / seconds
+			 << "\n  seconds:               " << seconds
+			 << "\n  rendering:             " << renderSeconds
+			 << "\n  waiting for readback:  " << readbackSeconds
+			 << "\n  waiting for writer:    " << writerStatistics.stallSeconds
+			 << "\n  encoding (writer):     " << writerStatistics.encodeSeconds
+			 << "\n  writing (writer):      " << writerStatistics.writeSeconds
+			 << "\n  megabytes written:     " << writerStatistics.bytesWritten / (1024.0 * 1024.0)
+			 << "\n  compression ratio:     " << (writerStatistics.bytesWritten ? (double)writerStatistics.pixelBytes / writerStatistics.bytesWritten : 0.0)
+			 << "\n  unbuffered files:      " << writerStatistics.unbufferedFiles << "\n";
+	}
+
+	writer->Shutdown();
+	delete writer;
+	if (device)
+	{
+		device->ReleaseReadback(readback);
+		device->ReleaseRenderTarget(target);
+	}
+	graphics->Shutdown();
+	delete graphics;
+
+	return bResult;
+}
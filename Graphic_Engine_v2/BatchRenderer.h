@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef BATCH_RENDERER
+#define BATCH_RENDERER
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const char BATCH_SWITCH[] = "-batch";				//Command line switch followed by a job file that renders it without a window.
+const char BATCH_REPORT_FILE[] = "batch.txt";
+const unsigned int BATCH_READBACK_DEPTH = 3;		//Frames copied back from the device at once.
+const unsigned int BATCH_WRITER_FRAMES = 4;			//Frames waiting to be written at most, which bounds the memory.
+const bool BATCH_UNBUFFERED_WRITES = true;			//Writes the frames around the file cache.
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+/*
+ *	RunBatchRender()
+ *	brief: Renders the frames of the job file named after the switch in the command line, for example
+ *		   "-batch flyby.txt", through GraphicsClass without a window, writes every frame to a file on a thread of
+ *		   its own, and reports the frames per second of the whole run to a text file. The job file has a setting
+ *		   per line, and # starts a comment:
+ *
+ *			 model frames/ship.obj				OBJ or PLY model of the scene. Without one the built in triangle.
+ *			 size 1920 1080						Of the frames.
+ *			 frames 240
+ *			 backend software					Or hardware. Without it, RENDER_BACKEND.
+ *			 output frames/ship_%04d.png		printf pattern of the files, with the number of the frame.
+ *			 format png							Or raw, lz4 or exr.
+ *			 camera 0 0 0 -5 0 0 0				Key of the camera path: frame, position and rotation in degrees.
+ *
+ *		   The camera moves in straight lines between its keys and stays at the first and last one before and after
+ *		   them.
+ *	return: False if the job couldn't be read or a frame couldn't be rendered or written.
+ */
+bool RunBatchRender(const char* commandLine, const char* reportFilename);
+
+#endif
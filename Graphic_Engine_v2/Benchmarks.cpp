@@ -0,0 +1,2668 @@
+#include "Benchmarks.h"
+#include "BVHClass.h"
+#include "ColorShader.h"
+#include "FramePipeline.h"
+#include "FrustumClass.h"
+#include "JobSystem.h"
+#include "MeshLoader.h"
+#include "ModelClass.h"
+#include "PixelKernel.h"
+#include "Profiler.h"
+#include "RasterizerKernel.h"
+#include "RenderQueue.h"
+#include "SceneGraph.h"
+#include "ShaderCache.h"
+#include "SoftwareRenderer.h"
+#include "VertexProcessor.h"
+#ifdef _WIN32
+#include "D3DClass.h"
+#endif
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const int	BENCHMARK_WIDTH = 1920;
+static const int	BENCHMARK_HEIGHT = 1080;
+static const int	BENCHMARK_TILE_SIZE = 64;
+static const double BENCHMARK_MIN_SECONDS = 0.5;		//Every case repeats its work until it takes at least this long.
+static const unsigned int BENCHMARK_VERTEX_COUNT = 1 << 20;
+static const int	BENCHMARK_FRAME_WIDTH = 1280;			//Size of the frames rendered by the software device.
+static const int	BENCHMARK_FRAME_HEIGHT = 720;
+static const int	BENCHMARK_MESH_SIDE = 724;				//Vertices per side of the grid mesh, about a million triangles.
+static const char	BENCHMARK_MESH_FILE[] = "benchmark_mesh.obj";
+static const unsigned int BENCHMARK_OBJECT_COUNT = 100000;		//Objects spread around the camera to cull.
+static const float	BENCHMARK_SCENE_SIZE = 200.0f;
+static const char	BENCHMARK_SHADER_CACHE_FILE[] = "benchmark.shadercache";
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+typedef std::chrono::high_resolution_clock BenchmarkClock;
+
+//Triangles already snapped to the sub-pixel grid, three vertices each.
+struct RasterBenchmarkCase
+{
+	const char*		 name;
+	std::vector<int> x;
+	std::vector<int> y;
+};
+
+/*
+ *	BenchmarkRandom()
+ *	brief: A small linear congruential generator, so every run draws the same triangles.
+ */
+static unsigned int BenchmarkRandom(unsigned int& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static int CountBits(unsigned long long mask)
+{
+	int count = 0;
+
+	while (mask)
+	{
+		mask &= mask - 1;
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ *	BuildRasterCase()
+ *	brief: Makes right triangles with legs of the given length in pixels at random places of the screen, all of them
+ *		   clockwise so none is culled.
+ */
+static void BuildRasterCase(RasterBenchmarkCase& rasterCase, const char* name, int triangleCount, int size)
+{
+	unsigned int state = 12345;
+	int x, y, legX, legY;
+
+	rasterCase.name = name;
+	for (int i = 0; i < triangleCount; i++)
+	{
+		x = (int)(BenchmarkRandom(state) % (unsigned int)((BENCHMARK_WIDTH - size) << RASTER_SUBPIXEL_BITS));
+		y = (int)(BenchmarkRandom(state) % (unsigned int)((BENCHMARK_HEIGHT - size) << RASTER_SUBPIXEL_BITS));
+		legX = size << RASTER_SUBPIXEL_BITS;
+		legY = size << RASTER_SUBPIXEL_BITS;
+
+		rasterCase.x.push_back(x);
+		rasterCase.y.push_back(y);
+		rasterCase.x.push_back(x + legX);
+		rasterCase.y.push_back(y);
+		rasterCase.x.push_back(x);
+		rasterCase.y.push_back(y + legY);
+	}
+}
+
+/*
+ *	RasterizeCase()
+ *	brief: Sets up every triangle of the case and finds its coverage tile by tile, the same way the software
+ *		   renderer does.
+ *	return: The number of covered pixels.
+ */
+static long long RasterizeCase(const RasterBenchmarkCase& rasterCase, std::vector<CoverageBlock>& blocks)
+{
+	const int pixelOffset = 1 << (RASTER_SUBPIXEL_BITS - 1);
+	const int pixelMask = (1 << RASTER_SUBPIXEL_BITS) - 1;
+	RasterEdges edges;
+	int minX, minY, maxX, maxY, blockCount;
+	long long pixels = 0;
+
+	for (size_t i = 0; i < rasterCase.x.size(); i += 3)
+	{
+		const int* x = &rasterCase.x[i];
+		const int* y = &rasterCase.y[i];
+
+		if (SetupRasterEdges(x, y, edges) <= 0)
+		{
+			continue;
+		}
+
+		minX = std::max((std::min(std::min(x[0], x[1]), x[2]) - pixelOffset + pixelMask) >> RASTER_SUBPIXEL_BITS, 0);
+		minY = std::max((std::min(std::min(y[0], y[1]), y[2]) - pixelOffset + pixelMask) >> RASTER_SUBPIXEL_BITS, 0);
+		maxX = std::min((std::max(std::max(x[0], x[1]), x[2]) - pixelOffset) >> RASTER_SUBPIXEL_BITS, BENCHMARK_WIDTH - 1);
+		maxY = std::min((std::max(std::max(y[0], y[1]), y[2]) - pixelOffset) >> RASTER_SUBPIXEL_BITS, BENCHMARK_HEIGHT - 1);
+
+		for (int tileY = minY / BENCHMARK_TILE_SIZE; tileY <= maxY / BENCHMARK_TILE_SIZE; tileY++)
+		{
+			for (int tileX = minX / BENCHMARK_TILE_SIZE; tileX <= maxX / BENCHMARK_TILE_SIZE; tileX++)
+			{
+				blockCount = RasterizeBlocks(edges, std::max(minX, tileX * BENCHMARK_TILE_SIZE),
+											 std::max(minY, tileY * BENCHMARK_TILE_SIZE),
+											 std::min(maxX, (tileX + 1) * BENCHMARK_TILE_SIZE - 1),
+											 std::min(maxY, (tileY + 1) * BENCHMARK_TILE_SIZE - 1), &blocks[0]);
+
+				for (int j = 0; j < blockCount; j++)
+				{
+					pixels += CountBits(blocks[j].mask);
+				}
+			}
+		}
+	}
+
+	return pixels;
+}
+
+/*
+ *	BenchmarkRasterizer()
+ *	brief: Measures triangle setup and coverage of small, medium and full-screen triangles with every SIMD kernel
+ *		   the CPU supports, in millions of triangles and pixels per second, on one thread.
+ */
+static void BenchmarkRasterizer(std::ofstream& fout)
+{
+	RasterBenchmarkCase cases[3];
+	std::vector<CoverageBlock> blocks((BENCHMARK_TILE_SIZE / RASTER_BLOCK_SIZE) * (BENCHMARK_TILE_SIZE / RASTER_BLOCK_SIZE));
+	SimdLevel supportedLevel;
+	BenchmarkClock::time_point start;
+	double seconds;
+	long long triangles, pixels;
+
+	BuildRasterCase(cases[0], "small (8 px)", 200000, 8);
+	BuildRasterCase(cases[1], "medium (64 px)", 20000, 64);
+
+	//A single triangle twice the size of the screen, the way full-screen passes are drawn.
+	cases[2].name = "full-screen";
+	cases[2].x.push_back(0);
+	cases[2].y.push_back(0);
+	cases[2].x.push_back((2 * BENCHMARK_WIDTH) << RASTER_SUBPIXEL_BITS);
+	cases[2].y.push_back(0);
+	cases[2].x.push_back(0);
+	cases[2].y.push_back((2 * BENCHMARK_HEIGHT) << RASTER_SUBPIXEL_BITS);
+
+	supportedLevel = GetRasterizerSimdLevel();
+
+	fout << "Rasterizer: " << BENCHMARK_WIDTH << "x" << BENCHMARK_HEIGHT << ", 1 thread, CPU supports "
+		 << GetSimdLevelName(supportedLevel) << "\n";
+	fout << std::left << std::setw(16) << "case" << std::setw(10) << "kernel" << std::right << std::setw(12) << "Mtri/s"
+		 << std::setw(12) << "Mpix/s" << "\n";
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int level = SIMD_LEVEL_SCALAR; level <= supportedLevel; level++)
+		{
+			SetRasterizerSimdLevel((SimdLevel)level);
+
+			triangles = 0;
+			pixels = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				pixels += RasterizeCase(cases[i], blocks);
+				triangles += cases[i].x.size() / 3;
+				seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds < BENCHMARK_MIN_SECONDS);
+
+			fout << std::left << std::setw(16) << cases[i].name << std::setw(10) << GetSimdLevelName((SimdLevel)level)
+				 << std::right << std::fixed << std::setprecision(4) << std::setw(12) << triangles / seconds / 1e6
+				 << std::setw(12) << pixels / seconds / 1e6 << "\n";
+		}
+	}
+
+	SetRasterizerSimdLevel(supportedLevel);
+	fout << "\n";
+}
+
+/*
+ *	BenchmarkTransform()
+ *	brief: Measures the clip space transform of a million positions, first the way the vertex shader used to do it
+ *		   (three matrices transposed and applied to every vertex) and then as a stream with one world-view-projection
+ *		   matrix and every SIMD kernel the CPU supports.
+ */
+static void BenchmarkTransform(std::ofstream& fout)
+{
+	std::vector<float> input(3 * BENCHMARK_VERTEX_COUNT), output(4 * BENCHMARK_VERTEX_COUNT);
+	std::vector<unsigned char> outcodes(BENCHMARK_VERTEX_COUNT);
+	XMFLOAT4X4 matrices[3];
+	XMMATRIX worldMatrix, viewMatrix, projectionMatrix;
+	PositionStream positionStream;
+	ClipStream clipStream;
+	SimdLevel supportedLevel;
+	BenchmarkClock::time_point start;
+	double seconds;
+	long long vertices;
+	unsigned int state = 12345;
+
+	for (unsigned int i = 0; i < 3 * BENCHMARK_VERTEX_COUNT; i++)
+	{
+		input[i] = (float)(BenchmarkRandom(state) % 2001) * 0.01f - 10.0f;
+	}
+
+	worldMatrix = XMMatrixRotationY(0.5f);
+	viewMatrix = XMMatrixTranslation(0.0f, 0.0f, 25.0f);
+	projectionMatrix = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+	positionStream.x = &input[0];
+	positionStream.y = &input[BENCHMARK_VERTEX_COUNT];
+	positionStream.z = &input[2 * BENCHMARK_VERTEX_COUNT];
+	clipStream.x = &output[0];
+	clipStream.y = &output[BENCHMARK_VERTEX_COUNT];
+	clipStream.z = &output[2 * BENCHMARK_VERTEX_COUNT];
+	clipStream.w = &output[3 * BENCHMARK_VERTEX_COUNT];
+	clipStream.outcodes = &outcodes[0];
+
+	supportedLevel = GetVertexProcessorSimdLevel();
+
+	fout << "Vertex transform: " << BENCHMARK_VERTEX_COUNT << " positions, 1 thread, CPU supports "
+		 << GetSimdLevelName(supportedLevel) << "\n";
+	fout << std::left << std::setw(26) << "path" << std::right << std::setw(12) << "Mvert/s" << "\n";
+
+	//The constant buffer held the three matrices transposed and every vertex transposed them back.
+	XMStoreFloat4x4(&matrices[0], XMMatrixTranspose(worldMatrix));
+	XMStoreFloat4x4(&matrices[1], XMMatrixTranspose(viewMatrix));
+	XMStoreFloat4x4(&matrices[2], XMMatrixTranspose(projectionMatrix));
+
+	vertices = 0;
+	start = BenchmarkClock::now();
+	do
+	{
+		for (unsigned int i = 0; i < BENCHMARK_VERTEX_COUNT; i++)
+		{
+			XMVECTOR position = XMVectorSet(positionStream.x[i], positionStream.y[i], positionStream.z[i], 1.0f);
+
+			position = XMVector4Transform(position, XMMatrixTranspose(XMLoadFloat4x4(&matrices[0])));
+			position = XMVector4Transform(position, XMMatrixTranspose(XMLoadFloat4x4(&matrices[1])));
+			position = XMVector4Transform(position, XMMatrixTranspose(XMLoadFloat4x4(&matrices[2])));
+			clipStream.x[i] = XMVectorGetX(position);
+			clipStream.y[i] = XMVectorGetY(position);
+			clipStream.z[i] = XMVectorGetZ(position);
+			clipStream.w[i] = XMVectorGetW(position);
+		}
+		vertices += BENCHMARK_VERTEX_COUNT;
+		seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+	} while (seconds < BENCHMARK_MIN_SECONDS);
+
+	fout << std::left << std::setw(26) << "per vertex, 3 matrices" << std::right << std::fixed << std::setprecision(2)
+		 << std::setw(12) << vertices / seconds / 1e6 << "\n";
+
+	for (int level = SIMD_LEVEL_SCALAR; level <= supportedLevel; level++)
+	{
+		SetVertexProcessorSimdLevel((SimdLevel)level);
+
+		vertices = 0;
+		start = BenchmarkClock::now();
+		do
+		{
+			TransformPositionStream(XMMatrixMultiply(XMMatrixMultiply(worldMatrix, viewMatrix), projectionMatrix),
+									positionStream, clipStream, BENCHMARK_VERTEX_COUNT, 1.0f, 1.0f);
+			vertices += BENCHMARK_VERTEX_COUNT;
+			seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+		} while (seconds < BENCHMARK_MIN_SECONDS);
+
+		fout << std::left << std::setw(26) << (std::string("stream, ") + GetSimdLevelName((SimdLevel)level)) << std::right
+			 << std::fixed << std::setprecision(2) << std::setw(12) << vertices / seconds / 1e6 << "\n";
+	}
+
+	SetVertexProcessorSimdLevel(supportedLevel);
+	fout << "\n";
+}
+
+/*
+ *	BenchmarkShading()
+ *	brief: Measures the SIMD quad kernels of ColorPS, first alone on one thread over whole blocks of the frame, in
+ *		   millions of pixels per second, and then in frames of many models drawn by the software device, checking
+ *		   their image against the one the scalar pixel shader draws pixel by pixel.
+ */
+static void BenchmarkShading(std::ofstream& fout)
+{
+	const float fogColor[4] = { 0.5f, 0.6f, 0.7f, 1.0f };
+	const int objectCount = 2000;
+	int blocksX = BENCHMARK_FRAME_WIDTH / RASTER_BLOCK_SIZE, blocksY = BENCHMARK_FRAME_HEIGHT / RASTER_BLOCK_SIZE;
+	std::vector<unsigned int> colorBuffer(BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+	std::vector<float> depthBuffer(BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+	std::vector<unsigned int> referenceImage;
+	std::vector<XMFLOAT4X4> worldMatrices(objectCount);
+	PixelPlane planes[PIXEL_PLANE_VARYINGS + 5];
+	PixelBlockTarget target;
+	SoftwareRendererClass* device;
+	ModelClass* model;
+	ColorShader* shader;
+	XMMATRIX positionMatrix, projectionMatrix;
+	SimdLevel supportedLevel;
+	BenchmarkClock::time_point start;
+	const unsigned int* image;
+	double seconds;
+	long long pixels;
+	int frames, pass, differentPixels, maximumDifference, difference;
+	unsigned int random = 3;
+	bool bResult;
+
+	supportedLevel = GetPixelKernelSimdLevel();
+
+	fout << "Pixel shading: ColorPS, " << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT
+		 << ", CPU supports " << GetSimdLevelName(supportedLevel) << "\n";
+	fout << std::left << std::setw(12) << "fog" << std::setw(10) << "kernel" << std::right << std::setw(12) << "Mpix/s" << "\n";
+
+	//A color gradient in perspective, the fog factor going across the frame.
+	planes[PIXEL_PLANE_INV_W].stepX = 0.0001f;
+	planes[PIXEL_PLANE_INV_W].stepY = 0.0002f;
+	for (int i = 0; i < 5; i++)
+	{
+		planes[PIXEL_PLANE_VARYINGS + i].stepX = 0.001f * (i + 1);
+		planes[PIXEL_PLANE_VARYINGS + i].stepY = 0.0005f * (5 - i);
+	}
+	planes[PIXEL_PLANE_DEPTH].stepX = 0.0f;
+	planes[PIXEL_PLANE_DEPTH].stepY = 0.0f;
+	target.pitch = BENCHMARK_FRAME_WIDTH;
+
+	for (int fog = 0; fog < 2; fog++)
+	{
+		for (int level = SIMD_LEVEL_SCALAR; level <= supportedLevel; level++)
+		{
+			SetPixelKernelSimdLevel((SimdLevel)level);
+
+			pixels = 0;
+			pass = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				//Every pass is a bit closer than the last one, so all of its pixels pass the depth test.
+				if (pass % 4096 == 0)
+				{
+					std::fill(depthBuffer.begin(), depthBuffer.end(), 1.0f);
+				}
+				planes[PIXEL_PLANE_DEPTH].base = 1.0f - (pass % 4096 + 1) / 8192.0f;
+
+				for (int blockY = 0; blockY < blocksY; blockY++)
+				{
+					for (int blockX = 0; blockX < blocksX; blockX++)
+					{
+						planes[PIXEL_PLANE_INV_W].base = 0.5f + 0.0001f * blockX * RASTER_BLOCK_SIZE;
+						for (int i = 0; i < 5; i++)
+						{
+							planes[PIXEL_PLANE_VARYINGS + i].base = 0.05f * i + 0.0002f * blockY * RASTER_BLOCK_SIZE;
+						}
+
+						target.color = &colorBuffer[(blockY * BENCHMARK_FRAME_WIDTH + blockX) * RASTER_BLOCK_SIZE];
+						target.depth = &depthBuffer[(blockY * BENCHMARK_FRAME_WIDTH + blockX) * RASTER_BLOCK_SIZE];
+						pixels += fog ? ShadeFoggedColorBlock(planes, ~0ULL, fogColor, target) :
+										ShadeColorBlock(planes, ~0ULL, target);
+					}
+				}
+
+				pass++;
+				seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds < BENCHMARK_MIN_SECONDS);
+
+			fout << std::left << std::setw(12) << (fog ? "on" : "off") << std::setw(10)
+				 << GetSimdLevelName((SimdLevel)level) << std::right << std::fixed << std::setprecision(1)
+				 << std::setw(12) << pixels / seconds / 1e6 << "\n";
+		}
+	}
+	fout << "\n";
+
+	//Whole frames, every kernel against the scalar pixel shader.
+	device = new SoftwareRendererClass();
+	model = new ModelClass();
+	shader = new ColorShader();
+
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device) && model->Initialize(device, nullptr, VERTEX_FORMAT_FULL, nullptr);
+
+	if (bResult)
+	{
+		device->GetProjectionMatrix(projectionMatrix);
+		model->GetPositionMatrix(positionMatrix);
+		for (int i = 0; i < objectCount; i++)
+		{
+			float depth = 3.0f + (BenchmarkRandom(random) % 1000) * 0.03f;
+			float x = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depth;
+			float y = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depth * 0.6f;
+
+			XMStoreFloat4x4(&worldMatrices[i],
+							XMMatrixMultiply(XMMatrixMultiply(XMMatrixMultiply(positionMatrix, XMMatrixRotationY(i * 0.1f)),
+															  XMMatrixTranslation(x, y, depth)), projectionMatrix));
+		}
+
+		fout << "Pixel shading frames: " << objectCount << " models, image against the scalar pixel shader\n";
+		fout << std::left << std::setw(12) << "fog" << std::setw(10) << "kernel" << std::right << std::setw(12)
+			 << "ms/frame" << std::setw(16) << "pixels changed" << std::setw(14) << "max change" << "\n";
+
+		for (int fog = 0; fog < 2; fog++)
+		{
+			shader->SetFog(fog != 0, XMFLOAT4(fogColor[0], fogColor[1], fogColor[2], fogColor[3]), 5.0f, 30.0f);
+
+			//Level -1 is the reference, pixel by pixel.
+			for (int level = -1; level <= (int)supportedLevel; level++)
+			{
+				device->SetBlockShading(level >= 0);
+				if (level >= 0)
+				{
+					SetPixelKernelSimdLevel((SimdLevel)level);
+				}
+
+				frames = 0;
+				start = BenchmarkClock::now();
+				do
+				{
+					device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+					for (int i = 0; i < objectCount; i++)
+					{
+						model->Render(device);
+						shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(),
+									   XMLoadFloat4x4(&worldMatrices[i]));
+					}
+					device->EndScene();
+
+					frames++;
+					seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+				} while (seconds < BENCHMARK_MIN_SECONDS);
+
+				image = device->GetColorBuffer();
+				if (level < 0)
+				{
+					referenceImage.assign(image, image + BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+				}
+
+				differentPixels = 0;
+				maximumDifference = 0;
+				for (int i = 0; i < BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT; i++)
+				{
+					if (image[i] == referenceImage[i])
+					{
+						continue;
+					}
+
+					differentPixels++;
+					for (int channel = 0; channel < 32; channel += 8)
+					{
+						difference = std::abs((int)((image[i] >> channel) & 0xff) - (int)((referenceImage[i] >> channel) & 0xff));
+						maximumDifference = std::max(maximumDifference, difference);
+					}
+				}
+
+				fout << std::left << std::setw(12) << (fog ? "on" : "off") << std::setw(10)
+					 << (level < 0 ? "reference" : GetSimdLevelName((SimdLevel)level)) << std::right << std::fixed
+					 << std::setprecision(3) << std::setw(12) << seconds * 1000.0 / frames << std::setw(16)
+					 << differentPixels << std::setw(14) << maximumDifference << "\n";
+			}
+		}
+		fout << "\n";
+	}
+	else
+	{
+		fout << "Pixel shading frames: could not create the software device\n\n";
+	}
+
+	SetPixelKernelSimdLevel(supportedLevel);
+
+	model->Shutdown();
+	delete model;
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+}
+
+/*
+ *	BenchmarkDepthRejection()
+ *	brief: Draws a frame of many large overlapping models on the software device with and without the depth bounds
+ *		   of its tiles and blocks, first in random order and then front to back, and reports how much each level
+ *		   rejected, the overdraw, and whether the image came out the same.
+ */
+static void BenchmarkDepthRejection(std::ofstream& fout)
+{
+	const int objectCount = 3000;
+	std::vector<XMFLOAT4X4> worldMatrices(objectCount);
+	std::vector<float> depths(objectCount);
+	std::vector<int> order(objectCount);
+	std::vector<unsigned int> referenceImage;
+	SoftwareRendererClass* device;
+	ModelClass* model;
+	ColorShader* shader;
+	SoftwareFrameStatistics statistics;
+	XMMATRIX positionMatrix, projectionMatrix;
+	BenchmarkClock::time_point start;
+	const unsigned int* image;
+	double seconds;
+	int frames;
+	unsigned int random = 5;
+	bool bResult, sameImage;
+
+	device = new SoftwareRendererClass();
+	model = new ModelClass();
+	shader = new ColorShader();
+
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device) && model->Initialize(device, nullptr, VERTEX_FORMAT_FULL, nullptr);
+
+	if (bResult)
+	{
+		device->GetProjectionMatrix(projectionMatrix);
+		model->GetPositionMatrix(positionMatrix);
+		for (int i = 0; i < objectCount; i++)
+		{
+			depths[i] = 3.0f + (BenchmarkRandom(random) % 1000) * 0.03f;
+			float x = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depths[i];
+			float y = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depths[i] * 0.6f;
+
+			XMStoreFloat4x4(&worldMatrices[i],
+							XMMatrixMultiply(XMMatrixMultiply(XMMatrixMultiply(XMMatrixMultiply(positionMatrix, XMMatrixScaling(2.0f, 2.0f, 2.0f)),
+																			   XMMatrixRotationY(i * 0.1f)),
+															  XMMatrixTranslation(x, y, depths[i])), projectionMatrix));
+			order[i] = i;
+		}
+
+		fout << "Depth rejection: " << objectCount << " models, " << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT << "\n";
+		fout << std::left << std::setw(14) << "order" << std::setw(6) << "hiz" << std::right << std::setw(10) << "ms/frame"
+			 << std::setw(12) << "tile tris" << std::setw(10) << "rejected" << std::setw(10) << "blocks" << std::setw(10)
+			 << "rejected" << std::setw(10) << "accepted" << std::setw(11) << "complexity" << std::setw(10) << "overdraw"
+			 << std::setw(7) << "same" << "\n";
+
+		for (int sorted = 0; sorted < 2; sorted++)
+		{
+			if (sorted)
+			{
+				std::sort(order.begin(), order.end(), [&depths](int a, int b) { return depths[a] < depths[b]; });
+			}
+
+			for (int hierarchical = 0; hierarchical < 2; hierarchical++)
+			{
+				device->SetHierarchicalDepth(hierarchical != 0);
+
+				frames = 0;
+				start = BenchmarkClock::now();
+				do
+				{
+					device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+					for (int i = 0; i < objectCount; i++)
+					{
+						model->Render(device);
+						shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(),
+									   XMLoadFloat4x4(&worldMatrices[order[i]]));
+					}
+					device->EndScene();
+
+					frames++;
+					seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+				} while (seconds < BENCHMARK_MIN_SECONDS);
+
+				device->GetFrameStatistics(statistics);
+				image = device->GetColorBuffer();
+				if (!hierarchical)
+				{
+					referenceImage.assign(image, image + BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+				}
+				sameImage = std::equal(referenceImage.begin(), referenceImage.end(), image);
+
+				fout << std::left << std::setw(14) << (sorted ? "front to back" : "random") << std::setw(6)
+					 << (hierarchical ? "on" : "off") << std::right << std::fixed << std::setprecision(3) << std::setw(10)
+					 << seconds * 1000.0 / frames << std::setw(12) << statistics.tileTriangles << std::setw(10)
+					 << statistics.tileTrianglesRejected << std::setw(10) << statistics.blocks << std::setw(10)
+					 << statistics.blocksRejected << std::setw(10) << statistics.blocksAccepted << std::setprecision(2)
+					 << std::setw(11) << statistics.depthComplexity << std::setw(10) << statistics.overdraw << std::setw(7)
+					 << (sameImage ? "yes" : "NO") << "\n";
+			}
+		}
+		fout << "\n";
+	}
+	else
+	{
+		fout << "Depth rejection: could not create the software device\n\n";
+	}
+
+	model->Shutdown();
+	delete model;
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+}
+
+/*
+ *	BenchmarkSubBlockDepth()
+ *	brief: Draws a frame of many tilted triangles smaller than a block, piled up at almost the same depth in the
+ *		   middle of the screen over a large one, with and without the depth bounds, and compares the images. The weights of such a
+ *		   triangle at the corner of its block are far from the triangle, which is where the depth bounds are
+ *		   easiest to get wrong.
+ *	return: False if the depth bounds changed any pixel.
+ */
+static bool BenchmarkSubBlockDepth(std::ofstream& fout)
+{
+	const int triangleCount = 20000;
+	const float pixelSize = 2.0f * 5.0f * tanf(XM_PIDIV4 * 0.5f) / BENCHMARK_FRAME_HEIGHT;	//At a depth of 5.
+	std::vector<XMFLOAT4X4> worldMatrices(triangleCount);
+	std::vector<unsigned int> referenceImage;
+	SoftwareRendererClass* device;
+	ModelClass* model;
+	ColorShader* shader;
+	SoftwareFrameStatistics statistics;
+	XMMATRIX positionMatrix, projectionMatrix;
+	BenchmarkClock::time_point start;
+	const unsigned int* image;
+	double seconds;
+	int frames, differentPixels;
+	unsigned int random = 11;
+	bool bResult, bSameImages = true;
+
+	device = new SoftwareRendererClass();
+	model = new ModelClass();
+	shader = new ColorShader();
+
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device) && model->Initialize(device, nullptr, VERTEX_FORMAT_FULL, nullptr);
+
+	if (bResult)
+	{
+		device->GetProjectionMatrix(projectionMatrix);
+		model->GetPositionMatrix(positionMatrix);
+		for (int i = 0; i < triangleCount; i++)
+		{
+			//Half a pixel to 3 pixels across, tilted almost edge on, over 48x48 pixels and a quarter deep.
+			float scale = (0.25f + (BenchmarkRandom(random) % 1000) * 0.00125f) * pixelSize;
+			float depth = 5.0f + (BenchmarkRandom(random) % 1000) * 0.00025f;
+			float x = ((BenchmarkRandom(random) % 1000) * 0.048f - 24.0f) * pixelSize;
+			float y = ((BenchmarkRandom(random) % 1000) * 0.048f - 24.0f) * pixelSize;
+			float tiltX = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * 2.8f;
+			float tiltY = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * 2.8f;
+			XMMATRIX worldMatrix = XMMatrixMultiply(XMMatrixScaling(scale, scale, scale), XMMatrixRotationZ(i * 0.7f));
+
+			//The first one is a large triangle behind half of the rest, so the blocks have bounds to reject with.
+			if (i == 0)
+			{
+				worldMatrix = XMMatrixScaling(100.0f * pixelSize, 100.0f * pixelSize, 1.0f);
+				depth = 5.125f;
+				tiltX = 0.0f;
+				tiltY = 0.0f;
+			}
+
+			worldMatrix = XMMatrixMultiply(XMMatrixMultiply(worldMatrix, XMMatrixRotationX(tiltX)), XMMatrixRotationY(tiltY));
+			worldMatrix = XMMatrixMultiply(worldMatrix, XMMatrixTranslation(x, y, depth));
+			XMStoreFloat4x4(&worldMatrices[i], XMMatrixMultiply(XMMatrixMultiply(positionMatrix, worldMatrix), projectionMatrix));
+		}
+
+		fout << "Depth bounds of sub-block triangles: " << triangleCount << " triangles of 0.5 to 3 pixels\n";
+		fout << std::left << std::setw(6) << "hiz" << std::right << std::setw(10) << "ms/frame" << std::setw(12)
+			 << "tile tris" << std::setw(10) << "rejected" << std::setw(10) << "blocks" << std::setw(10) << "rejected"
+			 << std::setw(10) << "accepted" << std::setw(16) << "pixels changed" << "\n";
+
+		for (int hierarchical = 0; hierarchical < 2; hierarchical++)
+		{
+			device->SetHierarchicalDepth(hierarchical != 0);
+
+			frames = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+				for (int i = 0; i < triangleCount; i++)
+				{
+					model->Render(device);
+					shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(), XMLoadFloat4x4(&worldMatrices[i]));
+				}
+				device->EndScene();
+
+				frames++;
+				seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds < BENCHMARK_MIN_SECONDS);
+
+			device->GetFrameStatistics(statistics);
+			image = device->GetColorBuffer();
+			if (!hierarchical)
+			{
+				referenceImage.assign(image, image + BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+			}
+
+			differentPixels = 0;
+			for (int i = 0; i < BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT; i++)
+			{
+				differentPixels += image[i] != referenceImage[i] ? 1 : 0;
+			}
+			bSameImages = bSameImages && differentPixels == 0;
+
+			fout << std::left << std::setw(6) << (hierarchical ? "on" : "off") << std::right << std::fixed
+				 << std::setprecision(3) << std::setw(10) << seconds * 1000.0 / frames << std::setw(12)
+				 << statistics.tileTriangles << std::setw(10) << statistics.tileTrianglesRejected << std::setw(10)
+				 << statistics.blocks << std::setw(10) << statistics.blocksRejected << std::setw(10) << statistics.blocksAccepted
+				 << std::setw(16) << differentPixels << "\n";
+		}
+		if (!bSameImages)
+		{
+			fout << "FAILED: the depth bounds rejected visible pixels\n";
+		}
+		fout << "\n";
+	}
+	else
+	{
+		fout << "Depth bounds of sub-block triangles: could not create the software device\n\n";
+	}
+
+	model->Shutdown();
+	delete model;
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+
+	return bSameImages;
+}
+
+/*
+ *	ChecksumReadback()
+ *	brief: Hashes the rows of a mapped image, skipping the padding at the end of each row.
+ */
+static unsigned long long ChecksumReadback(const ReadbackImage& image)
+{
+	const unsigned char* row;
+	unsigned long long hash = 14695981039346656037ull;
+	unsigned int rowSize;
+
+	rowSize = image.width * (image.format == RENDER_TARGET_FORMAT_RGBA16F ? 8 : 4);
+	for (int y = 0; y < image.height; y++)
+	{
+		row = (const unsigned char*)image.data + (size_t)y * image.rowPitch;
+		for (unsigned int x = 0; x < rowSize; x++)
+		{
+			hash = (hash ^ row[x]) * 1099511628211ull;
+		}
+	}
+
+	return hash + image.tag;
+}
+
+/*
+ *	BenchmarkReadbackDevice()
+ *	brief: Renders frames into an offscreen target of the device and reads every one back, first waiting for each
+ *		   copy right after queueing it and then through a ring of copies mapped once they are done, and reports
+ *		   the frames per second of both and whether they read back the same images.
+ */
+static void BenchmarkReadbackDevice(std::ofstream& fout, RenderDevice* device, const char* deviceName)
+{
+	const int objectCount = 200;
+	const unsigned int frameCount = 120;
+	const unsigned int ringDepth = 3;
+	std::vector<XMFLOAT4X4> worldMatrices(objectCount);
+	RenderTargetDesc targetDesc;
+	RenderTarget* target;
+	RenderReadback* readback;
+	ModelClass* model;
+	ColorShader* shader;
+	ReadbackImage image;
+	XMMATRIX positionMatrix, projectionMatrix;
+	BenchmarkClock::time_point start;
+	unsigned long long checksums[2];
+	double seconds[2];
+	unsigned int random = 9;
+	bool bResult;
+
+	target = nullptr;
+	readback = nullptr;
+	model = new ModelClass();
+	shader = new ColorShader();
+
+	targetDesc.width = BENCHMARK_FRAME_WIDTH;
+	targetDesc.height = BENCHMARK_FRAME_HEIGHT;
+	targetDesc.format = RENDER_TARGET_FORMAT_RGBA8;
+
+	bResult = shader->Initialize(device) && model->Initialize(device, nullptr, VERTEX_FORMAT_FULL, nullptr);
+	bResult = bResult && device->CreateRenderTarget(targetDesc, &target);
+	bResult = bResult && device->CreateReadback(target, ringDepth, &readback);
+
+	if (bResult)
+	{
+		device->GetProjectionMatrix(projectionMatrix);
+		model->GetPositionMatrix(positionMatrix);
+		for (int i = 0; i < objectCount; i++)
+		{
+			float depth = 3.0f + (BenchmarkRandom(random) % 1000) * 0.03f;
+			float x = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depth;
+			float y = ((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depth * 0.6f;
+
+			XMStoreFloat4x4(&worldMatrices[i], XMMatrixMultiply(positionMatrix, XMMatrixTranslation(x, y, depth)));
+		}
+
+		device->SetRenderTarget(target);
+		for (int async = 0; async < 2; async++)
+		{
+			checksums[async] = 0;
+			start = BenchmarkClock::now();
+			for (unsigned int frame = 0; frame < frameCount; frame++)
+			{
+				device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+				for (int i = 0; i < objectCount; i++)
+				{
+					model->Render(device);
+					shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(),
+								   XMMatrixMultiply(XMMatrixMultiply(XMMatrixRotationY(frame * 0.05f), XMLoadFloat4x4(&worldMatrices[i])),
+													projectionMatrix));
+				}
+				device->EndScene();
+
+				//Synchronously the copy is waited for at once; in the ring only when no slot is free for it.
+				while (!device->QueueReadback(readback, frame))
+				{
+					device->MapReadback(readback, true, image);
+					checksums[async] += ChecksumReadback(image);
+					device->UnmapReadback(readback);
+				}
+				while (device->MapReadback(readback, !async, image))
+				{
+					checksums[async] += ChecksumReadback(image);
+					device->UnmapReadback(readback);
+				}
+			}
+			while (device->MapReadback(readback, true, image))
+			{
+				checksums[async] += ChecksumReadback(image);
+				device->UnmapReadback(readback);
+			}
+			seconds[async] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+		}
+		device->SetRenderTarget(nullptr);
+
+		fout << "Readback (" << deviceName << "): " << frameCount << " frames of " << objectCount << " models, "
+			 << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT << ", ring of " << ringDepth << "\n";
+		fout << std::fixed << std::setprecision(1) << "  wait each frame: " << frameCount / seconds[0] << " frames/s\n"
+			 << "  ring:            " << frameCount / seconds[1] << " frames/s\n"
+			 << "  same images:     " << (checksums[0] == checksums[1] ? "yes" : "NO") << "\n\n";
+	}
+	else
+	{
+		fout << "Readback (" << deviceName << "): could not create the render target\n\n";
+	}
+
+	device->ReleaseReadback(readback);
+	device->ReleaseRenderTarget(target);
+	model->Shutdown();
+	delete model;
+	shader->Shutdown();
+	delete shader;
+}
+
+/*
+ *	BenchmarkReadback()
+ *	brief: Runs the readback benchmark on the software device and, on Windows, on a D3D device without a window.
+ */
+static void BenchmarkReadback(std::ofstream& fout)
+{
+	SoftwareRendererClass* softwareDevice;
+#ifdef _WIN32
+	D3DClass* d3dDevice;
+#endif
+
+	softwareDevice = new SoftwareRendererClass();
+	if (softwareDevice->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f))
+	{
+		BenchmarkReadbackDevice(fout, softwareDevice, "software");
+	}
+	softwareDevice->Shutdown();
+	delete softwareDevice;
+
+#ifdef _WIN32
+	d3dDevice = new D3DClass();
+	if (d3dDevice->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f))
+	{
+		BenchmarkReadbackDevice(fout, d3dDevice, "D3D11");
+	}
+	else
+	{
+		fout << "Readback (D3D11): could not create the device\n\n";
+	}
+	d3dDevice->Shutdown();
+	delete d3dDevice;
+#endif
+}
+
+/*
+ *	BuildInstanceGrid()
+ *	brief: Places copies of the model in a square grid in front of the camera, each one small enough to fit in its
+ *		   cell and with its own color.
+ */
+static void BuildInstanceGrid(std::vector<ModelClass::InstanceType>& instances, int instanceCount)
+{
+	int side;
+	float cellSize, x, y;
+	XMMATRIX worldMatrix;
+
+	side = (int)ceil(sqrt((double)instanceCount));
+	cellSize = 4.0f / (float)side;
+
+	instances.resize(instanceCount);
+	for (int i = 0; i < instanceCount; i++)
+	{
+		x = -2.0f + ((float)(i % side) + 0.5f) * cellSize;
+		y = -2.0f + ((float)(i / side) + 0.5f) * cellSize;
+
+		worldMatrix = XMMatrixMultiply(XMMatrixScaling(cellSize * 0.4f, cellSize * 0.4f, 1.0f), XMMatrixTranslation(x, y, 0.0f));
+		XMStoreFloat4x4(&instances[i].world, worldMatrix);
+		instances[i].color = XMFLOAT4((float)(i % 7) / 6.0f, (float)(i % 5) / 4.0f, 1.0f, 1.0f);
+	}
+}
+
+/*
+ *	BenchmarkInstancing()
+ *	brief: Renders 1k, 10k and 100k copies of the model with the software device, first with one draw and one
+ *		   constant buffer update per copy and then with a single instanced draw.
+ */
+static void BenchmarkInstancing(std::ofstream& fout)
+{
+	const int instanceCounts[] = { 1000, 10000, 100000 };
+	SoftwareRendererClass* device;
+	ModelClass* model;
+	ColorShader* shader;
+	std::vector<ModelClass::InstanceType> instances;
+	XMMATRIX viewMatrix, projectionMatrix, viewProjectionMatrix;
+	BenchmarkClock::time_point start;
+	double seconds[2];
+	char cardName[128];
+	int frames, memory;
+	bool bResult;
+
+	device = new SoftwareRendererClass();
+	model = new ModelClass();
+	shader = new ColorShader();
+
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && model->Initialize(device, nullptr, VERTEX_FORMAT_FULL, nullptr);
+	bResult = bResult && shader->Initialize(device);
+
+	if (bResult)
+	{
+		viewMatrix = XMMatrixTranslation(0.0f, 0.0f, 5.0f);
+		device->GetProjectionMatrix(projectionMatrix);
+		viewProjectionMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
+
+		device->GetVideoCardInfo(cardName, memory);
+		fout << "Instancing: " << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT << ", " << cardName << "\n";
+		fout << std::left << std::setw(12) << "instances" << std::right << std::setw(20) << "ms/frame per draw"
+			 << std::setw(20) << "ms/frame instanced" << std::setw(12) << "speedup" << "\n";
+
+		for (int i = 0; i < 3; i++)
+		{
+			BuildInstanceGrid(instances, instanceCounts[i]);
+
+			//One draw per copy, each with its own world-view-projection.
+			frames = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+				model->Render(device);
+				for (int j = 0; j < instanceCounts[i]; j++)
+				{
+					shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(),
+								   XMMatrixMultiply(XMLoadFloat4x4(&instances[j].world), viewProjectionMatrix));
+				}
+				device->EndScene();
+
+				frames++;
+				seconds[0] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds[0] < BENCHMARK_MIN_SECONDS);
+			seconds[0] /= frames;
+
+			//Every copy in one draw. Updating the instances is part of the frame.
+			frames = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+				model->SetInstances(device, &instances[0], instanceCounts[i]);
+				model->RenderInstanced(device);
+				shader->RenderInstanced(device, model->GetIndexCount(), model->GetInstanceCount(), model->GetVertexFormat(),
+										viewProjectionMatrix);
+				device->EndScene();
+
+				frames++;
+				seconds[1] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds[1] < BENCHMARK_MIN_SECONDS);
+			seconds[1] /= frames;
+
+			fout << std::left << std::setw(12) << instanceCounts[i] << std::right << std::fixed << std::setprecision(3)
+				 << std::setw(20) << seconds[0] * 1000.0 << std::setw(20) << seconds[1] * 1000.0
+				 << std::setprecision(2) << std::setw(11) << seconds[0] / seconds[1] << "x" << "\n";
+		}
+
+		fout << "\n";
+	}
+	else
+	{
+		fout << "Instancing: could not create the software device\n\n";
+	}
+
+	shader->Shutdown();
+	delete shader;
+	model->Shutdown();
+	delete model;
+	device->Shutdown();
+	delete device;
+}
+
+/*
+ *	WriteBenchmarkMesh()
+ *	brief: Writes a colored grid of BENCHMARK_MESH_SIDE x BENCHMARK_MESH_SIDE vertices as an OBJ file.
+ */
+static bool WriteBenchmarkMesh(const char* filename)
+{
+	std::ofstream fout;
+	int side = BENCHMARK_MESH_SIDE;
+
+	fout.open(filename);
+	if (!fout)
+	{
+		return false;
+	}
+
+	fout << std::fixed << std::setprecision(6);
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			fout << "v " << (float)x / side << " " << (float)y / side << " " << sin(x * 0.05) * cos(y * 0.05) * 0.1
+				 << " " << (float)x / side << " " << (float)y / side << " 0.5\n";
+		}
+	}
+
+	for (int y = 0; y + 1 < side; y++)
+	{
+		for (int x = 0; x + 1 < side; x++)
+		{
+			int corner = y * side + x + 1;
+			fout << "f " << corner << " " << corner + 1 << " " << corner + side + 1 << " " << corner + side << "\n";
+		}
+	}
+
+	fout.close();
+	return !fout.fail();
+}
+
+/*
+ *	BenchmarkMeshLoad()
+ *	brief: Loads a big OBJ file the first time, parsing it and writing its cache, and then from the cache. Both
+ *		   cases copy the mesh out as the upload to the buffers would, so the cached pages are really read.
+ */
+static void BenchmarkMeshLoad(std::ofstream& fout)
+{
+	MeshLoaderClass meshLoader;
+	std::vector<unsigned char> upload;
+	std::string cacheFilename;
+	BenchmarkClock::time_point start;
+	unsigned long long sourceSize, sourceTime, cacheSize, cacheTime;
+	double seconds[2];
+	size_t vertexBytes = 0, indexBytes = 0;
+	int loads;
+	bool bResult;
+
+	cacheFilename = std::string(BENCHMARK_MESH_FILE) + MESH_CACHE_EXTENSION;
+	remove(cacheFilename.c_str());
+
+	bResult = WriteBenchmarkMesh(BENCHMARK_MESH_FILE) && GetFileInfo(BENCHMARK_MESH_FILE, sourceSize, sourceTime);
+
+	//First load, without a cache.
+	start = BenchmarkClock::now();
+	bResult = bResult && meshLoader.Load(BENCHMARK_MESH_FILE) && !meshLoader.IsFromCache();
+	if (bResult)
+	{
+		vertexBytes = meshLoader.GetVertexCount() * sizeof(MeshVertex);
+		indexBytes = meshLoader.GetIndexCount() * sizeof(unsigned int);
+		upload.resize(vertexBytes + indexBytes);
+		memcpy(&upload[0], meshLoader.GetVertices(), vertexBytes);
+		memcpy(&upload[vertexBytes], meshLoader.GetIndices(), indexBytes);
+	}
+	seconds[0] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+	meshLoader.Unload();
+
+	bResult = bResult && GetFileInfo(cacheFilename.c_str(), cacheSize, cacheTime);
+
+	//Next loads, from the cache.
+	loads = 0;
+	start = BenchmarkClock::now();
+	while (bResult)
+	{
+		bResult = meshLoader.Load(BENCHMARK_MESH_FILE) && meshLoader.IsFromCache();
+		if (bResult)
+		{
+			memcpy(&upload[0], meshLoader.GetVertices(), vertexBytes);
+			memcpy(&upload[vertexBytes], meshLoader.GetIndices(), indexBytes);
+		}
+		meshLoader.Unload();
+
+		loads++;
+		seconds[1] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+		if (seconds[1] >= BENCHMARK_MIN_SECONDS)
+		{
+			break;
+		}
+	}
+
+	if (bResult)
+	{
+		seconds[1] /= loads;
+
+		fout << "Mesh load: " << vertexBytes / sizeof(MeshVertex) << " vertices, " << indexBytes / sizeof(unsigned int) / 3
+			 << " triangles\n";
+		fout << std::left << std::setw(12) << "load" << std::right << std::setw(12) << "file MB" << std::setw(12) << "ms"
+			 << std::setw(12) << "MB/s" << "\n";
+		fout << std::fixed << std::setprecision(2);
+		fout << std::left << std::setw(12) << "import" << std::right << std::setw(12) << sourceSize / 1048576.0
+			 << std::setw(12) << seconds[0] * 1000.0 << std::setw(12) << sourceSize / 1048576.0 / seconds[0] << "\n";
+		fout << std::left << std::setw(12) << "cache" << std::right << std::setw(12) << cacheSize / 1048576.0
+			 << std::setw(12) << seconds[1] * 1000.0 << std::setw(12) << cacheSize / 1048576.0 / seconds[1] << "\n";
+		fout << "speedup " << seconds[0] / seconds[1] << "x\n\n";
+	}
+	else
+	{
+		fout << "Mesh load: could not write or load " << BENCHMARK_MESH_FILE << "\n\n";
+	}
+
+	remove(cacheFilename.c_str());
+	remove(BENCHMARK_MESH_FILE);
+}
+
+/*
+ *	BenchmarkMeshOptimizer()
+ *	brief: Optimizes the grid mesh with its triangles in rows, as exported from most tools, and in random order,
+ *		   and reports the vertex cache statistics before and after.
+ */
+static void BenchmarkMeshOptimizer(std::ofstream& fout)
+{
+	const char* caseNames[2] = { "rows", "shuffled" };
+	std::vector<MeshVertex> vertices, workVertices;
+	std::vector<unsigned int> indices, workIndices;
+	MeshOptimizationReport report;
+	BenchmarkClock::time_point start;
+	unsigned int random = 1, triangleCount;
+	double seconds;
+	int side = BENCHMARK_MESH_SIDE;
+
+	vertices.resize(side * side);
+	for (int y = 0; y < side; y++)
+	{
+		for (int x = 0; x < side; x++)
+		{
+			vertices[y * side + x].position = XMFLOAT3((float)x / side, (float)y / side, 0.0f);
+			vertices[y * side + x].color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+		}
+	}
+	for (int y = 0; y + 1 < side; y++)
+	{
+		for (int x = 0; x + 1 < side; x++)
+		{
+			unsigned int corner = y * side + x;
+			unsigned int quad[6] = { corner, corner + side, corner + side + 1, corner, corner + side + 1, corner + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	triangleCount = (unsigned int)indices.size() / 3;
+
+	fout << "Mesh optimizer: " << vertices.size() << " vertices, " << triangleCount << " triangles, FIFO cache of "
+		 << VERTEX_CACHE_SIZE << "\n";
+	fout << std::left << std::setw(12) << "order" << std::right << std::setw(12) << "ACMR before" << std::setw(12)
+		 << "ACMR after" << std::setw(12) << "ATVR before" << std::setw(12) << "ATVR after" << std::setw(12) << "ms" << "\n";
+
+	for (int c = 0; c < 2; c++)
+	{
+		if (c == 1)
+		{
+			for (unsigned int i = triangleCount - 1; i > 0; i--)
+			{
+				unsigned int j = BenchmarkRandom(random) % (i + 1);
+				std::swap_ranges(&indices[i * 3], &indices[i * 3] + 3, &indices[j * 3]);
+			}
+		}
+
+		workVertices = vertices;
+		workIndices = indices;
+
+		start = BenchmarkClock::now();
+		OptimizeMesh(&workVertices[0], &workIndices[0], (unsigned int)workIndices.size(), (unsigned int)workVertices.size(),
+					 sizeof(MeshVertex), report);
+		seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+
+		fout << std::left << std::setw(12) << caseNames[c] << std::right << std::fixed << std::setprecision(3)
+			 << std::setw(12) << report.before.acmr << std::setw(12) << report.after.acmr << std::setw(12)
+			 << report.before.atvr << std::setw(12) << report.after.atvr << std::setprecision(1) << std::setw(12)
+			 << seconds * 1000.0 << "\n";
+	}
+
+	fout << "\n";
+}
+
+/*
+ *	BenchmarkVertexFormat()
+ *	brief: Renders the grid mesh, and a piece of it small enough for 16 bit indices, with the full and the packed
+ *		   vertex formats, and reports the memory of their buffers and the time per frame.
+ */
+static void BenchmarkVertexFormat(std::ofstream& fout)
+{
+	const char* formatNames[VERTEX_FORMAT_COUNT] = { "full", "packed" };
+	const char* meshNames[2] = { "grid", "small grid" };
+	const char smallMeshFile[] = "benchmark_small_mesh.obj";
+	const char* meshFiles[2] = { BENCHMARK_MESH_FILE, smallMeshFile };
+	SoftwareRendererClass* device;
+	ModelClass* model;
+	ColorShader* shader;
+	XMMATRIX positionMatrix, worldMatrix, viewProjectionMatrix, projectionMatrix;
+	BenchmarkClock::time_point start;
+	std::ofstream meshFile;
+	double seconds;
+	int frames;
+	bool bResult;
+
+	device = new SoftwareRendererClass();
+	shader = new ColorShader();
+
+	//A 128 x 128 grid, under the 65536 vertices of 16 bit indices.
+	meshFile.open(smallMeshFile);
+	for (int y = 0; y < 128; y++)
+	{
+		for (int x = 0; x < 128; x++)
+		{
+			meshFile << "v " << x / 128.0f << " " << y / 128.0f << " 0 " << x / 128.0f << " " << y / 128.0f << " 0.5\n";
+		}
+	}
+	for (int y = 0; y < 127; y++)
+	{
+		for (int x = 0; x < 127; x++)
+		{
+			meshFile << "f " << y * 128 + x + 1 << " " << y * 128 + x + 2 << " " << (y + 1) * 128 + x + 2 << " "
+					 << (y + 1) * 128 + x + 1 << "\n";
+		}
+	}
+	meshFile.close();
+
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device) && WriteBenchmarkMesh(BENCHMARK_MESH_FILE);
+
+	if (bResult)
+	{
+		device->GetProjectionMatrix(projectionMatrix);
+		viewProjectionMatrix = XMMatrixMultiply(XMMatrixTranslation(-0.5f, -0.5f, 1.5f), projectionMatrix);
+
+		fout << "Vertex formats: " << BENCHMARK_FRAME_WIDTH << "x" << BENCHMARK_FRAME_HEIGHT << "\n";
+		fout << std::left << std::setw(12) << "mesh" << std::setw(10) << "format" << std::right << std::setw(14)
+			 << "buffer KB" << std::setw(12) << "ms/frame" << "\n";
+
+		for (int m = 0; m < 2 && bResult; m++)
+		{
+			for (int f = 0; f < VERTEX_FORMAT_COUNT && bResult; f++)
+			{
+				model = new ModelClass();
+				bResult = model->Initialize(device, meshFiles[m], (VertexFormat)f, nullptr);
+				if (bResult)
+				{
+					model->GetPositionMatrix(positionMatrix);
+					worldMatrix = XMMatrixMultiply(positionMatrix, viewProjectionMatrix);
+
+					//One frame first, so the device grows its buffers outside of the timing.
+					device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+					model->Render(device);
+					shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(), worldMatrix);
+					device->EndScene();
+
+					frames = 0;
+					start = BenchmarkClock::now();
+					do
+					{
+						device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+						model->Render(device);
+						shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(), worldMatrix);
+						device->EndScene();
+
+						frames++;
+						seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+					} while (seconds < BENCHMARK_MIN_SECONDS);
+
+					fout << std::left << std::setw(12) << meshNames[m] << std::setw(10) << formatNames[f] << std::right
+						 << std::fixed << std::setprecision(1) << std::setw(14) << model->GetBufferMemory() / 1024.0
+						 << std::setprecision(3) << std::setw(12) << seconds * 1000.0 / frames << "\n";
+				}
+
+				model->Shutdown();
+				delete model;
+			}
+		}
+
+		fout << (bResult ? "\n" : "Vertex formats: could not load the meshes\n\n");
+	}
+	else
+	{
+		fout << "Vertex formats: could not create the software device\n\n";
+	}
+
+	for (int m = 0; m < 2; m++)
+	{
+		remove((std::string(meshFiles[m]) + MESH_CACHE_EXTENSION).c_str());
+		remove(meshFiles[m]);
+	}
+
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+}
+
+/*
+ *	BuildObjectScene()
+ *	brief: Spreads objects at random all around the origin, and makes room for their world space bounds.
+ *	param streams: The seven arrays behind the bounds.
+ */
+static void BuildObjectScene(std::vector<XMFLOAT4X4>& worldMatrices, std::vector<float>* streams, BoundsStream& bounds)
+{
+	unsigned int random = 1;
+
+	worldMatrices.resize(BENCHMARK_OBJECT_COUNT);
+	for (unsigned int i = 0; i < BENCHMARK_OBJECT_COUNT; i++)
+	{
+		XMStoreFloat4x4(&worldMatrices[i], XMMatrixTranslation(
+			(BenchmarkRandom(random) % 10000) / 10000.0f * BENCHMARK_SCENE_SIZE - BENCHMARK_SCENE_SIZE * 0.5f,
+			(BenchmarkRandom(random) % 10000) / 10000.0f * BENCHMARK_SCENE_SIZE - BENCHMARK_SCENE_SIZE * 0.5f,
+			(BenchmarkRandom(random) % 10000) / 10000.0f * BENCHMARK_SCENE_SIZE - BENCHMARK_SCENE_SIZE * 0.5f));
+	}
+	for (int i = 0; i < 7; i++)
+	{
+		streams[i].resize(BENCHMARK_OBJECT_COUNT);
+	}
+	bounds.centerX = &streams[0][0];
+	bounds.centerY = &streams[1][0];
+	bounds.centerZ = &streams[2][0];
+	bounds.extentX = &streams[3][0];
+	bounds.extentY = &streams[4][0];
+	bounds.extentZ = &streams[5][0];
+	bounds.radius = &streams[6][0];
+}
+
+/*
+ *	BenchmarkCulling()
+ *	brief: Culls objects spread all around the camera, so most are out of the view, with every instruction set.
+ *		   Then renders a tenth of them with the software device, drawing all of them and only the visible ones.
+ */
+static void BenchmarkCulling(std::ofstream& fout)
+{
+	const int drawCount = BENCHMARK_OBJECT_COUNT / 10;
+	std::vector<XMFLOAT4X4> worldMatrices;
+	std::vector<float> streams[7];
+	std::vector<unsigned char> visible(BENCHMARK_OBJECT_COUNT);
+	BoundsStream bounds;
+	BoundingVolume objectBounds;
+	FrustumClass frustum;
+	SoftwareRendererClass* device;
+	ModelClass* model;
+	ColorShader* shader;
+	XMMATRIX viewMatrix, projectionMatrix, viewProjectionMatrix;
+	BenchmarkClock::time_point start;
+	SimdLevel originalLevel;
+	double seconds[2];
+	unsigned int visibleCount = 0, culledCount = 0;
+	int frames;
+	bool bResult;
+
+	BuildObjectScene(worldMatrices, streams, bounds);
+
+	device = new SoftwareRendererClass();
+	model = new ModelClass();
+	shader = new ColorShader();
+
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && model->Initialize(device, nullptr, VERTEX_FORMAT_FULL, nullptr);
+	bResult = bResult && shader->Initialize(device);
+
+	if (bResult)
+	{
+		model->GetBoundingVolume(objectBounds);
+		viewMatrix = XMMatrixIdentity();
+		device->GetProjectionMatrix(projectionMatrix);
+		viewProjectionMatrix = XMMatrixMultiply(viewMatrix, projectionMatrix);
+
+		fout << "Culling: " << BENCHMARK_OBJECT_COUNT << " objects\n";
+		fout << std::left << std::setw(10) << "simd" << std::right << std::setw(16) << "transform ms" << std::setw(12)
+			 << "cull ms" << std::setw(16) << "Mobjects/s" << std::setw(10) << "visible" << std::setw(10) << "culled" << "\n";
+
+		originalLevel = GetFrustumSimdLevel();
+		for (int level = SIMD_LEVEL_SCALAR; level <= SIMD_LEVEL_AVX2; level++)
+		{
+			if (!SetFrustumSimdLevel((SimdLevel)level))
+			{
+				continue;
+			}
+
+			//Every frame takes the bounds to world space and culls them.
+			frames = 0;
+			seconds[0] = 0.0;
+			seconds[1] = 0.0;
+			do
+			{
+				start = BenchmarkClock::now();
+				TransformBoundingVolumes(objectBounds, &worldMatrices[0], BENCHMARK_OBJECT_COUNT, bounds);
+				seconds[0] += std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+
+				start = BenchmarkClock::now();
+				frustum.ConstructFrustum(viewMatrix, projectionMatrix);
+				frustum.CullBounds(bounds, BENCHMARK_OBJECT_COUNT, &visible[0]);
+				seconds[1] += std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+
+				frames++;
+			} while (seconds[0] + seconds[1] < BENCHMARK_MIN_SECONDS);
+
+			frustum.GetCullingStatistics(visibleCount, culledCount);
+			fout << std::left << std::setw(10) << GetSimdLevelName((SimdLevel)level) << std::right << std::fixed
+				 << std::setprecision(3) << std::setw(16) << seconds[0] * 1000.0 / frames << std::setw(12)
+				 << seconds[1] * 1000.0 / frames << std::setprecision(1) << std::setw(16)
+				 << BENCHMARK_OBJECT_COUNT * frames / seconds[1] / 1000000.0 << std::setw(10) << visibleCount
+				 << std::setw(10) << culledCount << "\n";
+		}
+		SetFrustumSimdLevel(originalLevel);
+
+		//Draw the first objects, without and with culling.
+		for (int cull = 0; cull < 2; cull++)
+		{
+			frames = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+				model->Render(device);
+
+				frustum.ConstructFrustum(viewMatrix, projectionMatrix);
+				TransformBoundingVolumes(objectBounds, &worldMatrices[0], drawCount, bounds);
+				if (cull)
+				{
+					frustum.CullBounds(bounds, drawCount, &visible[0]);
+				}
+
+				for (int i = 0; i < drawCount; i++)
+				{
+					if (!cull || visible[i])
+					{
+						shader->Render(device, model->GetIndexCount(), model->GetVertexFormat(),
+									   XMMatrixMultiply(XMLoadFloat4x4(&worldMatrices[i]), viewProjectionMatrix));
+					}
+				}
+				device->EndScene();
+
+				frames++;
+				seconds[cull] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds[cull] < BENCHMARK_MIN_SECONDS);
+			seconds[cull] /= frames;
+		}
+
+		frustum.GetCullingStatistics(visibleCount, culledCount);
+		fout << "Rendering " << drawCount << " objects: " << std::setprecision(3) << seconds[0] * 1000.0
+			 << " ms/frame drawing all, " << seconds[1] * 1000.0 << " ms/frame drawing the " << visibleCount
+			 << " visible\n\n";
+	}
+	else
+	{
+		fout << "Culling: could not create the software device\n\n";
+	}
+
+	shader->Shutdown();
+	delete shader;
+	model->Shutdown();
+	delete model;
+	device->Shutdown();
+	delete device;
+}
+
+/*
+ *	BenchmarkHierarchy()
+ *	brief: Builds a hierarchy over the objects of the culling benchmark, and compares culling them and casting rays
+ *		   at them through it with testing every object. Then moves them to time refitting.
+ */
+static void BenchmarkHierarchy(std::ofstream& fout)
+{
+	const unsigned int rayCount = 1000;
+	const unsigned int movedCount = BENCHMARK_OBJECT_COUNT / 100;
+	const BoundingVolume objectBounds = { XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f), sqrtf(3.0f) };
+	std::vector<XMFLOAT4X4> worldMatrices;
+	std::vector<float> streams[7];
+	std::vector<unsigned char> visible(BENCHMARK_OBJECT_COUNT);
+	std::vector<unsigned int> visibleObjects(BENCHMARK_OBJECT_COUNT);
+	std::vector<XMFLOAT3> rays(rayCount);
+	BoundsStream bounds;
+	FrustumClass frustum;
+	BVHClass hierarchy;
+	BenchmarkClock::time_point start;
+	SimdLevel originalLevel;
+	double seconds[2];
+	unsigned int random = 7, visibleCount[2] = { 0, 0 }, object, hits[2];
+	float distance, length;
+	int frames;
+	bool bRebuilt;
+
+	BuildObjectScene(worldMatrices, streams, bounds);
+	TransformBoundingVolumes(objectBounds, &worldMatrices[0], BENCHMARK_OBJECT_COUNT, bounds);
+
+	start = BenchmarkClock::now();
+	if (!hierarchy.Build(bounds, BENCHMARK_OBJECT_COUNT))
+	{
+		fout << "Hierarchy: could not build it\n\n";
+		return;
+	}
+	seconds[0] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+
+	fout << "Hierarchy: " << BENCHMARK_OBJECT_COUNT << " objects, " << hierarchy.GetNodeCount() << " nodes, built in "
+		 << std::fixed << std::setprecision(1) << seconds[0] * 1000.0 << " ms, SAH cost " << hierarchy.GetCost() << "\n";
+	fout << std::left << std::setw(10) << "simd" << std::right << std::setw(16) << "linear ms" << std::setw(12)
+		 << "bvh ms" << std::setw(10) << "speedup" << std::setw(10) << "visible" << std::setw(10) << "nodes" << "\n";
+
+	frustum.ConstructFrustum(XMMatrixIdentity(), XMMatrixPerspectiveFovLH(XM_PIDIV4,
+		(float)BENCHMARK_FRAME_WIDTH / (float)BENCHMARK_FRAME_HEIGHT, 0.1f, 1000.0f));
+
+	originalLevel = GetBVHSimdLevel();
+	for (int level = SIMD_LEVEL_SCALAR; level <= SIMD_LEVEL_AVX2; level++)
+	{
+		if (!SetBVHSimdLevel((SimdLevel)level) || !SetFrustumSimdLevel((SimdLevel)level))
+		{
+			continue;
+		}
+
+		//Testing every object against the frustum, and walking the tree.
+		for (int method = 0; method < 2; method++)
+		{
+			frames = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				if (method == 0)
+				{
+					visibleCount[method] = frustum.CullBounds(bounds, BENCHMARK_OBJECT_COUNT, &visible[0]);
+				}
+				else
+				{
+					visibleCount[method] = hierarchy.Cull(&frustum, &visibleObjects[0]);
+				}
+				frames++;
+				seconds[method] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds[method] < BENCHMARK_MIN_SECONDS);
+			seconds[method] /= frames;
+		}
+
+		//The flat test also uses the spheres, so it can find a few less objects than the boxes of the tree.
+		fout << std::left << std::setw(10) << GetSimdLevelName((SimdLevel)level) << std::right << std::setprecision(3)
+			 << std::setw(16) << seconds[0] * 1000.0 << std::setw(12) << seconds[1] * 1000.0 << std::setprecision(1)
+			 << std::setw(9) << seconds[0] / seconds[1] << "x" << std::setw(10) << visibleCount[1] << std::setw(10)
+			 << hierarchy.GetVisitedNodes() << "\n";
+	}
+	SetBVHSimdLevel(originalLevel);
+	SetFrustumSimdLevel(GetBVHSimdLevel());
+
+	//Rays from the origin in random directions, through the tree and against every object.
+	for (unsigned int i = 0; i < rayCount; i++)
+	{
+		do
+		{
+			rays[i] = XMFLOAT3((BenchmarkRandom(random) % 2001) / 1000.0f - 1.0f, (BenchmarkRandom(random) % 2001) / 1000.0f - 1.0f,
+							   (BenchmarkRandom(random) % 2001) / 1000.0f - 1.0f);
+			length = sqrtf(rays[i].x * rays[i].x + rays[i].y * rays[i].y + rays[i].z * rays[i].z);
+		} while (length < 0.01f);
+	}
+
+	for (int method = 0; method < 2; method++)
+	{
+		frames = 0;
+		start = BenchmarkClock::now();
+		do
+		{
+			hits[method] = 0;
+			for (unsigned int i = 0; i < rayCount; i++)
+			{
+				if (method == 1)
+				{
+					hits[method] += hierarchy.IntersectRay(XMFLOAT3(0.0f, 0.0f, 0.0f), rays[i], FLT_MAX, object, distance) ? 1 : 0;
+					continue;
+				}
+
+				//Slab test against every box, keeping the closest.
+				distance = FLT_MAX;
+				for (unsigned int j = 0; j < BENCHMARK_OBJECT_COUNT; j++)
+				{
+					float enter = 0.0f, leave = FLT_MAX;
+					const float origin[3] = { -bounds.centerX[j], -bounds.centerY[j], -bounds.centerZ[j] };
+					const float extent[3] = { bounds.extentX[j], bounds.extentY[j], bounds.extentZ[j] };
+					const float direction[3] = { rays[i].x, rays[i].y, rays[i].z };
+
+					for (int axis = 0; axis < 3; axis++)
+					{
+						const float nearSide = (-extent[axis] - origin[axis]) / direction[axis];
+						const float farSide = (extent[axis] - origin[axis]) / direction[axis];
+						enter = std::max(enter, std::min(nearSide, farSide));
+						leave = std::min(leave, std::max(nearSide, farSide));
+					}
+					if (enter <= leave && enter < distance)
+					{
+						distance = enter;
+					}
+				}
+				hits[method] += distance != FLT_MAX ? 1 : 0;
+			}
+			frames++;
+			seconds[method] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+		} while (seconds[method] < BENCHMARK_MIN_SECONDS);
+		seconds[method] /= frames;
+	}
+
+	fout << "Rays: " << std::setprecision(1) << rayCount / seconds[0] / 1000.0 << " krays/s testing every object, "
+		 << rayCount / seconds[1] / 1000.0 << " krays/s through the tree, " << hits[1] << "/" << rayCount << " hit ("
+		 << hits[0] << " linear)\n";
+
+	//A few objects moving every frame, refitting the path from each of them to the root.
+	frames = 0;
+	start = BenchmarkClock::now();
+	do
+	{
+		for (unsigned int i = 0; i < movedCount; i++)
+		{
+			object = BenchmarkRandom(random) % BENCHMARK_OBJECT_COUNT;
+			bounds.centerX[object] += (BenchmarkRandom(random) % 201) / 100.0f - 1.0f;
+			hierarchy.MoveObject(object, XMFLOAT3(bounds.centerX[object], bounds.centerY[object], bounds.centerZ[object]),
+								 XMFLOAT3(bounds.extentX[object], bounds.extentY[object], bounds.extentZ[object]));
+		}
+		frames++;
+		seconds[0] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+	} while (seconds[0] < BENCHMARK_MIN_SECONDS);
+	seconds[0] /= frames;
+
+	//Every object moving every frame, refitting the whole tree.
+	frames = 0;
+	bRebuilt = false;
+	start = BenchmarkClock::now();
+	do
+	{
+		for (unsigned int i = 0; i < BENCHMARK_OBJECT_COUNT; i++)
+		{
+			bounds.centerY[i] += (BenchmarkRandom(random) % 201) / 100.0f - 1.0f;
+		}
+		bRebuilt = hierarchy.Refit(bounds) || bRebuilt;
+		frames++;
+		seconds[1] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+	} while (seconds[1] < BENCHMARK_MIN_SECONDS);
+	seconds[1] /= frames;
+
+	fout << "Refit: " << std::setprecision(3) << seconds[0] * 1000.0 << " ms/frame moving " << movedCount
+		 << " objects, " << seconds[1] * 1000.0 << " ms/frame moving all of them" << (bRebuilt ? " (rebuilt)" : "")
+		 << ", SAH cost " << std::setprecision(1) << hierarchy.GetCost() << "\n\n";
+
+	hierarchy.Shutdown();
+}
+
+/*
+ *	BuildBenchmarkScene()
+ *	brief: Fills a scene graph with BENCHMARK_OBJECT_COUNT nodes: roots with 10 children of 99 leaves each, all
+ *		   with a transform of their own.
+ *	param nodes: Receives the handle of every node.
+ *	param roots: Receives the handle of every root.
+ */
+static void BuildBenchmarkScene(SceneGraphClass& scene, std::vector<unsigned int>& nodes, std::vector<unsigned int>& roots)
+{
+	unsigned int random = 3, root, group;
+
+	nodes.clear();
+	roots.clear();
+	while (nodes.size() + 1000 <= BENCHMARK_OBJECT_COUNT)
+	{
+		root = scene.AddNode(SCENE_NO_PARENT);
+		nodes.push_back(root);
+		roots.push_back(root);
+		for (int i = 0; i < 10; i++)
+		{
+			group = scene.AddNode(root);
+			nodes.push_back(group);
+			for (int j = 0; j < 99; j++)
+			{
+				nodes.push_back(scene.AddNode(group));
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < nodes.size(); i++)
+	{
+		scene.SetLocalPosition(nodes[i], (BenchmarkRandom(random) % 1000) * 0.01f, (BenchmarkRandom(random) % 1000) * 0.01f,
+							   (BenchmarkRandom(random) % 1000) * 0.01f);
+		scene.SetLocalRotation(nodes[i], (BenchmarkRandom(random) % 628) * 0.01f, (BenchmarkRandom(random) % 628) * 0.01f, 0.0f);
+	}
+	scene.Update();
+}
+
+/*
+ *	BenchmarkSceneGraph()
+ *	brief: Times updating the world matrices of a scene graph when nothing moves, when a few leaves move and when
+ *		   every root moves, on one thread and on all of them.
+ */
+static void BenchmarkSceneGraph(std::ofstream& fout)
+{
+	const char* const caseNames[] = { "static", "1% of nodes", "every root" };
+	SceneGraphClass scenes[2];
+	std::vector<unsigned int> nodes, roots;
+	JobSystemClass jobSystem;
+	BenchmarkClock::time_point start;
+	double seconds;
+	unsigned int random = 5, updated = 0, node;
+	int frames;
+
+	jobSystem.Initialize(0, 1);
+	scenes[0].Initialize(nullptr);
+	scenes[1].Initialize(&jobSystem);
+	BuildBenchmarkScene(scenes[0], nodes, roots);
+	BuildBenchmarkScene(scenes[1], nodes, roots);
+
+	fout << "Scene graph: " << nodes.size() << " nodes\n";
+	fout << std::left << std::setw(16) << "change" << std::right << std::setw(10) << "threads" << std::setw(12) << "ms"
+		 << std::setw(12) << "updated" << "\n";
+
+	for (int change = 0; change < 3; change++)
+	{
+		for (int threaded = 0; threaded < 2; threaded++)
+		{
+			SceneGraphClass& scene = scenes[threaded];
+
+			frames = 0;
+			seconds = 0.0;
+			do
+			{
+				//Only the update is timed, not the changes.
+				if (change == 1)
+				{
+					for (unsigned int i = 0; i < nodes.size() / 100; i++)
+					{
+						node = nodes[BenchmarkRandom(random) % nodes.size()];
+						scene.SetLocalPosition(node, (BenchmarkRandom(random) % 1000) * 0.01f, 0.0f, 0.0f);
+					}
+				}
+				else if (change == 2)
+				{
+					for (unsigned int i = 0; i < roots.size(); i++)
+					{
+						scene.SetLocalRotation(roots[i], 0.0f, frames * 0.01f, 0.0f);
+					}
+				}
+
+				start = BenchmarkClock::now();
+				updated = scene.Update();
+				seconds += std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+				frames++;
+			} while (seconds < BENCHMARK_MIN_SECONDS && frames < 1000000);
+
+			fout << std::left << std::setw(16) << caseNames[change] << std::right << std::setw(10)
+				 << (threaded ? jobSystem.GetThreadCount() : 1) << std::fixed << std::setprecision(4) << std::setw(12)
+				 << seconds * 1000.0 / frames << std::setw(12) << updated << "\n";
+		}
+	}
+	fout << "\n";
+
+	scenes[0].Shutdown();
+	scenes[1].Shutdown();
+	jobSystem.Shutdown();
+}
+
+/*
+ *	BenchmarkRenderQueue()
+ *	brief: Draws small copies of several models in both vertex formats in random order with the software device,
+ *		   binding everything for every draw like before, and through the render queue. Both images must match.
+ *	return: False if any image of the queue differs from the one drawn directly.
+ */
+static bool BenchmarkRenderQueue(std::ofstream& fout)
+{
+	const int modelCount = 8;
+	const int drawCounts[] = { 1000, 10000, 100000 };
+	SoftwareRendererClass* device;
+	ModelClass* models[modelCount];
+	ColorShader* shader;
+	RenderQueueClass queue;
+	RenderQueueStatistics statistics;
+	std::vector<XMFLOAT4X4> worldViewProjections;
+	std::vector<float> depths;
+	std::vector<int> drawModels;
+	std::vector<unsigned int> directImage;
+	XMMATRIX projectionMatrix, worldMatrix;
+	BenchmarkClock::time_point start;
+	double seconds[2];
+	unsigned int random = 11;
+	int frames;
+	bool bResult, bSameImage, bSameImages = true;
+
+	device = new SoftwareRendererClass();
+	shader = new ColorShader();
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device);
+	for (int i = 0; i < modelCount; i++)
+	{
+		models[i] = new ModelClass();
+		bResult = bResult && models[i]->Initialize(device, nullptr, i % 2 ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_FULL, nullptr);
+	}
+
+	if (bResult)
+	{
+		device->GetProjectionMatrix(projectionMatrix);
+		queue.Initialize(device, nullptr);
+
+		fout << "Render queue: " << modelCount << " models in 2 vertex formats\n";
+		fout << std::left << std::setw(10) << "draws" << std::right << std::setw(14) << "direct ms" << std::setw(12)
+			 << "queue ms" << std::setw(16) << "shader changes" << std::setw(16) << "buffer changes" << std::setw(16)
+			 << "sorted shader" << std::setw(16) << "sorted buffer" << std::setw(15) << "constant maps" << std::setw(8)
+			 << "image" << "\n";
+
+		for (int drawCase = 0; drawCase < 3; drawCase++)
+		{
+			const int drawCount = drawCounts[drawCase];
+
+			//Tiny copies at random places in the view, so the state changes weigh more than the pixels. Every copy has
+			//its own depth, or the overlapping ones would depend on the draw order.
+			worldViewProjections.resize(drawCount);
+			depths.resize(drawCount);
+			drawModels.resize(drawCount);
+			for (int i = 0; i < drawCount; i++)
+			{
+				depths[i] = 5.0f + 50.0f * i / drawCount;
+			}
+			for (int i = drawCount - 1; i > 0; i--)
+			{
+				std::swap(depths[i], depths[BenchmarkRandom(random) % (i + 1)]);
+			}
+			for (int i = 0; i < drawCount; i++)
+			{
+				drawModels[i] = BenchmarkRandom(random) % modelCount;
+				worldMatrix = XMMatrixMultiply(XMMatrixScaling(0.05f, 0.05f, 0.05f), XMMatrixTranslation(
+					((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depths[i],
+					((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depths[i] * 0.5f, depths[i]));
+				XMStoreFloat4x4(&worldViewProjections[i], XMMatrixMultiply(worldMatrix, projectionMatrix));
+			}
+
+			for (int method = 0; method < 2; method++)
+			{
+				frames = 0;
+				start = BenchmarkClock::now();
+				do
+				{
+					device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+					if (method == 0)
+					{
+						for (int i = 0; i < drawCount; i++)
+						{
+							models[drawModels[i]]->Render(device);
+							shader->Render(device, models[drawModels[i]]->GetIndexCount(), models[drawModels[i]]->GetVertexFormat(),
+										   XMLoadFloat4x4(&worldViewProjections[i]));
+						}
+					}
+					else
+					{
+						queue.Begin();
+						for (int i = 0; i < drawCount; i++)
+						{
+							queue.AddDraw(RENDER_PASS_OPAQUE, shader, models[drawModels[i]],
+										  XMLoadFloat4x4(&worldViewProjections[i]), depths[i]);
+						}
+						queue.Submit();
+					}
+					device->EndScene();
+
+					frames++;
+					seconds[method] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+				} while (seconds[method] < BENCHMARK_MIN_SECONDS);
+				seconds[method] /= frames;
+
+				if (method == 0)
+				{
+					directImage.assign(device->GetColorBuffer(), device->GetColorBuffer() + BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+				}
+			}
+
+			bSameImage = memcmp(&directImage[0], device->GetColorBuffer(), directImage.size() * sizeof(unsigned int)) == 0;
+			bSameImages = bSameImages && bSameImage;
+			queue.GetStatistics(statistics);
+			fout << std::left << std::setw(10) << drawCount << std::right << std::fixed << std::setprecision(3)
+				 << std::setw(14) << seconds[0] * 1000.0 << std::setw(12) << seconds[1] * 1000.0 << std::setw(16)
+				 << statistics.unsortedShaderChanges << std::setw(16) << statistics.unsortedBufferChanges << std::setw(16)
+				 << statistics.shaderChanges << std::setw(16) << statistics.bufferChanges << std::setw(15)
+				 << statistics.constantMaps << std::setw(8) << (bSameImage ? "same" : "DIFF") << "\n";
+		}
+		if (!bSameImages)
+		{
+			fout << "FAILED: the render queue changed the image\n";
+		}
+		fout << "\n";
+
+		queue.Shutdown();
+	}
+	else
+	{
+		fout << "Render queue: could not create the software device\n\n";
+	}
+
+	for (int i = 0; i < modelCount; i++)
+	{
+		models[i]->Shutdown();
+		delete models[i];
+	}
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+
+	return bSameImages;
+}
+
+/*
+ *	BenchmarkCommandRecording()
+ *	brief: Times submitting a frame of 20000 sorted draws with the software device, recorded by 1, 2, 4... threads
+ *		   into command lists. Only the submission is timed, not the rasterization. Every image must match the one
+ *		   recorded on a single thread.
+ */
+static void BenchmarkCommandRecording(std::ofstream& fout)
+{
+	const int modelCount = 8;
+	const int drawCount = 20000;
+	SoftwareRendererClass* device;
+	ModelClass* models[modelCount];
+	ColorShader* shader;
+	RenderQueueClass queue;
+	JobSystemClass jobSystem;
+	std::vector<XMFLOAT4X4> worldViewProjections;
+	std::vector<float> depths;
+	std::vector<int> drawModels;
+	std::vector<unsigned int> threadCounts, singleThreadImage;
+	XMMATRIX projectionMatrix, worldMatrix;
+	BenchmarkClock::time_point start;
+	double seconds, singleThreadSeconds = 0.0;
+	unsigned int random = 13, hardwareThreads;
+	int frames;
+	bool bResult, bSameImage;
+
+	device = new SoftwareRendererClass();
+	shader = new ColorShader();
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device);
+	for (int i = 0; i < modelCount; i++)
+	{
+		models[i] = new ModelClass();
+		bResult = bResult && models[i]->Initialize(device, nullptr, i % 2 ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_FULL, nullptr);
+	}
+
+	if (bResult)
+	{
+		//The same kind of frame as the render queue benchmark.
+		device->GetProjectionMatrix(projectionMatrix);
+		worldViewProjections.resize(drawCount);
+		depths.resize(drawCount);
+		drawModels.resize(drawCount);
+		for (int i = 0; i < drawCount; i++)
+		{
+			depths[i] = 5.0f + 50.0f * i / drawCount;
+		}
+		for (int i = drawCount - 1; i > 0; i--)
+		{
+			std::swap(depths[i], depths[BenchmarkRandom(random) % (i + 1)]);
+		}
+		for (int i = 0; i < drawCount; i++)
+		{
+			drawModels[i] = BenchmarkRandom(random) % modelCount;
+			worldMatrix = XMMatrixMultiply(XMMatrixScaling(0.05f, 0.05f, 0.05f), XMMatrixTranslation(
+				((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depths[i],
+				((BenchmarkRandom(random) % 1000) * 0.001f - 0.5f) * depths[i] * 0.5f, depths[i]));
+			XMStoreFloat4x4(&worldViewProjections[i], XMMatrixMultiply(worldMatrix, projectionMatrix));
+		}
+
+		hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+		for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+		{
+			threadCounts.push_back(threads);
+		}
+		threadCounts.push_back(hardwareThreads);
+
+		fout << "Command recording: " << drawCount << " draws of " << modelCount << " models\n";
+		fout << std::left << std::setw(10) << "threads" << std::right << std::setw(14) << "submit ms" << std::setw(10)
+			 << "speedup" << std::setw(8) << "image" << "\n";
+
+		for (unsigned int i = 0; i < threadCounts.size(); i++)
+		{
+			jobSystem.Initialize(threadCounts[i], 1);
+			queue.Initialize(device, &jobSystem);
+
+			frames = 0;
+			seconds = 0.0;
+			do
+			{
+				device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+				queue.Begin();
+				for (int j = 0; j < drawCount; j++)
+				{
+					queue.AddDraw(RENDER_PASS_OPAQUE, shader, models[drawModels[j]], XMLoadFloat4x4(&worldViewProjections[j]),
+								  depths[j]);
+				}
+
+				start = BenchmarkClock::now();
+				queue.Submit();
+				seconds += std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+
+				device->EndScene();
+				frames++;
+			} while (seconds < BENCHMARK_MIN_SECONDS);
+			seconds /= frames;
+
+			if (i == 0)
+			{
+				singleThreadSeconds = seconds;
+				singleThreadImage.assign(device->GetColorBuffer(), device->GetColorBuffer() + BENCHMARK_FRAME_WIDTH * BENCHMARK_FRAME_HEIGHT);
+			}
+			bSameImage = memcmp(&singleThreadImage[0], device->GetColorBuffer(), singleThreadImage.size() * sizeof(unsigned int)) == 0;
+
+			fout << std::left << std::setw(10) << threadCounts[i] << std::right << std::fixed << std::setprecision(3)
+				 << std::setw(14) << seconds * 1000.0 << std::setprecision(2) << std::setw(10)
+				 << singleThreadSeconds / seconds << std::setw(8) << (bSameImage ? "same" : "DIFF") << "\n";
+
+			queue.Shutdown();
+			jobSystem.Shutdown();
+		}
+		fout << "\n";
+	}
+	else
+	{
+		fout << "Command recording: could not create the software device\n\n";
+	}
+
+	for (int i = 0; i < modelCount; i++)
+	{
+		models[i]->Shutdown();
+		delete models[i];
+	}
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+}
+
+/*
+ *	BenchmarkJobSystem()
+ *	brief: Times a parallel for of one job per index on 1 to 64 threads, with empty jobs, which only measure the
+ *		   cost of the job system, and with small ones that transform a few points each. With one thread the
+ *		   parallel for is a plain loop, so the speedup is over code without jobs.
+ */
+static void BenchmarkJobSystem(std::ofstream& fout)
+{
+	const unsigned int jobCount = 65536;
+	const unsigned int pointsPerJob = 16;
+	const char* const workloadNames[] = { "empty", "small" };
+	JobSystemClass jobSystem;
+	std::vector<XMFLOAT4> points, results;
+	XMFLOAT4X4 matrix;
+	BenchmarkClock::time_point start;
+	double seconds, singleThreadSeconds[2] = { 0.0, 0.0 };
+	unsigned int random = 17;
+	int frames;
+
+	points.resize(jobCount * pointsPerJob);
+	results.resize(jobCount * pointsPerJob);
+	for (unsigned int i = 0; i < points.size(); i++)
+	{
+		points[i] = XMFLOAT4((BenchmarkRandom(random) % 1000) * 0.01f, (BenchmarkRandom(random) % 1000) * 0.01f,
+							 (BenchmarkRandom(random) % 1000) * 0.01f, 1.0f);
+	}
+	XMStoreFloat4x4(&matrix, XMMatrixMultiply(XMMatrixRotationRollPitchYaw(0.3f, 0.7f, 0.1f), XMMatrixTranslation(1.0f, 2.0f, 3.0f)));
+
+	fout << "Job system: " << jobCount << " jobs per parallel for, " << pointsPerJob << " points per small job\n";
+	fout << std::left << std::setw(10) << "workload" << std::right << std::setw(10) << "threads" << std::setw(12) << "ms"
+		 << std::setw(14) << "jobs per ms" << std::setw(10) << "speedup" << "\n";
+
+	for (int workload = 0; workload < 2; workload++)
+	{
+		for (unsigned int threads = 1; threads <= 64; threads *= 2)
+		{
+			jobSystem.Initialize(threads, 1);
+
+			frames = 0;
+			start = BenchmarkClock::now();
+			do
+			{
+				if (workload == 0)
+				{
+					jobSystem.ParallelFor(jobCount, 1, [](unsigned int /*index*/, unsigned int /*threadIndex*/)
+					{
+					});
+				}
+				else
+				{
+					jobSystem.ParallelFor(jobCount, 1, [&points, &results, &matrix](unsigned int index, unsigned int /*threadIndex*/)
+					{
+						XMMATRIX transform = XMLoadFloat4x4(&matrix);
+
+						for (unsigned int i = index * pointsPerJob; i < (index + 1) * pointsPerJob; i++)
+						{
+							XMStoreFloat4(&results[i], XMVector4Transform(XMLoadFloat4(&points[i]), transform));
+						}
+					});
+				}
+				frames++;
+				seconds = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+			} while (seconds < BENCHMARK_MIN_SECONDS);
+			seconds /= frames;
+
+			if (threads == 1)
+			{
+				singleThreadSeconds[workload] = seconds;
+			}
+
+			fout << std::left << std::setw(10) << workloadNames[workload] << std::right << std::setw(10) << threads
+				 << std::fixed << std::setprecision(3) << std::setw(12) << seconds * 1000.0 << std::setprecision(0)
+				 << std::setw(14) << jobCount / (seconds * 1000.0) << std::setprecision(2) << std::setw(10)
+				 << singleThreadSeconds[workload] / seconds << "\n";
+
+			jobSystem.Shutdown();
+		}
+	}
+	fout << "\n";
+}
+
+/*
+ *	BenchmarkFramePipeline()
+ *	brief: Makes frames of a scene graph with BENCHMARK_OBJECT_COUNT nodes whose roots all turn, drawing a fifth of
+ *		   the nodes with the software device. The frames are simulated and rendered one after the other on one
+ *		   thread, and then pipelined on two. Reports the throughput and the latency from the start of the
+ *		   simulation of a frame to the end of its render, and the allocations from the heap per frame, which
+ *		   once the frames have grown what they keep must be none.
+ *	return: False if a frame failed or still allocated.
+ */
+static bool BenchmarkFramePipeline(std::ofstream& fout)
+{
+	const int modelCount = 8;
+	const unsigned int drawStride = 5;
+	const unsigned int maxWarmupFrames = 64;
+	const char* const modeNames[] = { "serial", "pipelined" };
+	SoftwareRendererClass* device;
+	ModelClass* models[modelCount];
+	ColorShader* shader;
+	JobSystemClass jobSystem;
+	SceneGraphClass scene;
+	RenderQueueClass queue;
+	FrameAllocatorClass frameAllocator;
+	FramePipelineClass pipeline;
+	FramePipelineStatistics statistics;
+	HeapStatistics heapStart, heapEnd;
+	AllocatorStatistics memory;
+	std::vector<unsigned int> nodes, roots;
+	XMMATRIX projectionMatrix, viewMatrix;
+	XMFLOAT4X4 viewProjection, scale;
+	BenchmarkClock::time_point start;
+	unsigned int warmupFrames, warmupStart;
+	bool bResult, bPassed = true;
+
+	device = new SoftwareRendererClass();
+	shader = new ColorShader();
+	bResult = device->Initialize(BENCHMARK_FRAME_WIDTH, BENCHMARK_FRAME_HEIGHT, false, NULL, false, 1000.0f, 0.1f);
+	bResult = bResult && shader->Initialize(device);
+	for (int i = 0; i < modelCount; i++)
+	{
+		models[i] = new ModelClass();
+		bResult = bResult && models[i]->Initialize(device, nullptr, i % 2 ? VERTEX_FORMAT_PACKED : VERTEX_FORMAT_FULL, nullptr);
+	}
+
+	if (bResult)
+	{
+		jobSystem.Initialize(0, FRAME_PIPELINE_THREADS);
+		scene.Initialize(&jobSystem);
+		BuildBenchmarkScene(scene, nodes, roots);
+		queue.Initialize(device, &jobSystem);
+		frameAllocator.Initialize(jobSystem.GetThreadCount(), 4 * 1024 * 1024);
+
+		//A camera looking at the whole scene, and small models at the nodes.
+		device->GetProjectionMatrix(projectionMatrix);
+		viewMatrix = XMMatrixLookAtLH(XMVectorSet(15.0f, 15.0f, -30.0f, 1.0f), XMVectorSet(15.0f, 15.0f, 15.0f, 1.0f),
+									  XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMStoreFloat4x4(&viewProjection, XMMatrixMultiply(viewMatrix, projectionMatrix));
+		XMStoreFloat4x4(&scale, XMMatrixScaling(0.05f, 0.05f, 0.05f));
+
+		pipeline.Initialize(&jobSystem, [&](FrameSnapshot& snapshot)
+		{
+			XMMATRIX worldMatrix;
+
+			for (unsigned int i = 0; i < roots.size(); i++)
+			{
+				scene.SetLocalRotation(roots[i], 0.0f, snapshot.frame * 0.01f, 0.0f);
+			}
+			scene.Update();
+
+			snapshot.drawCount = (unsigned int)nodes.size() / drawStride;
+			snapshot.draws = (FrameDraw*)frameAllocator.Allocate(snapshot.frame, FRAME_SIMULATION_THREAD,
+																 sizeof(FrameDraw) * snapshot.drawCount, alignof(FrameDraw));
+			if (!snapshot.draws)
+			{
+				return false;
+			}
+
+			for (unsigned int i = 0; i < snapshot.drawCount; i++)
+			{
+				FrameDraw& draw = snapshot.draws[i];
+
+				scene.GetWorldMatrix(nodes[i * drawStride], worldMatrix);
+				XMStoreFloat4x4(&draw.worldViewProjection, XMMatrixMultiply(XMMatrixMultiply(XMLoadFloat4x4(&scale), worldMatrix),
+																			XMLoadFloat4x4(&viewProjection)));
+				draw.pass = RENDER_PASS_OPAQUE;
+				draw.shader = shader;
+				draw.model = models[i % modelCount];
+
+				//The projected w of the origin of the model is its depth in view space.
+				draw.depth = draw.worldViewProjection.m[3][3];
+			}
+			snapshot.visibleCount = snapshot.drawCount;
+			snapshot.culledCount = 0;
+
+			return true;
+		},
+		[&](const FrameSnapshot& snapshot)
+		{
+			bool bSubmitted;
+
+			queue.Begin();
+			for (unsigned int i = 0; i < snapshot.drawCount; i++)
+			{
+				const FrameDraw& draw = snapshot.draws[i];
+
+				queue.AddDraw(draw.pass, draw.shader, draw.model, XMLoadFloat4x4(&draw.worldViewProjection), draw.depth);
+			}
+
+			device->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+			bSubmitted = queue.Submit();
+			device->EndScene();
+			frameAllocator.EndFrame(snapshot.frame);
+
+			return bSubmitted;
+		});
+
+		fout << "Frame pipeline: " << nodes.size() << " nodes, " << nodes.size() / drawStride << " draws, "
+			 << jobSystem.GetThreadCount() << " job threads\n";
+		fout << std::left << std::setw(12) << "mode" << std::right << std::setw(10) << "frames/s" << std::setw(14)
+			 << "latency ms" << std::setw(14) << "max latency" << std::setw(14) << "simulate ms" << std::setw(12)
+			 << "render ms" << std::setw(12) << "heap/frame" << std::setw(12) << "frame KB" << "\n";
+
+		for (int mode = 0; mode < 2; mode++)
+		{
+			//Frames first, made the way they are measured since each thread records with its own context, until
+			//the device, the queue and the command lists have grown what they keep and a frame allocates nothing.
+			bResult = mode == 1 ? pipeline.Start() : true;
+			warmupFrames = 0;
+			do
+			{
+				GetHeapStatistics(heapStart);
+				if (mode == 0)
+				{
+					bResult = bResult && pipeline.RunFrame();
+				}
+				else
+				{
+					//Two frames rendered, so at least one was made whole in between.
+					pipeline.GetStatistics(statistics);
+					warmupStart = statistics.frames;
+					while (bResult && statistics.frames < warmupStart + 2)
+					{
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+						pipeline.GetStatistics(statistics);
+						bResult = !pipeline.HasFailed();
+					}
+				}
+				GetHeapStatistics(heapEnd);
+			} while (bResult && heapEnd.allocations != heapStart.allocations && ++warmupFrames < maxWarmupFrames);
+
+			pipeline.ResetStatistics();
+			GetHeapStatistics(heapStart);
+			if (mode == 0)
+			{
+				start = BenchmarkClock::now();
+				while (bResult && std::chrono::duration<double>(BenchmarkClock::now() - start).count() < BENCHMARK_MIN_SECONDS)
+				{
+					bResult = pipeline.RunFrame();
+				}
+			}
+			else
+			{
+				std::this_thread::sleep_for(std::chrono::duration<double>(BENCHMARK_MIN_SECONDS));
+				bResult = bResult && !pipeline.HasFailed();
+			}
+
+			//Taken before stopping, which waits for the frames being made.
+			pipeline.GetStatistics(statistics);
+			GetHeapStatistics(heapEnd);
+			pipeline.Stop();
+			frameAllocator.Reset();
+			frameAllocator.GetStatistics(memory);
+
+			fout << std::left << std::setw(12) << modeNames[mode] << std::right << std::fixed << std::setprecision(1)
+				 << std::setw(10) << statistics.framesPerSecond << std::setprecision(3) << std::setw(14)
+				 << statistics.averageLatency << std::setw(14) << statistics.maximumLatency << std::setw(14)
+				 << statistics.averageSimulationTime << std::setw(12) << statistics.averageRenderTime << std::setprecision(2)
+				 << std::setw(12) << (statistics.frames ? (double)(heapEnd.allocations - heapStart.allocations) / statistics.frames : 0.0)
+				 << std::setprecision(1) << std::setw(12) << memory.peakBytes / 1024.0 << (bResult ? "" : "  (failed)") << "\n";
+
+			if (!bResult)
+			{
+				bPassed = false;
+			}
+			else if (heapEnd.allocations != heapStart.allocations)
+			{
+				fout << "FAILED: the " << modeNames[mode] << " frames still allocate from the heap after "
+					 << warmupFrames << " frames to warm up.\n";
+				bPassed = false;
+			}
+		}
+		fout << "\n";
+
+		pipeline.Shutdown();
+		frameAllocator.Shutdown();
+		queue.Shutdown();
+		scene.Shutdown();
+		jobSystem.Shutdown();
+	}
+	else
+	{
+		fout << "Frame pipeline: could not create the software device\n\n";
+	}
+
+	for (int i = 0; i < modelCount; i++)
+	{
+		models[i]->Shutdown();
+		delete models[i];
+	}
+	shader->Shutdown();
+	delete shader;
+	device->Shutdown();
+	delete device;
+
+	return bPassed;
+}
+
+/*
+ *	BenchmarkShaderCache()
+ *	brief: Loads the shader code ColorShader creates at startup, its vertex and pixel shaders for every vertex
+ *		   format and permutation, once with an empty cache, compiling them, and then from the cache file.
+ *		   Only the code is loaded, without a device, so the times are the part of the startup the cache saves.
+ */
+static void BenchmarkShaderCache(std::ofstream& fout)
+{
+#ifdef _WIN32
+	const WCHAR* filenames[2] = { L"../Graphic_Engine_v2/ColorVS.hlsl", L"../Graphic_Engine_v2/ColorPS.hlsl" };
+	ShaderCacheClass cache;
+	ShaderDefine defines[SHADER_FEATURE_COUNT];
+	unsigned int numDefines;
+	ShaderCacheStatistics statistics[2];
+	ID3D10Blob* errorMessage;
+	const void* bytecode;
+	unsigned int bytecodeSize;
+	unsigned long long cacheSize, cacheTime;
+	BenchmarkClock::time_point start;
+	double seconds[2];
+	int startups;
+	bool bResult;
+
+	remove(BENCHMARK_SHADER_CACHE_FILE);
+
+	bResult = true;
+	startups = 0;
+	for (int run = 0; run < 2 && bResult; run++)
+	{
+		start = BenchmarkClock::now();
+		do
+		{
+			//The first run starts cold every time, the second finds the file the first one saved.
+			if (run == 0)
+			{
+				remove(BENCHMARK_SHADER_CACHE_FILE);
+			}
+
+			cache.Initialize(BENCHMARK_SHADER_CACHE_FILE);
+			for (int format = 0; format < VERTEX_FORMAT_COUNT && bResult; format++)
+			{
+				for (unsigned int permutation = 0; permutation < SHADER_PERMUTATION_COUNT && bResult; permutation++)
+				{
+					numDefines = GetShaderPermutationDefines(permutation, defines);
+					bResult = D3DClass::LoadShaderBytecode(cache, filenames[0], "ColorVertexShader", "vs_5_0", defines,
+														   numDefines, bytecode, bytecodeSize, &errorMessage) &&
+							  D3DClass::LoadShaderBytecode(cache, filenames[1], "ColorPixelShader", "ps_5_0", defines,
+														   numDefines, bytecode, bytecodeSize, &errorMessage);
+					if (errorMessage)
+					{
+						errorMessage->Release();
+					}
+				}
+			}
+			cache.GetStatistics(statistics[run]);
+			bResult = bResult && cache.Save();
+			cache.Shutdown();
+
+			startups++;
+			seconds[run] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+		} while (bResult && seconds[run] < BENCHMARK_MIN_SECONDS);
+		seconds[run] /= startups;
+		startups = 0;
+	}
+
+	if (bResult && GetFileInfo(BENCHMARK_SHADER_CACHE_FILE, cacheSize, cacheTime))
+	{
+		fout << "Shader cache: ColorShader startup, " << statistics[0].hits + statistics[0].misses << " shader loads\n";
+		fout << std::left << std::setw(12) << "startup" << std::right << std::setw(12) << "ms" << std::setw(12)
+			 << "compiled" << std::setw(12) << "cached" << "\n";
+		fout << std::fixed << std::setprecision(3);
+		fout << std::left << std::setw(12) << "cold" << std::right << std::setw(12) << seconds[0] * 1000.0 << std::setw(12)
+			 << statistics[0].misses << std::setw(12) << statistics[0].hits << "\n";
+		fout << std::left << std::setw(12) << "warm" << std::right << std::setw(12) << seconds[1] * 1000.0 << std::setw(12)
+			 << statistics[1].misses << std::setw(12) << statistics[1].hits << "\n";
+		fout << "cache file " << cacheSize / 1024.0 << " KB, speedup " << seconds[0] / seconds[1] << "x\n\n";
+	}
+	else
+	{
+		fout << "Shader cache: could not compile the shaders or write " << BENCHMARK_SHADER_CACHE_FILE << "\n\n";
+	}
+
+	remove(BENCHMARK_SHADER_CACHE_FILE);
+#else
+	fout << "Shader cache: needs the HLSL compiler, only on Windows\n\n";
+#endif
+}
+
+/*
+ *	BenchmarkProfiler()
+ *	brief: Measures what a profiler zone costs on one thread: with no profiler running, and recording, where the
+ *		   profiler ends a frame every half buffer of zones. Collecting the zones at the end of the frames is
+ *		   measured apart, it happens once a frame and not in the zone.
+ */
+static void BenchmarkProfiler(std::ofstream& fout)
+{
+	const unsigned int zonesPerFrame = PROFILER_THREAD_EVENTS / 2;
+	ProfilerClass profiler;
+	ProfilerStatistics statistics;
+	BenchmarkClock::time_point start, collectStart;
+	double seconds[3], collectSeconds;
+	unsigned long long zones[3];
+	volatile unsigned int sink;
+
+	fout << "Profiler: 1 thread, " << zonesPerFrame << " zones per frame\n";
+	fout << std::left << std::setw(26) << "zone" << std::right << std::setw(12) << "ns/zone" << "\n";
+
+	sink = 0;
+	collectSeconds = 0.0;
+	for (int run = 0; run < 3; run++)
+	{
+		//Without a zone, then a zone no profiler records, then a zone recorded.
+		if (run == 2 && !profiler.Initialize())
+		{
+			fout << "could not start the profiler\n\n";
+			return;
+		}
+
+		zones[run] = 0;
+		start = BenchmarkClock::now();
+		do
+		{
+			for (unsigned int i = 0; i < zonesPerFrame; i++)
+			{
+				if (run == 0)
+				{
+					sink = sink + 1;
+				}
+				else
+				{
+					PROFILE_ZONE("benchmark zone");
+					sink = sink + 1;
+				}
+			}
+			zones[run] += zonesPerFrame;
+
+			if (run == 2)
+			{
+				collectStart = BenchmarkClock::now();
+				profiler.EndFrame();
+				collectSeconds += std::chrono::duration<double>(BenchmarkClock::now() - collectStart).count();
+			}
+			seconds[run] = std::chrono::duration<double>(BenchmarkClock::now() - start).count();
+		} while (seconds[run] < BENCHMARK_MIN_SECONDS);
+	}
+	seconds[2] -= collectSeconds;
+	profiler.GetStatistics(statistics);
+	profiler.Shutdown();
+
+	fout << std::fixed << std::setprecision(2);
+	fout << std::left << std::setw(26) << "none" << std::right << std::setw(12) << seconds[0] * 1e9 / zones[0] << "\n";
+	fout << std::left << std::setw(26) << "profiler stopped" << std::right << std::setw(12)
+		 << seconds[1] * 1e9 / zones[1] << "\n";
+	fout << std::left << std::setw(26) << "recording" << std::right << std::setw(12) << seconds[2] * 1e9 / zones[2] << "\n";
+	fout << std::left << std::setw(26) << "collecting, per zone" << std::right << std::setw(12)
+		 << collectSeconds * 1e9 / zones[2] << "\n";
+	fout << statistics.events << " zones recorded, " << statistics.droppedEvents << " dropped, time stamp counter at "
+		 << statistics.ticksPerSecond / 1e9 << " GHz\n\n";
+}
+
+/*
+ *	IsBenchmarkSelected()
+ *	brief: Checks if a benchmark was named after the switch. Naming none selects all of them.
+ */
+static bool IsBenchmarkSelected(const char* arguments, const char* name)
+{
+	const char* found;
+	size_t length;
+
+	if (arguments[strspn(arguments, " \t")] == '\0')
+	{
+		return true;
+	}
+
+	length = strlen(name);
+	for (found = strstr(arguments, name); found; found = strstr(found + 1, name))
+	{
+		if ((found == arguments || found[-1] == ' ' || found[-1] == '\t') &&
+			(found[length] == '\0' || found[length] == ' ' || found[length] == '\t'))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool RunBenchmarks(const char* commandLine, const char* outputFilename)
+{
+	std::ofstream fout;
+	const char* arguments;
+	bool bChecksPassed = true;
+
+	arguments = strstr(commandLine, BENCHMARK_SWITCH);
+	arguments = arguments ? arguments + strlen(BENCHMARK_SWITCH) : "";
+
+	fout.open(outputFilename);
+	if (!fout)
+	{
+		return false;
+	}
+
+	if (IsBenchmarkSelected(arguments, "raster"))
+	{
+		BenchmarkRasterizer(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "transform"))
+	{
+		BenchmarkTransform(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "shading"))
+	{
+		BenchmarkShading(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "depth"))
+	{
+		BenchmarkDepthRejection(fout);
+		bChecksPassed = BenchmarkSubBlockDepth(fout) && bChecksPassed;
+	}
+
+	if (IsBenchmarkSelected(arguments, "readback"))
+	{
+		BenchmarkReadback(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "instancing"))
+	{
+		BenchmarkInstancing(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "meshload"))
+	{
+		BenchmarkMeshLoad(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "meshopt"))
+	{
+		BenchmarkMeshOptimizer(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "vertexformat"))
+	{
+		BenchmarkVertexFormat(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "culling"))
+	{
+		BenchmarkCulling(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "bvh"))
+	{
+		BenchmarkHierarchy(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "scene"))
+	{
+		BenchmarkSceneGraph(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "queue"))
+	{
+		bChecksPassed = BenchmarkRenderQueue(fout) && bChecksPassed;
+	}
+
+	if (IsBenchmarkSelected(arguments, "recording"))
+	{
+		BenchmarkCommandRecording(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "jobs"))
+	{
+		BenchmarkJobSystem(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "pipeline"))
+	{
+		bChecksPassed = BenchmarkFramePipeline(fout) && bChecksPassed;
+	}
+
+	if (IsBenchmarkSelected(arguments, "shadercache"))
+	{
+		BenchmarkShaderCache(fout);
+	}
+
+	if (IsBenchmarkSelected(arguments, "profiler"))
+	{
+		BenchmarkProfiler(fout);
+	}
+
+	fout.close();
+	return bChecksPassed;
+}
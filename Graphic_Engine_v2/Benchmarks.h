@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef BENCHMARKS
+#define BENCHMARKS
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const char BENCHMARK_SWITCH[] = "-benchmark";				//Command line switch that runs the benchmarks instead of the engine.
+const char BENCHMARK_OUTPUT_FILE[] = "benchmark.txt";
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+/*
+ *	RunBenchmarks()
+ *	brief: Runs the benchmarks named after the switch in the command line, or all of them if none is named, and
+ *		   writes the results to a text file. For example: "-benchmark raster".
+ *	return: False if the file couldn't be written, or if a benchmark that checks its images found a difference.
+ */
+bool RunBenchmarks(const char* commandLine, const char* outputFilename);
+
+#endif
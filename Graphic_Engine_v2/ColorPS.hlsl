@@ -1,3 +1,24 @@
+/********************************/
+/*   DEFINES                    */
+/********************************/
+//The features of the permutation being compiled, see ShaderPermutation.h.
+#ifndef FOG
+#define FOG 0
+#endif
+
+/********************************/
+/*   GLOBALS                    */
+/********************************/
+#if FOG
+cbuffer FogBuffer : register(b1)
+{
+    float4 fogColor;
+    float  fogStart;
+    float  fogEnd;
+    float2 fogPadding;
+};
+#endif
+
 /********************************/
 /*   TYPEDEFS                   */
 /********************************/
@@ -5,9 +26,16 @@ struct PixelInputType
 {
     float4 position : SV_Position;
     float4 color    : COLOR;
+#if FOG
+    float  fog      : FOG;
+#endif
 };
 
 float4 ColorPixelShader(PixelInputType input) : SV_TARGET
 {
+#if FOG
+	return lerp(fogColor, input.color, input.fog);
+#else
 	return input.color;
-}
\ No newline at end of file
+#endif
+}
@@ -1,13 +1,73 @@
 #include "ColorShader.h"
+#include "Profiler.h"
+#include <cstring>
+
+/*
+ *	SetVertexElements()
+ *	brief: Fills the two elements of a layout that read the vertex buffer of a model in the given vertex format.
+ *		   The packed formats are expanded to floats by the input assembler, so the shaders are the same for all.
+ */
+static void SetVertexElements(VertexFormat vertexFormat, InputElementDesc* polygonLayout)
+{
+	polygonLayout[0].semanticName = "POSITION";
+	polygonLayout[0].semanticIndex = 0;
+	polygonLayout[0].format = vertexFormat == VERTEX_FORMAT_PACKED ? ELEMENT_FORMAT_UNORM16X4 : ELEMENT_FORMAT_FLOAT3;
+	polygonLayout[0].inputSlot = 0;
+	polygonLayout[0].alignedByteOffset = 0;
+	polygonLayout[0].inputSlotClass = INPUT_PER_VERTEX_DATA;
+	polygonLayout[0].instanceDataStepRate = 0;
+
+	polygonLayout[1].semanticName = "COLOR";
+	polygonLayout[1].semanticIndex = 0;
+	polygonLayout[1].format = vertexFormat == VERTEX_FORMAT_PACKED ? ELEMENT_FORMAT_UNORM8X4 : ELEMENT_FORMAT_FLOAT4;
+	polygonLayout[1].inputSlot = 0;
+	polygonLayout[1].alignedByteOffset = APPEND_ALIGNED_ELEMENT;
+	polygonLayout[1].inputSlotClass = INPUT_PER_VERTEX_DATA;
+	polygonLayout[1].instanceDataStepRate = 0;
+}
 
+/*
+ *	SetInstanceElements()
+ *	brief: Fills the five elements after the vertex ones that read the instances from slot 1. They have to match
+ *		   the InstanceType structure in the ModelClass: the four rows of the world matrix and then the color.
+ */
+static void SetInstanceElements(InputElementDesc* polygonLayout)
+{
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		polygonLayout[2 + i].semanticName = "WORLD";
+		polygonLayout[2 + i].semanticIndex = i;
+		polygonLayout[2 + i].format = ELEMENT_FORMAT_FLOAT4;
+		polygonLayout[2 + i].inputSlot = 1;
+		polygonLayout[2 + i].alignedByteOffset = i == 0 ? 0 : APPEND_ALIGNED_ELEMENT;
+		polygonLayout[2 + i].inputSlotClass = INPUT_PER_INSTANCE_DATA;
+		polygonLayout[2 + i].instanceDataStepRate = 1;
+	}
 
+	polygonLayout[6].semanticName = "INSTANCECOLOR";
+	polygonLayout[6].semanticIndex = 0;
+	polygonLayout[6].format = ELEMENT_FORMAT_FLOAT4;
+	polygonLayout[6].inputSlot = 1;
+	polygonLayout[6].alignedByteOffset = APPEND_ALIGNED_ELEMENT;
+	polygonLayout[6].inputSlotClass = INPUT_PER_INSTANCE_DATA;
+	polygonLayout[6].instanceDataStepRate = 1;
+}
 
 ColorShader::ColorShader()
 {
+	m_device = nullptr;
 	m_matrixBuffer = nullptr;
-	m_pixelShader = nullptr;
-	m_vertexShader = nullptr;
-	m_inputLayout = nullptr;
+	m_fogBuffer = nullptr;
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+	{
+		for (unsigned int j = 0; j < SHADER_PERMUTATION_COUNT; j++)
+		{
+			m_programs[i][j] = nullptr;
+		}
+	}
+	m_features = 0;
+	m_matrixUploaded = false;
+	m_uploadedCommandLists = 0;
 }
 
 ColorShader::ColorShader(const ColorShader& object)
@@ -20,11 +80,14 @@ ColorShader::~ColorShader()
 {
 }
 
-bool ColorShader::Initialize(ID3D11Device * device, HWND hwnd)
+bool ColorShader::Initialize(RenderDevice * device)
 {
 	bool bResult;
 
-	bResult = InitializeShader(device, hwnd, L"../Graphic_Engine_v2/ColorVS.hlsl", L"../Graphic_Engine_v2/ColorPS.hlsl");
+	//Keep the device that owns the shader so it can be released on shutdown.
+	m_device = device;
+
+	bResult = InitializeShader(device, L"../Graphic_Engine_v2/ColorVS.hlsl", L"../Graphic_Engine_v2/ColorPS.hlsl");
 	if (!bResult)
 	{
 		return false;
@@ -38,255 +101,241 @@ void ColorShader::Shutdown()
 	ShutdownShader();
 }
 
-bool ColorShader::Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix,
-						 XMMATRIX viewMatrix, XMMATRIX projectionMatrix)
+/*
+ *	Render()
+ *	brief: Draws the bound model with the shader.
+ *	param vertexFormat: The vertex format of the model, see ModelClass::GetVertexFormat().
+ *	param worldViewProjectionMatrix: The world, view and projection matrices of the object multiplied together,
+ *		  after the position matrix of the model if its vertices are packed.
+ */
+bool ColorShader::Render(RenderContext* context, int indexCount, VertexFormat vertexFormat,
+						 const XMMATRIX& worldViewProjectionMatrix)
 {
 	bool bResult;
 
+	PROFILE_ZONE("ColorShader::Render");
+
 	//Set the shader parameters that will be used for rendering.
-	bResult = SetShaderParameters(deviceContext, worldMatrix, viewMatrix, projectionMatrix);
+	bResult = SetShaderParameters(context, worldViewProjectionMatrix);
 	if (!bResult)
 	{
 		return false;
 	}
 
-	RenderShader(deviceContext, indexCount);
+	RenderShader(context, indexCount, vertexFormat);
 
 	return true;
 }
 
-bool ColorShader::InitializeShader(ID3D11Device *device, HWND hwnd, WCHAR *vsFilename, WCHAR *psFilename)
+/*
+ *	RenderInstanced()
+ *	brief: Draws many copies of the bound model at once. The model has to have its instances bound too, see
+ *		   ModelClass::RenderInstanced().
+ *	param viewProjectionMatrix: The view and projection matrices multiplied together. The world matrix of every copy
+ *		  comes with its instance data.
+ */
+bool ColorShader::RenderInstanced(RenderContext* context, int indexCount, int instanceCount, VertexFormat vertexFormat,
+								  const XMMATRIX& viewProjectionMatrix)
 {
-	HRESULT hResult;
-	ID3D10Blob* errorMessage;
-	ID3D10Blob* vertexShaderBuffer;
-	ID3D10Blob* pixelShaderBuffer;
-	D3D11_INPUT_ELEMENT_DESC polygonLayout[2];
-	unsigned int numElements;
-	D3D11_BUFFER_DESC matrixBufferDesc;
-	
-	//Initialize the pointers this function will use to null.
-	errorMessage = nullptr;
-	vertexShaderBuffer = nullptr;
-	pixelShaderBuffer = nullptr;
-
-	//Compile the vertex shader code.
-	hResult = D3DCompileFromFile(vsFilename,
-								 NULL,
-								 NULL,
-								 "ColorVertexShader",
-								 "vs_5_0",
-								 D3D10_SHADER_ENABLE_STRICTNESS,
-								 0,
-								 &vertexShaderBuffer,
-								 &errorMessage);
-	
-	//We catch the error in case that the compilation failed. If the errorMessage has no message, then it couldn't find the file.
-	if (FAILED(hResult))
-	{
-		if (errorMessage)
-		{
-			OutputShaderErrorMessage(errorMessage, hwnd, vsFilename);
-		}
-		else
-		{
-			MessageBox(hwnd, vsFilename, L"Missing Vertex Shader File", MB_OK);
-		}
-
-		return false;
-	}
+	bool bResult;
 
-	//Compile the pixel shader.
-	hResult = D3DCompileFromFile(psFilename,
-								 NULL,
-								 NULL,
-								 "ColorPixelShader",
-								 "ps_5_0",
-								 D3D10_SHADER_ENABLE_STRICTNESS,
-								 0,
-								 &pixelShaderBuffer,
-								 &errorMessage);
-	if (FAILED(hResult))
+	//The instanced vertex shader reads the view-projection from the same buffer as the world-view-projection.
+	bResult = SetShaderParameters(context, viewProjectionMatrix);
+	if (!bResult)
 	{
-		if (errorMessage)
-		{
-			OutputShaderErrorMessage(errorMessage, hwnd, psFilename);
-		}
-		else
-		{
-			MessageBox(hwnd, psFilename, L"Missing Pixel Shader File", MB_OK);
-		}
 		return false;
 	}
 
-	//After compiling the vertex and pixel shader code, it's time to create the shader objects using the buffers.
-	
-	//Create the vertex shader using the buffer.
-	hResult = device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(), vertexShaderBuffer->GetBufferSize(),
-										 NULL, &m_vertexShader);
-	if (FAILED(hResult))
-	{
-		return false;
-	}
+	context->SetShader(m_programs[vertexFormat][m_features | SHADER_FEATURE_INSTANCING]);
+	context->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
 
-	//Create the pixel shader using the buffer.
-	hResult = device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(), pixelShaderBuffer->GetBufferSize(),
-									    NULL, &m_pixelShader);
-	if (FAILED(hResult))
+	return true;
+}
+
+/*
+ *	SetFog()
+ *	brief: Turns the fog on or off. With it on, the color of a pixel goes toward the fog color from the start
+ *		   distance, and is the fog color from the end distance on.
+ *	param start: The view depth where the fog starts.
+ *	param end: The view depth where it covers everything. It has to be further than the start.
+ */
+bool ColorShader::SetFog(bool enabled, const XMFLOAT4& color, float start, float end)
+{
+	FogBufferType* fogBuffer;
+
+	if (!enabled)
 	{
-		return false;
+		m_features &= ~SHADER_FEATURE_FOG;
+		return true;
 	}
 
-	//Create the input layout description.
-	//This setup needs to match the VertexType structure in the ModelClass and in the shader.
-	polygonLayout[0].SemanticName = "POSITION";
-	polygonLayout[0].SemanticIndex = 0;
-	polygonLayout[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	polygonLayout[0].InputSlot = 0;
-	polygonLayout[0].AlignedByteOffset = 0;
-	polygonLayout[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	polygonLayout[0].InstanceDataStepRate = 0;
-
-	polygonLayout[1].SemanticName = "COLOR";
-	polygonLayout[1].SemanticIndex = 0;
-	polygonLayout[1].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
-	polygonLayout[1].InputSlot = 0;
-	polygonLayout[1].AlignedByteOffset = D3D11_APPEND_ALIGNED_ELEMENT;
-	polygonLayout[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-	polygonLayout[1].InstanceDataStepRate = 0;
-
-	//Get count of the elements in the layout.
-	numElements = sizeof(polygonLayout) / sizeof(polygonLayout[0]);
-
-	//Create the vertex input layout.
-	hResult = device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(),
-										vertexShaderBuffer->GetBufferSize(), &m_inputLayout);
-	if (FAILED(hResult))
+	if (end <= start)
 	{
 		return false;
 	}
 
-	//Release the vertex and pixel shader buffers since they're not longer needed.
-	vertexShaderBuffer->Release();
-	vertexShaderBuffer = nullptr;
-
-	pixelShaderBuffer->Release();
-	pixelShaderBuffer = nullptr;
-	
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-
-	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
-	hResult = device->CreateBuffer(&matrixBufferDesc, NULL, &m_matrixBuffer);
-	if (FAILED(hResult))
+	fogBuffer = (FogBufferType*)m_device->MapBuffer(m_fogBuffer);
+	if (!fogBuffer)
 	{
 		return false;
 	}
 
+	fogBuffer->fogColor = color;
+	fogBuffer->fogStart = start;
+	fogBuffer->fogEnd = end;
+	fogBuffer->padding[0] = 0.0f;
+	fogBuffer->padding[1] = 0.0f;
+	m_device->UnmapBuffer(m_fogBuffer);
+
+	m_features |= SHADER_FEATURE_FOG;
 	return true;
 }
 
-void ColorShader::ShutdownShader()
+//The program that draws models of a vertex format, with its input layout and the features turned on.
+RenderProgram* ColorShader::GetProgram(VertexFormat vertexFormat)
 {
-	// Release the matrix constant buffer.
-	if (m_matrixBuffer)
+	return m_programs[vertexFormat][m_features];
+}
+
+/*
+ *	InitializeShader()
+ *	brief: Creates every variant of the shader at once, so the device can compile the ones it doesn't have yet in
+ *		   parallel, and the constant buffers they read.
+ */
+bool ColorShader::InitializeShader(RenderDevice *device, const WCHAR *vsFilename, const WCHAR *psFilename)
+{
+	bool bResult;
+	InputElementDesc polygonLayouts[VERTEX_FORMAT_COUNT][7];
+	ShaderDefine defines[SHADER_PERMUTATION_COUNT][SHADER_FEATURE_COUNT];
+	ShaderDesc shaderDescs[VERTEX_FORMAT_COUNT][SHADER_PERMUTATION_COUNT];
+	BufferDesc matrixBufferDesc, fogBufferDesc;
+
+	//One layout per vertex format. Their vertex elements need to match the VertexType and PackedVertexType
+	//structures in the ModelClass, and the instanced permutations read the instance elements after them.
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
 	{
-		m_matrixBuffer->Release();
-		m_matrixBuffer = nullptr;
+		SetVertexElements((VertexFormat)i, polygonLayouts[i]);
+		SetInstanceElements(polygonLayouts[i]);
 	}
 
-	// Release the layout.
-	if (m_inputLayout)
+	//Describe the vertex and pixel shaders of every variant. The device compiles them with the defines of the
+	//permutation (or picks its CPU version of them) and creates the input layout that feeds the vertex shader.
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
 	{
-		m_inputLayout->Release();
-		m_inputLayout = nullptr;
+		for (unsigned int j = 0; j < SHADER_PERMUTATION_COUNT; j++)
+		{
+			ShaderDesc& shaderDesc = shaderDescs[i][j];
+
+			shaderDesc.vsFilename = vsFilename;
+			shaderDesc.vsEntryPoint = "ColorVertexShader";
+			shaderDesc.psFilename = psFilename;
+			shaderDesc.psEntryPoint = "ColorPixelShader";
+			shaderDesc.inputLayout = polygonLayouts[i];
+			shaderDesc.numElements = (j & SHADER_FEATURE_INSTANCING) ? 7 : 2;
+			shaderDesc.defines = defines[j];
+			shaderDesc.numDefines = GetShaderPermutationDefines(j, defines[j]);
+			shaderDesc.permutation = j;
+		}
 	}
 
-	// Release the pixel shader.
-	if (m_pixelShader)
+	bResult = device->CreateShaders(&shaderDescs[0][0], VERTEX_FORMAT_COUNT * SHADER_PERMUTATION_COUNT,
+									&m_programs[0][0]);
+	if (!bResult)
 	{
-		m_pixelShader->Release();
-		m_pixelShader = nullptr;
+		return false;
 	}
+	
+	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
+	matrixBufferDesc.bindType = BUFFER_BIND_CONSTANT;
+	matrixBufferDesc.byteWidth = sizeof(MatrixBufferType);
+	matrixBufferDesc.dynamic = true;
 
-	// Release the vertex shader.
-	if (m_vertexShader)
+	// Create the constant buffer pointer so we can access the vertex shader constant buffer from within this class.
+	bResult = device->CreateBuffer(matrixBufferDesc, NULL, &m_matrixBuffer);
+	if (!bResult)
 	{
-		m_vertexShader->Release();
-		m_vertexShader = nullptr;
+		return false;
 	}
-}
-
-void ColorShader::OutputShaderErrorMessage(ID3D10Blob * errorMessage, HWND hwnd, WCHAR* shaderFilename)
-{
-	char* compileErrors;
-	unsigned long long bufferSize;
-	ofstream fout;
-
 
-	// Get a pointer to the error message text buffer.
-	compileErrors = (char*)(errorMessage->GetBufferPointer());
+	//The fog buffer is only written when the fog changes.
+	fogBufferDesc.bindType = BUFFER_BIND_CONSTANT;
+	fogBufferDesc.byteWidth = sizeof(FogBufferType);
+	fogBufferDesc.dynamic = true;
 
-	// Get the length of the message.
-	bufferSize = errorMessage->GetBufferSize();
+	bResult = device->CreateBuffer(fogBufferDesc, NULL, &m_fogBuffer);
+	if (!bResult)
+	{
+		return false;
+	}
 
-	// Open a file to write the error message to.
-	fout.open("shader-error.txt");
+	return true;
+}
 
-	// Write out the error message.
-	for (unsigned long long i = 0; i < bufferSize; i++)
+void ColorShader::ShutdownShader()
+{
+	// Release the matrix and fog constant buffers.
+	if (m_fogBuffer)
 	{
-		fout << compileErrors[i];
+		m_device->ReleaseBuffer(m_fogBuffer);
+		m_fogBuffer = nullptr;
+		m_features = 0;
 	}
 
-	// Close the file.
-	fout.close();
-
-	// Release the error message.
-	errorMessage->Release();
-	errorMessage = 0;
+	if (m_matrixBuffer)
+	{
+		m_device->ReleaseBuffer(m_matrixBuffer);
+		m_matrixBuffer = nullptr;
+		m_matrixUploaded = false;
+	}
 
-	// Pop a message up on the screen to notify the user to check the text file for compile errors.
-	MessageBox(hwnd, L"Error compiling shader.  Check shader-error.txt for message.", shaderFilename, MB_OK);
+	// Release the layouts and the pixel and vertex shaders.
+	for (int i = 0; i < VERTEX_FORMAT_COUNT; i++)
+	{
+		for (unsigned int j = 0; j < SHADER_PERMUTATION_COUNT; j++)
+		{
+			if (m_programs[i][j])
+			{
+				m_device->ReleaseShader(m_programs[i][j]);
+				m_programs[i][j] = nullptr;
+			}
+		}
+	}
 }
 
-bool ColorShader::SetShaderParameters(ID3D11DeviceContext * deviceContext, XMMATRIX worldMatrix, 
-									  XMMATRIX viewMatrix, XMMATRIX projectionMatrix)
+bool ColorShader::SetShaderParameters(RenderContext* context, const XMMATRIX& worldViewProjectionMatrix)
 {
-	HRESULT hResult;
-	D3D11_MAPPED_SUBRESOURCE mappedSubresourse;
 	MatrixBufferType* constantBuffer;
+	XMFLOAT4X4 transposedMatrix;
 	unsigned int bufferNumber;
 
-	//Transpose matrices to prepare them to the shader. This is required by DirectX.
-	worldMatrix = XMMatrixTranspose(worldMatrix);
-	viewMatrix = XMMatrixTranspose(viewMatrix);
-	projectionMatrix = XMMatrixTranspose(projectionMatrix);
-
-	//Lock the m_matrixBuffer, set the new matrices inside it, and then unlock it.
+	//Transpose the matrix to prepare it to the shader. This is required by DirectX.
+	XMStoreFloat4x4(&transposedMatrix, XMMatrixTranspose(worldViewProjectionMatrix));
 
-	//Lock the constant buffer so it can be written to.
-	hResult = deviceContext->Map(m_matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresourse);
-	if (FAILED(hResult))
+	//The buffer keeps its contents between draws, so it only has to be written when the matrix changes. Deferred
+	//contexts record on other threads and only their own draws see what they map, so they always write it.
+	if (context != m_device || !m_matrixUploaded || m_uploadedCommandLists != m_device->GetExecutedCommandLists() ||
+		memcmp(&transposedMatrix, &m_uploadedMatrix, sizeof(transposedMatrix)) != 0)
 	{
-		return false;
-	}
+		//Lock the constant buffer so it can be written to and get the pointer to the data in it.
+		constantBuffer = (MatrixBufferType*)context->MapBuffer(m_matrixBuffer);
+		if (!constantBuffer)
+		{
+			return false;
+		}
 
-	//Get the pointer to the data in the constant buffer.
-	constantBuffer = (MatrixBufferType*)mappedSubresourse.pData;
+		//Copy the matrix into the constant buffer.
+		constantBuffer->worldViewProjection = XMLoadFloat4x4(&transposedMatrix);
 
-	//Copy the matrices into the constant buffer.
-	constantBuffer->world = worldMatrix;
-	constantBuffer->view = viewMatrix;
-	constantBuffer->projection = projectionMatrix;
+		//Unlock the constant buffer.
+		context->UnmapBuffer(m_matrixBuffer);
 
-	//Unlock the constant buffer.
-	deviceContext->Unmap(m_matrixBuffer, 0);
+		if (context == m_device)
+		{
+			m_uploadedMatrix = transposedMatrix;
+			m_matrixUploaded = true;
+			m_uploadedCommandLists = m_device->GetExecutedCommandLists();
+		}
+	}
 
 	//Now set the updated matrix buffer in the HLSL vertex shader.
 
@@ -294,20 +343,45 @@ bool ColorShader::SetShaderParameters(ID3D11DeviceContext * deviceContext, XMMAT
 	bufferNumber = 0;
 
 	// Finally set the constant buffer in the vertex shader with the updated values.
-	deviceContext->VSSetConstantBuffers(bufferNumber, 1, &m_matrixBuffer);
+	context->SetConstantBuffer(bufferNumber, m_matrixBuffer);
+
+	SetFogBuffer(context);
 	return true;
 }
 
-void ColorShader::RenderShader(ID3D11DeviceContext * deviceContext, int indexCount)
+//Bytes of the parameters of a draw.
+unsigned int ColorShader::GetParameterSize()
+{
+	return sizeof(MatrixBufferType);
+}
+
+//Writes the parameters of a draw where they are read from, like SetShaderParameters() does in the matrix buffer.
+void ColorShader::WriteShaderParameters(void* constants, const XMMATRIX& worldViewProjectionMatrix)
 {
-	// Set the vertex input layout.
-	deviceContext->IASetInputLayout(m_inputLayout);
+	XMStoreFloat4x4((XMFLOAT4X4*)constants, XMMatrixTranspose(worldViewProjectionMatrix));
+}
 
-	// Set the vertex and pixel shaders that will be used to render this triangle.
-	deviceContext->VSSetShader(m_vertexShader, NULL, 0);
-	deviceContext->PSSetShader(m_pixelShader, NULL, 0);
+//Binds parameters written by WriteShaderParameters() at an offset of the constant ring.
+void ColorShader::SetShaderParameterRange(RenderContext* context, unsigned int offset)
+{
+	context->SetConstantRange(0, offset, sizeof(MatrixBufferType));
+	SetFogBuffer(context);
+}
 
-	// Render the triangle.
-	deviceContext->DrawIndexed(indexCount, 0, 0);
+//Binds the fog parameters when the programs drawn with read them.
+void ColorShader::SetFogBuffer(RenderContext* context)
+{
+	if (m_features & SHADER_FEATURE_FOG)
+	{
+		context->SetConstantBuffer(1, m_fogBuffer);
+	}
 }
 
+void ColorShader::RenderShader(RenderContext* context, int indexCount, VertexFormat vertexFormat)
+{
+	// Set the vertex input layout and the vertex and pixel shaders that will be used to render this triangle.
+	context->SetShader(m_programs[vertexFormat][m_features]);
+
+	// Render the triangle.
+	context->DrawIndexed(indexCount, 0, 0);
+}
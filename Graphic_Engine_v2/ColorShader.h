@@ -6,12 +6,11 @@
 /************************************************************************/
 /* INCLUDES                                                             */
 /************************************************************************/
-#include <d3d11.h>
-#include <d3dcompiler.h>
+#include "RenderDevice.h"
+#include "ModelClass.h"
+#include "ShaderPermutation.h"
 #include <DirectXMath.h>
-#include <fstream>
 using namespace DirectX;
-using namespace std;
 
 class ColorShader
 {
@@ -21,9 +20,16 @@ private:
 	  vertex shader because it needs to match to do a proper rendering.*/
 	struct MatrixBufferType
 	{
-		XMMATRIX world;
-		XMMATRIX view;
-		XMMATRIX projection;
+		XMMATRIX worldViewProjection;
+	};
+
+	//The cBuffer of the fog, in slot 1 of both shaders.
+	struct FogBufferType
+	{
+		XMFLOAT4 fogColor;
+		float	 fogStart;
+		float	 fogEnd;
+		float	 padding[2];
 	};
 
 public:
@@ -33,23 +39,43 @@ public:
 
 	/*Functions to initialize, shutdown the shader. The render function will set the parameters and then draw 
 	  the prepared model vertices using the shader.*/
-	bool Initialize(ID3D11Device* device, HWND hwnd);
+	bool Initialize(RenderDevice* device);
 	void Shutdown();
-	bool Render(ID3D11DeviceContext* deviceContext, int indexCount, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix);
+	bool Render(RenderContext* context, int indexCount, VertexFormat vertexFormat, const XMMATRIX& worldViewProjectionMatrix);
+	bool RenderInstanced(RenderContext* context, int indexCount, int instanceCount, VertexFormat vertexFormat,
+						 const XMMATRIX& viewProjectionMatrix);
+
+	/*Switches the fog of the draws that follow, which picks the permutation of the shader that has it. Not while
+	  other threads are recording draws of this shader.*/
+	bool SetFog(bool enabled, const XMFLOAT4& color, float start, float end);
+
+	/*Pieces of Render() for the render queue, which binds the program itself only when it changes between draws.*/
+	RenderProgram* GetProgram(VertexFormat vertexFormat);
+	bool SetShaderParameters(RenderContext* context, const XMMATRIX& worldViewProjectionMatrix);
+
+	/*The same parameters written to the constant ring of the device, for the queue to fill the blocks of all its
+	  draws with one map and then bind each one.*/
+	unsigned int GetParameterSize();
+	void WriteShaderParameters(void* constants, const XMMATRIX& worldViewProjectionMatrix);
+	void SetShaderParameterRange(RenderContext* context, unsigned int offset);
 
 private:
-	bool InitializeShader(ID3D11Device* device, HWND hwnd, WCHAR* vsFilename, WCHAR* psFilename);
+	bool InitializeShader(RenderDevice* device, const WCHAR* vsFilename, const WCHAR* psFilename);
 	void ShutdownShader();
-	void OutputShaderErrorMessage(ID3D10Blob* errorMessage, HWND hwnd, WCHAR* shaderFilename);
+	void SetFogBuffer(RenderContext* context);
 
-	bool SetShaderParameters(ID3D11DeviceContext* deviceContext, XMMATRIX worldMatrix, XMMATRIX viewMatrix, XMMATRIX projectionMatrix);
-	void RenderShader(ID3D11DeviceContext* deviceContext, int indexCount);
+	void RenderShader(RenderContext* context, int indexCount, VertexFormat vertexFormat);
 
 private:
-	ID3D11VertexShader* m_vertexShader;
-	ID3D11PixelShader*	m_pixelShader;
-	ID3D11InputLayout*	m_inputLayout;
-	ID3D11Buffer*		m_matrixBuffer;
+	RenderDevice*	m_device;
+	//One per vertex format, each with its input layout, and per permutation of the ShaderFeature bits.
+	RenderProgram*	m_programs[VERTEX_FORMAT_COUNT][SHADER_PERMUTATION_COUNT];
+	unsigned int	m_features;			//The features of the programs drawn with, but instancing.
+	RenderBuffer*	m_matrixBuffer;
+	RenderBuffer*	m_fogBuffer;
+	XMFLOAT4X4		m_uploadedMatrix;	//What the matrix buffer holds, so it is only written when the matrix changes.
+	bool			m_matrixUploaded;
+	unsigned int	m_uploadedCommandLists;	//Command lists the device had executed then; one more may have rewritten it.
 };
 
-#endif
\ No newline at end of file
+#endif
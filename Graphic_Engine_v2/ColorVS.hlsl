@@ -1,48 +1,102 @@
+/********************************/
+/*   DEFINES                    */
+/********************************/
+//The features of the permutation being compiled, see ShaderPermutation.h.
+#ifndef INSTANCING
+#define INSTANCING 0
+#endif
+
+#ifndef FOG
+#define FOG 0
+#endif
+
 /********************************/
 /*   GLOBALS                    */
 /********************************/
-cbuffer MatrixBuffer
+cbuffer MatrixBuffer : register(b0)
+{
+    matrix worldViewProjectionMatrix;
+};
+
+#if FOG
+cbuffer FogBuffer : register(b1)
 {
-    matrix worldMatrix;
-    matrix viewMatrix;
-    matrix projectionMatrix;
+    float4 fogColor;
+    float  fogStart;
+    float  fogEnd;
+    float2 fogPadding;
 };
+#endif
 
 /********************************/
 /*   TYPEDEFS                   */
 /********************************/
 struct VertexInputType
 {
-    float4 position : POSITION;
-    float4 color    : COLOR;
+    float4 position      : POSITION;
+    float4 color         : COLOR;
+#if INSTANCING
+    //The data of the instance, that advances once per instance instead of once per vertex.
+    float4 world0        : WORLD0;
+    float4 world1        : WORLD1;
+    float4 world2        : WORLD2;
+    float4 world3        : WORLD3;
+    float4 instanceColor : INSTANCECOLOR;
+#endif
 };
 
 struct PixelInputType
 {
     float4 position : SV_Position;
     float4 color    : COLOR;
+#if FOG
+    float  fog      : FOG;
+#endif
 };
 
 /*
 *   ColorVertexShader()
-*   brief: This shader will put the vertex in a position relative to the world, view and projection matrices.
+*   brief: This shader will put the vertex in a position relative to the world, view and projection matrices,
+*          already multiplied together on the CPU once per object.
+*          Instanced, it draws one of many copies of the model at once. Each copy brings its world matrix and a
+*          color that tints the vertex color, and the matrix buffer holds only the view and projection matrices
+*          multiplied together.
+*          With fog, it computes how much of the vertex color is left at its view depth.
 *   param VertexInputType input: Is the input with the position of each vertex and its color.
 *   output PixelInputType: The information with the calculated position of the vertex and the color.
 */
 PixelInputType ColorVertexShader( VertexInputType input )
 {
     PixelInputType output;
+#if INSTANCING
+    float4x4 instanceWorldMatrix;
+#endif
 
     //Change the position vector to be 4 unitos for proper matrix calculations.
     input.position.w = 1.0f;
 
+#if INSTANCING
+    //The rows of the world matrix of the instance, not transposed.
+    instanceWorldMatrix = float4x4(input.world0, input.world1, input.world2, input.world3);
+
+    //Calculate the vertex position agains the world matrix of the instance and then the view and projection.
+    output.position = mul(input.position, instanceWorldMatrix);
+    output.position = mul(output.position, worldViewProjectionMatrix);
+
+    //Tint the input color with the color of the instance.
+    output.color = input.color * input.instanceColor;
+#else
     //Calculate the vertex position agains world, view and projection matrices.
-    output.position = mul(input.position, worldMatrix);
-    output.position = mul(output.position, viewMatrix);
-    output.position = mul(output.position, projectionMatrix);
+    output.position = mul(input.position, worldViewProjectionMatrix);
 
     //Store the input color for the pixel shader to use.
     output.color = input.color;
-	
+#endif
+
+#if FOG
+    //The w of a perspective projection is the view depth. 1 keeps the whole color and 0 is all fog.
+    output.fog = saturate((fogEnd - output.position.w) / (fogEnd - fogStart));
+#endif
+
     return output;
-}
\ No newline at end of file
+}
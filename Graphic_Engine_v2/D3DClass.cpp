@@ -1,4 +1,14 @@
 #include "D3DClass.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned int SHADER_COMPILE_FLAGS = D3D10_SHADER_ENABLE_STRICTNESS;
 
 
 
@@ -12,6 +22,28 @@ D3DClass::D3DClass()
 	m_rasterizerState = nullptr;
 	m_renderTargetView = nullptr;
 	m_swapChain = nullptr;
+	m_hwnd = NULL;
+	m_deviceContext1 = nullptr;
+	m_constantRing = nullptr;
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+	{
+		m_ringFences[i] = nullptr;
+		m_ringFenceBytes[i] = 0;
+	}
+	m_ringFenceFirst = 0;
+	m_ringFenceCount = 0;
+	m_ringHead = 0;
+	m_ringUsed = 0;
+	m_ringFrameUsed = 0;
+	m_ringDiscarded = false;
+	m_target = nullptr;
+	memset(m_timingFrames, 0, sizeof(m_timingFrames));
+	m_timingFrame = 0;
+	m_timingSceneOpen = false;
+	m_timingPassOpen = false;
+	m_frameCount = 0;
+	m_gpuClockTicks = 0;
+	m_gpuClockSeconds = 0.0;
 }
 
 D3DClass::D3DClass(const D3DClass &)
@@ -56,9 +88,9 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	D3D11_DEPTH_STENCIL_VIEW_DESC depthStencilViewDesc;
 	D3D11_RASTERIZER_DESC		  rasterizerDesc;
 	D3D11_VIEWPORT				  viewport;
-	float						  fieldOfView, screenAspect;
 
 	m_vSyncEnabled = vsync;
+	m_hwnd = hwnd;
 
 	//Create DirectX graphics interface factory.
 	hResult = CreateDXGIFactory(__uuidof(IDXGIFactory), (void**)&dxgiFactory);
@@ -74,44 +106,52 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 		return false;
 	}
 
-	//Enumerate the primary adapter output (monitor).
-	hResult = dxgiAdapter->EnumOutputs(0, &adapterOutput);
-	if (FAILED(hResult))
+	//Without a window there is no swap chain, and maybe not even a monitor, so the display modes aren't needed.
+	numarator = 0;
+	denominator = 1;
+	displayModeList = nullptr;
+	adapterOutput = nullptr;
+	if (hwnd)
 	{
-		return false;
-	}
+		//Enumerate the primary adapter output (monitor).
+		hResult = dxgiAdapter->EnumOutputs(0, &adapterOutput);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
 
-	//Get the number of modes that fit the DXGI_FORMAT_R8G8B8A8_UNORM display format for the adapter output (monitor).
-	hResult = adapterOutput->GetDisplayModeList(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_ENUM_MODES_INTERLACED, &numModes, NULL);
-	if (FAILED(hResult))
-	{
-		return false;
-	}
+		//Get the number of modes that fit the DXGI_FORMAT_R8G8B8A8_UNORM display format for the adapter output (monitor).
+		hResult = adapterOutput->GetDisplayModeList(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_ENUM_MODES_INTERLACED, &numModes, NULL);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
 
-	//Create a list to hold all the possible display modes for this monitor/video card combinations.
-	displayModeList = new DXGI_MODE_DESC[numModes];
-	if (!displayModeList)
-	{
-		return false;
-	}
+		//Create a list to hold all the possible display modes for this monitor/video card combinations.
+		displayModeList = new DXGI_MODE_DESC[numModes];
+		if (!displayModeList)
+		{
+			return false;
+		}
 
-	//Fill the display mode list structures.
-	hResult = adapterOutput->GetDisplayModeList(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_ENUM_MODES_INTERLACED, &numModes, displayModeList);
-	if (FAILED(hResult))
-	{
-		return false;
-	}
+		//Fill the display mode list structures.
+		hResult = adapterOutput->GetDisplayModeList(DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_ENUM_MODES_INTERLACED, &numModes, displayModeList);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
 
-	//Go through all the display modes and find the one that matches the screen width and height.
-	//When a match is found store the numerator and denominator of the refresh rate for that monitor.
-	for (unsigned int i = 0; i < numModes; i++)
-	{
-		if (displayModeList[i].Width == (unsigned int)screenWidth)
+		//Go through all the display modes and find the one that matches the screen width and height.
+		//When a match is found store the numerator and denominator of the refresh rate for that monitor.
+		for (unsigned int i = 0; i < numModes; i++)
 		{
-			if (displayModeList[i].Height == (unsigned int)screenHeight)
+			if (displayModeList[i].Width == (unsigned int)screenWidth)
 			{
-				numarator = displayModeList[i].RefreshRate.Numerator;
-				denominator = displayModeList[i].RefreshRate.Denominator;
+				if (displayModeList[i].Height == (unsigned int)screenHeight)
+				{
+					numarator = displayModeList[i].RefreshRate.Numerator;
+					denominator = displayModeList[i].RefreshRate.Denominator;
+				}
 			}
 		}
 	}
@@ -143,8 +183,11 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	displayModeList = 0;
 
 	//Release the adapter output.
-	adapterOutput->Release();
-	adapterOutput = nullptr;
+	if (adapterOutput)
+	{
+		adapterOutput->Release();
+		adapterOutput = nullptr;
+	}
 
 	//Release the factory.
 	dxgiFactory->Release();
@@ -214,31 +257,43 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 	//Set feature level to DirectX. For now will be 11. TODO: Make it variable.
 	featureLevel = D3D_FEATURE_LEVEL_11_0;
 
-	//Create the swap chain and the DirectX11 device and device context.
-	hResult = D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, &featureLevel, 1, D3D11_SDK_VERSION,
-											&swapChainDesc, &m_swapChain, &m_device, NULL, &m_deviceContext);
-	if (FAILED(hResult))
+	//Create the swap chain and the DirectX11 device and device context. Without a window, only the device, for
+	//drawing into render targets.
+	if (hwnd)
 	{
-		return false;
+		hResult = D3D11CreateDeviceAndSwapChain(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, &featureLevel, 1, D3D11_SDK_VERSION,
+												&swapChainDesc, &m_swapChain, &m_device, NULL, &m_deviceContext);
 	}
-
-	//Get the pointer to the back buffer.
-	hResult = m_swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&backBufferPntr);
-	if (FAILED(hResult))
+	else
 	{
-		return false;
+		hResult = D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, 0, &featureLevel, 1, D3D11_SDK_VERSION,
+									&m_device, NULL, &m_deviceContext);
 	}
-
-	//Create the render target view with the back buffer.
-	hResult = m_device->CreateRenderTargetView(backBufferPntr, NULL, &m_renderTargetView);
 	if (FAILED(hResult))
 	{
 		return false;
 	}
 
-	//Release the pointer to the back buffer as we no longer need it.
-	backBufferPntr->Release();
-	backBufferPntr = nullptr;
+	if (m_swapChain)
+	{
+		//Get the pointer to the back buffer.
+		hResult = m_swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&backBufferPntr);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
+
+		//Create the render target view with the back buffer.
+		hResult = m_device->CreateRenderTargetView(backBufferPntr, NULL, &m_renderTargetView);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
+
+		//Release the pointer to the back buffer as we no longer need it.
+		backBufferPntr->Release();
+		backBufferPntr = nullptr;
+	}
 
 	//Time to set the depth buffer description. Also will attach a stencil buffer.
 
@@ -358,25 +413,25 @@ bool D3DClass::Initialize(int screenWidth, int screenHeight, bool vsync, HWND hw
 
 	//Create the viewport.
 	m_deviceContext->RSSetViewports(1, &viewport);
+	m_viewport = viewport;
 
-	//Setup the projection matrix.
-	fieldOfView = 3.141592654f / 4.0f; //This here is a fixed number. It may be good to play with it to see what happens.
-	screenAspect = (float)screenWidth / (float)screenHeight;
-
-	//Create the projection matrix for 3D rendering.
-	m_projectionMatrix = XMMatrixPerspectiveFovLH(fieldOfView, screenAspect, screenNear, screenFar);
+	//Setup the projection, world and orthographic matrices.
+	InitializeMatrices(screenWidth, screenHeight, screenFar, screenNear);
 
-	//Setup the world matrix.
-	m_worldMatrix = XMMatrixIdentity();
-
-	/*Here would be the view matrix, but because it is the matrix which will determine our point of view
-	  it seems to be better in the camera class.*/
+	//Create the ring the constants of the draws are written to, where the driver supports it.
+	if (!InitializeConstantRing())
+	{
+		return false;
+	}
 
-	/*The last thing to set in the initialize function is the orthographic matrix. This matrix will be used
-	  to render the 2D elements (like the GUI) on the screens.*/
+	//Create the queries the passes are timed with.
+	if (!InitializeTimingQueries())
+	{
+		return false;
+	}
 
-	//Create an orthographic projection matrix for 2D rendering.
-	m_orthographicMatrix = XMMatrixOrthographicLH((float)screenWidth, (float)screenHeight, screenNear, screenFar);
+	//Open the compiled shaders of the last runs, so only the shaders that changed since are compiled.
+	m_ShaderCache.Initialize(SHADER_CACHE_FILENAME);
 
 	return true;
 }
@@ -390,6 +445,13 @@ void D3DClass::Shutdown()
 		m_swapChain->SetFullscreenState(false, NULL);
 	}
 
+	//Keep the shaders compiled in this run for the next one.
+	m_ShaderCache.Save();
+	m_ShaderCache.Shutdown();
+
+	ShutdownConstantRing();
+	ShutdownTimingQueries();
+
 	if (m_rasterizerState)
 	{
 		m_rasterizerState->Release();
@@ -451,6 +513,18 @@ void D3DClass::Shutdown()
 void D3DClass::BeginScene(float red, float green, float blue, float alpha)
 {
 	float color[4];
+
+	//Take the timings the GPU finished, and time this frame if its queries are free. They aren't when the GPU is
+	//more than GPU_TIMING_FRAMES behind, and the frame goes untimed instead of waiting.
+	ReadTimingFrames();
+	GpuTimingFrame& timing = m_timingFrames[m_timingFrame];
+	if (timing.disjoint && !timing.pending)
+	{
+		m_deviceContext->Begin(timing.disjoint);
+		timing.passCount = 0;
+		timing.frame = m_frameCount;
+		m_timingSceneOpen = true;
+	}
 	
 	// Setup the color to clear the buffer to.
 	color[0] = red;
@@ -458,8 +532,18 @@ void D3DClass::BeginScene(float red, float green, float blue, float alpha)
 	color[2] = blue;
 	color[3] = alpha;
 
-	// Clear the back buffer.
-	m_deviceContext->ClearRenderTargetView(m_renderTargetView, color);
+	// Clear the back buffer, or the render target set.
+	if (m_target)
+	{
+		m_deviceContext->ClearRenderTargetView(m_target->renderTargetView, color);
+		m_deviceContext->ClearDepthStencilView(m_target->depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
+		return;
+	}
+
+	if (m_renderTargetView)
+	{
+		m_deviceContext->ClearRenderTargetView(m_renderTargetView, color);
+	}
 
 	// Clear the depth buffer.
 	m_deviceContext->ClearDepthStencilView(m_depthStencilView, D3D11_CLEAR_DEPTH, 1.0f, 0);
@@ -473,6 +557,43 @@ void D3DClass::BeginScene(float red, float green, float blue, float alpha)
 */
 void D3DClass::EndScene()
 {
+	unsigned int fence;
+
+	PROFILE_ZONE("D3DClass::EndScene");
+
+	if (m_timingSceneOpen)
+	{
+		EndPass();
+		m_deviceContext->End(m_timingFrames[m_timingFrame].disjoint);
+		m_timingFrames[m_timingFrame].pending = true;
+		m_timingFrame = (m_timingFrame + 1) % GPU_TIMING_FRAMES;
+		m_timingSceneOpen = false;
+	}
+	m_frameCount++;
+
+	//Mark where the GPU will be done with the constants of the frame, so the ring can write over them afterwards.
+	if (m_ringFrameUsed > 0)
+	{
+		if (m_ringFenceCount == CONSTANT_RING_FRAMES)
+		{
+			WaitForRingFence();
+		}
+
+		fence = (m_ringFenceFirst + m_ringFenceCount) % CONSTANT_RING_FRAMES;
+		m_deviceContext->End(m_ringFences[fence]);
+		m_ringFenceBytes[fence] = m_ringFrameUsed;
+		m_ringFenceCount++;
+		m_ringUsed += m_ringFrameUsed;
+		m_ringFrameUsed = 0;
+	}
+
+	//An offscreen frame isn't presented, only sent to the GPU so it starts while the next one is made.
+	if (m_target || !m_swapChain)
+	{
+		m_deviceContext->Flush();
+		return;
+	}
+
 	//Present the back buffer to the screen since the rendering is complete.
 	if (m_vSyncEnabled)
 	{
@@ -485,33 +606,1568 @@ void D3DClass::EndScene()
 	}
 }
 
-ID3D11Device * D3DClass::GetDevice()
+/*
+ *	CreateBuffer()
+ *	brief: Creates a vertex, index or constant buffer on the video card.
+ *	param desc: What the buffer is going to be bound as, its size and whether the CPU rewrites it.
+ *	param initialData: The data to fill the buffer with. Can be null for dynamic buffers.
+ *	param buffer: Receives the handle of the created buffer.
+ */
+bool D3DClass::CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer)
 {
-	return m_device;
+	HRESULT hResult;
+	D3D11_BUFFER_DESC bufferDesc;
+	D3D11_SUBRESOURCE_DATA bufferData;
+	ID3D11Buffer* d3dBuffer;
+
+	//Set up the description of the buffer.
+	bufferDesc.Usage = desc.dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_DEFAULT;
+	bufferDesc.ByteWidth = desc.byteWidth;
+	bufferDesc.CPUAccessFlags = desc.dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.StructureByteStride = 0;
+
+	switch (desc.bindType)
+	{
+	case BUFFER_BIND_VERTEX:
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		break;
+	case BUFFER_BIND_INDEX:
+		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		break;
+	default:
+		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+		break;
+	}
+
+	//Give the subresource structure a pointer to the data.
+	bufferData.pSysMem = initialData;
+	bufferData.SysMemPitch = 0;
+	bufferData.SysMemSlicePitch = 0;
+
+	//Now create the buffer.
+	hResult = m_device->CreateBuffer(&bufferDesc, initialData ? &bufferData : NULL, &d3dBuffer);
+	if (FAILED(hResult))
+	{
+		return false;
+	}
+
+	*buffer = (RenderBuffer*)d3dBuffer;
+	return true;
 }
 
-ID3D11DeviceContext * D3DClass::GetDeviceContext()
+void D3DClass::ReleaseBuffer(RenderBuffer* buffer)
 {
-	return m_deviceContext;
+	if (buffer)
+	{
+		((ID3D11Buffer*)buffer)->Release();
+	}
 }
 
-void D3DClass::GetProjectionMatrix(XMMATRIX &projectionMatrix)
+/*
+ *	MapBuffer()
+ *	brief: Locks a dynamic buffer so the CPU can write into it. The previous content is discarded.
+ *	return: The pointer to write to, or null if the buffer couldn't be locked.
+ */
+void* D3DClass::MapBuffer(RenderBuffer* buffer)
 {
-	projectionMatrix = m_projectionMatrix;
+	HRESULT hResult;
+	D3D11_MAPPED_SUBRESOURCE mappedSubresource;
+
+	hResult = m_deviceContext->Map((ID3D11Buffer*)buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresource);
+	if (FAILED(hResult))
+	{
+		return nullptr;
+	}
+
+	return mappedSubresource.pData;
 }
 
-void D3DClass::GetOrthographicMatrix(XMMATRIX &orthographicMatrix)
+void D3DClass::UnmapBuffer(RenderBuffer* buffer)
 {
-	orthographicMatrix = m_orthographicMatrix;
+	m_deviceContext->Unmap((ID3D11Buffer*)buffer, 0);
 }
 
-void D3DClass::GetWorldMatrix(XMMATRIX &worldMatrix)
+/*
+ *	CreateShader()
+ *	brief: Compiles the vertex and pixel shaders described and creates the input layout that feeds them.
+ *	param desc: The shader files, entry points, macros and input layout.
+ *	param shader: Receives the handle of the created shader.
+ */
+bool D3DClass::CreateShader(const ShaderDesc& desc, RenderProgram** shader)
 {
-	worldMatrix = m_worldMatrix;
+	ID3D10Blob* errorMessage;
+	const void* vertexShaderBuffer;
+	const void* pixelShaderBuffer;
+	unsigned int vertexShaderSize, pixelShaderSize;
+
+	//Initialize the pointers this function will use to null.
+	errorMessage = nullptr;
+	vertexShaderBuffer = nullptr;
+	pixelShaderBuffer = nullptr;
+
+	//Get the vertex shader code, compiling it only if it isn't in the cache.
+	if (!LoadShaderBytecode(m_ShaderCache, desc.vsFilename, desc.vsEntryPoint, "vs_5_0", desc.defines,
+							desc.numDefines, vertexShaderBuffer, vertexShaderSize, &errorMessage))
+	{
+		ReportShaderError(errorMessage, desc.vsFilename, L"Missing Vertex Shader File");
+		return false;
+	}
+
+	//Get the pixel shader.
+	if (!LoadShaderBytecode(m_ShaderCache, desc.psFilename, desc.psEntryPoint, "ps_5_0", desc.defines,
+							desc.numDefines, pixelShaderBuffer, pixelShaderSize, &errorMessage))
+	{
+		ReportShaderError(errorMessage, desc.psFilename, L"Missing Pixel Shader File");
+		return false;
+	}
+
+	return CreateShaderObjects(desc, vertexShaderBuffer, vertexShaderSize, pixelShaderBuffer, pixelShaderSize, shader);
 }
 
-void D3DClass::GetVideoCardInfo(char *cardName, int & memory)
+/*
+ *	CreateShaders()
+ *	brief: Creates many shaders, compiling at once on a pool of threads the stages the cache doesn't have. The
+ *		   compiler can run on many threads, but the cache and the device are filled from this one.
+ *	param shaders: Receives a handle for every description, or nulls if any of them failed.
+ */
+bool D3DClass::CreateShaders(const ShaderDesc* descs, unsigned int count, RenderProgram** shaders)
 {
-	strcpy_s(cardName, 128, m_videoCardDescription);
-	memory = m_videoCardMemory;
+	std::vector<ShaderStage> stages;
+	std::vector<unsigned int> compiles;
+	std::vector<ID3D10Blob*> shaderBuffers, errorMessages;
+	std::vector<ShaderReflection> reflections;
+	ThreadPoolClass threadPool;
+	ShaderReflection reflection;
+	unsigned int threadCount;
+	bool bResult;
+
+	//The vertex and pixel stage of every shader, in that order.
+	stages.resize(count * 2);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		stages[i * 2].filename = descs[i].vsFilename;
+		stages[i * 2].entryPoint = descs[i].vsEntryPoint;
+		stages[i * 2].profile = "vs_5_0";
+		stages[i * 2 + 1].filename = descs[i].psFilename;
+		stages[i * 2 + 1].entryPoint = descs[i].psEntryPoint;
+		stages[i * 2 + 1].profile = "ps_5_0";
+		stages[i * 2].defines = stages[i * 2 + 1].defines = descs[i].defines;
+		stages[i * 2].numDefines = stages[i * 2 + 1].numDefines = descs[i].numDefines;
+	}
+
+	//Look for every stage in the cache, keeping the ones missing, each key once, to be compiled.
+	for (unsigned int i = 0; i < stages.size(); i++)
+	{
+		ShaderStage& stage = stages[i];
+
+		if (!ReadShaderSource(stage.filename, stage.source))
+		{
+			MessageBox(m_hwnd, stage.filename, L"Missing Shader File", MB_OK);
+			return false;
+		}
+
+		stage.key = HashShaderStage(stage.source, stage.defines, stage.numDefines, stage.entryPoint, stage.profile);
+		stage.bytecode = nullptr;
+		stage.bytecodeSize = 0;
+		if (m_ShaderCache.Find(stage.key, stage.bytecode, stage.bytecodeSize, reflection))
+		{
+			continue;
+		}
+
+		bResult = true;
+		for (unsigned int j = 0; j < compiles.size() && bResult; j++)
+		{
+			bResult = stages[compiles[j]].key != stage.key;
+		}
+		if (bResult)
+		{
+			compiles.push_back(i);
+		}
+	}
+
+	//Compile them in parallel. Each task only touches its own slots.
+	shaderBuffers.resize(compiles.size(), nullptr);
+	errorMessages.resize(compiles.size(), nullptr);
+	reflections.resize(compiles.size());
+	if (!compiles.empty())
+	{
+		threadCount = std::thread::hardware_concurrency();
+		threadCount = threadCount == 0 ? 1 : (threadCount < compiles.size() ? threadCount : (unsigned int)compiles.size());
+		threadPool.Initialize(threadCount);
+		threadPool.ParallelFor((unsigned int)compiles.size(), [&](unsigned int index, unsigned int /*threadIndex*/)
+		{
+			const ShaderStage& stage = stages[compiles[index]];
+
+			CompileShaderStage(stage.source, stage.defines, stage.numDefines, stage.entryPoint, stage.profile,
+							   &shaderBuffers[index], reflections[index], &errorMessages[index]);
+		});
+		threadPool.Shutdown();
+	}
+
+	//Keep what compiled in the cache and report what didn't.
+	bResult = true;
+	for (unsigned int i = 0; i < compiles.size(); i++)
+	{
+		if (shaderBuffers[i])
+		{
+			m_ShaderCache.Add(stages[compiles[i]].key, shaderBuffers[i]->GetBufferPointer(),
+							  (unsigned int)shaderBuffers[i]->GetBufferSize(), reflections[i]);
+			shaderBuffers[i]->Release();
+		}
+		else if (bResult)
+		{
+			ReportShaderError(errorMessages[i], stages[compiles[i]].filename, L"Missing Shader File");
+			errorMessages[i] = nullptr;
+			bResult = false;
+		}
+
+		if (errorMessages[i])
+		{
+			errorMessages[i]->Release();
+		}
+	}
+
+	for (unsigned int i = 0; i < stages.size() && bResult; i++)
+	{
+		if (!stages[i].bytecode)
+		{
+			bResult = m_ShaderCache.Find(stages[i].key, stages[i].bytecode, stages[i].bytecodeSize, reflection);
+		}
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		shaders[i] = nullptr;
+	}
+	if (!bResult)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!CreateShaderObjects(descs[i], stages[i * 2].bytecode, stages[i * 2].bytecodeSize, stages[i * 2 + 1].bytecode,
+								 stages[i * 2 + 1].bytecodeSize, &shaders[i]))
+		{
+			for (unsigned int j = 0; j < i; j++)
+			{
+				ReleaseShader(shaders[j]);
+				shaders[j] = nullptr;
+			}
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Creates the shader objects and the input layout from the compiled code of both stages.
+bool D3DClass::CreateShaderObjects(const ShaderDesc& desc, const void* vertexShaderBuffer, unsigned int vertexShaderSize,
+								   const void* pixelShaderBuffer, unsigned int pixelShaderSize, RenderProgram** shader)
+{
+	HRESULT hResult;
+	D3D11_INPUT_ELEMENT_DESC polygonLayout[D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT];
+	D3DShader* d3dShader;
+
+	if (desc.numElements > D3D11_IA_VERTEX_INPUT_STRUCTURE_ELEMENT_COUNT)
+	{
+		return false;
+	}
+
+	d3dShader = new D3DShader();
+	d3dShader->vertexShader = nullptr;
+	d3dShader->pixelShader = nullptr;
+	d3dShader->inputLayout = nullptr;
+	*shader = (RenderProgram*)d3dShader;
+
+	//Create the vertex shader using the buffer.
+	hResult = m_device->CreateVertexShader(vertexShaderBuffer, vertexShaderSize, NULL, &d3dShader->vertexShader);
+	if (SUCCEEDED(hResult))
+	{
+		//Create the pixel shader using the buffer.
+		hResult = m_device->CreatePixelShader(pixelShaderBuffer, pixelShaderSize, NULL, &d3dShader->pixelShader);
+	}
+
+	if (SUCCEEDED(hResult))
+	{
+		//Translate the engine layout into the D3D11 input layout description.
+		for (unsigned int i = 0; i < desc.numElements; i++)
+		{
+			polygonLayout[i].SemanticName = desc.inputLayout[i].semanticName;
+			polygonLayout[i].SemanticIndex = desc.inputLayout[i].semanticIndex;
+			polygonLayout[i].InputSlot = desc.inputLayout[i].inputSlot;
+			polygonLayout[i].AlignedByteOffset = desc.inputLayout[i].alignedByteOffset == APPEND_ALIGNED_ELEMENT ?
+												 D3D11_APPEND_ALIGNED_ELEMENT : desc.inputLayout[i].alignedByteOffset;
+			polygonLayout[i].InputSlotClass = desc.inputLayout[i].inputSlotClass == INPUT_PER_INSTANCE_DATA ?
+											  D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+			polygonLayout[i].InstanceDataStepRate = desc.inputLayout[i].instanceDataStepRate;
+
+			switch (desc.inputLayout[i].format)
+			{
+			case ELEMENT_FORMAT_FLOAT3:
+				polygonLayout[i].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+				break;
+			case ELEMENT_FORMAT_UNORM16X4:
+				polygonLayout[i].Format = DXGI_FORMAT_R16G16B16A16_UNORM;
+				break;
+			case ELEMENT_FORMAT_UNORM8X4:
+				polygonLayout[i].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+				break;
+			default:
+				polygonLayout[i].Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+				break;
+			}
+		}
+
+		//Create the vertex input layout.
+		hResult = m_device->CreateInputLayout(polygonLayout, desc.numElements, vertexShaderBuffer, vertexShaderSize,
+											  &d3dShader->inputLayout);
+	}
+
+	//The shader code belongs to the cache, so there is nothing to release.
+	if (FAILED(hResult))
+	{
+		ReleaseShader(*shader);
+		*shader = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ *	LoadShaderBytecode()
+ *	brief: Gets the compiled code of a shader from the cache, or compiles the source and adds it to the cache. The
+ *		   source is always read, since its content is part of the key, but reading it costs little next to
+ *		   compiling it.
+ *	param defines: The macros that pick the permutation of the shader, or null.
+ *	param bytecode: Receives the compiled code. It belongs to the cache and stays valid until it is saved.
+ *	param errorMessage: Receives the messages of the compiler if it failed, or null if the file couldn't be read.
+ *		  The caller releases them.
+ */
+bool D3DClass::LoadShaderBytecode(ShaderCacheClass& cache, const WCHAR* filename, const char* entryPoint,
+								  const char* profile, const ShaderDefine* defines, unsigned int numDefines,
+								  const void*& bytecode, unsigned int& bytecodeSize, ID3D10Blob** errorMessage)
+{
+	std::vector<char> source;
+	unsigned long long key;
+	ID3D10Blob* shaderBuffer;
+	ShaderReflection reflection;
+
+	*errorMessage = nullptr;
+
+	if (!ReadShaderSource(filename, source))
+	{
+		return false;
+	}
+
+	key = HashShaderStage(source, defines, numDefines, entryPoint, profile);
+	if (cache.Find(key, bytecode, bytecodeSize, reflection))
+	{
+		return true;
+	}
+
+	if (!CompileShaderStage(source, defines, numDefines, entryPoint, profile, &shaderBuffer, reflection, errorMessage))
+	{
+		return false;
+	}
+
+	cache.Add(key, shaderBuffer->GetBufferPointer(), (unsigned int)shaderBuffer->GetBufferSize(), reflection);
+	shaderBuffer->Release();
+
+	return cache.Find(key, bytecode, bytecodeSize, reflection);
+}
+
+//Reads a whole shader source file.
+bool D3DClass::ReadShaderSource(const WCHAR* filename, std::vector<char>& source)
+{
+	std::ifstream fin;
+
+	fin.open(filename, std::ios::binary | std::ios::ate);
+	if (!fin)
+	{
+		return false;
+	}
+	source.resize((size_t)fin.tellg());
+	fin.seekg(0);
+	fin.read(source.data(), source.size());
+
+	return !fin.fail();
+}
+
+//The cache key of a stage. The macros go in as "NAME=VALUE" lines, in the order they are given.
+unsigned long long D3DClass::HashShaderStage(const std::vector<char>& source, const ShaderDefine* defines,
+											 unsigned int numDefines, const char* entryPoint, const char* profile)
+{
+	std::string definesText;
+
+	for (unsigned int i = 0; i < numDefines; i++)
+	{
+		definesText += defines[i].name;
+		definesText += '=';
+		definesText += defines[i].definition ? defines[i].definition : "";
+		definesText += '\n';
+	}
+
+	return ShaderCacheClass::HashShader(source.data(), source.size(), numDefines ? definesText.c_str() : NULL,
+										entryPoint, profile, SHADER_COMPILE_FLAGS);
+}
+
+/*
+ *	CompileShaderStage()
+ *	brief: Compiles a stage and reflects what it uses. It touches nothing but its arguments, so many stages can
+ *		   be compiled on different threads at once.
+ *	param shaderBuffer: Receives the compiled code, for the caller to release.
+ *	param errorMessage: Receives the messages of the compiler if it failed. The caller releases them.
+ */
+bool D3DClass::CompileShaderStage(const std::vector<char>& source, const ShaderDefine* defines, unsigned int numDefines,
+								  const char* entryPoint, const char* profile, ID3D10Blob** shaderBuffer,
+								  ShaderReflection& reflection, ID3D10Blob** errorMessage)
+{
+	HRESULT hResult;
+	std::vector<D3D_SHADER_MACRO> macros;
+	ID3D11ShaderReflection* reflector;
+	ID3D11ShaderReflectionConstantBuffer* constantBuffer;
+	D3D11_SHADER_DESC shaderDesc;
+	D3D11_SHADER_BUFFER_DESC bufferDesc;
+
+	*shaderBuffer = nullptr;
+	*errorMessage = nullptr;
+
+	//The compiler takes the macros ended by a null one.
+	macros.resize(numDefines + 1);
+	for (unsigned int i = 0; i < numDefines; i++)
+	{
+		macros[i].Name = defines[i].name;
+		macros[i].Definition = defines[i].definition;
+	}
+	macros[numDefines].Name = NULL;
+	macros[numDefines].Definition = NULL;
+
+	hResult = D3DCompile(source.data(), source.size(), NULL, macros.data(), NULL, entryPoint, profile,
+						 SHADER_COMPILE_FLAGS, 0, shaderBuffer, errorMessage);
+	if (FAILED(hResult))
+	{
+		*shaderBuffer = nullptr;
+		return false;
+	}
+
+	//The warnings of a shader that compiled aren't shown.
+	if (*errorMessage)
+	{
+		(*errorMessage)->Release();
+		*errorMessage = nullptr;
+	}
+
+	//Keep what the shader uses with it, so it doesn't have to be reflected again either.
+	memset(&reflection, 0, sizeof(reflection));
+	hResult = D3DReflect((*shaderBuffer)->GetBufferPointer(), (*shaderBuffer)->GetBufferSize(),
+						 __uuidof(ID3D11ShaderReflection), (void**)&reflector);
+	if (SUCCEEDED(hResult))
+	{
+		reflector->GetDesc(&shaderDesc);
+		reflection.constantBufferCount = shaderDesc.ConstantBuffers < SHADER_REFLECTION_MAX_CONSTANT_BUFFERS ?
+										 shaderDesc.ConstantBuffers : SHADER_REFLECTION_MAX_CONSTANT_BUFFERS;
+		for (unsigned int i = 0; i < reflection.constantBufferCount; i++)
+		{
+			constantBuffer = reflector->GetConstantBufferByIndex(i);
+			constantBuffer->GetDesc(&bufferDesc);
+			reflection.constantBufferSizes[i] = bufferDesc.Size;
+		}
+		reflection.inputParameterCount = shaderDesc.InputParameters;
+		reflection.instructionCount = shaderDesc.InstructionCount;
+		reflector->Release();
+	}
+
+	return true;
+}
+
+void D3DClass::ReleaseShader(RenderProgram* shader)
+{
+	D3DShader* d3dShader = (D3DShader*)shader;
+
+	if (!d3dShader)
+	{
+		return;
+	}
+
+	// Release the layout.
+	if (d3dShader->inputLayout)
+	{
+		d3dShader->inputLayout->Release();
+	}
+
+	// Release the pixel shader.
+	if (d3dShader->pixelShader)
+	{
+		d3dShader->pixelShader->Release();
+	}
+
+	// Release the vertex shader.
+	if (d3dShader->vertexShader)
+	{
+		d3dShader->vertexShader->Release();
+	}
+
+	delete d3dShader;
+}
+
+void D3DClass::OutputShaderErrorMessage(ID3D10Blob * errorMessage, const WCHAR* shaderFilename)
+{
+	char* compileErrors;
+	unsigned long long bufferSize;
+	std::ofstream fout;
+
+
+	// Get a pointer to the error message text buffer.
+	compileErrors = (char*)(errorMessage->GetBufferPointer());
+
+	// Get the length of the message.
+	bufferSize = errorMessage->GetBufferSize();
+
+	// Open a file to write the error message to.
+	fout.open("shader-error.txt");
+
+	// Write out the error message.
+	for (unsigned long long i = 0; i < bufferSize; i++)
+	{
+		fout << compileErrors[i];
+	}
+
+	// Close the file.
+	fout.close();
+
+	// Release the error message.
+	errorMessage->Release();
+	errorMessage = 0;
+
+	// Pop a message up on the screen to notify the user to check the text file for compile errors.
+	MessageBox(m_hwnd, L"Error compiling shader.  Check shader-error.txt for message.", shaderFilename, MB_OK);
+}
+
+//Shows why a shader couldn't be loaded. Without compiler messages it is because the file couldn't be read.
+void D3DClass::ReportShaderError(ID3D10Blob* errorMessage, const WCHAR* shaderFilename, const WCHAR* missingCaption)
+{
+	if (errorMessage)
+	{
+		OutputShaderErrorMessage(errorMessage, shaderFilename);
+	}
+	else
+	{
+		MessageBox(m_hwnd, shaderFilename, missingCaption, MB_OK);
+	}
+}
+
+void D3DClass::SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset)
+{
+	ID3D11Buffer* d3dBuffer = (ID3D11Buffer*)buffer;
+
+	// Set the vertex buffer to active in the input assembler so it can be rendered.
+	m_deviceContext->IASetVertexBuffers(slot, 1, &d3dBuffer, &stride, &offset);
+}
+
+void D3DClass::SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset)
+{
+	// Set the index buffer to active in the input assembler so it can be rendered.
+	m_deviceContext->IASetIndexBuffer((ID3D11Buffer*)buffer,
+									  format == INDEX_FORMAT_UINT16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT,
+									  offset);
+}
+
+void D3DClass::SetPrimitiveTopology(PrimitiveTopology topology)
+{
+	// Triangle lists are the only primitive the engine draws for now.
+	m_deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3DClass::SetConstantBuffer(unsigned int slot, RenderBuffer* buffer)
+{
+	ID3D11Buffer* d3dBuffer = (ID3D11Buffer*)buffer;
+
+	// Set the constant buffer in the vertex and pixel shaders, both read the fog.
+	m_deviceContext->VSSetConstantBuffers(slot, 1, &d3dBuffer);
+	m_deviceContext->PSSetConstantBuffers(slot, 1, &d3dBuffer);
+}
+
+void D3DClass::SetShader(RenderProgram* shader)
+{
+	D3DShader* d3dShader = (D3DShader*)shader;
+
+	// Set the vertex input layout.
+	m_deviceContext->IASetInputLayout(d3dShader->inputLayout);
+
+	// Set the vertex and pixel shaders that will be used to render.
+	m_deviceContext->VSSetShader(d3dShader->vertexShader, NULL, 0);
+	m_deviceContext->PSSetShader(d3dShader->pixelShader, NULL, 0);
+}
+
+void D3DClass::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	m_deviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3DClass::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex,
+									int baseVertex, unsigned int startInstance)
+{
+	m_deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+//Binds a block of the ring. Offsets and sizes are counted in constants of 16 bytes, and the size in blocks of 16 of them.
+void D3DClass::SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize)
+{
+	unsigned int firstConstant, constantCount;
+
+	if (!m_deviceContext1 || !m_constantRing)
+	{
+		return;
+	}
+
+	firstConstant = offset / 16;
+	constantCount = ((byteSize + CONSTANT_RING_ALIGNMENT - 1) & ~(CONSTANT_RING_ALIGNMENT - 1)) / 16;
+	m_deviceContext1->VSSetConstantBuffers1(slot, 1, &m_constantRing, &firstConstant, &constantCount);
+	m_deviceContext1->PSSetConstantBuffers1(slot, 1, &m_constantRing, &firstConstant, &constantCount);
+}
+
+bool D3DClass::CreateDeferredContext(RenderContext** context)
+{
+	HRESULT hResult;
+	ID3D11DeviceContext* deviceContext;
+	DeferredContext* deferredContext;
+
+	hResult = m_device->CreateDeferredContext(0, &deviceContext);
+	if (FAILED(hResult))
+	{
+		return false;
+	}
+
+	deferredContext = new DeferredContext(deviceContext, m_constantRing);
+	if (!deferredContext)
+	{
+		deviceContext->Release();
+		return false;
+	}
+
+	//A deferred context starts without render targets, viewport or states.
+	SetOutputState(deviceContext);
+	m_deferredContexts.push_back(deferredContext);
+
+	*context = deferredContext;
+	return true;
+}
+
+void D3DClass::ReleaseDeferredContext(RenderContext* context)
+{
+	for (unsigned int i = 0; i < m_deferredContexts.size(); i++)
+	{
+		if (m_deferredContexts[i] == (DeferredContext*)context)
+		{
+			m_deferredContexts.erase(m_deferredContexts.begin() + i);
+			break;
+		}
+	}
+
+	delete (DeferredContext*)context;
+}
+
+/*
+ *	FinishCommandList()
+ *	brief: Takes the commands recorded by a deferred context into a command list. The context is cleared, so the
+ *		   output state is bound again for the next list.
+ *	param commandList: Receives the handle of the list.
+ */
+bool D3DClass::FinishCommandList(RenderContext* context, RenderCommandList** commandList)
+{
+	HRESULT hResult;
+	ID3D11DeviceContext* deviceContext;
+	ID3D11CommandList* d3dCommandList;
+
+	deviceContext = ((DeferredContext*)context)->GetDeviceContext();
+
+	hResult = deviceContext->FinishCommandList(FALSE, &d3dCommandList);
+	if (FAILED(hResult))
+	{
+		return false;
+	}
+
+	SetOutputState(deviceContext);
+
+	*commandList = (RenderCommandList*)d3dCommandList;
+	return true;
+}
+
+/*
+ *	ExecuteCommandList()
+ *	brief: Runs a command list on the immediate context. Restoring the whole previous state is slow, so it is
+ *		   cleared instead and only the output state the frame needs is bound again.
+ */
+void D3DClass::ExecuteCommandList(RenderCommandList* commandList)
+{
+	m_deviceContext->ExecuteCommandList((ID3D11CommandList*)commandList, FALSE);
+	SetOutputState(m_deviceContext);
+	m_executedCommandLists++;
+}
+
+void D3DClass::ReleaseCommandList(RenderCommandList* commandList)
+{
+	if (commandList)
+	{
+		((ID3D11CommandList*)commandList)->Release();
+	}
+}
+
+/*
+ *	MapConstantRing()
+ *	brief: Reserves the constants of count draws after the ones written before. If they don't fit before the end of
+ *		   the ring they start over from its beginning, and if the GPU is still reading that part, for frames it
+ *		   hasn't finished, it waits for them. The buffer is mapped with no overwrite, so the driver neither copies
+ *		   nor stalls on it.
+ *	param stride: Receives byteSize aligned to the 256 bytes constant buffer offsets go in.
+ *	return: Where to write the first block, or null if the driver can't bind ranges or the frame alone fills the ring.
+ */
+void* D3DClass::MapConstantRing(unsigned int byteSize, unsigned int count, unsigned int& offset, unsigned int& stride)
+{
+	HRESULT hResult;
+	D3D11_MAPPED_SUBRESOURCE mappedSubresource;
+	unsigned long long size;
+	unsigned int wasted;
+
+	if (!m_constantRing)
+	{
+		return nullptr;
+	}
+
+	stride = (byteSize + CONSTANT_RING_ALIGNMENT - 1) & ~(CONSTANT_RING_ALIGNMENT - 1);
+	size = (unsigned long long)stride * count;
+	if (size == 0 || size > CONSTANT_RING_SIZE)
+	{
+		return nullptr;
+	}
+
+	//The end of the ring is wasted when the blocks don't fit there.
+	wasted = m_ringHead + size > CONSTANT_RING_SIZE ? CONSTANT_RING_SIZE - m_ringHead : 0;
+	while (m_ringUsed + m_ringFrameUsed + wasted + size > CONSTANT_RING_SIZE)
+	{
+		if (m_ringFenceCount == 0)
+		{
+			return nullptr;
+		}
+		WaitForRingFence();
+	}
+
+	hResult = m_deviceContext->Map(m_constantRing, 0, m_ringDiscarded ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD,
+								   0, &mappedSubresource);
+	if (FAILED(hResult))
+	{
+		return nullptr;
+	}
+	m_ringDiscarded = true;
+
+	if (wasted > 0)
+	{
+		m_ringHead = 0;
+	}
+	offset = m_ringHead;
+	m_ringHead = (m_ringHead + (unsigned int)size) % CONSTANT_RING_SIZE;
+	m_ringFrameUsed += wasted + (unsigned int)size;
+
+	return (unsigned char*)mappedSubresource.pData + offset;
+}
+
+void D3DClass::UnmapConstantRing()
+{
+	m_deviceContext->Unmap(m_constantRing, 0);
+}
+
+/*
+ *	CreateRenderTarget()
+ *	brief: Creates a texture of the size and format given to draw into, with a depth buffer like the screen's.
+ *	param target: Receives the handle of the created target.
+ */
+bool D3DClass::CreateRenderTarget(const RenderTargetDesc& desc, RenderTarget** target)
+{
+	HRESULT hResult;
+	D3D11_TEXTURE2D_DESC textureDesc;
+	D3DTarget* d3dTarget;
+
+	if (desc.width <= 0 || desc.height <= 0)
+	{
+		return false;
+	}
+
+	d3dTarget = new D3DTarget();
+	d3dTarget->desc = desc;
+	d3dTarget->texture = nullptr;
+	d3dTarget->renderTargetView = nullptr;
+	d3dTarget->depthStencilBuffer = nullptr;
+	d3dTarget->depthStencilView = nullptr;
+
+	ZeroMemory(&textureDesc, sizeof(textureDesc));
+	textureDesc.Width = desc.width;
+	textureDesc.Height = desc.height;
+	textureDesc.MipLevels = 1;
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = GetTargetFormat(desc.format);
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+
+	hResult = m_device->CreateTexture2D(&textureDesc, NULL, &d3dTarget->texture);
+	if (SUCCEEDED(hResult))
+	{
+		hResult = m_device->CreateRenderTargetView(d3dTarget->texture, NULL, &d3dTarget->renderTargetView);
+	}
+
+	//The same depth buffer as the screen, in the size of the target.
+	if (SUCCEEDED(hResult))
+	{
+		textureDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		textureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+		hResult = m_device->CreateTexture2D(&textureDesc, NULL, &d3dTarget->depthStencilBuffer);
+	}
+	if (SUCCEEDED(hResult))
+	{
+		hResult = m_device->CreateDepthStencilView(d3dTarget->depthStencilBuffer, NULL, &d3dTarget->depthStencilView);
+	}
+
+	if (FAILED(hResult))
+	{
+		ReleaseRenderTarget((RenderTarget*)d3dTarget);
+		return false;
+	}
+
+	d3dTarget->viewport.Width = (float)desc.width;
+	d3dTarget->viewport.Height = (float)desc.height;
+	d3dTarget->viewport.MinDepth = 0.0f;
+	d3dTarget->viewport.MaxDepth = 1.0f;
+	d3dTarget->viewport.TopLeftX = 0.0f;
+	d3dTarget->viewport.TopLeftY = 0.0f;
+
+	*target = (RenderTarget*)d3dTarget;
+	return true;
+}
+
+void D3DClass::ReleaseRenderTarget(RenderTarget* target)
+{
+	D3DTarget* d3dTarget;
+
+	if (!target)
+	{
+		return;
+	}
+	d3dTarget = (D3DTarget*)target;
+
+	if (m_target == d3dTarget)
+	{
+		SetRenderTarget(nullptr);
+	}
+
+	if (d3dTarget->depthStencilView)
+	{
+		d3dTarget->depthStencilView->Release();
+	}
+	if (d3dTarget->depthStencilBuffer)
+	{
+		d3dTarget->depthStencilBuffer->Release();
+	}
+	if (d3dTarget->renderTargetView)
+	{
+		d3dTarget->renderTargetView->Release();
+	}
+	if (d3dTarget->texture)
+	{
+		d3dTarget->texture->Release();
+	}
+
+	delete d3dTarget;
+}
+
+//Binds the target on the device and on every deferred context, which are idle between frames.
+void D3DClass::SetRenderTarget(RenderTarget* target)
+{
+	m_target = (D3DTarget*)target;
+
+	SetOutputState(m_deviceContext);
+	for (unsigned int i = 0; i < m_deferredContexts.size(); i++)
+	{
+		SetOutputState(m_deferredContexts[i]->GetDeviceContext());
+	}
+}
+
+/*
+ *	CreateReadback()
+ *	brief: Creates the ring of a readback: depth staging textures like the target, which the CPU can map to read,
+ *		   and an event query for each.
+ *	param target: The render target read back. Not the screen.
+ *	param depth: How many copies can be on their way at once.
+ *	param readback: Receives the handle of the created readback.
+ */
+bool D3DClass::CreateReadback(RenderTarget* target, unsigned int depth, RenderReadback** readback)
+{
+	HRESULT hResult;
+	D3D11_TEXTURE2D_DESC textureDesc;
+	D3D11_QUERY_DESC queryDesc;
+	D3DReadback* d3dReadback;
+
+	if (!target || depth == 0)
+	{
+		return false;
+	}
+
+	d3dReadback = new D3DReadback();
+	d3dReadback->target = (D3DTarget*)target;
+	d3dReadback->stagingTextures.assign(depth, nullptr);
+	d3dReadback->fences.assign(depth, nullptr);
+	d3dReadback->tags.assign(depth, 0);
+	d3dReadback->first = 0;
+	d3dReadback->count = 0;
+	d3dReadback->mapped = false;
+
+	d3dReadback->target->texture->GetDesc(&textureDesc);
+	textureDesc.Usage = D3D11_USAGE_STAGING;
+	textureDesc.BindFlags = 0;
+	textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	textureDesc.MiscFlags = 0;
+
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	queryDesc.MiscFlags = 0;
+
+	for (unsigned int i = 0; i < depth; i++)
+	{
+		hResult = m_device->CreateTexture2D(&textureDesc, NULL, &d3dReadback->stagingTextures[i]);
+		if (SUCCEEDED(hResult))
+		{
+			hResult = m_device->CreateQuery(&queryDesc, &d3dReadback->fences[i]);
+		}
+
+		if (FAILED(hResult))
+		{
+			ReleaseReadback((RenderReadback*)d3dReadback);
+			return false;
+		}
+	}
+
+	*readback = (RenderReadback*)d3dReadback;
+	return true;
+}
+
+void D3DClass::ReleaseReadback(RenderReadback* readback)
+{
+	D3DReadback* d3dReadback;
+
+	if (!readback)
+	{
+		return;
+	}
+	d3dReadback = (D3DReadback*)readback;
+
+	if (d3dReadback->mapped)
+	{
+		m_deviceContext->Unmap(d3dReadback->stagingTextures[d3dReadback->first], 0);
+	}
+
+	for (unsigned int i = 0; i < d3dReadback->stagingTextures.size(); i++)
+	{
+		if (d3dReadback->fences[i])
+		{
+			d3dReadback->fences[i]->Release();
+		}
+		if (d3dReadback->stagingTextures[i])
+		{
+			d3dReadback->stagingTextures[i]->Release();
+		}
+	}
+
+	delete d3dReadback;
+}
+
+/*
+ *	QueueReadback()
+ *	brief: Copies the target into the next free staging texture on the GPU and marks when the copy is done. Nothing
+ *		   waits here: the copy runs after the frames already sent, and the staging texture is only mapped once
+ *		   its query is signaled, so Map() never stalls the pipeline.
+ *	param tag: Handed back with the image, like the index of the frame.
+ *	return: False if the ring is full.
+ */
+bool D3DClass::QueueReadback(RenderReadback* readback, unsigned long long tag)
+{
+	D3DReadback* d3dReadback;
+	unsigned int slot;
+
+	d3dReadback = (D3DReadback*)readback;
+	if (d3dReadback->count == d3dReadback->stagingTextures.size())
+	{
+		return false;
+	}
+
+	slot = (d3dReadback->first + d3dReadback->count) % d3dReadback->stagingTextures.size();
+	m_deviceContext->CopyResource(d3dReadback->stagingTextures[slot], d3dReadback->target->texture);
+	m_deviceContext->End(d3dReadback->fences[slot]);
+	d3dReadback->tags[slot] = tag;
+	d3dReadback->count++;
+
+	return true;
+}
+
+/*
+ *	MapReadback()
+ *	brief: Maps the oldest copy queued if the GPU has finished it.
+ *	param wait: Waits for the copy instead of returning false when it isn't done yet.
+ *	return: False if nothing is queued or, without wait, the copy isn't done.
+ */
+bool D3DClass::MapReadback(RenderReadback* readback, bool wait, ReadbackImage& image)
+{
+	HRESULT hResult;
+	D3D11_MAPPED_SUBRESOURCE mappedSubresource;
+	D3DReadback* d3dReadback;
+	BOOL done;
+
+	d3dReadback = (D3DReadback*)readback;
+	if (d3dReadback->count == 0 || d3dReadback->mapped)
+	{
+		return false;
+	}
+
+	//The first poll flushes the copy to the GPU if it is still in the command buffer.
+	while (m_deviceContext->GetData(d3dReadback->fences[d3dReadback->first], &done, sizeof(done), 0) != S_OK)
+	{
+		if (!wait)
+		{
+			return false;
+		}
+		YieldProcessor();
+	}
+
+	hResult = m_deviceContext->Map(d3dReadback->stagingTextures[d3dReadback->first], 0, D3D11_MAP_READ, 0,
+								   &mappedSubresource);
+	if (FAILED(hResult))
+	{
+		return false;
+	}
+	d3dReadback->mapped = true;
+
+	image.data = mappedSubresource.pData;
+	image.rowPitch = mappedSubresource.RowPitch;
+	image.width = d3dReadback->target->desc.width;
+	image.height = d3dReadback->target->desc.height;
+	image.format = d3dReadback->target->desc.format;
+	image.tag = d3dReadback->tags[d3dReadback->first];
+	return true;
+}
+
+void D3DClass::UnmapReadback(RenderReadback* readback)
+{
+	D3DReadback* d3dReadback;
+
+	d3dReadback = (D3DReadback*)readback;
+	if (!d3dReadback->mapped)
+	{
+		return;
+	}
+
+	m_deviceContext->Unmap(d3dReadback->stagingTextures[d3dReadback->first], 0);
+	d3dReadback->mapped = false;
+	d3dReadback->first = (d3dReadback->first + 1) % d3dReadback->stagingTextures.size();
+	d3dReadback->count--;
+}
+
+/*
+ *	BeginPass()
+ *	brief: Takes a GPU timestamp at the start of the pass and counts what the pipeline does until EndPass(). Does
+ *		   nothing in a frame that isn't timed.
+ */
+void D3DClass::BeginPass(const char* name)
+{
+	unsigned int pass;
+
+	if (!m_timingSceneOpen)
+	{
+		return;
+	}
+
+	EndPass();
+	GpuTimingFrame& timing = m_timingFrames[m_timingFrame];
+	if (timing.passCount == RENDER_MAX_PASSES)
+	{
+		return;
+	}
+
+	pass = timing.passCount;
+	timing.passNames[pass] = name;
+	m_deviceContext->End(timing.passStart[pass]);
+	m_deviceContext->Begin(timing.pipelineStatistics[pass]);
+	m_timingPassOpen = true;
+}
+
+void D3DClass::EndPass()
+{
+	if (!m_timingPassOpen)
+	{
+		return;
+	}
+
+	GpuTimingFrame& timing = m_timingFrames[m_timingFrame];
+	m_deviceContext->End(timing.pipelineStatistics[timing.passCount]);
+	m_deviceContext->End(timing.passEnd[timing.passCount]);
+	timing.passCount++;
+	m_timingPassOpen = false;
+}
+
+ID3D11Device * D3DClass::GetDevice()
+{
+	return m_device;
+}
+
+ID3D11DeviceContext * D3DClass::GetDeviceContext()
+{
+	return m_deviceContext;
+}
+
+void D3DClass::GetVideoCardInfo(char *cardName, int & memory)
+{
+	strcpy_s(cardName, 128, m_videoCardDescription);
+	memory = m_videoCardMemory;
+}
+
+//Binds the render target set, or the back buffer, with the depth stencil and rasterizer states created in Initialize().
+void D3DClass::SetOutputState(ID3D11DeviceContext* deviceContext)
+{
+	if (m_target)
+	{
+		deviceContext->OMSetRenderTargets(1, &m_target->renderTargetView, m_target->depthStencilView);
+		deviceContext->RSSetViewports(1, &m_target->viewport);
+	}
+	else
+	{
+		deviceContext->OMSetRenderTargets(1, &m_renderTargetView, m_depthStencilView);
+		deviceContext->RSSetViewports(1, &m_viewport);
+	}
+	deviceContext->OMSetDepthStencilState(m_depthStencilState, 1);
+	deviceContext->RSSetState(m_rasterizerState);
+}
+
+DXGI_FORMAT D3DClass::GetTargetFormat(RenderTargetFormat format)
+{
+	switch (format)
+	{
+	case RENDER_TARGET_FORMAT_BGRA8:
+		return DXGI_FORMAT_B8G8R8A8_UNORM;
+	case RENDER_TARGET_FORMAT_RGBA16F:
+		return DXGI_FORMAT_R16G16B16A16_FLOAT;
+	default:
+		return DXGI_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+/*
+ *	InitializeConstantRing()
+ *	brief: Creates the constant ring and the queries that fence it. Binding ranges of a constant buffer and mapping
+ *		   it with no overwrite needs D3D 11.1; without them there is no ring and the draws keep their own buffers.
+ */
+bool D3DClass::InitializeConstantRing()
+{
+	HRESULT hResult;
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	D3D11_BUFFER_DESC bufferDesc;
+	D3D11_QUERY_DESC queryDesc;
+
+	hResult = m_deviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&m_deviceContext1);
+	if (FAILED(hResult))
+	{
+		m_deviceContext1 = nullptr;
+		return true;
+	}
+
+	hResult = m_device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	if (FAILED(hResult) || !options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		return true;
+	}
+
+	bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+	bufferDesc.ByteWidth = CONSTANT_RING_SIZE;
+	bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	bufferDesc.MiscFlags = 0;
+	bufferDesc.StructureByteStride = 0;
+
+	hResult = m_device->CreateBuffer(&bufferDesc, NULL, &m_constantRing);
+	if (FAILED(hResult))
+	{
+		return false;
+	}
+
+	queryDesc.Query = D3D11_QUERY_EVENT;
+	queryDesc.MiscFlags = 0;
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+	{
+		hResult = m_device->CreateQuery(&queryDesc, &m_ringFences[i]);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
+	}
+
+	m_ringFenceFirst = 0;
+	m_ringFenceCount = 0;
+	m_ringHead = 0;
+	m_ringUsed = 0;
+	m_ringFrameUsed = 0;
+	m_ringDiscarded = false;
+
+	return true;
+}
+
+void D3DClass::ShutdownConstantRing()
+{
+	for (unsigned int i = 0; i < CONSTANT_RING_FRAMES; i++)
+	{
+		if (m_ringFences[i])
+		{
+			m_ringFences[i]->Release();
+			m_ringFences[i] = nullptr;
+		}
+	}
+
+	if (m_constantRing)
+	{
+		m_constantRing->Release();
+		m_constantRing = nullptr;
+	}
+
+	if (m_deviceContext1)
+	{
+		m_deviceContext1->Release();
+		m_deviceContext1 = nullptr;
+	}
+}
+
+//Waits for the GPU to finish the oldest frame that used the ring and frees its part.
+void D3DClass::WaitForRingFence()
+{
+	BOOL done;
+
+	while (m_deviceContext->GetData(m_ringFences[m_ringFenceFirst], &done, sizeof(done), 0) != S_OK)
+	{
+		YieldProcessor();
+	}
+
+	m_ringUsed -= m_ringFenceBytes[m_ringFenceFirst];
+	m_ringFenceFirst = (m_ringFenceFirst + 1) % CONSTANT_RING_FRAMES;
+	m_ringFenceCount--;
+}
+
+//Creates the queries of every frame timed and puts the GPU clock on the CPU one.
+bool D3DClass::InitializeTimingQueries()
+{
+	HRESULT hResult;
+	D3D11_QUERY_DESC queryDesc;
+
+	queryDesc.MiscFlags = 0;
+	for (unsigned int i = 0; i < GPU_TIMING_FRAMES; i++)
+	{
+		queryDesc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		hResult = m_device->CreateQuery(&queryDesc, &m_timingFrames[i].disjoint);
+		if (FAILED(hResult))
+		{
+			return false;
+		}
+
+		for (unsigned int j = 0; j < RENDER_MAX_PASSES; j++)
+		{
+			queryDesc.Query = D3D11_QUERY_TIMESTAMP;
+			hResult = m_device->CreateQuery(&queryDesc, &m_timingFrames[i].passStart[j]);
+			if (FAILED(hResult))
+			{
+				return false;
+			}
+
+			hResult = m_device->CreateQuery(&queryDesc, &m_timingFrames[i].passEnd[j]);
+			if (FAILED(hResult))
+			{
+				return false;
+			}
+
+			queryDesc.Query = D3D11_QUERY_PIPELINE_STATISTICS;
+			hResult = m_device->CreateQuery(&queryDesc, &m_timingFrames[i].pipelineStatistics[j]);
+			if (FAILED(hResult))
+			{
+				return false;
+			}
+		}
+
+		m_timingFrames[i].pending = false;
+	}
+
+	m_timingFrame = 0;
+	m_timingSceneOpen = false;
+	m_timingPassOpen = false;
+
+	return CalibrateGpuClock();
+}
+
+void D3DClass::ShutdownTimingQueries()
+{
+	for (unsigned int i = 0; i < GPU_TIMING_FRAMES; i++)
+	{
+		if (m_timingFrames[i].disjoint)
+		{
+			m_timingFrames[i].disjoint->Release();
+			m_timingFrames[i].disjoint = nullptr;
+		}
+
+		for (unsigned int j = 0; j < RENDER_MAX_PASSES; j++)
+		{
+			if (m_timingFrames[i].passStart[j])
+			{
+				m_timingFrames[i].passStart[j]->Release();
+				m_timingFrames[i].passStart[j] = nullptr;
+			}
+
+			if (m_timingFrames[i].passEnd[j])
+			{
+				m_timingFrames[i].passEnd[j]->Release();
+				m_timingFrames[i].passEnd[j] = nullptr;
+			}
+
+			if (m_timingFrames[i].pipelineStatistics[j])
+			{
+				m_timingFrames[i].pipelineStatistics[j]->Release();
+				m_timingFrames[i].pipelineStatistics[j] = nullptr;
+			}
+		}
+
+		m_timingFrames[i].pending = false;
+	}
+}
+
+/*
+ *	CalibrateGpuClock()
+ *	brief: Takes a timestamp on the idle GPU and waits for it, reading the CPU clock right after sending it. The
+ *		   GPU takes it a few microseconds after, which is as close as the two clocks can be put. Done once, while
+ *		   the driver has nothing else queued.
+ */
+bool D3DClass::CalibrateGpuClock()
+{
+	HRESULT hResult;
+	D3D11_QUERY_DESC queryDesc;
+	ID3D11Query* timestamp;
+	UINT64 ticks;
+
+	queryDesc.Query = D3D11_QUERY_TIMESTAMP;
+	queryDesc.MiscFlags = 0;
+	hResult = m_device->CreateQuery(&queryDesc, &timestamp);
+	if (FAILED(hResult))
+	{
+		return false;
+	}
+
+	m_deviceContext->End(timestamp);
+	m_deviceContext->Flush();
+	m_gpuClockSeconds = ReadPassClock();
+	while (m_deviceContext->GetData(timestamp, &ticks, sizeof(ticks), 0) != S_OK)
+	{
+		YieldProcessor();
+	}
+	m_gpuClockTicks = ticks;
+
+	timestamp->Release();
+
+	return true;
+}
+
+//Reads the frames timed the GPU finished, from the oldest, without waiting for the others.
+void D3DClass::ReadTimingFrames()
+{
+	for (unsigned int i = 0; i < GPU_TIMING_FRAMES; i++)
+	{
+		GpuTimingFrame& timing = m_timingFrames[(m_timingFrame + i) % GPU_TIMING_FRAMES];
+		if (!timing.pending)
+		{
+			continue;
+		}
+		if (!ReadTimingFrame(timing))
+		{
+			return;
+		}
+	}
+}
+
+/*
+ *	ReadTimingFrame()
+ *	brief: Turns the queries of a frame into the statistics of its passes, with the timestamps on the CPU clock.
+ *		   The passes of a frame the GPU clock changed in are counted but not timed.
+ *	return: False if the GPU isn't done with the frame yet.
+ */
+bool D3DClass::ReadTimingFrame(GpuTimingFrame& timing)
+{
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	D3D11_QUERY_DATA_PIPELINE_STATISTICS pipelineStatistics[RENDER_MAX_PASSES];
+	UINT64 passStart[RENDER_MAX_PASSES], passEnd[RENDER_MAX_PASSES];
+	RenderPassStatistics statistics;
+
+	//The frame ended after its passes, so they are done when it is, but they are read first to be sure.
+	for (unsigned int i = 0; i < timing.passCount; i++)
+	{
+		if (m_deviceContext->GetData(timing.passStart[i], &passStart[i], sizeof(UINT64),
+									 D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			m_deviceContext->GetData(timing.passEnd[i], &passEnd[i], sizeof(UINT64),
+									 D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+			m_deviceContext->GetData(timing.pipelineStatistics[i], &pipelineStatistics[i],
+									 sizeof(D3D11_QUERY_DATA_PIPELINE_STATISTICS), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		{
+			return false;
+		}
+	}
+	if (m_deviceContext->GetData(timing.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < timing.passCount; i++)
+	{
+		statistics.name = timing.passNames[i];
+		statistics.frame = timing.frame;
+		statistics.timed = !disjoint.Disjoint && disjoint.Frequency > 0;
+		statistics.start = 0.0;
+		statistics.end = 0.0;
+		if (statistics.timed)
+		{
+			statistics.start = m_gpuClockSeconds +
+							   (double)(long long)(passStart[i] - m_gpuClockTicks) / (double)disjoint.Frequency;
+			statistics.end = m_gpuClockSeconds +
+							 (double)(long long)(passEnd[i] - m_gpuClockTicks) / (double)disjoint.Frequency;
+		}
+		statistics.verticesShaded = pipelineStatistics[i].VSInvocations;
+		statistics.trianglesIn = pipelineStatistics[i].IAPrimitives;
+		statistics.trianglesOut = pipelineStatistics[i].CPrimitives;
+		statistics.pixelsShaded = pipelineStatistics[i].PSInvocations;
+		statistics.tilesTouched = 0;
+
+		AddPassStatistics(statistics);
+	}
+
+	timing.pending = false;
+	return true;
+}
+
+D3DClass::DeferredContext::DeferredContext(ID3D11DeviceContext* deviceContext, ID3D11Buffer* constantRing)
+{
+	m_deviceContext = deviceContext;
+	m_constantRing = constantRing;
+	if (FAILED(deviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&m_deviceContext1)))
+	{
+		m_deviceContext1 = nullptr;
+	}
+}
+
+D3DClass::DeferredContext::~DeferredContext()
+{
+	if (m_deviceContext1)
+	{
+		m_deviceContext1->Release();
+		m_deviceContext1 = nullptr;
+	}
+
+	if (m_deviceContext)
+	{
+		m_deviceContext->Release();
+		m_deviceContext = nullptr;
+	}
+}
+
+//Deferred contexts can only map dynamic buffers with discard, which is what the engine always does.
+void* D3DClass::DeferredContext::MapBuffer(RenderBuffer* buffer)
+{
+	HRESULT hResult;
+	D3D11_MAPPED_SUBRESOURCE mappedSubresource;
+
+	hResult = m_deviceContext->Map((ID3D11Buffer*)buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedSubresource);
+	if (FAILED(hResult))
+	{
+		return nullptr;
+	}
+
+	return mappedSubresource.pData;
+}
+
+void D3DClass::DeferredContext::UnmapBuffer(RenderBuffer* buffer)
+{
+	m_deviceContext->Unmap((ID3D11Buffer*)buffer, 0);
+}
+
+void D3DClass::DeferredContext::SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride,
+												unsigned int offset)
+{
+	ID3D11Buffer* d3dBuffer = (ID3D11Buffer*)buffer;
+
+	m_deviceContext->IASetVertexBuffers(slot, 1, &d3dBuffer, &stride, &offset);
+}
+
+void D3DClass::DeferredContext::SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset)
+{
+	m_deviceContext->IASetIndexBuffer((ID3D11Buffer*)buffer,
+									  format == INDEX_FORMAT_UINT16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT,
+									  offset);
+}
+
+void D3DClass::DeferredContext::SetPrimitiveTopology(PrimitiveTopology topology)
+{
+	m_deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void D3DClass::DeferredContext::SetConstantBuffer(unsigned int slot, RenderBuffer* buffer)
+{
+	ID3D11Buffer* d3dBuffer = (ID3D11Buffer*)buffer;
+
+	m_deviceContext->VSSetConstantBuffers(slot, 1, &d3dBuffer);
+	m_deviceContext->PSSetConstantBuffers(slot, 1, &d3dBuffer);
+}
+
+void D3DClass::DeferredContext::SetShader(RenderProgram* shader)
+{
+	D3DShader* d3dShader = (D3DShader*)shader;
+
+	m_deviceContext->IASetInputLayout(d3dShader->inputLayout);
+	m_deviceContext->VSSetShader(d3dShader->vertexShader, NULL, 0);
+	m_deviceContext->PSSetShader(d3dShader->pixelShader, NULL, 0);
+}
+
+void D3DClass::DeferredContext::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	m_deviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3DClass::DeferredContext::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+													 unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	m_deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+/*
+ *	SetConstantRange()
+ *	brief: Binds a block of the ring of the device. Some runtimes don't update the offsets on a deferred context
+ *		   when the same buffer is already bound, so the slot is cleared first.
+ */
+void D3DClass::DeferredContext::SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize)
+{
+	ID3D11Buffer* nullBuffer = nullptr;
+	unsigned int firstConstant, constantCount;
+
+	if (!m_deviceContext1 || !m_constantRing)
+	{
+		return;
+	}
+
+	firstConstant = offset / 16;
+	constantCount = ((byteSize + CONSTANT_RING_ALIGNMENT - 1) & ~(CONSTANT_RING_ALIGNMENT - 1)) / 16;
+	m_deviceContext1->VSSetConstantBuffers(slot, 1, &nullBuffer);
+	m_deviceContext1->VSSetConstantBuffers1(slot, 1, &m_constantRing, &firstConstant, &constantCount);
+	m_deviceContext1->PSSetConstantBuffers(slot, 1, &nullBuffer);
+	m_deviceContext1->PSSetConstantBuffers1(slot, 1, &m_constantRing, &firstConstant, &constantCount);
+}
+
+ID3D11DeviceContext* D3DClass::DeferredContext::GetDeviceContext()
+{
+	return m_deviceContext;
 }
@@ -19,37 +19,205 @@
 /************************************************************************/
 /* INCLUDES                                                             */
 /************************************************************************/
-#include <d3d11.h>
+#include "RenderDevice.h"
+#include "ShaderCache.h"
+#include <d3d11_1.h>
+#include <d3dcompiler.h>
 #include <directxmath.h>
+#include <fstream>
+#include <vector>
 using namespace DirectX;
 
-class D3DClass
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int CONSTANT_RING_FRAMES = 4;			//Frames the GPU can be behind before mapping the ring waits.
+const unsigned int CONSTANT_RING_ALIGNMENT = 256;		//Constant buffer offsets go in blocks of 16 constants.
+const unsigned int GPU_TIMING_FRAMES = 3;				//Frames timed on the GPU before their results are read.
+
+class D3DClass : public RenderDevice
 {
+private:
+	//What is behind a RenderProgram handle for this backend.
+	struct D3DShader
+	{
+		ID3D11VertexShader* vertexShader;
+		ID3D11PixelShader*	pixelShader;
+		ID3D11InputLayout*	inputLayout;
+	};
+
+	//What is behind a RenderTarget handle for this backend.
+	struct D3DTarget
+	{
+		RenderTargetDesc		desc;
+		ID3D11Texture2D*		texture;
+		ID3D11RenderTargetView* renderTargetView;
+		ID3D11Texture2D*		depthStencilBuffer;
+		ID3D11DepthStencilView* depthStencilView;
+		D3D11_VIEWPORT			viewport;
+	};
+
+	/*What is behind a RenderReadback handle: a ring of staging textures the target is copied into on the GPU, each
+	  with the event query that tells when its copy is done.*/
+	struct D3DReadback
+	{
+		D3DTarget*						target;
+		std::vector<ID3D11Texture2D*>	stagingTextures;
+		std::vector<ID3D11Query*>		fences;
+		std::vector<unsigned long long> tags;
+		unsigned int					first;		//The oldest copy waiting to be mapped.
+		unsigned int					count;
+		bool							mapped;
+	};
+
+	//The queries timing the passes of a frame on the GPU. The disjoint query spans the frame and gives the frequency
+	//of the timestamps, or says they can't be trusted.
+	struct GpuTimingFrame
+	{
+		ID3D11Query*		disjoint;
+		ID3D11Query*		passStart[RENDER_MAX_PASSES];
+		ID3D11Query*		passEnd[RENDER_MAX_PASSES];
+		ID3D11Query*		pipelineStatistics[RENDER_MAX_PASSES];
+		const char*			passNames[RENDER_MAX_PASSES];
+		unsigned int		passCount;
+		unsigned long long	frame;
+		bool				pending;		//Sent to the GPU and not read yet.
+	};
+
+	//A vertex or pixel stage CreateShaders() looks for in the cache or compiles.
+	struct ShaderStage
+	{
+		const WCHAR*		filename;
+		const char*			entryPoint;
+		const char*			profile;
+		const ShaderDefine* defines;
+		unsigned int		numDefines;
+		std::vector<char>	source;
+		unsigned long long	key;
+		const void*			bytecode;			//In the cache, once found or compiled.
+		unsigned int		bytecodeSize;
+	};
+
+	/*
+	 *	DeferredContext
+	 *	brief: A D3D11 deferred context. The driver records the calls into a command list on the calling thread.
+	 */
+	class DeferredContext final : public RenderContext
+	{
+	public:
+		DeferredContext(ID3D11DeviceContext* deviceContext, ID3D11Buffer* constantRing);
+		~DeferredContext();
+
+		void* MapBuffer(RenderBuffer* buffer) override;
+		void UnmapBuffer(RenderBuffer* buffer) override;
+
+		void SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset) override;
+		void SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset) override;
+		void SetPrimitiveTopology(PrimitiveTopology topology) override;
+		void SetConstantBuffer(unsigned int slot, RenderBuffer* buffer) override;
+		void SetShader(RenderProgram* shader) override;
+		void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+		void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex,
+								  int baseVertex, unsigned int startInstance) override;
+		void SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize) override;
+
+		ID3D11DeviceContext* GetDeviceContext();
+
+	private:
+		ID3D11DeviceContext*  m_deviceContext;
+		ID3D11DeviceContext1* m_deviceContext1;		//Null before D3D 11.1, where ranges can't be bound.
+		ID3D11Buffer*		  m_constantRing;
+	};
+
 public:
 	D3DClass();
 	D3DClass(const D3DClass&);
 	~D3DClass();
 
 	bool Initialize(int screenWidth, int screenHeight, bool vsync, HWND hwnd, bool fullscreen, 
-					float screenFar, float screenNear);
-	void Shutdown();
+					float screenFar, float screenNear) override;
+	void Shutdown() override;
+
+	void BeginScene(float red, float green, float blue, float alpha) override;
+	void EndScene() override;
+
+	bool CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer) override;
+	void ReleaseBuffer(RenderBuffer* buffer) override;
+	void* MapBuffer(RenderBuffer* buffer) override;
+	void UnmapBuffer(RenderBuffer* buffer) override;
+
+	bool CreateShader(const ShaderDesc& desc, RenderProgram** shader) override;
+	void ReleaseShader(RenderProgram* shader) override;
+	bool CreateShaders(const ShaderDesc* descs, unsigned int count, RenderProgram** shaders) override;
+
+	void SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset) override;
+	void SetPrimitiveTopology(PrimitiveTopology topology) override;
+	void SetConstantBuffer(unsigned int slot, RenderBuffer* buffer) override;
+	void SetShader(RenderProgram* shader) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex,
+							  int baseVertex, unsigned int startInstance) override;
+	void SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize) override;
+
+	bool CreateDeferredContext(RenderContext** context) override;
+	void ReleaseDeferredContext(RenderContext* context) override;
+	bool FinishCommandList(RenderContext* context, RenderCommandList** commandList) override;
+	void ExecuteCommandList(RenderCommandList* commandList) override;
+	void ReleaseCommandList(RenderCommandList* commandList) override;
+
+	void* MapConstantRing(unsigned int byteSize, unsigned int count, unsigned int& offset, unsigned int& stride) override;
+	void UnmapConstantRing() override;
 
-	void BeginScene(float red, float green, float blue, float alpha);
-	void EndScene();
+	bool CreateRenderTarget(const RenderTargetDesc& desc, RenderTarget** target) override;
+	void ReleaseRenderTarget(RenderTarget* target) override;
+	void SetRenderTarget(RenderTarget* target) override;
+
+	bool CreateReadback(RenderTarget* target, unsigned int depth, RenderReadback** readback) override;
+	void ReleaseReadback(RenderReadback* readback) override;
+	bool QueueReadback(RenderReadback* readback, unsigned long long tag) override;
+	bool MapReadback(RenderReadback* readback, bool wait, ReadbackImage& image) override;
+	void UnmapReadback(RenderReadback* readback) override;
+
+	void BeginPass(const char* name) override;
+	void EndPass() override;
 
 	ID3D11Device* GetDevice();
 	ID3D11DeviceContext* GetDeviceContext();
 
-	void GetProjectionMatrix(XMMATRIX &projectionMatrix);
-	void GetOrthographicMatrix(XMMATRIX &orthographicMatrix);
-	void GetWorldMatrix(XMMATRIX &worldMatrix);
+	static bool LoadShaderBytecode(ShaderCacheClass& cache, const WCHAR* filename, const char* entryPoint,
+								   const char* profile, const ShaderDefine* defines, unsigned int numDefines,
+								   const void*& bytecode, unsigned int& bytecodeSize, ID3D10Blob** errorMessage);
+
+	void GetVideoCardInfo(char* cardName, int& memory) override;
 
-	void GetVideoCardInfo(char* cardName, int& memory);
+private:
+	void OutputShaderErrorMessage(ID3D10Blob* errorMessage, const WCHAR* shaderFilename);
+	void ReportShaderError(ID3D10Blob* errorMessage, const WCHAR* shaderFilename, const WCHAR* missingCaption);
+	bool CreateShaderObjects(const ShaderDesc& desc, const void* vertexShaderBuffer, unsigned int vertexShaderSize,
+							 const void* pixelShaderBuffer, unsigned int pixelShaderSize, RenderProgram** shader);
+	static bool ReadShaderSource(const WCHAR* filename, std::vector<char>& source);
+	static unsigned long long HashShaderStage(const std::vector<char>& source, const ShaderDefine* defines,
+											  unsigned int numDefines, const char* entryPoint, const char* profile);
+	static bool CompileShaderStage(const std::vector<char>& source, const ShaderDefine* defines, unsigned int numDefines,
+								   const char* entryPoint, const char* profile, ID3D10Blob** shaderBuffer,
+								   ShaderReflection& reflection, ID3D10Blob** errorMessage);
+	void SetOutputState(ID3D11DeviceContext* deviceContext);
+	static DXGI_FORMAT GetTargetFormat(RenderTargetFormat format);
+	bool InitializeConstantRing();
+	void ShutdownConstantRing();
+	void WaitForRingFence();
+	bool InitializeTimingQueries();
+	void ShutdownTimingQueries();
+	bool CalibrateGpuClock();
+	void ReadTimingFrames();
+	bool ReadTimingFrame(GpuTimingFrame& timing);
 
 private:
 	bool					 m_vSyncEnabled;
 	int						 m_videoCardMemory;
 	char					 m_videoCardDescription[128];
+	HWND					 m_hwnd;
 	IDXGISwapChain*			 m_swapChain;
 	ID3D11Device*			 m_device;
 	ID3D11DeviceContext*	 m_deviceContext;
@@ -58,10 +226,34 @@ private:
 	ID3D11DepthStencilState* m_depthStencilState;
 	ID3D11DepthStencilView*  m_depthStencilView;
 	ID3D11RasterizerState*	 m_rasterizerState;
-	XMMATRIX				 m_projectionMatrix;
-	XMMATRIX				 m_worldMatrix;
-	XMMATRIX				 m_orthographicMatrix;
+	D3D11_VIEWPORT			 m_viewport;
+	ShaderCacheClass		 m_ShaderCache;
+
+	//The offscreen target drawn into instead of the back buffer, and the deferred contexts to bind it on too.
+	D3DTarget*				 m_target;
+	std::vector<DeferredContext*> m_deferredContexts;
+
+	//The constant ring, written with no overwrite behind the frames the GPU hasn't finished yet.
+	ID3D11DeviceContext1*	 m_deviceContext1;
+	ID3D11Buffer*			 m_constantRing;
+	ID3D11Query*			 m_ringFences[CONSTANT_RING_FRAMES];	//A queue of event queries, from the oldest frame.
+	unsigned int			 m_ringFenceBytes[CONSTANT_RING_FRAMES];	//Taken by the frame of each one.
+	unsigned int			 m_ringFenceFirst;
+	unsigned int			 m_ringFenceCount;
+	unsigned int			 m_ringHead;
+	unsigned int			 m_ringUsed;		//Bytes the GPU may still read, from the frames not signaled yet.
+	unsigned int			 m_ringFrameUsed;	//Bytes taken by the frame being made.
+	bool					 m_ringDiscarded;	//The first map has to discard.
 
+	//The passes timed, a ring of frames from m_timingFrame, the oldest, and a GPU timestamp taken at a known time
+	//of the CPU clock to put the GPU times on it.
+	GpuTimingFrame			 m_timingFrames[GPU_TIMING_FRAMES];
+	unsigned int			 m_timingFrame;
+	bool					 m_timingSceneOpen;
+	bool					 m_timingPassOpen;
+	unsigned long long		 m_frameCount;
+	unsigned long long		 m_gpuClockTicks;
+	double					 m_gpuClockSeconds;
 
 };
 #endif
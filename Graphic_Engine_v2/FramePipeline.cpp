@@ -0,0 +1,350 @@
+#include "FramePipeline.h"
+#include "Profiler.h"
+#include <algorithm>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned int FRAME_SNAPSHOT_INDEX_MASK = 3;
+static const unsigned int FRAME_SNAPSHOT_NEW = 4;		//Set on the ready index from publishing until acquiring.
+
+TripleBufferClass::TripleBufferClass()
+{
+	Reset();
+}
+
+TripleBufferClass::TripleBufferClass(const TripleBufferClass &)
+{
+}
+
+
+TripleBufferClass::~TripleBufferClass()
+{
+}
+
+//Forgets the snapshot waiting to be acquired and opens the buffer again. No thread can be using it.
+void TripleBufferClass::Reset()
+{
+	m_writeIndex = 0;
+	m_readIndex = 1;
+	m_readyIndex = 2;
+	m_closed = false;
+}
+
+//Wakes up the threads waiting on the buffer and makes them, and the ones that wait later, return at once.
+void TripleBufferClass::Close()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_closed = true;
+	}
+	m_changedCondition.notify_all();
+}
+
+//The snapshot the producer fills. It has whatever was written to it a few frames before.
+FrameSnapshot* TripleBufferClass::GetWriteSnapshot()
+{
+	return &m_snapshots[m_writeIndex];
+}
+
+/*
+ *	Publish()
+ *	brief: Makes the written snapshot the latest one, and takes the previous latest one to write the next. If the
+ *		   consumer hadn't acquired it, that frame is dropped.
+ */
+void TripleBufferClass::Publish()
+{
+	m_writeIndex = m_readyIndex.exchange(m_writeIndex | FRAME_SNAPSHOT_NEW, std::memory_order_acq_rel) & FRAME_SNAPSHOT_INDEX_MASK;
+
+	//Taking the lock makes sure a consumer that saw nothing new is already waiting and not about to.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_changedCondition.notify_all();
+}
+
+/*
+ *	WaitForConsumer()
+ *	brief: Returns when the consumer has acquired the latest published snapshot.
+ *	return: False if the buffer was closed.
+ */
+bool TripleBufferClass::WaitForConsumer()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_changedCondition.wait(lock, [this] { return m_closed || !(m_readyIndex.load() & FRAME_SNAPSHOT_NEW); });
+	return !m_closed;
+}
+
+/*
+ *	Acquire()
+ *	brief: Gives the consumer the latest published snapshot, waiting for one if it already has it. The one it
+ *		   had before goes back to the producer.
+ *	return: The snapshot, or null if the buffer was closed.
+ */
+FrameSnapshot* TripleBufferClass::Acquire()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_changedCondition.wait(lock, [this] { return m_closed || (m_readyIndex.load() & FRAME_SNAPSHOT_NEW); });
+	if (m_closed)
+	{
+		return nullptr;
+	}
+
+	m_readIndex = m_readyIndex.exchange(m_readIndex, std::memory_order_acq_rel) & FRAME_SNAPSHOT_INDEX_MASK;
+	lock.unlock();
+	m_changedCondition.notify_all();
+
+	return &m_snapshots[m_readIndex];
+}
+
+FramePipelineClass::FramePipelineClass()
+{
+	m_jobSystem = nullptr;
+	m_nextFrame = 0;
+	m_running = false;
+	m_quit = false;
+	m_failed = false;
+	ResetStatistics();
+}
+
+FramePipelineClass::FramePipelineClass(const FramePipelineClass &)
+{
+}
+
+
+FramePipelineClass::~FramePipelineClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Sets the stages of the frames. The pipeline starts stopped.
+ *	param jobSystem: The system the stages use, or null. The pipeline threads attach to it as
+ *		  FRAME_SIMULATION_THREAD and FRAME_RENDER_THREAD.
+ *	param simulate: Fills the snapshot of a frame. It returns false if the frame failed.
+ *	param render: Draws a snapshot. It returns false if the frame failed.
+ */
+bool FramePipelineClass::Initialize(JobSystemClass* jobSystem, const SimulateFunction& simulate, const RenderFunction& render)
+{
+	m_jobSystem = jobSystem;
+	m_simulate = simulate;
+	m_render = render;
+	m_nextFrame = 0;
+	m_failed = false;
+	m_Snapshots.Reset();
+	ResetStatistics();
+
+	return true;
+}
+
+void FramePipelineClass::Shutdown()
+{
+	Stop();
+
+	m_simulate = nullptr;
+	m_render = nullptr;
+	m_jobSystem = nullptr;
+}
+
+/*
+ *	RunFrame()
+ *	brief: Simulates and renders a frame on the calling thread. The pipeline can't be running.
+ */
+bool FramePipelineClass::RunFrame()
+{
+	FrameSnapshot* snapshot;
+
+	if (m_running)
+	{
+		return false;
+	}
+
+	if (!Simulate(m_Snapshots.GetWriteSnapshot()))
+	{
+		return false;
+	}
+	m_Snapshots.Publish();
+
+	snapshot = m_Snapshots.Acquire();
+	return snapshot && Render(snapshot);
+}
+
+/*
+ *	Start()
+ *	brief: Starts the simulation and render threads, which make frames until Stop() is called or a stage fails.
+ *		   The statistics start over.
+ */
+bool FramePipelineClass::Start()
+{
+	if (m_running)
+	{
+		return true;
+	}
+
+	m_Snapshots.Reset();
+	m_quit = false;
+	m_failed = false;
+	ResetStatistics();
+
+	m_running = true;
+	m_simulationThread = std::thread(&FramePipelineClass::SimulationThread, this);
+	m_renderThread = std::thread(&FramePipelineClass::RenderThread, this);
+
+	return true;
+}
+
+//Stops the threads after the frames they are making. A simulated frame not rendered yet is dropped.
+void FramePipelineClass::Stop()
+{
+	if (!m_running)
+	{
+		return;
+	}
+
+	m_quit = true;
+	m_Snapshots.Close();
+	m_simulationThread.join();
+	m_renderThread.join();
+
+	m_Snapshots.Reset();
+	m_running = false;
+}
+
+bool FramePipelineClass::IsRunning()
+{
+	return m_running;
+}
+
+//Whether a stage failed on the threads. They stop when it happens, although Stop() still has to be called.
+bool FramePipelineClass::HasFailed()
+{
+	return m_failed;
+}
+
+void FramePipelineClass::GetStatistics(FramePipelineStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	double seconds;
+
+	seconds = std::chrono::duration<double>(FrameClock::now() - m_statisticsStart).count();
+
+	statistics.frames = m_frames;
+	statistics.framesPerSecond = seconds > 0.0 ? m_frames / seconds : 0.0;
+	statistics.averageLatency = m_frames ? m_latencySeconds * 1000.0 / m_frames : 0.0;
+	statistics.maximumLatency = m_maximumLatencySeconds * 1000.0;
+	statistics.averageSimulationTime = m_frames ? m_simulationSeconds * 1000.0 / m_frames : 0.0;
+	statistics.averageRenderTime = m_frames ? m_renderSeconds * 1000.0 / m_frames : 0.0;
+}
+
+void FramePipelineClass::ResetStatistics()
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+
+	m_statisticsStart = FrameClock::now();
+	m_frames = 0;
+	m_latencySeconds = 0.0;
+	m_maximumLatencySeconds = 0.0;
+	m_simulationSeconds = 0.0;
+	m_renderSeconds = 0.0;
+}
+
+//Runs the simulation stage of the next frame, timing it.
+bool FramePipelineClass::Simulate(FrameSnapshot* snapshot)
+{
+	bool bResult;
+
+	snapshot->frame = m_nextFrame++;
+	snapshot->simulationStart = FrameClock::now();
+
+	bResult = m_simulate(*snapshot);
+
+	snapshot->simulationSeconds = std::chrono::duration<double>(FrameClock::now() - snapshot->simulationStart).count();
+	return bResult;
+}
+
+//Runs the render stage of a frame and adds the frame to the statistics.
+bool FramePipelineClass::Render(FrameSnapshot* snapshot)
+{
+	FrameClock::time_point start, end;
+	double latency;
+	bool bResult;
+
+	start = FrameClock::now();
+	bResult = m_render(*snapshot);
+	end = FrameClock::now();
+	if (!bResult)
+	{
+		return false;
+	}
+
+	latency = std::chrono::duration<double>(end - snapshot->simulationStart).count();
+
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	m_frames++;
+	m_latencySeconds += latency;
+	m_maximumLatencySeconds = std::max(m_maximumLatencySeconds, latency);
+	m_simulationSeconds += snapshot->simulationSeconds;
+	m_renderSeconds += std::chrono::duration<double>(end - start).count();
+
+	return true;
+}
+
+/*
+ *	SimulationThread()
+ *	brief: Simulates frames and publishes them. Once a frame is published it waits for the render to take it
+ *		   before simulating the next, so it never simulates frames that would be dropped and the latency stays
+ *		   at about two frames.
+ */
+void FramePipelineClass::SimulationThread()
+{
+	if (m_jobSystem)
+	{
+		m_jobSystem->AttachThread(FRAME_SIMULATION_THREAD);
+	}
+	ProfilerClass::SetThreadName("simulation");
+
+	while (!m_quit)
+	{
+		if (!Simulate(m_Snapshots.GetWriteSnapshot()))
+		{
+			Fail();
+			return;
+		}
+		m_Snapshots.Publish();
+
+		if (!m_Snapshots.WaitForConsumer())
+		{
+			return;
+		}
+	}
+}
+
+//Renders every frame the simulation publishes, until the pipeline stops.
+void FramePipelineClass::RenderThread()
+{
+	FrameSnapshot* snapshot;
+
+	if (m_jobSystem)
+	{
+		m_jobSystem->AttachThread(FRAME_RENDER_THREAD);
+	}
+	ProfilerClass::SetThreadName("render");
+
+	for (snapshot = m_Snapshots.Acquire(); snapshot; snapshot = m_Snapshots.Acquire())
+	{
+		if (!Render(snapshot))
+		{
+			Fail();
+			return;
+		}
+	}
+}
+
+//Stops both threads after a stage failed.
+void FramePipelineClass::Fail()
+{
+	m_failed = true;
+	m_Snapshots.Close();
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#ifndef FRAME_PIPELINE
+#define FRAME_PIPELINE
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include <DirectXMath.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int FRAME_SNAPSHOT_COUNT = 3;		//Rendered, waiting to be rendered and being simulated.
+
+//Indices the pipeline threads take in the job system. It needs to be created with FRAME_PIPELINE_THREADS user
+//threads, the one starting the pipeline plus these two.
+const unsigned int FRAME_SIMULATION_THREAD = 1;
+const unsigned int FRAME_RENDER_THREAD = 2;
+const unsigned int FRAME_PIPELINE_THREADS = 3;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+typedef std::chrono::steady_clock FrameClock;
+
+//A draw of a frame, with its matrix already made for the camera of the frame.
+struct FrameDraw
+{
+	RenderPass	 pass;
+	ColorShader* shader;
+	ModelClass*	 model;
+	XMFLOAT4X4	 worldViewProjection;
+	float		 depth;
+};
+
+/*
+ *	FrameSnapshot
+ *	brief: Everything the render of a frame needs from the simulation. Once published it isn't changed until the
+ *		   render is done with it, so the simulation of the next frame can't touch what is being drawn.
+ */
+struct FrameSnapshot
+{
+	unsigned long long		frame;
+	FrameClock::time_point	simulationStart;
+	double					simulationSeconds;
+	XMFLOAT3				cameraPosition;
+	XMFLOAT4X4				viewMatrix;
+	XMFLOAT4X4				viewProjectionMatrix;
+	FrameDraw*				draws;					//Of the visible objects, unsorted, in memory that lives for the frame.
+	unsigned int			drawCount;
+	unsigned int			visibleCount;			//Objects drawn and skipped by frustum culling.
+	unsigned int			culledCount;
+};
+
+struct FramePipelineStatistics
+{
+	unsigned int frames;				//Rendered since the statistics were reset.
+	double framesPerSecond;
+	double averageLatency;				//Milliseconds from the start of the simulation of a frame to the end of its render.
+	double maximumLatency;
+	double averageSimulationTime;		//Milliseconds each stage took per frame.
+	double averageRenderTime;
+};
+
+/*
+ *	TripleBufferClass
+ *	brief: Hands frame snapshots from one producer thread to one consumer thread. Each of them owns one snapshot
+ *		   and the third one is the latest published; publishing and acquiring swap the own snapshot with that one
+ *		   in a single atomic exchange, so neither thread ever waits for the other to finish with a snapshot.
+ *		   They only wait when there is nothing new to render, or when the producer wants to stay at most one
+ *		   frame ahead.
+ */
+class TripleBufferClass
+{
+public:
+	TripleBufferClass();
+	TripleBufferClass(const TripleBufferClass&);
+	~TripleBufferClass();
+
+	void Reset();
+	void Close();
+
+	FrameSnapshot* GetWriteSnapshot();
+	void Publish();
+	bool WaitForConsumer();
+
+	FrameSnapshot* Acquire();
+
+private:
+	FrameSnapshot				m_snapshots[FRAME_SNAPSHOT_COUNT];
+	unsigned int				m_writeIndex;		//Owned by the producer.
+	unsigned int				m_readIndex;		//Owned by the consumer.
+	std::atomic<unsigned int>	m_readyIndex;		//The latest published, with FRAME_SNAPSHOT_NEW while not acquired.
+
+	//The threads sleep until the other one changes the ready snapshot.
+	std::mutex					m_mutex;
+	std::condition_variable		m_changedCondition;
+	bool						m_closed;
+};
+
+/*
+ *	FramePipelineClass
+ *	brief: Makes frames in two stages, the simulation, which fills a snapshot, and the render, which draws it.
+ *		   Run serially, both stages of a frame happen on the calling thread. Started, each stage gets a thread
+ *		   of its own and frame N+1 is simulated while frame N is rendered, with the simulation at most one frame
+ *		   ahead. Either way it measures the latency and the throughput of the frames.
+ */
+class FramePipelineClass
+{
+public:
+	typedef std::function<bool(FrameSnapshot& snapshot)> SimulateFunction;
+	typedef std::function<bool(const FrameSnapshot& snapshot)> RenderFunction;
+
+public:
+	FramePipelineClass();
+	FramePipelineClass(const FramePipelineClass&);
+	~FramePipelineClass();
+
+	bool Initialize(JobSystemClass* jobSystem, const SimulateFunction& simulate, const RenderFunction& render);
+	void Shutdown();
+
+	bool RunFrame();
+	bool Start();
+	void Stop();
+	bool IsRunning();
+	bool HasFailed();
+
+	void GetStatistics(FramePipelineStatistics& statistics);
+	void ResetStatistics();
+
+private:
+	bool Simulate(FrameSnapshot* snapshot);
+	bool Render(FrameSnapshot* snapshot);
+	void SimulationThread();
+	void RenderThread();
+	void Fail();
+
+private:
+	JobSystemClass*		m_jobSystem;
+	SimulateFunction	m_simulate;
+	RenderFunction		m_render;
+	TripleBufferClass	m_Snapshots;
+	unsigned long long	m_nextFrame;
+
+	std::thread			m_simulationThread;
+	std::thread			m_renderThread;
+	std::atomic<bool>	m_running;
+	std::atomic<bool>	m_quit;
+	std::atomic<bool>	m_failed;
+
+	//Written by the thread that renders, read by any.
+	std::mutex			m_statisticsMutex;
+	FrameClock::time_point m_statisticsStart;
+	unsigned int		m_frames;
+	double				m_latencySeconds;
+	double				m_maximumLatencySeconds;
+	double				m_simulationSeconds;
+	double				m_renderSeconds;
+};
+
+#endif
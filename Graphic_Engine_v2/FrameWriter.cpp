@@ -0,0 +1,795 @@
+#include "FrameWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned char PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+static const unsigned char PNG_ZLIB_HEADER[2] = { 0x78, 0x5E };		//Deflate with a 32 KB window, fast compression.
+static const unsigned char LZ4_FRAME_MAGIC[4] = { 0x04, 0x22, 0x4D, 0x18 };
+static const unsigned char LZ4_FRAME_FLAGS = 0x60;					//Version 1, independent blocks, no checksums.
+static const unsigned char LZ4_FRAME_BLOCK_SIZE = 0x70;				//Blocks of up to 4 MB.
+static const unsigned int  LZ4_UNCOMPRESSED_BLOCK = 0x80000000u;
+static const unsigned char EXR_MAGIC[4] = { 0x76, 0x2F, 0x31, 0x01 };
+static const unsigned int  EXR_PIXEL_TYPE_HALF = 1;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+typedef std::chrono::steady_clock FrameWriterClock;
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+static void AppendBigEndian(std::vector<unsigned char>& data, unsigned int value)
+{
+	data.push_back((unsigned char)(value >> 24));
+	data.push_back((unsigned char)(value >> 16));
+	data.push_back((unsigned char)(value >> 8));
+	data.push_back((unsigned char)value);
+}
+
+static void AppendLittleEndian(std::vector<unsigned char>& data, unsigned long long value, unsigned int size)
+{
+	for (unsigned int i = 0; i < size; i++)
+	{
+		data.push_back((unsigned char)(value >> (8 * i)));
+	}
+}
+
+static void AppendString(std::vector<unsigned char>& data, const char* text)
+{
+	data.insert(data.end(), text, text + strlen(text) + 1);
+}
+
+//Adds a chunk with its length and CRC, which covers the type and the data.
+static void AppendPngChunk(std::vector<unsigned char>& file, const char* type, const unsigned char* data, size_t size)
+{
+	size_t start;
+
+	AppendBigEndian(file, (unsigned int)size);
+	start = file.size();
+	file.insert(file.end(), type, type + 4);
+	file.insert(file.end(), data, data + size);
+	AppendBigEndian(file, Crc32(0, &file[start], file.size() - start));
+}
+
+static unsigned short FloatToHalf(float value)
+{
+	unsigned int bits, sign, exponent, mantissa, shift, remainder, halfway;
+
+	memcpy(&bits, &value, sizeof(bits));
+	sign = (bits >> 16) & 0x8000;
+	exponent = (bits >> 23) & 0xFF;
+	mantissa = bits & 0x7FFFFF;
+
+	if (exponent == 0xFF)
+	{
+		return (unsigned short)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+	}
+	if (exponent > 142)
+	{
+		return (unsigned short)(sign | 0x7C00);
+	}
+	if (exponent < 113)
+	{
+		//Too small for a normal half: a denormal, rounded, or zero.
+		if (exponent < 102)
+		{
+			return (unsigned short)sign;
+		}
+		mantissa |= 0x800000;
+		shift = 126 - exponent;
+		bits = mantissa >> shift;
+		remainder = mantissa & ((1u << shift) - 1);
+		halfway = 1u << (shift - 1);
+		bits += remainder > halfway || (remainder == halfway && (bits & 1));
+		return (unsigned short)(sign | bits);
+	}
+
+	//Round to nearest even; a carry out of the mantissa correctly bumps the exponent.
+	bits = ((exponent - 112) << 10) | (mantissa >> 13);
+	bits += (mantissa & 0x1FFF) > 0x1000 || ((mantissa & 0x1FFF) == 0x1000 && (bits & 1));
+	return (unsigned short)(sign | bits);
+}
+
+static float HalfToFloat(unsigned short half)
+{
+	unsigned int sign, exponent, mantissa, bits;
+	float value;
+
+	sign = (unsigned int)(half & 0x8000) << 16;
+	exponent = (half >> 10) & 0x1F;
+	mantissa = half & 0x3FF;
+
+	if (exponent == 0x1F)
+	{
+		bits = sign | 0x7F800000 | (mantissa << 13);
+	}
+	else if (exponent == 0)
+	{
+		value = mantissa * (1.0f / 16777216.0f);
+		return sign ? -value : value;
+	}
+	else
+	{
+		bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	}
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+//Checks that the pattern takes exactly one integer, like "frame_%04d.png", so formatting it is safe.
+static bool IsFilenamePatternValid(const char* pattern)
+{
+	int conversions = 0;
+
+	for (const char* c = pattern; *c; c++)
+	{
+		if (*c != '%')
+		{
+			continue;
+		}
+		if (c[1] == '%')
+		{
+			c++;
+			continue;
+		}
+
+		c++;
+		while (*c >= '0' && *c <= '9')
+		{
+			c++;
+		}
+		if (*c != 'd')
+		{
+			return false;
+		}
+		conversions++;
+	}
+
+	return conversions == 1;
+}
+
+/*
+ *	FilterPngRow()
+ *	brief: Writes an RGBA8 row as PNG stores it: a filter type, then the bytes minus what the filter predicts from
+ *		   the pixels to the left and above. It picks the filter that leaves the smallest differences, which
+ *		   usually compresses best.
+ *	param previous: The row above, or null for the first one.
+ */
+static void FilterPngRow(const unsigned char* row, const unsigned char* previous, size_t size, unsigned char* output)
+{
+	unsigned int sums[5];
+	unsigned int filter;
+	int left, up, upLeft, estimate, distanceLeft, distanceUp, distanceUpLeft;
+	unsigned char predictions[5];
+
+	memset(sums, 0, sizeof(sums));
+	for (int pass = 0; pass < 2; pass++)
+	{
+		filter = 0;
+		if (pass == 1)
+		{
+			for (unsigned int i = 1; i < 5; i++)
+			{
+				filter = sums[i] < sums[filter] ? i : filter;
+			}
+			output[0] = (unsigned char)filter;
+		}
+
+		for (size_t x = 0; x < size; x++)
+		{
+			left = x >= 4 ? row[x - 4] : 0;
+			up = previous ? previous[x] : 0;
+			upLeft = previous && x >= 4 ? previous[x - 4] : 0;
+
+			//Paeth: whichever of the three is closest to left + up - upLeft.
+			estimate = left + up - upLeft;
+			distanceLeft = abs(estimate - left);
+			distanceUp = abs(estimate - up);
+			distanceUpLeft = abs(estimate - upLeft);
+
+			predictions[0] = 0;
+			predictions[1] = (unsigned char)left;
+			predictions[2] = (unsigned char)up;
+			predictions[3] = (unsigned char)((left + up) >> 1);
+			predictions[4] = (unsigned char)(distanceLeft <= distanceUp && distanceLeft <= distanceUpLeft ? left :
+											 distanceUp <= distanceUpLeft ? up : upLeft);
+
+			if (pass == 0)
+			{
+				for (unsigned int i = 0; i < 5; i++)
+				{
+					sums[i] += abs((int)(signed char)(unsigned char)(row[x] - predictions[i]));
+				}
+			}
+			else
+			{
+				output[x + 1] = (unsigned char)(row[x] - predictions[filter]);
+			}
+		}
+	}
+}
+
+FrameWriterClass::FrameWriterClass()
+{
+	m_format = FRAME_FILE_PNG;
+	m_unbuffered = false;
+	m_ThreadPool = nullptr;
+	m_firstQueued = 0;
+	m_queuedCount = 0;
+	m_writing = false;
+	m_quit = false;
+	m_failed = false;
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+FrameWriterClass::FrameWriterClass(const FrameWriterClass&)
+{
+}
+
+FrameWriterClass::~FrameWriterClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Starts the writer thread and the threads it encodes with.
+ *	param filenamePattern: printf pattern of the files, with one integer for the number of the frame, like
+ *		   "frames/frame_%04d.png".
+ *	param frameCount: Frames held at most, waiting to be written or being written. Their memory is allocated by
+ *		   the first frames and reused after.
+ *	param threadCount: Threads encoding the stripes of a frame, counting the writer thread. 0 for one per hardware
+ *		   thread.
+ *	param unbuffered: Writes the files around the file cache where the file system allows it.
+ */
+bool FrameWriterClass::Initialize(const char* filenamePattern, FrameFileFormat format, unsigned int frameCount,
+								  unsigned int threadCount, bool unbuffered)
+{
+	bool bResult;
+
+	if (!filenamePattern || !IsFilenamePatternValid(filenamePattern) || frameCount == 0)
+	{
+		return false;
+	}
+
+	m_ThreadPool = new ThreadPoolClass();
+	bResult = m_ThreadPool->Initialize(threadCount) && m_File.Initialize();
+	if (!bResult)
+	{
+		return false;
+	}
+	m_DeflateEncoders.resize(m_ThreadPool->GetThreadCount());
+	m_lz4Tables.resize(m_ThreadPool->GetThreadCount());
+
+	m_filenamePattern = filenamePattern;
+	m_format = format;
+	m_unbuffered = unbuffered;
+	m_frames.resize(frameCount);
+	m_queuedFrames.assign(frameCount, 0);
+	m_freeFrames.clear();
+	for (unsigned int i = 0; i < frameCount; i++)
+	{
+		m_freeFrames.push_back(frameCount - 1 - i);
+	}
+	m_firstQueued = 0;
+	m_queuedCount = 0;
+	m_writing = false;
+	m_quit = false;
+	m_failed = false;
+	memset(&m_statistics, 0, sizeof(m_statistics));
+
+	m_thread = std::thread(&FrameWriterClass::WriterThread, this);
+	return true;
+}
+
+//Writes the frames still queued and stops the thread.
+void FrameWriterClass::Shutdown()
+{
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_queuedCondition.notify_all();
+		m_thread.join();
+	}
+
+	if (m_ThreadPool)
+	{
+		m_ThreadPool->Shutdown();
+		delete m_ThreadPool;
+		m_ThreadPool = nullptr;
+	}
+	m_File.Shutdown();
+
+	m_frames.clear();
+	m_DeflateEncoders.clear();
+	m_lz4Tables.clear();
+	m_stripes.clear();
+	m_pixelData.clear();
+	m_imageData.clear();
+	m_fileData.clear();
+	m_trailerData.clear();
+}
+
+/*
+ *	WriteFrame()
+ *	brief: Copies the image into a free frame and queues it to be written as the file of its tag. Waits for a
+ *		   frame to be written if none is free; the image can be unmapped as soon as this returns.
+ *	return: False if writing a frame before has failed.
+ */
+bool FrameWriterClass::WriteFrame(const ReadbackImage& image)
+{
+	FrameWriterClock::time_point start;
+	unsigned int index, rowSize;
+
+	start = FrameWriterClock::now();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_freeCondition.wait(lock, [this] { return !m_freeFrames.empty() || m_failed; });
+	m_statistics.stallSeconds += std::chrono::duration<double>(FrameWriterClock::now() - start).count();
+	if (m_failed)
+	{
+		return false;
+	}
+
+	index = m_freeFrames.back();
+	m_freeFrames.pop_back();
+	lock.unlock();
+
+	//The copy is done outside the lock, the writer thread doesn't touch free frames.
+	PendingFrame& frame = m_frames[index];
+	rowSize = image.width * (image.format == RENDER_TARGET_FORMAT_RGBA16F ? 8 : 4);
+	frame.pixels.resize((size_t)rowSize * image.height);
+	for (int y = 0; y < image.height; y++)
+	{
+		memcpy(&frame.pixels[(size_t)y * rowSize], (const unsigned char*)image.data + (size_t)y * image.rowPitch, rowSize);
+	}
+	frame.width = image.width;
+	frame.height = image.height;
+	frame.format = image.format;
+	frame.number = image.tag;
+
+	lock.lock();
+	m_queuedFrames[(m_firstQueued + m_queuedCount) % m_queuedFrames.size()] = index;
+	m_queuedCount++;
+	lock.unlock();
+	m_queuedCondition.notify_one();
+
+	return true;
+}
+
+/*
+ *	Flush()
+ *	brief: Waits until every frame queued is written.
+ *	return: False if writing any of them failed.
+ */
+bool FrameWriterClass::Flush()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_freeCondition.wait(lock, [this] { return (m_queuedCount == 0 && !m_writing) || m_failed; });
+	return !m_failed;
+}
+
+void FrameWriterClass::GetStatistics(FrameWriterStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	statistics = m_statistics;
+}
+
+//Writes the queued frames in order until asked to quit with none left.
+void FrameWriterClass::WriterThread()
+{
+	unsigned int index;
+	bool bResult, bFailed;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		m_queuedCondition.wait(lock, [this] { return m_queuedCount > 0 || m_quit; });
+		if (m_queuedCount == 0)
+		{
+			break;
+		}
+
+		index = m_queuedFrames[m_firstQueued];
+		m_firstQueued = (m_firstQueued + 1) % m_queuedFrames.size();
+		m_queuedCount--;
+		m_writing = true;
+		bFailed = m_failed;
+		lock.unlock();
+
+		//After a failure the frames are only dropped, so WriteFrame() doesn't wait forever.
+		bResult = !bFailed && WriteFile(m_frames[index]);
+
+		lock.lock();
+		m_writing = false;
+		m_failed = m_failed || !bResult;
+		m_freeFrames.push_back(index);
+		m_freeCondition.notify_all();
+	}
+}
+
+//Encodes the frame in the format of the files and writes it. Only called on the writer thread.
+bool FrameWriterClass::WriteFile(const PendingFrame& frame)
+{
+	FrameWriterClock::time_point start, encoded;
+	std::vector<char> filename;
+	int length;
+	bool bResult;
+
+	start = FrameWriterClock::now();
+	m_fileData.clear();
+	m_trailerData.clear();
+	m_fileParts.clear();
+	switch (m_format)
+	{
+	case FRAME_FILE_PNG:
+		EncodePng(frame);
+		break;
+	case FRAME_FILE_LZ4:
+		EncodeLz4(frame);
+		break;
+	case FRAME_FILE_EXR:
+		EncodeExr(frame);
+		break;
+	default:
+		EncodeRaw(frame);
+		break;
+	}
+	encoded = FrameWriterClock::now();
+
+	length = snprintf(nullptr, 0, m_filenamePattern.c_str(), (int)frame.number);
+	filename.resize(length + 1);
+	snprintf(&filename[0], filename.size(), m_filenamePattern.c_str(), (int)frame.number);
+
+	bResult = m_File.Open(&filename[0], m_unbuffered);
+	if (!bResult)
+	{
+		return false;
+	}
+	for (unsigned int i = 0; i < m_fileParts.size() && bResult; i++)
+	{
+		bResult = m_File.Write(m_fileParts[i].data, m_fileParts[i].size);
+	}
+	bResult = m_File.Close() && bResult;
+	if (!bResult)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics.framesWritten++;
+	m_statistics.unbufferedFiles += m_File.IsUnbuffered() ? 1 : 0;
+	m_statistics.pixelBytes += frame.pixels.size();
+	for (unsigned int i = 0; i < m_fileParts.size(); i++)
+	{
+		m_statistics.bytesWritten += m_fileParts[i].size;
+	}
+	m_statistics.encodeSeconds += std::chrono::duration<double>(encoded - start).count();
+	m_statistics.writeSeconds += std::chrono::duration<double>(FrameWriterClock::now() - encoded).count();
+
+	return true;
+}
+
+/*
+ *	EncodePng()
+ *	brief: Makes an RGBA PNG of the frame. The rows are filtered and then compressed in stripes on the thread pool,
+ *		   each stripe into an IDAT chunk of its own. The stripes are pieces of a single zlib stream: each one
+ *		   takes the end of the stripe before as dictionary, and their checksums are combined into the one of the
+ *		   stream, which goes in a last chunk.
+ */
+void FrameWriterClass::EncodePng(const PendingFrame& frame)
+{
+	const unsigned char* pixels;
+	unsigned char header[13];
+	size_t rowSize, filteredRowSize;
+	unsigned int stripeRows, stripeCount, adler;
+
+	rowSize = (size_t)frame.width * 4;
+	filteredRowSize = rowSize + 1;
+	stripeRows = (unsigned int)std::max((size_t)1, FRAME_STRIPE_SIZE / rowSize);
+	stripeCount = (frame.height + stripeRows - 1) / stripeRows;
+
+	//Other formats are converted first, the filters need the rows above.
+	pixels = frame.pixels.data();
+	if (frame.format != RENDER_TARGET_FORMAT_RGBA8)
+	{
+		m_pixelData.resize(rowSize * frame.height);
+		m_ThreadPool->ParallelFor(stripeCount, [&](unsigned int stripe, unsigned int /*threadIndex*/)
+		{
+			unsigned int firstRow = stripe * stripeRows;
+			unsigned int endRow = std::min(firstRow + stripeRows, (unsigned int)frame.height);
+
+			for (size_t i = firstRow * (size_t)frame.width; i < endRow * (size_t)frame.width; i++)
+			{
+				unsigned char* pixel = &m_pixelData[i * 4];
+				if (frame.format == RENDER_TARGET_FORMAT_RGBA16F)
+				{
+					const unsigned short* halves = (const unsigned short*)&frame.pixels[i * 8];
+					for (int channel = 0; channel < 4; channel++)
+					{
+						float value = HalfToFloat(halves[channel]);
+						pixel[channel] = (unsigned char)(value <= 0.0f ? 0 : value >= 1.0f ? 255 : (int)(value * 255.0f + 0.5f));
+					}
+				}
+				else
+				{
+					pixel[0] = frame.pixels[i * 4 + 2];
+					pixel[1] = frame.pixels[i * 4 + 1];
+					pixel[2] = frame.pixels[i * 4];
+					pixel[3] = frame.pixels[i * 4 + 3];
+				}
+			}
+		});
+		pixels = m_pixelData.data();
+	}
+
+	m_imageData.resize(filteredRowSize * frame.height);
+	m_ThreadPool->ParallelFor(stripeCount, [&](unsigned int stripe, unsigned int /*threadIndex*/)
+	{
+		unsigned int firstRow = stripe * stripeRows;
+		unsigned int endRow = std::min(firstRow + stripeRows, (unsigned int)frame.height);
+
+		for (unsigned int y = firstRow; y < endRow; y++)
+		{
+			FilterPngRow(pixels + y * rowSize, y > 0 ? pixels + (y - 1) * rowSize : nullptr, rowSize,
+						 &m_imageData[y * filteredRowSize]);
+		}
+	});
+
+	//Every stripe makes a whole chunk: length, type, its piece of the zlib stream and CRC.
+	m_stripes.resize(std::max((size_t)stripeCount, m_stripes.size()));
+	m_ThreadPool->ParallelFor(stripeCount, [&](unsigned int stripe, unsigned int threadIndex)
+	{
+		size_t start = (size_t)stripe * stripeRows * filteredRowSize;
+		size_t size = (size_t)(std::min(stripe * stripeRows + stripeRows, (unsigned int)frame.height) - stripe * stripeRows) * filteredRowSize;
+		std::vector<unsigned char>& data = m_stripes[stripe].data;
+		unsigned int chunkSize, crc;
+
+		data.assign(8, 0);
+		memcpy(&data[4], "IDAT", 4);
+		if (stripe == 0)
+		{
+			data.insert(data.end(), PNG_ZLIB_HEADER, PNG_ZLIB_HEADER + sizeof(PNG_ZLIB_HEADER));
+		}
+		m_DeflateEncoders[threadIndex].Compress(&m_imageData[start], size, start, stripe == stripeCount - 1, data);
+
+		chunkSize = (unsigned int)data.size() - 8;
+		data[0] = (unsigned char)(chunkSize >> 24);
+		data[1] = (unsigned char)(chunkSize >> 16);
+		data[2] = (unsigned char)(chunkSize >> 8);
+		data[3] = (unsigned char)chunkSize;
+		crc = Crc32(0, &data[4], data.size() - 4);
+		AppendBigEndian(data, crc);
+
+		m_stripes[stripe].adler = Adler32(1, &m_imageData[start], size);
+	});
+
+	m_fileData.insert(m_fileData.end(), PNG_SIGNATURE, PNG_SIGNATURE + sizeof(PNG_SIGNATURE));
+	header[0] = (unsigned char)(frame.width >> 24);
+	header[1] = (unsigned char)(frame.width >> 16);
+	header[2] = (unsigned char)(frame.width >> 8);
+	header[3] = (unsigned char)frame.width;
+	header[4] = (unsigned char)(frame.height >> 24);
+	header[5] = (unsigned char)(frame.height >> 16);
+	header[6] = (unsigned char)(frame.height >> 8);
+	header[7] = (unsigned char)frame.height;
+	header[8] = 8;		//Bits per channel.
+	header[9] = 6;		//RGBA.
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	AppendPngChunk(m_fileData, "IHDR", header, sizeof(header));
+	m_fileParts.push_back({ m_fileData.data(), m_fileData.size() });
+
+	adler = m_stripes[0].adler;
+	m_fileParts.push_back({ m_stripes[0].data.data(), m_stripes[0].data.size() });
+	for (unsigned int stripe = 1; stripe < stripeCount; stripe++)
+	{
+		adler = Adler32Combine(adler, m_stripes[stripe].adler,
+							   (size_t)(std::min(stripe * stripeRows + stripeRows, (unsigned int)frame.height) - stripe * stripeRows) * filteredRowSize);
+		m_fileParts.push_back({ m_stripes[stripe].data.data(), m_stripes[stripe].data.size() });
+	}
+
+	header[0] = (unsigned char)(adler >> 24);
+	header[1] = (unsigned char)(adler >> 16);
+	header[2] = (unsigned char)(adler >> 8);
+	header[3] = (unsigned char)adler;
+	AppendPngChunk(m_trailerData, "IDAT", header, 4);
+	AppendPngChunk(m_trailerData, "IEND", nullptr, 0);
+	m_fileParts.push_back({ m_trailerData.data(), m_trailerData.size() });
+}
+
+//The rows as they were read back.
+void FrameWriterClass::EncodeRaw(const PendingFrame& frame)
+{
+	m_fileParts.push_back({ frame.pixels.data(), frame.pixels.size() });
+}
+
+/*
+ *	EncodeLz4()
+ *	brief: Makes an LZ4 frame of the raw rows, with the stripes compressed at the same time as independent blocks.
+ *		   A stripe that doesn't get smaller is stored as it is.
+ */
+void FrameWriterClass::EncodeLz4(const PendingFrame& frame)
+{
+	size_t rowSize;
+	unsigned int stripeRows, stripeCount;
+
+	rowSize = frame.pixels.size() / frame.height;
+	stripeRows = (unsigned int)std::max((size_t)1, std::min(FRAME_STRIPE_SIZE, (size_t)LZ4_MAX_BLOCK_SIZE) / rowSize);
+	stripeCount = (frame.height + stripeRows - 1) / stripeRows;
+
+	m_stripes.resize(std::max((size_t)stripeCount, m_stripes.size()));
+	m_ThreadPool->ParallelFor(stripeCount, [&](unsigned int stripe, unsigned int threadIndex)
+	{
+		size_t start = (size_t)stripe * stripeRows * rowSize;
+		size_t size = std::min(start + stripeRows * rowSize, frame.pixels.size()) - start;
+		std::vector<unsigned char>& data = m_stripes[stripe].data;
+		unsigned int blockSize;
+
+		data.resize(4 + Lz4CompressBound(size));
+		blockSize = (unsigned int)Lz4CompressBlock(&frame.pixels[start], size, &data[4], m_lz4Tables[threadIndex]);
+		if (blockSize >= size)
+		{
+			memcpy(&data[4], &frame.pixels[start], size);
+			blockSize = (unsigned int)size;
+			data.resize(4 + blockSize);
+			blockSize |= LZ4_UNCOMPRESSED_BLOCK;
+		}
+		else
+		{
+			data.resize(4 + blockSize);
+		}
+
+		data[0] = (unsigned char)blockSize;
+		data[1] = (unsigned char)(blockSize >> 8);
+		data[2] = (unsigned char)(blockSize >> 16);
+		data[3] = (unsigned char)(blockSize >> 24);
+	});
+
+	//The descriptor is checked with the second byte of its hash.
+	m_fileData.insert(m_fileData.end(), LZ4_FRAME_MAGIC, LZ4_FRAME_MAGIC + sizeof(LZ4_FRAME_MAGIC));
+	m_fileData.push_back(LZ4_FRAME_FLAGS);
+	m_fileData.push_back(LZ4_FRAME_BLOCK_SIZE);
+	m_fileData.push_back((unsigned char)(Xxh32(&m_fileData[4], 2, 0) >> 8));
+	m_fileParts.push_back({ m_fileData.data(), m_fileData.size() });
+
+	for (unsigned int stripe = 0; stripe < stripeCount; stripe++)
+	{
+		m_fileParts.push_back({ m_stripes[stripe].data.data(), m_stripes[stripe].data.size() });
+	}
+
+	//A block of size 0 ends the frame.
+	AppendLittleEndian(m_trailerData, 0, 4);
+	m_fileParts.push_back({ m_trailerData.data(), m_trailerData.size() });
+}
+
+/*
+ *	EncodeExr()
+ *	brief: Makes a scanline OpenEXR file of the frame, half float RGBA without compression. Every line holds the
+ *		   channels one after the other, in the alphabetical order of their names. Their size is fixed, so the
+ *		   stripes of lines are converted at the same time straight into their place in the file.
+ */
+void FrameWriterClass::EncodeExr(const PendingFrame& frame)
+{
+	static const char* channelNames[4] = { "A", "B", "G", "R" };
+	size_t lineSize;
+	unsigned long long lineOffset;
+	unsigned int stripeRows, stripeCount;
+
+	m_fileData.insert(m_fileData.end(), EXR_MAGIC, EXR_MAGIC + sizeof(EXR_MAGIC));
+	AppendLittleEndian(m_fileData, 2, 4);		//Version 2, single part scanlines.
+
+	AppendString(m_fileData, "channels");
+	AppendString(m_fileData, "chlist");
+	AppendLittleEndian(m_fileData, 4 * (2 + 16) + 1, 4);
+	for (unsigned int channel = 0; channel < 4; channel++)
+	{
+		AppendString(m_fileData, channelNames[channel]);
+		AppendLittleEndian(m_fileData, EXR_PIXEL_TYPE_HALF, 4);
+		AppendLittleEndian(m_fileData, 0, 4);		//Not perceptually linear, and reserved.
+		AppendLittleEndian(m_fileData, 1, 4);		//No subsampling.
+		AppendLittleEndian(m_fileData, 1, 4);
+	}
+	m_fileData.push_back(0);
+
+	AppendString(m_fileData, "compression");
+	AppendString(m_fileData, "compression");
+	AppendLittleEndian(m_fileData, 1, 4);
+	m_fileData.push_back(0);
+
+	for (int window = 0; window < 2; window++)
+	{
+		AppendString(m_fileData, window ? "displayWindow" : "dataWindow");
+		AppendString(m_fileData, "box2i");
+		AppendLittleEndian(m_fileData, 16, 4);
+		AppendLittleEndian(m_fileData, 0, 4);
+		AppendLittleEndian(m_fileData, 0, 4);
+		AppendLittleEndian(m_fileData, frame.width - 1, 4);
+		AppendLittleEndian(m_fileData, frame.height - 1, 4);
+	}
+
+	AppendString(m_fileData, "lineOrder");
+	AppendString(m_fileData, "lineOrder");
+	AppendLittleEndian(m_fileData, 1, 4);
+	m_fileData.push_back(0);		//Increasing y.
+
+	AppendString(m_fileData, "pixelAspectRatio");
+	AppendString(m_fileData, "float");
+	AppendLittleEndian(m_fileData, 4, 4);
+	AppendLittleEndian(m_fileData, 0x3F800000, 4);
+
+	AppendString(m_fileData, "screenWindowCenter");
+	AppendString(m_fileData, "v2f");
+	AppendLittleEndian(m_fileData, 8, 4);
+	AppendLittleEndian(m_fileData, 0, 8);
+
+	AppendString(m_fileData, "screenWindowWidth");
+	AppendString(m_fileData, "float");
+	AppendLittleEndian(m_fileData, 4, 4);
+	AppendLittleEndian(m_fileData, 0x3F800000, 4);
+	m_fileData.push_back(0);
+
+	//The offset of every line: after the header and this table, each one with its number and size first.
+	lineSize = (size_t)frame.width * 4 * sizeof(unsigned short);
+	lineOffset = m_fileData.size() + (unsigned long long)frame.height * 8;
+	for (int y = 0; y < frame.height; y++)
+	{
+		AppendLittleEndian(m_fileData, lineOffset + (unsigned long long)y * (8 + lineSize), 8);
+	}
+	m_fileParts.push_back({ m_fileData.data(), m_fileData.size() });
+
+	stripeRows = (unsigned int)std::max((size_t)1, FRAME_STRIPE_SIZE / lineSize);
+	stripeCount = (frame.height + stripeRows - 1) / stripeRows;
+	m_imageData.resize((size_t)frame.height * (8 + lineSize));
+	m_ThreadPool->ParallelFor(stripeCount, [&](unsigned int stripe, unsigned int /*threadIndex*/)
+	{
+		static const unsigned int channelOffsets[4] = { 3, 2, 1, 0 };		//Of each channel in an RGBA pixel.
+		unsigned int endRow = std::min(stripe * stripeRows + stripeRows, (unsigned int)frame.height);
+		unsigned int offset;
+		unsigned short half;
+
+		for (unsigned int y = stripe * stripeRows; y < endRow; y++)
+		{
+			unsigned char* line = &m_imageData[y * (8 + lineSize)];
+			unsigned int header[2] = { y, (unsigned int)lineSize };
+
+			memcpy(line, header, sizeof(header));
+			line += sizeof(header);
+			for (unsigned int channel = 0; channel < 4; channel++)
+			{
+				offset = channelOffsets[channel];
+				if (frame.format == RENDER_TARGET_FORMAT_BGRA8 && offset != 3)
+				{
+					offset = 2 - offset;
+				}
+
+				for (int x = 0; x < frame.width; x++)
+				{
+					if (frame.format == RENDER_TARGET_FORMAT_RGBA16F)
+					{
+						memcpy(&half, &frame.pixels[((size_t)y * frame.width + x) * 8 + offset * 2], sizeof(half));
+					}
+					else
+					{
+						half = FloatToHalf(frame.pixels[((size_t)y * frame.width + x) * 4 + offset] * (1.0f / 255.0f));
+					}
+					memcpy(line, &half, sizeof(half));
+					line += sizeof(half);
+				}
+			}
+		}
+	});
+	m_fileParts.push_back({ m_imageData.data(), m_imageData.size() });
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#ifndef FRAME_WRITER
+#define FRAME_WRITER
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "RenderDevice.h"
+#include "ImageCompression.h"
+#include "SequentialFile.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const size_t FRAME_STRIPE_SIZE = 256 * 1024;		//Bytes of pixels, about, every stripe of a frame is encoded from.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+enum FrameFileFormat
+{
+	FRAME_FILE_PNG,		//8 bits per channel RGBA.
+	FRAME_FILE_RAW,		//The rows of the frame one after the other in the format it was read back, without a header.
+	FRAME_FILE_LZ4,		//The raw file in an LZ4 frame with a block per stripe, which "lz4 -d" turns back into it.
+	FRAME_FILE_EXR		//Half float RGBA scanlines, uncompressed.
+};
+
+struct FrameWriterStatistics
+{
+	unsigned int	   framesWritten;
+	unsigned int	   unbufferedFiles;		//Written around the file cache.
+	unsigned long long pixelBytes;			//Of the frames written, as they were read back.
+	unsigned long long bytesWritten;
+	double			   encodeSeconds;		//The writer thread turning frames into files.
+	double			   writeSeconds;		//The writer thread writing the files.
+	double			   stallSeconds;		//WriteFrame() waiting for a free frame because the writer was behind.
+};
+
+/*
+ *	FrameWriterClass
+ *	brief: Writes frames read back from a render target to numbered image files on a thread of its own, so the
+ *		   renderer only pays for copying each frame. It holds a fixed number of frames: when all of them are
+ *		   waiting to be written WriteFrame() waits for one, which bounds the memory taken however far the
+ *		   renderer is ahead of the disk. Each frame is split in stripes of rows that a thread pool encodes at the
+ *		   same time, and the file is written in large aligned blocks.
+ */
+class FrameWriterClass
+{
+public:
+	FrameWriterClass();
+	FrameWriterClass(const FrameWriterClass&);
+	~FrameWriterClass();
+
+	bool Initialize(const char* filenamePattern, FrameFileFormat format, unsigned int frameCount, unsigned int threadCount,
+					bool unbuffered);
+	void Shutdown();
+
+	bool WriteFrame(const ReadbackImage& image);
+	bool Flush();
+
+	void GetStatistics(FrameWriterStatistics& statistics);
+
+private:
+	//A frame copied out of a readback, with its rows packed.
+	struct PendingFrame
+	{
+		std::vector<unsigned char> pixels;
+		int						   width;
+		int						   height;
+		RenderTargetFormat		   format;
+		unsigned long long		   number;
+	};
+
+	//A piece of the file encoded from a stripe of the frame.
+	struct EncodedStripe
+	{
+		std::vector<unsigned char> data;
+		unsigned int			   adler;		//Of the rows it was compressed from, for the zlib stream of a PNG.
+	};
+
+	//A part of the file, which is written as the parts one after the other.
+	struct FilePart
+	{
+		const unsigned char* data;
+		size_t				 size;
+	};
+
+	void WriterThread();
+	bool WriteFile(const PendingFrame& frame);
+	void EncodePng(const PendingFrame& frame);
+	void EncodeRaw(const PendingFrame& frame);
+	void EncodeLz4(const PendingFrame& frame);
+	void EncodeExr(const PendingFrame& frame);
+
+private:
+	std::string				  m_filenamePattern;		//printf pattern taking the number of the frame.
+	FrameFileFormat			  m_format;
+	bool					  m_unbuffered;
+	std::vector<PendingFrame> m_frames;
+
+	//What the writer thread encodes with, all kept to reuse their memory.
+	ThreadPoolClass*		  m_ThreadPool;
+	std::vector<DeflateEncoderClass> m_DeflateEncoders;		//One per thread of the pool.
+	std::vector<std::vector<unsigned int>> m_lz4Tables;
+	std::vector<EncodedStripe> m_stripes;
+	std::vector<unsigned char> m_pixelData;				//The pixels converted to RGBA8, when they aren't.
+	std::vector<unsigned char> m_imageData;				//The pixels of the frame arranged for the file.
+	std::vector<unsigned char> m_fileData;				//Header of the file.
+	std::vector<unsigned char> m_trailerData;
+	std::vector<FilePart>	  m_fileParts;
+	SequentialFileClass		  m_File;
+
+	//Frames go from free to queued in WriteFrame() and back to free once written, in the order they came.
+	std::thread				  m_thread;
+	std::mutex				  m_mutex;
+	std::condition_variable	  m_queuedCondition;
+	std::condition_variable	  m_freeCondition;
+	std::vector<unsigned int> m_freeFrames;
+	std::vector<unsigned int> m_queuedFrames;			//A ring, from m_firstQueued.
+	unsigned int			  m_firstQueued;
+	unsigned int			  m_queuedCount;
+	bool					  m_writing;				//The writer thread holds a frame out of both lists.
+	bool					  m_quit;
+	bool					  m_failed;
+	FrameWriterStatistics	  m_statistics;
+};
+
+#endif
@@ -0,0 +1,402 @@
+#include "FrustumClass.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//Tests the bounds in [first, count) against the planes, writing 1 for the visible ones and 0 for the rest.
+typedef unsigned int (*CullFunction)(const XMFLOAT4* planes, const BoundsStream& bounds, unsigned int first,
+									 unsigned int count, unsigned char* visible);
+
+/************************************************************************/
+/* KERNELS                                                              */
+/* An object is out when its center is farther behind a plane than its  */
+/* radius along the plane normal: the projection of the box, or the     */
+/* sphere radius if it is smaller.                                      */
+/************************************************************************/
+static unsigned int CullScalar(const XMFLOAT4* planes, const BoundsStream& bounds, unsigned int first,
+							   unsigned int count, unsigned char* visible)
+{
+	unsigned int visibleCount = 0;
+	float distance, radius;
+	bool inside;
+
+	for (unsigned int i = first; i < count; i++)
+	{
+		inside = true;
+		for (int plane = 0; plane < 6; plane++)
+		{
+			distance = planes[plane].x * bounds.centerX[i] + planes[plane].y * bounds.centerY[i] +
+					   planes[plane].z * bounds.centerZ[i] + planes[plane].w;
+			radius = fabsf(planes[plane].x) * bounds.extentX[i] + fabsf(planes[plane].y) * bounds.extentY[i] +
+					 fabsf(planes[plane].z) * bounds.extentZ[i];
+			radius = std::min(radius, bounds.radius[i]);
+
+			if (distance + radius < 0.0f)
+			{
+				inside = false;
+			}
+		}
+
+		visible[i] = inside ? 1 : 0;
+		visibleCount += inside ? 1 : 0;
+	}
+
+	return visibleCount;
+}
+
+#ifdef SIMD_X86
+
+//Number of bits set in every 4 bit lane mask.
+static const unsigned int g_laneCounts[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+//4 objects at once.
+static unsigned int CullSSE2(const XMFLOAT4* planes, const BoundsStream& bounds, unsigned int first,
+							 unsigned int count, unsigned char* visible)
+{
+	static const unsigned int laneBytes[16] = { 0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001,
+												0x00010100, 0x00010101, 0x01000000, 0x01000001, 0x01000100, 0x01000101,
+												0x01010000, 0x01010001, 0x01010100, 0x01010101 };
+	__m128 normal[6][3], absNormal[6][3], offset[6];
+	__m128 x, y, z, extentX, extentY, extentZ, sphere, distance, radius, outside, zero;
+	unsigned int visibleCount = 0, i;
+	int mask;
+
+	for (int plane = 0; plane < 6; plane++)
+	{
+		const float* values = &planes[plane].x;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			normal[plane][axis] = _mm_set1_ps(values[axis]);
+			absNormal[plane][axis] = _mm_set1_ps(fabsf(values[axis]));
+		}
+		offset[plane] = _mm_set1_ps(values[3]);
+	}
+	zero = _mm_setzero_ps();
+
+	for (i = first; i + 4 <= count; i += 4)
+	{
+		x = _mm_loadu_ps(bounds.centerX + i);
+		y = _mm_loadu_ps(bounds.centerY + i);
+		z = _mm_loadu_ps(bounds.centerZ + i);
+		extentX = _mm_loadu_ps(bounds.extentX + i);
+		extentY = _mm_loadu_ps(bounds.extentY + i);
+		extentZ = _mm_loadu_ps(bounds.extentZ + i);
+		sphere = _mm_loadu_ps(bounds.radius + i);
+
+		outside = _mm_setzero_ps();
+		for (int plane = 0; plane < 6; plane++)
+		{
+			distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, normal[plane][0]), _mm_mul_ps(y, normal[plane][1])),
+								  _mm_add_ps(_mm_mul_ps(z, normal[plane][2]), offset[plane]));
+			radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, absNormal[plane][0]), _mm_mul_ps(extentY, absNormal[plane][1])),
+								_mm_mul_ps(extentZ, absNormal[plane][2]));
+			radius = _mm_min_ps(radius, sphere);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+		}
+
+		mask = ~_mm_movemask_ps(outside) & 0xf;
+		memcpy(visible + i, &laneBytes[mask], 4);
+		visibleCount += g_laneCounts[mask];
+	}
+
+	return visibleCount + CullScalar(planes, bounds, i, count, visible);
+}
+
+//8 objects at once.
+SIMD_TARGET_AVX2 static unsigned int CullAVX2(const XMFLOAT4* planes, const BoundsStream& bounds, unsigned int first,
+											  unsigned int count, unsigned char* visible)
+{
+	__m256 normal[6][3], absNormal[6][3], offset[6];
+	__m256 x, y, z, extentX, extentY, extentZ, sphere, distance, radius, outside, zero;
+	__m128i packed;
+	unsigned int visibleCount = 0, i;
+	int mask;
+
+	for (int plane = 0; plane < 6; plane++)
+	{
+		const float* values = &planes[plane].x;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			normal[plane][axis] = _mm256_set1_ps(values[axis]);
+			absNormal[plane][axis] = _mm256_set1_ps(fabsf(values[axis]));
+		}
+		offset[plane] = _mm256_set1_ps(values[3]);
+	}
+	zero = _mm256_setzero_ps();
+
+	for (i = first; i + 8 <= count; i += 8)
+	{
+		x = _mm256_loadu_ps(bounds.centerX + i);
+		y = _mm256_loadu_ps(bounds.centerY + i);
+		z = _mm256_loadu_ps(bounds.centerZ + i);
+		extentX = _mm256_loadu_ps(bounds.extentX + i);
+		extentY = _mm256_loadu_ps(bounds.extentY + i);
+		extentZ = _mm256_loadu_ps(bounds.extentZ + i);
+		sphere = _mm256_loadu_ps(bounds.radius + i);
+
+		outside = _mm256_setzero_ps();
+		for (int plane = 0; plane < 6; plane++)
+		{
+			distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, normal[plane][0]), _mm256_mul_ps(y, normal[plane][1])),
+									 _mm256_add_ps(_mm256_mul_ps(z, normal[plane][2]), offset[plane]));
+			radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(extentX, absNormal[plane][0]), _mm256_mul_ps(extentY, absNormal[plane][1])),
+								   _mm256_mul_ps(extentZ, absNormal[plane][2]));
+			radius = _mm256_min_ps(radius, sphere);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ));
+		}
+
+		//Turn the lanes into bytes of 1 or 0.
+		mask = ~_mm256_movemask_ps(outside) & 0xff;
+		packed = _mm_packs_epi32(_mm256_castsi256_si128(_mm256_castps_si256(outside)),
+								 _mm256_extracti128_si256(_mm256_castps_si256(outside), 1));
+		packed = _mm_add_epi8(_mm_packs_epi16(packed, packed), _mm_set1_epi8(1));
+		_mm_storel_epi64((__m128i*)(visible + i), packed);
+		visibleCount += g_laneCounts[mask & 0xf] + g_laneCounts[mask >> 4];
+	}
+
+	return visibleCount + CullScalar(planes, bounds, i, count, visible);
+}
+
+#endif
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static CullFunction SelectCull(SimdLevel level)
+{
+	switch (level)
+	{
+#ifdef SIMD_X86
+	//Culling is bound by loading the seven streams, so the wider AVX-512 registers don't pay off.
+	case SIMD_LEVEL_AVX512:
+	case SIMD_LEVEL_AVX2:
+		return CullAVX2;
+	case SIMD_LEVEL_SSE2:
+		return CullSSE2;
+#endif
+	default:
+		return CullScalar;
+	}
+}
+
+static SimdLevel	g_supportedLevel = DetectSimdLevel();
+static SimdLevel	g_frustumLevel = g_supportedLevel;
+static CullFunction g_cull = SelectCull(g_frustumLevel);
+
+FrustumClass::FrustumClass()
+{
+	for (int i = 0; i < 6; i++)
+	{
+		m_planes[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+	m_visibleCount = 0;
+	m_culledCount = 0;
+}
+
+FrustumClass::FrustumClass(const FrustumClass &)
+{
+}
+
+
+FrustumClass::~FrustumClass()
+{
+}
+
+/*
+ *	ConstructFrustum()
+ *	brief: Extracts the planes from the view and projection matrices of the frame (Gribb and Hartmann), and starts
+ *		   counting the culled objects again.
+ */
+void FrustumClass::ConstructFrustum(const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix)
+{
+	XMFLOAT4X4 matrix;
+	float length;
+
+	XMStoreFloat4x4(&matrix, XMMatrixMultiply(viewMatrix, projectionMatrix));
+
+	//With row vectors a clip coordinate is the dot product with a column, and every plane is a sum of two of them:
+	//-w <= x <= w, -w <= y <= w and, for D3D, 0 <= z <= w.
+	for (int i = 0; i < 6; i++)
+	{
+		const int axis = i < 4 ? i / 2 : 2;
+		const float sign = i % 2 == 0 ? 1.0f : -1.0f;
+		const float weight = i == 4 ? 0.0f : 1.0f;		//The near plane is z itself.
+
+		m_planes[i] = XMFLOAT4(weight * matrix.m[0][3] + sign * matrix.m[0][axis],
+							   weight * matrix.m[1][3] + sign * matrix.m[1][axis],
+							   weight * matrix.m[2][3] + sign * matrix.m[2][axis],
+							   weight * matrix.m[3][3] + sign * matrix.m[3][axis]);
+
+		length = sqrtf(m_planes[i].x * m_planes[i].x + m_planes[i].y * m_planes[i].y + m_planes[i].z * m_planes[i].z);
+		if (length > 0.0f)
+		{
+			m_planes[i] = XMFLOAT4(m_planes[i].x / length, m_planes[i].y / length, m_planes[i].z / length, m_planes[i].w / length);
+		}
+	}
+
+	m_visibleCount = 0;
+	m_culledCount = 0;
+}
+
+/*
+ *	CheckBoundingVolume()
+ *	brief: Tests a single object.
+ *	param worldMatrix: The world matrix the object is drawn with.
+ *	return: False if the object is out of the view.
+ */
+bool FrustumClass::CheckBoundingVolume(const BoundingVolume& bounds, const XMMATRIX& worldMatrix)
+{
+	float center[3], extent[3], radius;
+	unsigned char visible;
+	BoundsStream stream = { &center[0], &center[1], &center[2], &extent[0], &extent[1], &extent[2], &radius };
+	XMFLOAT4X4 world;
+
+	XMStoreFloat4x4(&world, worldMatrix);
+	TransformBoundingVolumes(bounds, &world, 1, stream);
+
+	return CullBounds(stream, 1, &visible) == 1;
+}
+
+/*
+ *	CullBounds()
+ *	brief: Tests the world space bounds of many objects at once.
+ *	param visible: Receives 1 for every object in the view and 0 for the rest.
+ *	return: The number of objects in the view.
+ */
+unsigned int FrustumClass::CullBounds(const BoundsStream& bounds, unsigned int count, unsigned char* visible)
+{
+	unsigned int visibleCount;
+
+	visibleCount = g_cull(m_planes, bounds, 0, count, visible);
+
+	m_visibleCount += visibleCount;
+	m_culledCount += count - visibleCount;
+	return visibleCount;
+}
+
+//The six planes, normalized and pointing inside: left, right, bottom, top, near and far.
+void FrustumClass::GetPlanes(XMFLOAT4* planes)
+{
+	memcpy(planes, m_planes, sizeof(m_planes));
+}
+
+//Counts objects culled without CullBounds(), like the ones a hierarchy skips whole.
+void FrustumClass::AddCullingStatistics(unsigned int visibleCount, unsigned int culledCount)
+{
+	m_visibleCount += visibleCount;
+	m_culledCount += culledCount;
+}
+
+//Objects found visible and culled since the last ConstructFrustum(), which is once per frame.
+void FrustumClass::GetCullingStatistics(unsigned int& visibleCount, unsigned int& culledCount)
+{
+	visibleCount = m_visibleCount;
+	culledCount = m_culledCount;
+}
+
+/*
+ *	ComputeBoundingVolume()
+ *	brief: Finds the box around the vertices and the sphere around its center that holds them.
+ *	param vertices: The vertices, with the position as three floats at the start.
+ */
+void ComputeBoundingVolume(const void* vertices, unsigned int vertexCount, unsigned int vertexSize, BoundingVolume& bounds)
+{
+	const unsigned char* bytes = (const unsigned char*)vertices;
+	float position[3], boundsMin[3], boundsMax[3], center[3], distance, radius = 0.0f;
+
+	if (vertexCount == 0)
+	{
+		bounds.center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		bounds.extent = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		bounds.radius = 0.0f;
+		return;
+	}
+
+	memcpy(boundsMin, bytes, sizeof(boundsMin));
+	memcpy(boundsMax, bytes, sizeof(boundsMax));
+	for (unsigned int i = 1; i < vertexCount; i++)
+	{
+		memcpy(position, bytes + (size_t)i * vertexSize, sizeof(position));
+		for (int axis = 0; axis < 3; axis++)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], position[axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], position[axis]);
+		}
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] = (boundsMin[axis] + boundsMax[axis]) * 0.5f;
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		memcpy(position, bytes + (size_t)i * vertexSize, sizeof(position));
+		distance = (position[0] - center[0]) * (position[0] - center[0]) + (position[1] - center[1]) * (position[1] - center[1]) +
+				   (position[2] - center[2]) * (position[2] - center[2]);
+		radius = std::max(radius, distance);
+	}
+
+	bounds.center = XMFLOAT3(center[0], center[1], center[2]);
+	bounds.extent = XMFLOAT3(boundsMax[0] - center[0], boundsMax[1] - center[1], boundsMax[2] - center[2]);
+	bounds.radius = sqrtf(radius);
+}
+
+/*
+ *	TransformBoundingVolumes()
+ *	brief: Takes the bounds of a model to world space for every copy of it. The box becomes the box around the
+ *		   transformed one (Arvo) and the sphere grows with the largest scale of the matrix.
+ *	param worldMatrices: The world matrix of every copy, not transposed.
+ *	param output: Receives the world space bounds of every copy.
+ */
+void TransformBoundingVolumes(const BoundingVolume& bounds, const XMFLOAT4X4* worldMatrices, unsigned int count,
+							  const BoundsStream& output)
+{
+	float scale;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const XMFLOAT4X4& m = worldMatrices[i];
+
+		output.centerX[i] = bounds.center.x * m.m[0][0] + bounds.center.y * m.m[1][0] + bounds.center.z * m.m[2][0] + m.m[3][0];
+		output.centerY[i] = bounds.center.x * m.m[0][1] + bounds.center.y * m.m[1][1] + bounds.center.z * m.m[2][1] + m.m[3][1];
+		output.centerZ[i] = bounds.center.x * m.m[0][2] + bounds.center.y * m.m[1][2] + bounds.center.z * m.m[2][2] + m.m[3][2];
+
+		output.extentX[i] = bounds.extent.x * fabsf(m.m[0][0]) + bounds.extent.y * fabsf(m.m[1][0]) + bounds.extent.z * fabsf(m.m[2][0]);
+		output.extentY[i] = bounds.extent.x * fabsf(m.m[0][1]) + bounds.extent.y * fabsf(m.m[1][1]) + bounds.extent.z * fabsf(m.m[2][1]);
+		output.extentZ[i] = bounds.extent.x * fabsf(m.m[0][2]) + bounds.extent.y * fabsf(m.m[1][2]) + bounds.extent.z * fabsf(m.m[2][2]);
+
+		scale = std::max(std::max(m.m[0][0] * m.m[0][0] + m.m[0][1] * m.m[0][1] + m.m[0][2] * m.m[0][2],
+								  m.m[1][0] * m.m[1][0] + m.m[1][1] * m.m[1][1] + m.m[1][2] * m.m[1][2]),
+						 m.m[2][0] * m.m[2][0] + m.m[2][1] * m.m[2][1] + m.m[2][2] * m.m[2][2]);
+		output.radius[i] = bounds.radius * sqrtf(scale);
+	}
+}
+
+SimdLevel GetFrustumSimdLevel()
+{
+	return g_frustumLevel;
+}
+
+/*
+ *	SetFrustumSimdLevel()
+ *	brief: Forces the kernel of a narrower instruction set, to compare them. It must not be called while rendering.
+ *	return: False if the CPU doesn't support that instruction set.
+ */
+bool SetFrustumSimdLevel(SimdLevel level)
+{
+	if (level > g_supportedLevel)
+	{
+		return false;
+	}
+
+	g_frustumLevel = level;
+	g_cull = SelectCull(level);
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef FRUSTUM_CLASS
+#define FRUSTUM_CLASS
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "SimdSupport.h"
+#include <DirectXMath.h>
+using namespace DirectX;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*	Bounds of a model in object space: a box, and the sphere around the same center that holds every vertex.
+	Whichever of the two is tighter along a plane decides the test against it.									*/
+struct BoundingVolume
+{
+	XMFLOAT3 center;
+	XMFLOAT3 extent;		//Half the size of the box along each axis.
+	float	 radius;
+};
+
+//Bounds of many objects in world space, as a structure of arrays so SIMD lanes hold consecutive objects.
+struct BoundsStream
+{
+	float* centerX;
+	float* centerY;
+	float* centerZ;
+	float* extentX;
+	float* extentY;
+	float* extentZ;
+	float* radius;
+};
+
+/*
+ *	FrustumClass
+ *	brief: The six planes of the view volume of a frame, to skip the objects that can't be seen before drawing
+ *		   them. The bounds are tested four or eight at a time with the widest instruction set of the CPU.
+ */
+class FrustumClass
+{
+public:
+	FrustumClass();
+	FrustumClass(const FrustumClass&);
+	~FrustumClass();
+
+	void ConstructFrustum(const XMMATRIX& viewMatrix, const XMMATRIX& projectionMatrix);
+
+	bool CheckBoundingVolume(const BoundingVolume& bounds, const XMMATRIX& worldMatrix);
+	unsigned int CullBounds(const BoundsStream& bounds, unsigned int count, unsigned char* visible);
+
+	void GetPlanes(XMFLOAT4* planes);
+	void AddCullingStatistics(unsigned int visibleCount, unsigned int culledCount);
+	void GetCullingStatistics(unsigned int& visibleCount, unsigned int& culledCount);
+
+private:
+	XMFLOAT4	 m_planes[6];		//Normalized, pointing inside. Left, right, bottom, top, near and far.
+	unsigned int m_visibleCount;	//Objects tested since ConstructFrustum().
+	unsigned int m_culledCount;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+void ComputeBoundingVolume(const void* vertices, unsigned int vertexCount, unsigned int vertexSize, BoundingVolume& bounds);
+void TransformBoundingVolumes(const BoundingVolume& bounds, const XMFLOAT4X4* worldMatrices, unsigned int count,
+							  const BoundsStream& output);
+
+SimdLevel GetFrustumSimdLevel();
+bool SetFrustumSimdLevel(SimdLevel level);
+
+#endif
@@ -1,4 +1,9 @@
 #include "GraphicsClass.h"
+#include "SoftwareRenderer.h"
+#include <cstring>
+#ifdef _WIN32
+#include "D3DClass.h"
+#endif
 
 GraphicsClass::GraphicsClass()
 {
@@ -6,6 +11,21 @@ GraphicsClass::GraphicsClass()
 	m_Camera = nullptr;
 	m_Model = nullptr;
 	m_ColorShader = nullptr;
+	m_Frustum = nullptr;
+	m_Hierarchy = nullptr;
+	m_visibleObjects = nullptr;
+	m_JobSystem = nullptr;
+	m_SceneGraph = nullptr;
+	m_modelNode = SCENE_NO_PARENT;
+	m_RenderQueue = nullptr;
+	m_Pipeline = nullptr;
+	m_FrameAllocator = nullptr;
+	m_ScratchAllocator = nullptr;
+	m_Profiler = nullptr;
+	m_deviceTrack = PROFILER_MAX_TRACKS;
+	m_visibleCount = 0;
+	m_culledCount = 0;
+	memset(&m_renderStatistics, 0, sizeof(m_renderStatistics));
 }
 
 GraphicsClass::GraphicsClass(const GraphicsClass &)
@@ -17,18 +37,56 @@ GraphicsClass::~GraphicsClass()
 {
 }
 
-bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
+/*
+ *	Initialize()
+ *	brief: Creates the render device and the objects of the scene.
+ *	param screenWidth: The width of the image to render.
+ *	param screenHeight: The height of the image to render.
+ *	param hwnd: The window to present to. The software backend doesn't need one.
+ *	param backend: Whether to render with Direct3D on the video card or with the CPU.
+ *	param modelFilename: OBJ or PLY file of the model to draw, or null for the built in triangle.
+ */
+bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd, RenderBackend backend, const char* modelFilename)
 {
+	BoundingVolume bounds;
+	float objectBounds[7];
+	BoundsStream stream = { &objectBounds[0], &objectBounds[1], &objectBounds[2], &objectBounds[3], &objectBounds[4],
+							&objectBounds[5], &objectBounds[6] };
+	unsigned int root;
 	bool bResult;
 
-	//Create the Direct3D object.
-	m_Direct3D = new D3DClass();
+	//Start the profiler first, so the zones of everything after are recorded.
+	m_Profiler = new ProfilerClass();
+	if (!m_Profiler)
+	{
+		return false;
+	}
+
+	bResult = m_Profiler->Initialize();
+	if (!bResult)
+	{
+		return false;
+	}
+
+	//Create the render device object.
+	if (backend == RENDER_BACKEND_SOFTWARE)
+	{
+		m_Direct3D = new SoftwareRendererClass();
+	}
+	else
+	{
+#ifdef _WIN32
+		m_Direct3D = new D3DClass();
+#else
+		m_Direct3D = nullptr;
+#endif
+	}
 	if (!m_Direct3D)
 	{
 		return false;
 	}
 
-	//Initialize the Direct3D object.
+	//Initialize the render device object.
 	bResult = m_Direct3D->Initialize(screenWidth, screenHeight, VSYNC_ENABLED, hwnd, FULL_SCREEN, SCREEN_DEPTH, SCREEN_NEAR);
 
 	if (!bResult)
@@ -37,6 +95,9 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 		return false;
 	}
 
+	//The passes the device renders get a row of their own in the profile, next to the threads.
+	m_deviceTrack = m_Profiler->AddTrack(backend == RENDER_BACKEND_SOFTWARE ? "software device" : "video card");
+
 	//Create the camera object.
 	m_Camera = new CameraClass();
 	if(!m_Camera)
@@ -47,6 +108,19 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 	//Set the initial position of the camera
 	m_Camera->SetPosition(0.0f, 0.0f, -5.0f);
 
+	//Create the scratch memory the loads stage their data in.
+	m_ScratchAllocator = new LinearAllocatorClass();
+	if (!m_ScratchAllocator)
+	{
+		return false;
+	}
+
+	bResult = m_ScratchAllocator->Initialize(SCRATCH_ALLOCATOR_SIZE);
+	if (!bResult)
+	{
+		return false;
+	}
+
 	//Create the model object.
 	m_Model = new ModelClass();
 	if (!m_Model)
@@ -55,7 +129,7 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 	}
 
 	//Initialize the model object.
-	bResult = m_Model->Initialize(m_Direct3D->GetDevice());
+	bResult = m_Model->Initialize(m_Direct3D, modelFilename, MODEL_VERTEX_FORMAT, m_ScratchAllocator);
 	if (!bResult)
 	{
 		MessageBox(hwnd, L"Could not initialize the model object.", L"Error", MB_OK);
@@ -70,18 +144,171 @@ bool GraphicsClass::Initialize(int screenWidth, int screenHeight, HWND hwnd)
 	}
 
 	//Initialize the color shader object.
-	bResult = m_ColorShader->Initialize(m_Direct3D->GetDevice(), hwnd);
+	bResult = m_ColorShader->Initialize(m_Direct3D);
 	if (!bResult)
 	{
 		MessageBox(hwnd, L"Could not initialize the color shader object.", L"Error", MB_OK);
 		return false;
 	}
 
+	//Create the frustum object.
+	m_Frustum = new FrustumClass();
+	if (!m_Frustum)
+	{
+		return false;
+	}
+
+	//Create the job system that runs the frame and splits the scene update and the recording of the draws. Besides
+	//this thread, the simulation and render threads of the pipeline use it.
+	m_JobSystem = new JobSystemClass();
+	if (!m_JobSystem)
+	{
+		return false;
+	}
+
+	bResult = m_JobSystem->Initialize(0, FRAME_PIPELINE_THREADS);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	//Create the memory of the frames, with a part for every thread of the job system.
+	m_FrameAllocator = new FrameAllocatorClass();
+	if (!m_FrameAllocator)
+	{
+		return false;
+	}
+
+	bResult = m_FrameAllocator->Initialize(m_JobSystem->GetThreadCount(), FRAME_ALLOCATOR_SIZE);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	//Create the scene graph, with the model under a root node that places the whole scene.
+	m_SceneGraph = new SceneGraphClass();
+	if (!m_SceneGraph)
+	{
+		return false;
+	}
+
+	bResult = m_SceneGraph->Initialize(m_JobSystem);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	root = m_SceneGraph->AddNode(SCENE_NO_PARENT);
+	m_modelNode = m_SceneGraph->AddNode(root);
+	m_SceneGraph->Update();
+
+	//Create the render queue object.
+	m_RenderQueue = new RenderQueueClass();
+	if (!m_RenderQueue)
+	{
+		return false;
+	}
+
+	bResult = m_RenderQueue->Initialize(m_Direct3D, m_JobSystem);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	//Create the hierarchy over the objects of the scene, for now the model.
+	m_Hierarchy = new BVHClass();
+	m_visibleObjects = new unsigned int[1];
+	if (!m_Hierarchy || !m_visibleObjects)
+	{
+		return false;
+	}
+
+	m_Model->GetBoundingVolume(bounds);
+	TransformBoundingVolumes(bounds, &m_SceneGraph->GetWorldMatrix(m_modelNode), 1, stream);
+
+	bResult = m_Hierarchy->Build(stream, 1);
+	if (!bResult)
+	{
+		MessageBox(hwnd, L"Could not build the bounding volume hierarchy.", L"Error", MB_OK);
+		return false;
+	}
+
+	//Create the pipeline that splits every frame in its simulation and its render.
+	m_Pipeline = new FramePipelineClass();
+	if (!m_Pipeline)
+	{
+		return false;
+	}
+
+	bResult = m_Pipeline->Initialize(m_JobSystem, [this](FrameSnapshot& snapshot) { return Simulate(snapshot); },
+									 [this](const FrameSnapshot& snapshot) { return Render(snapshot); });
+	if (!bResult)
+	{
+		return false;
+	}
+
 	return true;
 }
 
 void GraphicsClass::Shutdown()
 {
+	// Stop the frames and release the pipeline before anything they use.
+	if (m_Pipeline)
+	{
+		m_Pipeline->Shutdown();
+		delete m_Pipeline;
+		m_Pipeline = nullptr;
+	}
+
+	// Release the render queue object.
+	if (m_RenderQueue)
+	{
+		m_RenderQueue->Shutdown();
+		delete m_RenderQueue;
+		m_RenderQueue = nullptr;
+	}
+
+	// Release the bounding volume hierarchy.
+	if (m_Hierarchy)
+	{
+		m_Hierarchy->Shutdown();
+		delete m_Hierarchy;
+		m_Hierarchy = nullptr;
+	}
+	delete[] m_visibleObjects;
+	m_visibleObjects = nullptr;
+
+	// Release the scene graph.
+	if (m_SceneGraph)
+	{
+		m_SceneGraph->Shutdown();
+		delete m_SceneGraph;
+		m_SceneGraph = nullptr;
+	}
+
+	// Release the memory of the frames.
+	if (m_FrameAllocator)
+	{
+		m_FrameAllocator->Shutdown();
+		delete m_FrameAllocator;
+		m_FrameAllocator = nullptr;
+	}
+
+	// Release the job system.
+	if (m_JobSystem)
+	{
+		m_JobSystem->Shutdown();
+		delete m_JobSystem;
+		m_JobSystem = nullptr;
+	}
+
+	// Release the frustum object.
+	if (m_Frustum)
+	{
+		delete m_Frustum;
+		m_Frustum = nullptr;
+	}
+
 	// Release the color shader object.
 	if (m_ColorShader)
 	{
@@ -98,6 +325,14 @@ void GraphicsClass::Shutdown()
 		m_Model = nullptr;
 	}
 
+	// Release the scratch memory.
+	if (m_ScratchAllocator)
+	{
+		m_ScratchAllocator->Shutdown();
+		delete m_ScratchAllocator;
+		m_ScratchAllocator = nullptr;
+	}
+
 	// Release the camera object.
 	if (m_Camera)
 	{
@@ -105,60 +340,305 @@ void GraphicsClass::Shutdown()
 		m_Camera = nullptr;
 	}
 
-	//Release Direct3D object.
+	//Release the render device object.
 	if (m_Direct3D)
 	{
+		m_Direct3D->Shutdown();
 		delete m_Direct3D;
 		m_Direct3D = nullptr;
 	}
+
+	//Release the profiler object last, nothing records zones anymore.
+	if (m_Profiler)
+	{
+		m_Profiler->Shutdown();
+		delete m_Profiler;
+		m_Profiler = nullptr;
+	}
 }
 
+/*
+ *	Frame()
+ *	brief: Simulates and renders a frame on the calling thread. With the pipeline started its threads make the
+ *		   frames instead, and this only checks that they haven't failed.
+ */
 bool GraphicsClass::Frame()
 {
-	bool bResult;
-	
-	//Render the graphics scene
-	bResult = Render();
-	if(!bResult)
+	if (m_Pipeline->IsRunning())
+	{
+		return !m_Pipeline->HasFailed();
+	}
+
+	return m_Pipeline->RunFrame();
+}
+
+/*
+ *	StartPipeline()
+ *	brief: Moves the frames to a simulation thread and a render thread, so the next frame is simulated while the
+ *		   last one renders and the calling thread is free for the window. Frame() no longer makes them.
+ */
+bool GraphicsClass::StartPipeline()
+{
+	return m_Pipeline->Start();
+}
+
+//Waits for the pipeline threads to stop, after which Frame() makes the frames again.
+void GraphicsClass::StopPipeline()
+{
+	m_Pipeline->Stop();
+
+	//The frame dropped by stopping was never ended.
+	m_FrameAllocator->Reset();
+}
+
+//Moves the camera, rotation in degrees. Only between frames made by Frame(), the pipeline threads read the camera.
+void GraphicsClass::SetCamera(const XMFLOAT3& position, const XMFLOAT3& rotation)
+{
+	m_Camera->SetPosition(position.x, position.y, position.z);
+	m_Camera->SetRotation(rotation.x, rotation.y, rotation.z);
+}
+
+//The device the scene is drawn with, to render it into a target of its own instead of the screen.
+RenderDevice* GraphicsClass::GetRenderDevice()
+{
+	return m_Direct3D;
+}
+
+//The profiler of the frames, to read the times of its zones or write them out.
+ProfilerClass* GraphicsClass::GetProfiler()
+{
+	return m_Profiler;
+}
+
+//Models drawn and skipped by frustum culling in the last frame rendered.
+void GraphicsClass::GetCullingStatistics(unsigned int& visibleCount, unsigned int& culledCount)
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+
+	visibleCount = m_visibleCount;
+	culledCount = m_culledCount;
+}
+
+//Draws and pipeline state changes of the last frame rendered, with and without sorting the draws.
+void GraphicsClass::GetRenderStatistics(RenderQueueStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+
+	statistics = m_renderStatistics;
+}
+
+//Latency and throughput of the frames since the pipeline started, or since it was created if it never did.
+void GraphicsClass::GetPipelineStatistics(FramePipelineStatistics& statistics)
+{
+	m_Pipeline->GetStatistics(statistics);
+}
+
+//Use of the memory of the frames, by the last frame rendered, and of the scratch memory of the loads.
+void GraphicsClass::GetMemoryStatistics(AllocatorStatistics& frameStatistics, AllocatorStatistics& scratchStatistics)
+{
+	m_FrameAllocator->GetStatistics(frameStatistics);
+	m_ScratchAllocator->GetStatistics(scratchStatistics);
+}
+
+/*
+ *	Simulate()
+ *	brief: Makes the snapshot of a frame as jobs. Moving the objects and building the view of the camera don't
+ *		   depend on each other; culling and queueing the visible objects need both.
+ */
+bool GraphicsClass::Simulate(FrameSnapshot& snapshot)
+{
+	Job *updateJob, *viewJob, *queueJob;
+	bool bUpdated = false;
+
+	PROFILE_ZONE("GraphicsClass::Simulate");
+
+	updateJob = m_JobSystem->CreateJob([this, &bUpdated](unsigned int /*threadIndex*/) { bUpdated = UpdateScene(); }, nullptr);
+	viewJob = m_JobSystem->CreateJob([this, &snapshot](unsigned int /*threadIndex*/) { UpdateView(snapshot); }, nullptr);
+	queueJob = m_JobSystem->CreateJob([this, &snapshot](unsigned int threadIndex) { QueueVisibleObjects(snapshot, threadIndex); }, nullptr);
+	if (!updateJob || !viewJob || !queueJob)
 	{
 		return false;
 	}
-	return true;
+
+	m_JobSystem->AddDependency(queueJob, updateJob);
+	m_JobSystem->AddDependency(queueJob, viewJob);
+	m_JobSystem->Submit(queueJob);
+	m_JobSystem->Submit(viewJob);
+	m_JobSystem->Submit(updateJob);
+	m_JobSystem->Wait(queueJob);
+
+	//The draws are null if the memory of the frame ran out.
+	return bUpdated && snapshot.draws != nullptr;
 }
 
-bool GraphicsClass::Render()
+/*
+ *	UpdateScene()
+ *	brief: Brings the world matrices of the scene graph up to date, and fits the hierarchy to the objects that moved.
+ *		   When nothing has changed it does no work.
+ */
+bool GraphicsClass::UpdateScene()
 {
-	XMMATRIX worldMatrix, viewMatrix, projectionMatrix;
-	bool bResult;
+	BoundingVolume bounds;
+	float objectBounds[7];
+	BoundsStream stream = { &objectBounds[0], &objectBounds[1], &objectBounds[2], &objectBounds[3], &objectBounds[4],
+							&objectBounds[5], &objectBounds[6] };
 
-	//Clear buffers to begin the scene.
-	m_Direct3D->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+	if (m_SceneGraph->Update() == 0)
+	{
+		return true;
+	}
+
+	m_Model->GetBoundingVolume(bounds);
+	TransformBoundingVolumes(bounds, &m_SceneGraph->GetWorldMatrix(m_modelNode), 1, stream);
+	m_Hierarchy->Refit(stream);
+
+	return true;
+}
+
+//Builds the view of the camera for the frame and the frustum to skip the models out of it.
+void GraphicsClass::UpdateView(FrameSnapshot& snapshot)
+{
+	XMMATRIX viewMatrix, projectionMatrix;
 
 	//Generate the view matrix based in the camera's position.
 	m_Camera->Render();
 
-	//Get the world, view and projection matrices from the camera and the d3d objects.
-	m_Direct3D->GetWorldMatrix(worldMatrix);
+	//Get the view and projection matrices from the camera and the d3d objects.
 	m_Camera->GetViewMatrix(viewMatrix);
 	m_Direct3D->GetProjectionMatrix(projectionMatrix);
 
-	//Put the model vertex and index buffers on the graphics pipeline to prepare them for drawing.
-	m_Model->Render(m_Direct3D->GetDeviceContext());
+	//The view and projection are the same for every object, so they are multiplied once per frame and each object
+	//only adds its world matrix to them.
+	snapshot.cameraPosition = m_Camera->GetPosition();
+	XMStoreFloat4x4(&snapshot.viewMatrix, viewMatrix);
+	XMStoreFloat4x4(&snapshot.viewProjectionMatrix, XMMatrixMultiply(viewMatrix, projectionMatrix));
+
+	//Build the view frustum of the frame to skip the models out of the view.
+	m_Frustum->ConstructFrustum(viewMatrix, projectionMatrix);
+}
+
+/*
+ *	QueueVisibleObjects()
+ *	brief: Adds to the snapshot the draws of the objects the hierarchy finds in the view, in the memory of the frame.
+ *		   If the memory of the frame runs out the draws are left null.
+ *	param threadIndex: The thread of the job system it runs on.
+ */
+void GraphicsClass::QueueVisibleObjects(FrameSnapshot& snapshot, unsigned int threadIndex)
+{
+	XMMATRIX positionMatrix, worldMatrix;
+	XMFLOAT4X4 worldView;
+	BoundingVolume bounds;
+	FrameDraw draw;
+	unsigned int visibleCount;
+
+	//Get the world matrix from the scene graph.
+	m_SceneGraph->GetWorldMatrix(m_modelNode, worldMatrix);
+
+	//Packed vertices are taken back to object space by the position matrix of the model, before the world matrix.
+	m_Model->GetPositionMatrix(positionMatrix);
+	XMStoreFloat4x4(&draw.worldViewProjection, XMMatrixMultiply(XMMatrixMultiply(positionMatrix, worldMatrix),
+																XMLoadFloat4x4(&snapshot.viewProjectionMatrix)));
+
+	//The view depth of the center of the model orders the draws that share state.
+	XMStoreFloat4x4(&worldView, XMMatrixMultiply(worldMatrix, XMLoadFloat4x4(&snapshot.viewMatrix)));
+	m_Model->GetBoundingVolume(bounds);
+	draw.depth = bounds.center.x * worldView.m[0][2] + bounds.center.y * worldView.m[1][2] +
+				 bounds.center.z * worldView.m[2][2] + worldView.m[3][2];
+
+	draw.pass = RENDER_PASS_OPAQUE;
+	draw.shader = m_ColorShader;
+	draw.model = m_Model;
+
+	visibleCount = m_Hierarchy->Cull(m_Frustum, m_visibleObjects);
+	m_Frustum->GetCullingStatistics(snapshot.visibleCount, snapshot.culledCount);
+
+	snapshot.drawCount = 0;
+	snapshot.draws = (FrameDraw*)m_FrameAllocator->Allocate(snapshot.frame, threadIndex, sizeof(FrameDraw) * visibleCount,
+															 alignof(FrameDraw));
+	if (!snapshot.draws)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < visibleCount; i++)
+	{
+		snapshot.draws[i] = draw;
+	}
+	snapshot.drawCount = visibleCount;
+}
+
+/*
+ *	Render()
+ *	brief: Draws the snapshot of a frame. It only reads the snapshot and the objects that don't change, so it can
+ *		   run while the next frame is simulated.
+ */
+bool GraphicsClass::Render(const FrameSnapshot& snapshot)
+{
+	bool bResult;
+
+	PROFILE_ZONE("GraphicsClass::Render");
+
+	//Queue the draws of the frame to sort them by state.
+	m_RenderQueue->Begin();
+	for (unsigned int i = 0; i < snapshot.drawCount; i++)
+	{
+		const FrameDraw& draw = snapshot.draws[i];
+
+		m_RenderQueue->AddDraw(draw.pass, draw.shader, draw.model, XMLoadFloat4x4(&draw.worldViewProjection), draw.depth);
+	}
 
-	//Render the object using the color shader.
-	bResult = m_ColorShader->Render(m_Direct3D->GetDeviceContext(),
-									m_Model->GetIndexCount(),
-									worldMatrix,
-									viewMatrix,
-									projectionMatrix);
+	//Clear buffers to begin the scene.
+	m_Direct3D->BeginScene(0.0f, 0.0f, 0.0f, 1.0f);
+
+	//Render the queued objects using the color shader, sorted by state.
+	m_Direct3D->BeginPass("Scene pass");
+	bResult = m_RenderQueue->Submit();
 	if (!bResult)
 	{
 		return false;
 	}
+	m_Direct3D->EndPass();
 
 	//Present the renderer scene to the screen.
 	m_Direct3D->EndScene();
+	RecordDevicePasses();
+
+	//Nothing uses the memory of the frame anymore, so it goes to the one after the next.
+	m_FrameAllocator->EndFrame(snapshot.frame);
+	m_Profiler->EndFrame();
+
+	std::lock_guard<std::mutex> lock(m_statisticsMutex);
+	m_visibleCount = snapshot.visibleCount;
+	m_culledCount = snapshot.culledCount;
+	m_RenderQueue->GetStatistics(m_renderStatistics);
 
-	
 	return true;
 }
+
+/*
+ *	RecordDevicePasses()
+ *	brief: Puts the passes the device finished into the track of the device in the profiler, with what the device
+ *		   counted in each. The video card finishes them a few frames late, so they don't line up with the zones of
+ *		   the frame that is ending.
+ */
+void GraphicsClass::RecordDevicePasses()
+{
+	RenderPassStatistics statistics;
+	ProfileCounter counters[5];
+
+	while (m_Direct3D->GetPassStatistics(statistics))
+	{
+		if (!statistics.timed)
+		{
+			continue;
+		}
+
+		counters[0] = ProfileCounter{ "vertices shaded", statistics.verticesShaded };
+		counters[1] = ProfileCounter{ "triangles in", statistics.trianglesIn };
+		counters[2] = ProfileCounter{ "triangles out", statistics.trianglesOut };
+		counters[3] = ProfileCounter{ "pixels shaded", statistics.pixelsShaded };
+		counters[4] = ProfileCounter{ "tiles touched", statistics.tilesTouched };
+		m_Profiler->RecordTrackZone(m_deviceTrack, RegisterProfileZone(statistics.name), statistics.start,
+									statistics.end, counters, 5);
+	}
+}
@@ -23,11 +23,37 @@ const float SCREEN_NEAR = 0.1f;
 /************************************************************************/
 /* INCLUDES                                                             */
 /************************************************************************/
-#include <windows.h>
-#include "D3DClass.h"
+#include "Platform.h"
+#include "Allocators.h"
+#include "RenderDevice.h"
 #include "CameraClass.h"
+#include "FrustumClass.h"
+#include "BVHClass.h"
+#include "SceneGraph.h"
+#include "JobSystem.h"
 #include "ModelClass.h"
 #include "ColorShader.h"
+#include "RenderQueue.h"
+#include "FramePipeline.h"
+#include "Profiler.h"
+#include <mutex>
+
+//Which device renders the scene. The software one runs on machines without a video card or a window.
+const RenderBackend RENDER_BACKEND = RENDER_BACKEND_HARDWARE;
+
+//Whether the frames are simulated and rendered on threads of their own, overlapping the simulation of a frame with
+//the render of the previous one, instead of one after the other on the thread of the window.
+const bool FRAME_PIPELINING = true;
+
+//OBJ or PLY file of the model to draw. Without one the built in triangle is drawn.
+const char* const MODEL_FILENAME = nullptr;
+
+//Layout of the vertices of the model. The packed one saves memory bandwidth, at the cost of rounding the positions.
+const VertexFormat MODEL_VERTEX_FORMAT = VERTEX_FORMAT_FULL;
+
+//Bytes the data of a frame can take, and bytes a load can stage at once.
+const size_t FRAME_ALLOCATOR_SIZE = 4 * 1024 * 1024;
+const size_t SCRATCH_ALLOCATOR_SIZE = 16 * 1024 * 1024;
 
 class GraphicsClass
 {
@@ -36,18 +62,52 @@ public:
 	GraphicsClass(const GraphicsClass&);
 	~GraphicsClass();
 
-	bool Initialize(int screenWidth, int screenHeight, HWND hwnd);
+	bool Initialize(int screenWidth, int screenHeight, HWND hwnd, RenderBackend backend, const char* modelFilename);
 	void Shutdown();
 	bool Frame();
+	bool StartPipeline();
+	void StopPipeline();
+
+	void SetCamera(const XMFLOAT3& position, const XMFLOAT3& rotation);
+	RenderDevice* GetRenderDevice();
+	ProfilerClass* GetProfiler();
+
+	void GetCullingStatistics(unsigned int& visibleCount, unsigned int& culledCount);
+	void GetRenderStatistics(RenderQueueStatistics& statistics);
+	void GetPipelineStatistics(FramePipelineStatistics& statistics);
+	void GetMemoryStatistics(AllocatorStatistics& frameStatistics, AllocatorStatistics& scratchStatistics);
 
 private:
-	bool Render();
+	bool Simulate(FrameSnapshot& snapshot);
+	bool UpdateScene();
+	void UpdateView(FrameSnapshot& snapshot);
+	void QueueVisibleObjects(FrameSnapshot& snapshot, unsigned int threadIndex);
+	bool Render(const FrameSnapshot& snapshot);
+	void RecordDevicePasses();
 
 private:
-	D3DClass* m_Direct3D;
+	RenderDevice* m_Direct3D;
 	CameraClass* m_Camera;
 	ModelClass* m_Model;
 	ColorShader* m_ColorShader;
+	FrustumClass* m_Frustum;
+	BVHClass* m_Hierarchy;
+	unsigned int* m_visibleObjects;		//Objects found by culling the hierarchy in the current frame.
+	JobSystemClass* m_JobSystem;
+	SceneGraphClass* m_SceneGraph;
+	unsigned int m_modelNode;			//Scene node the model is drawn at.
+	RenderQueueClass* m_RenderQueue;
+	FramePipelineClass* m_Pipeline;
+	FrameAllocatorClass* m_FrameAllocator;		//The data of the frames, so they don't touch the heap.
+	LinearAllocatorClass* m_ScratchAllocator;	//The data that loads only need until they are done.
+	ProfilerClass* m_Profiler;					//The zones of the frames, ended with every frame rendered.
+	unsigned int m_deviceTrack;					//Row of the profiler the passes of the render device go in.
+
+	//Of the last frame rendered, which can be on another thread.
+	std::mutex m_statisticsMutex;
+	unsigned int m_visibleCount;
+	unsigned int m_culledCount;
+	RenderQueueStatistics m_renderStatistics;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,825 @@
+#include "ImageCompression.h"
+#include <algorithm>
+#include <cstring>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned int DEFLATE_MIN_MATCH = 3;
+static const unsigned int DEFLATE_MAX_MATCH = 258;
+static const unsigned int DEFLATE_LITERAL_CODES = 286;
+static const unsigned int DEFLATE_DISTANCE_CODES = 30;
+static const unsigned int DEFLATE_LENGTH_CODES = 19;		//Of the code lengths of the other two tables.
+static const unsigned int DEFLATE_MAX_BITS = 15;
+static const unsigned int DEFLATE_MAX_LENGTH_BITS = 7;
+static const unsigned int DEFLATE_END_OF_BLOCK = 256;
+static const unsigned int DEFLATE_STORED_SIZE = 65535;		//The most a stored block holds.
+
+static const unsigned short DEFLATE_LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43,
+														51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned char DEFLATE_LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4,
+														4, 4, 5, 5, 5, 5, 0 };
+static const unsigned short DEFLATE_DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257,
+														  385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+														  12289, 16385, 24577 };
+static const unsigned char DEFLATE_DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9,
+														  9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+//Order the code lengths of the code length code are sent in.
+static const unsigned char DEFLATE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static const unsigned int LZ4_MIN_MATCH = 4;
+static const unsigned int LZ4_LAST_LITERALS = 5;		//A block ends with at least these many literals...
+static const unsigned int LZ4_MATCH_LIMIT = 12;			//...and its last match starts at least these many bytes before the end.
+static const unsigned int LZ4_MAX_DISTANCE = 65535;
+
+static const unsigned int XXH32_PRIME1 = 2654435761u;
+static const unsigned int XXH32_PRIME2 = 2246822519u;
+static const unsigned int XXH32_PRIME3 = 3266489917u;
+static const unsigned int XXH32_PRIME4 = 668265263u;
+static const unsigned int XXH32_PRIME5 = 374761393u;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//The symbol of every match length and distance, built the first time a block is written.
+struct DeflateSymbolTables
+{
+	unsigned char lengthSymbol[DEFLATE_MAX_MATCH + 1];		//Minus 257.
+	unsigned char distanceSymbol[512];						//Of distances up to 256, then of (distance - 1) >> 7.
+
+	DeflateSymbolTables()
+	{
+		for (unsigned int symbol = 0; symbol < 29; symbol++)
+		{
+			for (unsigned int length = DEFLATE_LENGTH_BASE[symbol];
+				 length < DEFLATE_LENGTH_BASE[symbol] + (1u << DEFLATE_LENGTH_EXTRA[symbol]) && length <= DEFLATE_MAX_MATCH; length++)
+			{
+				lengthSymbol[length] = (unsigned char)symbol;
+			}
+		}
+		//258 has a code of its own, not the last of the one before.
+		lengthSymbol[DEFLATE_MAX_MATCH] = 28;
+
+		for (unsigned int symbol = 0; symbol < DEFLATE_DISTANCE_CODES; symbol++)
+		{
+			for (unsigned int distance = DEFLATE_DISTANCE_BASE[symbol];
+				 distance < DEFLATE_DISTANCE_BASE[symbol] + (1u << DEFLATE_DISTANCE_EXTRA[symbol]); distance++)
+			{
+				if (distance <= 256)
+				{
+					distanceSymbol[distance - 1] = (unsigned char)symbol;
+				}
+				else
+				{
+					distanceSymbol[256 + ((distance - 1) >> 7)] = (unsigned char)symbol;
+				}
+			}
+		}
+	}
+
+	unsigned int GetDistanceSymbol(unsigned int distance) const
+	{
+		return distance <= 256 ? distanceSymbol[distance - 1] : distanceSymbol[256 + ((distance - 1) >> 7)];
+	}
+};
+
+//The CRC of every byte value, built the first time a CRC is taken.
+struct Crc32Table
+{
+	unsigned int values[256];
+
+	Crc32Table()
+	{
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			unsigned int value = i;
+			for (int bit = 0; bit < 8; bit++)
+			{
+				value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+			}
+			values[i] = value;
+		}
+	}
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+static const DeflateSymbolTables& GetDeflateSymbolTables()
+{
+	static const DeflateSymbolTables tables;
+
+	return tables;
+}
+
+static unsigned int HashDeflate(const unsigned char* data)
+{
+	return (((unsigned int)data[0] << 16 | (unsigned int)data[1] << 8 | data[2]) * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+static unsigned int ReadUnaligned32(const unsigned char* data)
+{
+	unsigned int value;
+
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static unsigned int RotateLeft(unsigned int value, unsigned int count)
+{
+	return (value << count) | (value >> (32 - count));
+}
+
+/*
+ *	BuildCodeLengths()
+ *	brief: Makes the lengths of a Huffman code for the symbols used, none longer than maxBits. When the tree comes
+ *		   out deeper, the deepest leaves are moved up, taking the space from the shortest codes that can spare it,
+ *		   and the lengths are given again to the symbols from the least frequent.
+ */
+static void BuildCodeLengths(const unsigned int* frequencies, unsigned int count, unsigned int maxBits, unsigned char* lengths)
+{
+	unsigned int symbols[DEFLATE_LITERAL_CODES];
+	unsigned int weights[2 * DEFLATE_LITERAL_CODES];
+	unsigned int parents[2 * DEFLATE_LITERAL_CODES];
+	unsigned int depths[2 * DEFLATE_LITERAL_CODES];
+	unsigned int lengthCounts[2 * DEFLATE_LITERAL_CODES];
+	unsigned int used, leaf, node, next, total, child;
+
+	memset(lengths, 0, count);
+	used = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (frequencies[i])
+		{
+			symbols[used++] = i;
+		}
+	}
+	if (used == 0)
+	{
+		return;
+	}
+	if (used == 1)
+	{
+		lengths[symbols[0]] = 1;
+		return;
+	}
+
+	std::sort(symbols, symbols + used, [frequencies](unsigned int a, unsigned int b)
+	{
+		return frequencies[a] < frequencies[b] || (frequencies[a] == frequencies[b] && a < b);
+	});
+
+	//Leaves come sorted and inner nodes are made in order of weight, so the two lightest are always at the front
+	//of one of both queues.
+	for (unsigned int i = 0; i < used; i++)
+	{
+		weights[i] = frequencies[symbols[i]];
+	}
+	leaf = 0;
+	node = used;
+	for (next = used; next < 2 * used - 1; next++)
+	{
+		weights[next] = 0;
+		for (int pick = 0; pick < 2; pick++)
+		{
+			if (leaf < used && (node == next || weights[leaf] <= weights[node]))
+			{
+				child = leaf++;
+			}
+			else
+			{
+				child = node++;
+			}
+			weights[next] += weights[child];
+			parents[child] = next;
+		}
+	}
+
+	//The root is the last node made, and every node is made after its children.
+	memset(lengthCounts, 0, sizeof(lengthCounts));
+	depths[2 * used - 2] = 0;
+	for (int i = (int)(2 * used) - 3; i >= 0; i--)
+	{
+		depths[i] = depths[parents[i]] + 1;
+		if (i < (int)used)
+		{
+			lengthCounts[depths[i]]++;
+		}
+	}
+
+	for (unsigned int bits = maxBits + 1; bits < 2 * used; bits++)
+	{
+		lengthCounts[maxBits] += lengthCounts[bits];
+	}
+	total = 0;
+	for (unsigned int bits = 1; bits <= maxBits; bits++)
+	{
+		total += lengthCounts[bits] << (maxBits - bits);
+	}
+	while (total != (1u << maxBits))
+	{
+		lengthCounts[maxBits]--;
+		for (unsigned int bits = maxBits - 1; bits > 0; bits--)
+		{
+			if (lengthCounts[bits])
+			{
+				lengthCounts[bits]--;
+				lengthCounts[bits + 1] += 2;
+				break;
+			}
+		}
+		total--;
+	}
+
+	leaf = 0;
+	for (unsigned int bits = maxBits; bits > 0; bits--)
+	{
+		for (unsigned int i = 0; i < lengthCounts[bits]; i++)
+		{
+			lengths[symbols[leaf++]] = (unsigned char)bits;
+		}
+	}
+}
+
+//Makes the canonical codes of the lengths, with their bits reversed since deflate writes them from the first bit.
+static void BuildCodes(const unsigned char* lengths, unsigned int count, unsigned short* codes)
+{
+	unsigned int lengthCounts[DEFLATE_MAX_BITS + 1];
+	unsigned int nextCode[DEFLATE_MAX_BITS + 1];
+	unsigned int code, reversed;
+
+	memset(lengthCounts, 0, sizeof(lengthCounts));
+	for (unsigned int i = 0; i < count; i++)
+	{
+		lengthCounts[lengths[i]]++;
+	}
+	lengthCounts[0] = 0;
+
+	code = 0;
+	for (unsigned int bits = 1; bits <= DEFLATE_MAX_BITS; bits++)
+	{
+		code = (code + lengthCounts[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!lengths[i])
+		{
+			codes[i] = 0;
+			continue;
+		}
+
+		code = nextCode[lengths[i]]++;
+		reversed = 0;
+		for (unsigned int bit = 0; bit < lengths[i]; bit++)
+		{
+			reversed = (reversed << 1) | ((code >> bit) & 1);
+		}
+		codes[i] = (unsigned short)reversed;
+	}
+}
+
+DeflateEncoderClass::DeflateEncoderClass()
+{
+	m_output = nullptr;
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+}
+
+DeflateEncoderClass::DeflateEncoderClass(const DeflateEncoderClass&)
+{
+	m_output = nullptr;
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+}
+
+DeflateEncoderClass::~DeflateEncoderClass()
+{
+}
+
+/*
+ *	Compress()
+ *	brief: Compresses a piece of a deflate stream and adds it to the output.
+ *	param data: The piece to compress.
+ *	param dictionarySize: Bytes before data it can refer to, the end of the pieces before it. Only the last
+ *		   DEFLATE_WINDOW_SIZE are used.
+ *	param last: Ends the stream. Otherwise the piece ends with an empty stored block, byte aligned, for the next one
+ *		   to follow.
+ */
+void DeflateEncoderClass::Compress(const unsigned char* data, size_t size, size_t dictionarySize, bool last,
+								   std::vector<unsigned char>& output)
+{
+	const unsigned char* base;
+	size_t total, position, blockStart, insertEnd;
+	unsigned int hash, bestLength, bestDistance, maxLength, length, chain;
+	int candidate;
+
+	dictionarySize = std::min(dictionarySize, (size_t)DEFLATE_WINDOW_SIZE);
+	base = data - dictionarySize;
+	total = dictionarySize + size;
+
+	m_output = &output;
+	m_bitBuffer = 0;
+	m_bitCount = 0;
+	m_head.assign((size_t)1 << DEFLATE_HASH_BITS, -1);
+	m_previous.resize(DEFLATE_WINDOW_SIZE);
+	m_tokens.clear();
+	m_tokens.reserve(DEFLATE_BLOCK_TOKENS);
+
+	//Matches can't start before the end of a hash, 2 bytes before the end.
+	insertEnd = total >= DEFLATE_MIN_MATCH ? total - DEFLATE_MIN_MATCH + 1 : 0;
+	for (position = 0; position < dictionarySize && position < insertEnd; position++)
+	{
+		hash = HashDeflate(base + position);
+		m_previous[position & (DEFLATE_WINDOW_SIZE - 1)] = m_head[hash];
+		m_head[hash] = (int)position;
+	}
+
+	blockStart = dictionarySize;
+	position = dictionarySize;
+	while (position < total)
+	{
+		bestLength = 0;
+		bestDistance = 0;
+
+		if (position < insertEnd)
+		{
+			hash = HashDeflate(base + position);
+			maxLength = (unsigned int)std::min(total - position, (size_t)DEFLATE_MAX_MATCH);
+
+			//Walk the earlier positions of the hash from the closest, keeping the longest match.
+			candidate = m_head[hash];
+			for (chain = DEFLATE_MAX_CHAIN; candidate >= 0 && position - candidate <= DEFLATE_WINDOW_SIZE && chain > 0; chain--)
+			{
+				if (base[candidate + bestLength] == base[position + bestLength])
+				{
+					for (length = 0; length < maxLength && base[candidate + length] == base[position + length]; length++)
+					{
+					}
+					if (length > bestLength)
+					{
+						bestLength = length;
+						bestDistance = (unsigned int)(position - candidate);
+						if (length == maxLength)
+						{
+							break;
+						}
+					}
+				}
+				candidate = m_previous[candidate & (DEFLATE_WINDOW_SIZE - 1)];
+			}
+
+			m_previous[position & (DEFLATE_WINDOW_SIZE - 1)] = m_head[hash];
+			m_head[hash] = (int)position;
+		}
+
+		if (bestLength >= DEFLATE_MIN_MATCH)
+		{
+			m_tokens.push_back({ (unsigned short)bestLength, (unsigned short)bestDistance });
+
+			//The positions inside the match can start later matches too.
+			for (size_t inside = position + 1; inside < position + bestLength && inside < insertEnd; inside++)
+			{
+				hash = HashDeflate(base + inside);
+				m_previous[inside & (DEFLATE_WINDOW_SIZE - 1)] = m_head[hash];
+				m_head[hash] = (int)inside;
+			}
+			position += bestLength;
+		}
+		else
+		{
+			m_tokens.push_back({ base[position], 0 });
+			position++;
+		}
+
+		if (m_tokens.size() == DEFLATE_BLOCK_TOKENS)
+		{
+			WriteBlock(base + blockStart, position - blockStart, false);
+			m_tokens.clear();
+			blockStart = position;
+		}
+	}
+
+	if (!m_tokens.empty() || last)
+	{
+		WriteBlock(base + blockStart, total - blockStart, last);
+	}
+
+	if (!last)
+	{
+		//An empty stored block, which leaves the stream on a byte boundary.
+		WriteBits(0, 3);
+		AlignBits();
+		output.push_back(0x00);
+		output.push_back(0x00);
+		output.push_back(0xFF);
+		output.push_back(0xFF);
+	}
+	AlignBits();
+	m_output = nullptr;
+}
+
+void DeflateEncoderClass::WriteBits(unsigned int bits, unsigned int count)
+{
+	m_bitBuffer |= (unsigned long long)bits << m_bitCount;
+	m_bitCount += count;
+	while (m_bitCount >= 8)
+	{
+		m_output->push_back((unsigned char)m_bitBuffer);
+		m_bitBuffer >>= 8;
+		m_bitCount -= 8;
+	}
+}
+
+void DeflateEncoderClass::AlignBits()
+{
+	if (m_bitCount > 0)
+	{
+		m_output->push_back((unsigned char)m_bitBuffer);
+		m_bitBuffer = 0;
+		m_bitCount = 0;
+	}
+}
+
+/*
+ *	WriteBlock()
+ *	brief: Writes the tokens gathered as a block with Huffman tables made for them, or the bytes they stand for as
+ *		   stored blocks if that is smaller.
+ *	param data: The bytes the tokens stand for.
+ */
+void DeflateEncoderClass::WriteBlock(const unsigned char* data, size_t size, bool final)
+{
+	const DeflateSymbolTables& tables = GetDeflateSymbolTables();
+	unsigned int literalFrequencies[DEFLATE_LITERAL_CODES];
+	unsigned int distanceFrequencies[DEFLATE_DISTANCE_CODES];
+	unsigned int lengthFrequencies[DEFLATE_LENGTH_CODES];
+	unsigned char literalLengths[DEFLATE_LITERAL_CODES];
+	unsigned char distanceLengths[DEFLATE_DISTANCE_CODES];
+	unsigned char codeLengths[DEFLATE_LENGTH_CODES];
+	unsigned short literalCodes[DEFLATE_LITERAL_CODES];
+	unsigned short distanceCodes[DEFLATE_DISTANCE_CODES];
+	unsigned short lengthCodes[DEFLATE_LENGTH_CODES];
+	unsigned char lengths[DEFLATE_LITERAL_CODES + DEFLATE_DISTANCE_CODES];
+	unsigned short runs[DEFLATE_LITERAL_CODES + DEFLATE_DISTANCE_CODES];		//Code length symbol and its extra bits above.
+	unsigned int literalCount, distanceCount, lengthCount, runCount, symbol, run, count;
+	unsigned long long dynamicBits, storedBits;
+
+	memset(literalFrequencies, 0, sizeof(literalFrequencies));
+	memset(distanceFrequencies, 0, sizeof(distanceFrequencies));
+	for (const DeflateToken& token : m_tokens)
+	{
+		if (token.distance == 0)
+		{
+			literalFrequencies[token.lengthOrLiteral]++;
+		}
+		else
+		{
+			literalFrequencies[257 + tables.lengthSymbol[token.lengthOrLiteral]]++;
+			distanceFrequencies[tables.GetDistanceSymbol(token.distance)]++;
+		}
+	}
+	literalFrequencies[DEFLATE_END_OF_BLOCK] = 1;
+
+	BuildCodeLengths(literalFrequencies, DEFLATE_LITERAL_CODES, DEFLATE_MAX_BITS, literalLengths);
+	BuildCodeLengths(distanceFrequencies, DEFLATE_DISTANCE_CODES, DEFLATE_MAX_BITS, distanceLengths);
+
+	//A block without matches still sends one distance code.
+	for (distanceCount = DEFLATE_DISTANCE_CODES; distanceCount > 1 && !distanceLengths[distanceCount - 1]; distanceCount--)
+	{
+	}
+	if (!distanceLengths[0] && distanceCount == 1)
+	{
+		distanceLengths[0] = 1;
+	}
+	for (literalCount = DEFLATE_LITERAL_CODES; !literalLengths[literalCount - 1]; literalCount--)
+	{
+	}
+
+	//Both tables of lengths go as one sequence, with the runs of repeated lengths and of zeros shortened.
+	memcpy(lengths, literalLengths, literalCount);
+	memcpy(lengths + literalCount, distanceLengths, distanceCount);
+	count = literalCount + distanceCount;
+	runCount = 0;
+	memset(lengthFrequencies, 0, sizeof(lengthFrequencies));
+	for (unsigned int i = 0; i < count; i += run)
+	{
+		for (run = 1; i + run < count && lengths[i + run] == lengths[i]; run++)
+		{
+		}
+
+		if (lengths[i] == 0 && run >= 3)
+		{
+			run = std::min(run, 138u);
+			symbol = run >= 11 ? 18 : 17;
+			runs[runCount++] = (unsigned short)(symbol | ((run - (symbol == 18 ? 11 : 3)) << 8));
+		}
+		else if (lengths[i] != 0 && run >= 4)
+		{
+			//The length itself, then the repeats of it, 3 to 6 at a time.
+			symbol = lengths[i];
+			runs[runCount++] = (unsigned short)symbol;
+			lengthFrequencies[symbol]++;
+			run = 1 + std::min(run - 1, 6u);
+			symbol = 16;
+			runs[runCount++] = (unsigned short)(symbol | ((run - 4) << 8));
+		}
+		else
+		{
+			symbol = lengths[i];
+			runs[runCount++] = (unsigned short)symbol;
+			run = 1;
+		}
+		lengthFrequencies[symbol]++;
+	}
+
+	BuildCodeLengths(lengthFrequencies, DEFLATE_LENGTH_CODES, DEFLATE_MAX_LENGTH_BITS, codeLengths);
+	for (lengthCount = DEFLATE_LENGTH_CODES; lengthCount > 4 && !codeLengths[DEFLATE_LENGTH_ORDER[lengthCount - 1]]; lengthCount--)
+	{
+	}
+
+	//The size of both ways of writing the block.
+	dynamicBits = 3 + 5 + 5 + 4 + 3 * lengthCount;
+	for (unsigned int i = 0; i < runCount; i++)
+	{
+		symbol = runs[i] & 0xFF;
+		dynamicBits += codeLengths[symbol] + (symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0);
+	}
+	for (unsigned int i = 0; i < DEFLATE_LITERAL_CODES; i++)
+	{
+		dynamicBits += (unsigned long long)literalFrequencies[i] * literalLengths[i];
+		if (i > DEFLATE_END_OF_BLOCK)
+		{
+			dynamicBits += (unsigned long long)literalFrequencies[i] * DEFLATE_LENGTH_EXTRA[i - 257];
+		}
+	}
+	for (unsigned int i = 0; i < DEFLATE_DISTANCE_CODES; i++)
+	{
+		dynamicBits += (unsigned long long)distanceFrequencies[i] * (distanceLengths[i] + DEFLATE_DISTANCE_EXTRA[i]);
+	}
+	storedBits = (unsigned long long)size * 8 + ((size + DEFLATE_STORED_SIZE - 1) / DEFLATE_STORED_SIZE) * (3 + 7 + 32);
+
+	if (size > 0 && storedBits < dynamicBits)
+	{
+		WriteStoredBlocks(data, size, final);
+		return;
+	}
+
+	BuildCodes(literalLengths, DEFLATE_LITERAL_CODES, literalCodes);
+	BuildCodes(distanceLengths, DEFLATE_DISTANCE_CODES, distanceCodes);
+	BuildCodes(codeLengths, DEFLATE_LENGTH_CODES, lengthCodes);
+
+	WriteBits(final ? 1 : 0, 1);
+	WriteBits(2, 2);
+	WriteBits(literalCount - 257, 5);
+	WriteBits(distanceCount - 1, 5);
+	WriteBits(lengthCount - 4, 4);
+	for (unsigned int i = 0; i < lengthCount; i++)
+	{
+		WriteBits(codeLengths[DEFLATE_LENGTH_ORDER[i]], 3);
+	}
+	for (unsigned int i = 0; i < runCount; i++)
+	{
+		symbol = runs[i] & 0xFF;
+		WriteBits(lengthCodes[symbol], codeLengths[symbol]);
+		if (symbol >= 16)
+		{
+			WriteBits(runs[i] >> 8, symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+		}
+	}
+
+	for (const DeflateToken& token : m_tokens)
+	{
+		if (token.distance == 0)
+		{
+			WriteBits(literalCodes[token.lengthOrLiteral], literalLengths[token.lengthOrLiteral]);
+			continue;
+		}
+
+		symbol = tables.lengthSymbol[token.lengthOrLiteral];
+		WriteBits(literalCodes[257 + symbol], literalLengths[257 + symbol]);
+		WriteBits(token.lengthOrLiteral - DEFLATE_LENGTH_BASE[symbol], DEFLATE_LENGTH_EXTRA[symbol]);
+
+		symbol = tables.GetDistanceSymbol(token.distance);
+		WriteBits(distanceCodes[symbol], distanceLengths[symbol]);
+		WriteBits(token.distance - DEFLATE_DISTANCE_BASE[symbol], DEFLATE_DISTANCE_EXTRA[symbol]);
+	}
+	WriteBits(literalCodes[DEFLATE_END_OF_BLOCK], literalLengths[DEFLATE_END_OF_BLOCK]);
+}
+
+//Writes the bytes as they are, in as many blocks as they need.
+void DeflateEncoderClass::WriteStoredBlocks(const unsigned char* data, size_t size, bool final)
+{
+	size_t offset, blockSize;
+
+	for (offset = 0; offset < size; offset += blockSize)
+	{
+		blockSize = std::min(size - offset, (size_t)DEFLATE_STORED_SIZE);
+
+		WriteBits(final && offset + blockSize == size ? 1 : 0, 1);
+		WriteBits(0, 2);
+		AlignBits();
+		m_output->push_back((unsigned char)blockSize);
+		m_output->push_back((unsigned char)(blockSize >> 8));
+		m_output->push_back((unsigned char)~blockSize);
+		m_output->push_back((unsigned char)(~blockSize >> 8));
+		m_output->insert(m_output->end(), data + offset, data + offset + blockSize);
+	}
+}
+
+//The most bytes Lz4CompressBlock() can write for data of the size, when nothing repeats.
+size_t Lz4CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+/*
+ *	Lz4CompressBlock()
+ *	brief: Compresses data into an LZ4 block, matching greedily against the position last seen with the same 4
+ *		   bytes. It looks further ahead the longer it goes without a match, so data that doesn't compress is
+ *		   skipped through quickly.
+ *	param output: Room for Lz4CompressBound(size) bytes.
+ *	param hashTable: Kept by the caller between blocks to reuse its memory.
+ *	return: The size of the block.
+ */
+size_t Lz4CompressBlock(const unsigned char* data, size_t size, unsigned char* output, std::vector<unsigned int>& hashTable)
+{
+	unsigned char* out;
+	unsigned char* token;
+	size_t position, anchor, literalCount, matchLength, candidate, matchEnd, remaining;
+	unsigned int hash, sequence, misses;
+
+	hashTable.assign((size_t)1 << LZ4_HASH_BITS, 0);
+	out = output;
+	anchor = 0;
+	position = 1;		//The table starts pointing at 0, so it is the first position put in it.
+	misses = 0;
+
+	while (size >= LZ4_MATCH_LIMIT + 1 && position < size - LZ4_MATCH_LIMIT)
+	{
+		sequence = ReadUnaligned32(data + position);
+		hash = (sequence * XXH32_PRIME1) >> (32 - LZ4_HASH_BITS);
+		candidate = hashTable[hash];
+		hashTable[hash] = (unsigned int)position;
+
+		if (position - candidate > LZ4_MAX_DISTANCE || ReadUnaligned32(data + candidate) != sequence)
+		{
+			position += 1 + (misses++ >> 6);
+			continue;
+		}
+		misses = 0;
+
+		//The match can't reach into the literals the block has to end with.
+		matchEnd = size - LZ4_LAST_LITERALS;
+		for (matchLength = LZ4_MIN_MATCH; position + matchLength < matchEnd && data[candidate + matchLength] == data[position + matchLength]; matchLength++)
+		{
+		}
+
+		literalCount = position - anchor;
+		token = out++;
+		*token = (unsigned char)(std::min(literalCount, (size_t)15) << 4);
+		if (literalCount >= 15)
+		{
+			for (remaining = literalCount - 15; remaining >= 255; remaining -= 255)
+			{
+				*out++ = 255;
+			}
+			*out++ = (unsigned char)remaining;
+		}
+		memcpy(out, data + anchor, literalCount);
+		out += literalCount;
+
+		*out++ = (unsigned char)(position - candidate);
+		*out++ = (unsigned char)((position - candidate) >> 8);
+
+		*token |= (unsigned char)std::min(matchLength - LZ4_MIN_MATCH, (size_t)15);
+		if (matchLength - LZ4_MIN_MATCH >= 15)
+		{
+			for (remaining = matchLength - LZ4_MIN_MATCH - 15; remaining >= 255; remaining -= 255)
+			{
+				*out++ = 255;
+			}
+			*out++ = (unsigned char)remaining;
+		}
+
+		position += matchLength;
+		anchor = position;
+	}
+
+	literalCount = size - anchor;
+	token = out++;
+	*token = (unsigned char)(std::min(literalCount, (size_t)15) << 4);
+	if (literalCount >= 15)
+	{
+		for (remaining = literalCount - 15; remaining >= 255; remaining -= 255)
+		{
+			*out++ = 255;
+		}
+		*out++ = (unsigned char)remaining;
+	}
+	memcpy(out, data + anchor, literalCount);
+	out += literalCount;
+
+	return out - output;
+}
+
+unsigned int Crc32(unsigned int crc, const unsigned char* data, size_t size)
+{
+	static const Crc32Table table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++)
+	{
+		crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+unsigned int Adler32(unsigned int adler, const unsigned char* data, size_t size)
+{
+	unsigned int a, b;
+	size_t run;
+
+	a = adler & 0xFFFF;
+	b = adler >> 16;
+	while (size > 0)
+	{
+		//The most bytes that can be added before the sums have to be reduced.
+		run = size < 5552 ? size : 5552;
+		size -= run;
+		while (run--)
+		{
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+//The Adler-32 of two pieces one after the other, from the checksum of each and the size of the second one.
+unsigned int Adler32Combine(unsigned int adlerA, unsigned int adlerB, size_t sizeB)
+{
+	const unsigned int modulus = 65521;
+	unsigned int remainder, sumA, sumB;
+
+	remainder = (unsigned int)(sizeB % modulus);
+	sumA = adlerA & 0xFFFF;
+	sumB = (remainder * sumA) % modulus;
+	sumA += (adlerB & 0xFFFF) + modulus - 1;
+	sumB += (adlerA >> 16) + (adlerB >> 16) + modulus - remainder;
+	if (sumA >= modulus) sumA -= modulus;
+	if (sumA >= modulus) sumA -= modulus;
+	if (sumB >= (modulus << 1)) sumB -= (modulus << 1);
+	if (sumB >= modulus) sumB -= modulus;
+	return (sumB << 16) | sumA;
+}
+
+//The 32 bit xxHash, which the LZ4 frame format checks its descriptor with.
+unsigned int Xxh32(const unsigned char* data, size_t size, unsigned int seed)
+{
+	unsigned int lanes[4], hash;
+	size_t position;
+
+	position = 0;
+	if (size >= 16)
+	{
+		lanes[0] = seed + XXH32_PRIME1 + XXH32_PRIME2;
+		lanes[1] = seed + XXH32_PRIME2;
+		lanes[2] = seed;
+		lanes[3] = seed - XXH32_PRIME1;
+		for (; position + 16 <= size; position += 16)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				lanes[lane] = RotateLeft(lanes[lane] + ReadUnaligned32(data + position + lane * 4) * XXH32_PRIME2, 13) * XXH32_PRIME1;
+			}
+		}
+		hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) + RotateLeft(lanes[3], 18);
+	}
+	else
+	{
+		hash = seed + XXH32_PRIME5;
+	}
+	hash += (unsigned int)size;
+
+	for (; position + 4 <= size; position += 4)
+	{
+		hash = RotateLeft(hash + ReadUnaligned32(data + position) * XXH32_PRIME3, 17) * XXH32_PRIME4;
+	}
+	for (; position < size; position++)
+	{
+		hash = RotateLeft(hash + data[position] * XXH32_PRIME5, 11) * XXH32_PRIME1;
+	}
+
+	hash ^= hash >> 15;
+	hash *= XXH32_PRIME2;
+	hash ^= hash >> 13;
+	hash *= XXH32_PRIME3;
+	hash ^= hash >> 16;
+	return hash;
+}
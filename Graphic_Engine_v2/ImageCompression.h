@@ -0,0 +1,76 @@
+#pragma once
+
+#ifndef IMAGE_COMPRESSION
+#define IMAGE_COMPRESSION
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include <cstddef>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int DEFLATE_WINDOW_SIZE = 32768;			//How far back a match can reach, so the most dictionary used.
+const unsigned int DEFLATE_HASH_BITS = 15;
+const unsigned int DEFLATE_MAX_CHAIN = 32;				//Earlier positions with the same hash tried per match.
+const unsigned int DEFLATE_BLOCK_TOKENS = 16384;		//Literals and matches coded with the same Huffman tables.
+const unsigned int LZ4_HASH_BITS = 14;
+const unsigned int LZ4_MAX_BLOCK_SIZE = 4 * 1024 * 1024;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//A literal, with a distance of 0, or a match of length bytes from distance bytes back.
+struct DeflateToken
+{
+	unsigned short lengthOrLiteral;
+	unsigned short distance;
+};
+
+/*
+ *	DeflateEncoderClass
+ *	brief: Compresses into raw deflate (RFC 1951), with hash chain matching and a dynamic Huffman block every
+ *		   DEFLATE_BLOCK_TOKENS tokens, or stored blocks where that comes out smaller. A stream can be made of pieces
+ *		   compressed separately, on different threads: every piece but the last ends byte aligned, and each one
+ *		   can take the data before it as dictionary so the pieces lose little ratio. One encoder per thread; it
+ *		   keeps its tables between calls.
+ */
+class DeflateEncoderClass
+{
+public:
+	DeflateEncoderClass();
+	DeflateEncoderClass(const DeflateEncoderClass&);
+	~DeflateEncoderClass();
+
+	void Compress(const unsigned char* data, size_t size, size_t dictionarySize, bool last, std::vector<unsigned char>& output);
+
+private:
+	void WriteBits(unsigned int bits, unsigned int count);
+	void AlignBits();
+	void WriteBlock(const unsigned char* data, size_t size, bool final);
+	void WriteStoredBlocks(const unsigned char* data, size_t size, bool final);
+
+private:
+	std::vector<int>		  m_head;			//Latest position of every hash.
+	std::vector<int>		  m_previous;		//Position before with the same hash, for the last window of positions.
+	std::vector<DeflateToken> m_tokens;
+	std::vector<unsigned char>* m_output;
+	unsigned long long		  m_bitBuffer;
+	unsigned int			  m_bitCount;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+size_t Lz4CompressBound(size_t size);
+size_t Lz4CompressBlock(const unsigned char* data, size_t size, unsigned char* output, std::vector<unsigned int>& hashTable);
+
+unsigned int Crc32(unsigned int crc, const unsigned char* data, size_t size);
+unsigned int Adler32(unsigned int adler, const unsigned char* data, size_t size);
+unsigned int Adler32Combine(unsigned int adlerA, unsigned int adlerB, size_t sizeB);
+unsigned int Xxh32(const unsigned char* data, size_t size, unsigned int seed);
+
+#endif
@@ -0,0 +1,572 @@
+#include "JobSystem.h"
+#include <algorithm>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+struct Job
+{
+	JobSystemClass::JobFunction			function;
+	const JobSystemClass::TaskFunction* task;			//Set for the jobs of ParallelFor(), which run a range of indices.
+	unsigned int						first, last, batchSize;
+	Job*								parent;
+	std::atomic<unsigned int>			unfinished;		//The job itself plus its children not finished yet.
+	std::atomic<unsigned int>			prerequisites;	//Jobs it waits for, plus one until it is submitted.
+	std::atomic<bool>					complete;		//Finished, and its slot of the pool can be reused.
+	Job*								dependents[JOB_MAX_DEPENDENTS];
+	unsigned int						dependentCount;
+};
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+
+//Which system the current thread works for and its index there.
+static thread_local JobSystemClass* t_jobSystem = nullptr;
+static thread_local unsigned int	t_threadIndex = 0;
+
+JobQueueClass::JobQueueClass()
+{
+	m_top = 0;
+	m_bottom = 0;
+	for (unsigned int i = 0; i < JOB_QUEUE_SIZE; i++)
+	{
+		m_jobs[i] = nullptr;
+	}
+}
+
+JobQueueClass::JobQueueClass(const JobQueueClass &)
+{
+}
+
+
+JobQueueClass::~JobQueueClass()
+{
+}
+
+/*
+ *	Push()
+ *	brief: Adds a job at the bottom. Only the owner of the queue can call it.
+ *	return: False if the queue is full.
+ */
+bool JobQueueClass::Push(Job* job)
+{
+	long long bottom, top;
+
+	bottom = m_bottom.load(std::memory_order_relaxed);
+	top = m_top.load(std::memory_order_acquire);
+	if (bottom - top >= (long long)JOB_QUEUE_SIZE)
+	{
+		return false;
+	}
+
+	m_jobs[bottom & (JOB_QUEUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+
+	//The job has to be visible before the thieves can see the new bottom.
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+/*
+ *	Pop()
+ *	brief: Takes the newest job, from the bottom. Only the owner of the queue can call it. If a thief goes for the
+ *		   same last job, whoever moves the top first gets it.
+ *	return: The job, or null if the queue is empty.
+ */
+Job* JobQueueClass::Pop()
+{
+	long long bottom, top;
+	Job* job;
+
+	bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	top = m_top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		//It was empty.
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	job = m_jobs[bottom & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			job = nullptr;
+		}
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+/*
+ *	Steal()
+ *	brief: Takes the oldest job, from the top. Any thread can call it.
+ *	return: The job, or null if the queue is empty or another thread took it first.
+ */
+Job* JobQueueClass::Steal()
+{
+	long long bottom, top;
+	Job* job;
+
+	top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	bottom = m_bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+	{
+		return nullptr;
+	}
+
+	job = m_jobs[top & (JOB_QUEUE_SIZE - 1)].load(std::memory_order_relaxed);
+	if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+	{
+		return nullptr;
+	}
+
+	return job;
+}
+
+JobSystemClass::JobSystemClass()
+{
+	m_queues = nullptr;
+	m_jobPools = nullptr;
+	m_nextJobs = nullptr;
+	m_threadCount = 0;
+	m_userThreadCount = 0;
+	m_queuedJobs = 0;
+	m_sleepingWorkers = 0;
+	m_quit = false;
+}
+
+JobSystemClass::JobSystemClass(const JobSystemClass &)
+{
+}
+
+
+JobSystemClass::~JobSystemClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Creates the queues and the pools of jobs and starts the worker threads.
+ *	param threadCount: How many threads run jobs, counting the user threads. With 0 it uses one per hardware
+ *					   thread. There are always at least as many as user threads.
+ *	param userThreadCount: Threads that aren't created by the system but use it, the one calling Initialize()
+ *						   included. The rest attach themselves with AttachThread().
+ */
+bool JobSystemClass::Initialize(unsigned int threadCount, unsigned int userThreadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+	}
+	userThreadCount = std::max(userThreadCount, 1u);
+	threadCount = std::max(threadCount, userThreadCount);
+
+	m_threadCount = threadCount;
+	m_userThreadCount = userThreadCount;
+	m_queues = new JobQueueClass[threadCount];
+	m_jobPools = new Job[threadCount * JOB_POOL_SIZE];
+	m_nextJobs = new unsigned int[threadCount];
+	if (!m_queues || !m_jobPools || !m_nextJobs)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < threadCount * JOB_POOL_SIZE; i++)
+	{
+		m_jobPools[i].complete = true;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		m_nextJobs[i] = 0;
+	}
+
+	m_queuedJobs = 0;
+	m_sleepingWorkers = 0;
+	m_quit = false;
+
+	//The calling thread is the first one, and the other user threads attach later, so only the workers are created.
+	t_jobSystem = this;
+	t_threadIndex = 0;
+	for (unsigned int i = userThreadCount; i < threadCount; i++)
+	{
+		m_threads.push_back(std::thread(&JobSystemClass::WorkerThread, this, i));
+	}
+
+	return true;
+}
+
+void JobSystemClass::Shutdown()
+{
+	//Wake up every worker telling them to leave and wait for them.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (unsigned int i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+	m_threads.clear();
+
+	if (t_jobSystem == this)
+	{
+		t_jobSystem = nullptr;
+	}
+
+	delete[] m_nextJobs;
+	m_nextJobs = nullptr;
+	delete[] m_jobPools;
+	m_jobPools = nullptr;
+	delete[] m_queues;
+	m_queues = nullptr;
+	m_threadCount = 0;
+	m_userThreadCount = 0;
+}
+
+/*
+ *	AttachThread()
+ *	brief: Lets the calling thread, which the system didn't create, submit and wait for jobs as one of the user
+ *		   threads. No two threads can use the same index at the same time.
+ *	param threadIndex: Lower than the user thread count given to Initialize(). 0 is the one that called it.
+ */
+void JobSystemClass::AttachThread(unsigned int threadIndex)
+{
+	if (threadIndex < m_userThreadCount)
+	{
+		t_jobSystem = this;
+		t_threadIndex = threadIndex;
+	}
+}
+
+/*
+ *	CreateJob()
+ *	brief: Creates a job that isn't run until it is submitted.
+ *	param function: What the job does. It receives the index of the thread running it.
+ *	param parent: A job that won't count as finished until this one is, or null. It must not have finished yet,
+ *		  so it is either not submitted or the one creating this job.
+ *	return: The job, or null if the pool of the thread has no free job.
+ */
+Job* JobSystemClass::CreateJob(const JobFunction& function, Job* parent)
+{
+	Job* job;
+
+	job = AllocateJob(parent);
+	if (!job)
+	{
+		return nullptr;
+	}
+
+	job->function = function;
+	return job;
+}
+
+/*
+ *	AddDependency()
+ *	brief: Makes a job wait for another one to finish, children included, before it starts. Both have to be
+ *		   added before the prerequisite is submitted.
+ *	return: False if the prerequisite already has JOB_MAX_DEPENDENTS jobs waiting for it.
+ */
+bool JobSystemClass::AddDependency(Job* job, Job* prerequisite)
+{
+	if (prerequisite->dependentCount == JOB_MAX_DEPENDENTS)
+	{
+		return false;
+	}
+
+	job->prerequisites++;
+	prerequisite->dependents[prerequisite->dependentCount++] = job;
+	return true;
+}
+
+//Lets the job run as soon as its prerequisites finish.
+void JobSystemClass::Submit(Job* job)
+{
+	if (job->prerequisites.fetch_sub(1) == 1)
+	{
+		Push(job);
+	}
+}
+
+/*
+ *	Wait()
+ *	brief: Returns when a job and all its children have finished. The thread runs other jobs meanwhile, so
+ *		   waiting from inside a job doesn't block a worker.
+ */
+void JobSystemClass::Wait(Job* job)
+{
+	unsigned int threadIndex;
+	Job* otherJob;
+
+	threadIndex = GetThreadIndex();
+	while (!job->complete.load(std::memory_order_acquire))
+	{
+		otherJob = GetJob(threadIndex);
+		if (otherJob)
+		{
+			Execute(otherJob, threadIndex);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+/*
+ *	ParallelFor()
+ *	brief: Calls the function once for every index in [0, count) and returns when all of them have finished.
+ *		   The range is split in halves by the jobs themselves, so the threads that steal get big pieces first.
+ *	param batchSize: The fewest indices a job runs. Ranges this size or smaller aren't split.
+ *	param function: What to do for each index. It also receives the index of the thread running it, which is
+ *					always lower than GetThreadCount().
+ */
+void JobSystemClass::ParallelFor(unsigned int count, unsigned int batchSize, const TaskFunction& function)
+{
+	unsigned int threadIndex;
+	Job* job;
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	//With a single batch or no workers there is nothing to split.
+	batchSize = batchSize ? batchSize : 1;
+	job = count > batchSize && !m_threads.empty() ? AllocateJob(nullptr) : nullptr;
+	if (!job)
+	{
+		threadIndex = GetThreadIndex();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			function(i, threadIndex);
+		}
+		return;
+	}
+
+	job->task = &function;
+	job->first = 0;
+	job->last = count;
+	job->batchSize = batchSize;
+
+	Submit(job);
+	Wait(job);
+}
+
+unsigned int JobSystemClass::GetThreadCount()
+{
+	return m_threadCount;
+}
+
+/*
+ *	AllocateJob()
+ *	brief: Takes the next job of the pool of the calling thread, if the one there has already finished.
+ */
+Job* JobSystemClass::AllocateJob(Job* parent)
+{
+	unsigned int threadIndex;
+	Job* job;
+
+	threadIndex = GetThreadIndex();
+	job = &m_jobPools[threadIndex * JOB_POOL_SIZE + (m_nextJobs[threadIndex] & (JOB_POOL_SIZE - 1))];
+	if (!job->complete.load(std::memory_order_acquire))
+	{
+		return nullptr;
+	}
+	m_nextJobs[threadIndex]++;
+
+	job->function = nullptr;
+	job->task = nullptr;
+	job->first = 0;
+	job->last = 0;
+	job->batchSize = 0;
+	job->parent = parent;
+	job->unfinished.store(1, std::memory_order_relaxed);
+	job->prerequisites.store(1, std::memory_order_relaxed);
+	job->complete.store(false, std::memory_order_relaxed);
+	job->dependentCount = 0;
+
+	if (parent)
+	{
+		parent->unfinished++;
+	}
+
+	return job;
+}
+
+//Puts a ready job in the queue of the calling thread, or runs it now if the queue is full.
+void JobSystemClass::Push(Job* job)
+{
+	unsigned int threadIndex;
+
+	//Counted before it can be taken, so the count is never lower than the jobs in the queues.
+	threadIndex = GetThreadIndex();
+	m_queuedJobs++;
+	if (!m_queues[threadIndex].Push(job))
+	{
+		m_queuedJobs--;
+		Execute(job, threadIndex);
+		return;
+	}
+
+	//Wake up a sleeping worker. Taking the lock makes sure it is waiting and not about to.
+	if (m_sleepingWorkers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_wakeCondition.notify_one();
+	}
+}
+
+/*
+ *	GetJob()
+ *	brief: Takes a job from the queue of the thread or, if it is empty, steals one from the other threads,
+ *		   starting with a different one every time.
+ */
+Job* JobSystemClass::GetJob(unsigned int threadIndex)
+{
+	static thread_local unsigned int victim = 0;
+	Job* job;
+
+	job = m_queues[threadIndex].Pop();
+	for (unsigned int i = 1; !job && i < m_threadCount; i++)
+	{
+		victim = victim + 1 < m_threadCount ? victim + 1 : 0;
+		if (victim != threadIndex)
+		{
+			job = m_queues[victim].Steal();
+		}
+	}
+
+	if (job)
+	{
+		m_queuedJobs--;
+	}
+	return job;
+}
+
+/*
+ *	Execute()
+ *	brief: Runs a job. The jobs of a ParallelFor() keep splitting their range in halves and push the upper one
+ *		   as a child job until what is left is a batch, which they run.
+ */
+void JobSystemClass::Execute(Job* job, unsigned int threadIndex)
+{
+	unsigned int middle;
+	Job* child;
+
+	if (job->task)
+	{
+		while (job->last - job->first > job->batchSize)
+		{
+			child = AllocateJob(job);
+			if (!child)
+			{
+				break;
+			}
+
+			middle = job->first + (job->last - job->first) / 2;
+			child->task = job->task;
+			child->first = middle;
+			child->last = job->last;
+			child->batchSize = job->batchSize;
+			job->last = middle;
+
+			Submit(child);
+		}
+
+		for (unsigned int i = job->first; i < job->last; i++)
+		{
+			(*job->task)(i, threadIndex);
+		}
+	}
+	else if (job->function)
+	{
+		job->function(threadIndex);
+	}
+
+	Finish(job, threadIndex);
+}
+
+/*
+ *	Finish()
+ *	brief: Counts a job or one of its children as finished. When the job has nothing left it releases the jobs
+ *		   waiting for it, and finishes a child of its parent.
+ */
+void JobSystemClass::Finish(Job* job, unsigned int threadIndex)
+{
+	Job* parent;
+
+	if (job->unfinished.fetch_sub(1) != 1)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < job->dependentCount; i++)
+	{
+		Submit(job->dependents[i]);
+	}
+
+	//After this the job can be reused, so the parent is read first.
+	parent = job->parent;
+	job->complete.store(true, std::memory_order_release);
+
+	if (parent)
+	{
+		Finish(parent, threadIndex);
+	}
+}
+
+/*
+ *	WorkerThread()
+ *	brief: Runs jobs until the system shuts down. A worker that finds no work for a while goes to sleep until a
+ *		   job is pushed.
+ */
+void JobSystemClass::WorkerThread(unsigned int threadIndex)
+{
+	unsigned int failedSearches = 0;
+	Job* job;
+
+	t_jobSystem = this;
+	t_threadIndex = threadIndex;
+
+	while (!m_quit.load(std::memory_order_relaxed))
+	{
+		job = GetJob(threadIndex);
+		if (job)
+		{
+			Execute(job, threadIndex);
+			failedSearches = 0;
+			continue;
+		}
+
+		if (++failedSearches < JOB_SPIN_COUNT)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_sleepingWorkers++;
+			m_wakeCondition.wait(lock, [this] { return m_quit.load() || m_queuedJobs.load() > 0; });
+			m_sleepingWorkers--;
+		}
+		failedSearches = 0;
+	}
+}
+
+//Index of the calling thread. Threads that don't belong to the system are taken as the first one.
+unsigned int JobSystemClass::GetThreadIndex()
+{
+	return t_jobSystem == this ? t_threadIndex : 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef JOB_SYSTEM
+#define JOB_SYSTEM
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int JOB_QUEUE_SIZE = 4096;		//Jobs waiting in the queue of a thread. Power of two.
+const unsigned int JOB_POOL_SIZE = 4096;		//Jobs a thread can have created and not yet finished. Power of two.
+const unsigned int JOB_MAX_DEPENDENTS = 8;		//Jobs that can wait for the same one.
+const unsigned int JOB_SPIN_COUNT = 64;			//Failed searches for work before a worker goes to sleep.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+struct Job;
+
+/*
+ *	JobQueueClass
+ *	brief: The Chase-Lev work stealing deque of a thread. Its owner pushes and pops jobs at the bottom without
+ *		   locking, and the other threads steal the oldest ones from the top. It doesn't grow; Push() fails when
+ *		   it is full.
+ */
+class JobQueueClass
+{
+public:
+	JobQueueClass();
+	JobQueueClass(const JobQueueClass&);
+	~JobQueueClass();
+
+	bool Push(Job* job);
+	Job* Pop();
+	Job* Steal();
+
+private:
+	std::atomic<long long> m_top;
+	std::atomic<long long> m_bottom;
+	std::atomic<Job*>	   m_jobs[JOB_QUEUE_SIZE];
+};
+
+/*
+ *	JobSystemClass
+ *	brief: Runs jobs on a fixed set of threads, each with its own queue, that steal from the others when theirs is
+ *		   empty. Jobs can have children, which the parent waits for before it counts as finished, and dependencies,
+ *		   jobs that have to finish before they start. The thread that calls Initialize() is thread 0 and works
+ *		   too while it waits. Other threads the system didn't create can take the next indices with AttachThread();
+ *		   only those threads and the jobs themselves can use the system.
+ *		   Jobs come from a ring per thread with no locking, so a thread can't have more than JOB_POOL_SIZE jobs
+ *		   alive at once, and a job is gone once it finishes and Wait() returns.
+ */
+class JobSystemClass
+{
+public:
+	typedef std::function<void(unsigned int threadIndex)> JobFunction;
+	typedef std::function<void(unsigned int index, unsigned int threadIndex)> TaskFunction;
+
+public:
+	JobSystemClass();
+	JobSystemClass(const JobSystemClass&);
+	~JobSystemClass();
+
+	bool Initialize(unsigned int threadCount, unsigned int userThreadCount);
+	void Shutdown();
+	void AttachThread(unsigned int threadIndex);
+
+	Job* CreateJob(const JobFunction& function, Job* parent);
+	bool AddDependency(Job* job, Job* prerequisite);
+	void Submit(Job* job);
+	void Wait(Job* job);
+
+	void ParallelFor(unsigned int count, unsigned int batchSize, const TaskFunction& function);
+	unsigned int GetThreadCount();
+
+private:
+	Job* AllocateJob(Job* parent);
+	void Push(Job* job);
+	Job* GetJob(unsigned int threadIndex);
+	void Execute(Job* job, unsigned int threadIndex);
+	void Finish(Job* job, unsigned int threadIndex);
+	void WorkerThread(unsigned int threadIndex);
+	unsigned int GetThreadIndex();
+
+private:
+	std::vector<std::thread>	m_threads;
+	JobQueueClass*				m_queues;			//One per thread.
+	Job*						m_jobPools;			//JOB_POOL_SIZE per thread.
+	unsigned int*				m_nextJobs;			//Next job of the pool of every thread.
+	unsigned int				m_threadCount;
+	unsigned int				m_userThreadCount;	//Threads the system didn't create, the first indices.
+
+	//Workers without work sleep until a job is pushed.
+	std::mutex					m_mutex;
+	std::condition_variable		m_wakeCondition;
+	std::atomic<unsigned int>	m_queuedJobs;
+	std::atomic<unsigned int>	m_sleepingWorkers;
+	std::atomic<bool>			m_quit;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "MappedFile.h"
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+MappedFileClass::MappedFileClass()
+{
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#else
+	m_file = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+MappedFileClass::MappedFileClass(const MappedFileClass &)
+{
+}
+
+
+MappedFileClass::~MappedFileClass()
+{
+}
+
+/*
+ *	Open()
+ *	brief: Maps the whole file for reading. Empty files can't be mapped and fail like missing ones.
+ */
+bool MappedFileClass::Open(const char* filename)
+{
+#ifdef _WIN32
+	LARGE_INTEGER fileSize;
+
+	Close();
+
+	//The file is read from start to end, so let the cache manager read ahead.
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+						 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = (unsigned long long)fileSize.QuadPart;
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = (const unsigned char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+#else
+	struct stat fileStatus;
+	void* data;
+
+	Close();
+
+	m_file = open(filename, O_RDONLY);
+	if (m_file < 0)
+	{
+		return false;
+	}
+
+	if (fstat(m_file, &fileStatus) != 0 || fileStatus.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = (unsigned long long)fileStatus.st_size;
+
+	data = mmap(nullptr, (size_t)m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	m_data = (const unsigned char*)data;
+
+	//The file is read from start to end, so let the kernel read ahead.
+	madvise(data, (size_t)m_size, MADV_SEQUENTIAL);
+	madvise(data, (size_t)m_size, MADV_WILLNEED);
+#endif
+
+	return true;
+}
+
+void MappedFileClass::Close()
+{
+#ifdef _WIN32
+	if (m_data)
+	{
+		UnmapViewOfFile(m_data);
+	}
+	if (m_mapping)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = NULL;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_data)
+	{
+		munmap((void*)m_data, (size_t)m_size);
+	}
+	if (m_file >= 0)
+	{
+		close(m_file);
+		m_file = -1;
+	}
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+const unsigned char* MappedFileClass::GetData()
+{
+	return m_data;
+}
+
+unsigned long long MappedFileClass::GetSize()
+{
+	return m_size;
+}
+
+/*
+ *	GetFileInfo()
+ *	brief: Gets the size and the last modification time of a file, to tell when a file made from it is outdated.
+ *	return: False if the file doesn't exist.
+ */
+bool GetFileInfo(const char* filename, unsigned long long& size, unsigned long long& modifiedTime)
+{
+#ifdef _WIN32
+	struct _stat64 fileStatus;
+
+	if (_stat64(filename, &fileStatus) != 0)
+	{
+		return false;
+	}
+#else
+	struct stat fileStatus;
+
+	if (stat(filename, &fileStatus) != 0)
+	{
+		return false;
+	}
+#endif
+
+	size = (unsigned long long)fileStatus.st_size;
+	modifiedTime = (unsigned long long)fileStatus.st_mtime;
+	return true;
+}
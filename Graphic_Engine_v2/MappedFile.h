@@ -0,0 +1,45 @@
+#pragma once
+
+#ifndef MAPPED_FILE
+#define MAPPED_FILE
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "Platform.h"
+
+/*
+ *	MappedFileClass
+ *	brief: A read only view of a whole file through the virtual memory of the process. The operating system reads
+ *		   the pages when they are first touched, so nothing is copied into buffers of our own.
+ */
+class MappedFileClass
+{
+public:
+	MappedFileClass();
+	MappedFileClass(const MappedFileClass&);
+	~MappedFileClass();
+
+	bool Open(const char* filename);
+	void Close();
+
+	const unsigned char* GetData();
+	unsigned long long GetSize();
+
+private:
+#ifdef _WIN32
+	HANDLE				 m_file;
+	HANDLE				 m_mapping;
+#else
+	int					 m_file;
+#endif
+	const unsigned char* m_data;
+	unsigned long long	 m_size;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+bool GetFileInfo(const char* filename, unsigned long long& size, unsigned long long& modifiedTime);
+
+#endif
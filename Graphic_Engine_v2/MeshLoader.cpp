@@ -0,0 +1,942 @@
+#include "MeshLoader.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const char MESH_CACHE_MAGIC[4] = { 'G', 'E', 'M', 'C' };
+
+/************************************************************************/
+/* TEXT PARSING                                                         */
+/* The files are read straight from the mapped memory, which has no     */
+/* terminating zero, so every function gets the end of the text.       */
+/************************************************************************/
+static bool IsBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* SkipBlanks(const char* p, const char* end)
+{
+	while (p < end && IsBlank(*p))
+	{
+		p++;
+	}
+	return p;
+}
+
+static const char* SkipWhitespace(const char* p, const char* end)
+{
+	while (p < end && (IsBlank(*p) || *p == '\n'))
+	{
+		p++;
+	}
+	return p;
+}
+
+static const char* SkipLine(const char* p, const char* end)
+{
+	while (p < end && *p != '\n')
+	{
+		p++;
+	}
+	return p < end ? p + 1 : end;
+}
+
+/*
+ *	ParseNumber()
+ *	brief: Reads a decimal number like strtod() does, without its locale lookups, which dominate the time of
+ *		   loading big text files.
+ *	param valid: Set to false, without moving, if there isn't a number there.
+ *	return: Where the number ends.
+ */
+static const char* ParseNumber(const char* p, const char* end, double& value, bool& valid)
+{
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+									 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char* start = p;
+	unsigned long long mantissa = 0;
+	int exponent = 0, digits = 0, exponentValue = 0;
+	bool negative = false, negativeExponent = false;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	//Digits past the 19th don't fit in the mantissa and only move the exponent.
+	for (; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+	{
+		if (mantissa < 1000000000000000000ULL)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+		}
+		else
+		{
+			exponent++;
+		}
+	}
+
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++, digits++)
+		{
+			if (mantissa < 1000000000000000000ULL)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+	}
+
+	if (digits == 0)
+	{
+		valid = false;
+		return start;
+	}
+
+	if (p + 1 < end && (*p == 'e' || *p == 'E') &&
+		((p[1] >= '0' && p[1] <= '9') || ((p[1] == '-' || p[1] == '+') && p + 2 < end && p[2] >= '0' && p[2] <= '9')))
+	{
+		p++;
+		if (*p == '-' || *p == '+')
+		{
+			negativeExponent = *p == '-';
+			p++;
+		}
+		for (; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			exponentValue = std::min(exponentValue * 10 + (*p - '0'), 1000);
+		}
+		exponent += negativeExponent ? -exponentValue : exponentValue;
+	}
+
+	value = (double)mantissa;
+	if (exponent < 0)
+	{
+		value = -exponent <= 22 ? value / powers[-exponent] : value * pow(10.0, exponent);
+	}
+	else if (exponent > 0)
+	{
+		value = exponent <= 22 ? value * powers[exponent] : value * pow(10.0, exponent);
+	}
+	if (negative)
+	{
+		value = -value;
+	}
+
+	valid = true;
+	return p;
+}
+
+static const char* ParseInteger(const char* p, const char* end, long long& value, bool& valid)
+{
+	const char* start = p;
+	bool negative = false;
+
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	value = 0;
+	valid = false;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+	{
+		value = value * 10 + (*p - '0');
+		valid = true;
+	}
+
+	if (!valid)
+	{
+		return start;
+	}
+
+	if (negative)
+	{
+		value = -value;
+	}
+	return p;
+}
+
+/*
+ *	AddPolygon()
+ *	brief: Splits a convex polygon into a fan of triangles, reversing the winding from counter clockwise to the
+ *		   clockwise front faces of the engine.
+ */
+static void AddPolygon(const std::vector<unsigned int>& polygon, std::vector<unsigned int>& indices)
+{
+	for (size_t i = 1; i + 1 < polygon.size(); i++)
+	{
+		indices.push_back(polygon[0]);
+		indices.push_back(polygon[i + 1]);
+		indices.push_back(polygon[i]);
+	}
+}
+
+/************************************************************************/
+/* OBJ                                                                  */
+/************************************************************************/
+
+/*
+ *	ImportObj()
+ *	brief: Reads the "v" and "f" lines of a Wavefront OBJ file. Vertices can have a color after the position
+ *		   ("v x y z r g b"); the ones without it are white. Texture coordinates and normals are ignored.
+ */
+static bool ImportObj(const char* text, unsigned long long size, std::vector<MeshVertex>& vertices,
+					  std::vector<unsigned int>& indices)
+{
+	const char* p = text;
+	const char* end = text + size;
+	std::vector<unsigned int> polygon;
+	MeshVertex vertex;
+	double values[6];
+	long long index;
+	int valueCount;
+	bool valid;
+
+	while (p < end)
+	{
+		p = SkipBlanks(p, end);
+
+		if (end - p >= 2 && p[0] == 'v' && IsBlank(p[1]))
+		{
+			for (p++, valueCount = 0; valueCount < 6; valueCount++)
+			{
+				p = ParseNumber(SkipBlanks(p, end), end, values[valueCount], valid);
+				if (!valid)
+				{
+					break;
+				}
+			}
+
+			if (valueCount < 3)
+			{
+				return false;
+			}
+
+			vertex.position = XMFLOAT3((float)values[0], (float)values[1], -(float)values[2]);
+			if (valueCount == 6)
+			{
+				vertex.color = XMFLOAT4((float)values[3], (float)values[4], (float)values[5], 1.0f);
+			}
+			else
+			{
+				vertex.color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			}
+			vertices.push_back(vertex);
+		}
+		else if (end - p >= 2 && p[0] == 'f' && IsBlank(p[1]))
+		{
+			polygon.clear();
+			for (p++;;)
+			{
+				p = ParseInteger(SkipBlanks(p, end), end, index, valid);
+				if (!valid)
+				{
+					break;
+				}
+
+				//Skip the texture coordinate and normal indices of "v/vt/vn".
+				while (p < end && !IsBlank(*p) && *p != '\n')
+				{
+					p++;
+				}
+
+				//Indices start at 1, and negative ones count back from the last vertex.
+				index = index > 0 ? index - 1 : (long long)vertices.size() + index;
+				if (index < 0 || index >= (long long)vertices.size())
+				{
+					return false;
+				}
+				polygon.push_back((unsigned int)index);
+			}
+
+			AddPolygon(polygon, indices);
+		}
+
+		p = SkipLine(p, end);
+	}
+
+	return true;
+}
+
+/************************************************************************/
+/* PLY                                                                  */
+/************************************************************************/
+enum PlyFormat
+{
+	PLY_FORMAT_ASCII,
+	PLY_FORMAT_BINARY_LITTLE_ENDIAN,
+	PLY_FORMAT_BINARY_BIG_ENDIAN
+};
+
+enum PlyType
+{
+	PLY_TYPE_INT8,
+	PLY_TYPE_UINT8,
+	PLY_TYPE_INT16,
+	PLY_TYPE_UINT16,
+	PLY_TYPE_INT32,
+	PLY_TYPE_UINT32,
+	PLY_TYPE_FLOAT32,
+	PLY_TYPE_FLOAT64,
+	PLY_TYPE_INVALID
+};
+
+struct PlyProperty
+{
+	std::string name;
+	PlyType		type;
+	bool		isList;
+	PlyType		countType;		//Type of the item count before every list.
+};
+
+struct PlyElement
+{
+	std::string				 name;
+	unsigned long long		 count;
+	std::vector<PlyProperty> properties;
+};
+
+static PlyType ParsePlyType(const std::string& name)
+{
+	if (name == "char" || name == "int8") return PLY_TYPE_INT8;
+	if (name == "uchar" || name == "uint8") return PLY_TYPE_UINT8;
+	if (name == "short" || name == "int16") return PLY_TYPE_INT16;
+	if (name == "ushort" || name == "uint16") return PLY_TYPE_UINT16;
+	if (name == "int" || name == "int32") return PLY_TYPE_INT32;
+	if (name == "uint" || name == "uint32") return PLY_TYPE_UINT32;
+	if (name == "float" || name == "float32") return PLY_TYPE_FLOAT32;
+	if (name == "double" || name == "float64") return PLY_TYPE_FLOAT64;
+	return PLY_TYPE_INVALID;
+}
+
+static unsigned int PlyTypeSize(PlyType type)
+{
+	switch (type)
+	{
+	case PLY_TYPE_INT8:
+	case PLY_TYPE_UINT8:
+		return 1;
+	case PLY_TYPE_INT16:
+	case PLY_TYPE_UINT16:
+		return 2;
+	case PLY_TYPE_FLOAT64:
+		return 8;
+	default:
+		return 4;
+	}
+}
+
+/*
+ *	ReadPlyValue()
+ *	brief: Reads the next scalar of the body of a PLY file as a double. Binary values are stored little endian by
+ *		   the CPUs the engine runs on, so only the big endian files are swapped.
+ */
+static bool ReadPlyValue(const char*& p, const char* end, PlyFormat format, PlyType type, double& value)
+{
+	unsigned char bytes[8];
+	unsigned int size;
+	bool valid;
+
+	if (format == PLY_FORMAT_ASCII)
+	{
+		p = ParseNumber(SkipWhitespace(p, end), end, value, valid);
+		return valid;
+	}
+
+	size = PlyTypeSize(type);
+	if ((unsigned long long)(end - p) < size)
+	{
+		return false;
+	}
+
+	memcpy(bytes, p, size);
+	p += size;
+	if (format == PLY_FORMAT_BINARY_BIG_ENDIAN)
+	{
+		std::reverse(bytes, bytes + size);
+	}
+
+	switch (type)
+	{
+	case PLY_TYPE_INT8:
+		value = (double)(signed char)bytes[0];
+		break;
+	case PLY_TYPE_UINT8:
+		value = (double)bytes[0];
+		break;
+	case PLY_TYPE_INT16:
+		{
+			short typed;
+			memcpy(&typed, bytes, sizeof(typed));
+			value = (double)typed;
+		}
+		break;
+	case PLY_TYPE_UINT16:
+		{
+			unsigned short typed;
+			memcpy(&typed, bytes, sizeof(typed));
+			value = (double)typed;
+		}
+		break;
+	case PLY_TYPE_INT32:
+		{
+			int typed;
+			memcpy(&typed, bytes, sizeof(typed));
+			value = (double)typed;
+		}
+		break;
+	case PLY_TYPE_UINT32:
+		{
+			unsigned int typed;
+			memcpy(&typed, bytes, sizeof(typed));
+			value = (double)typed;
+		}
+		break;
+	case PLY_TYPE_FLOAT32:
+		{
+			float typed;
+			memcpy(&typed, bytes, sizeof(typed));
+			value = (double)typed;
+		}
+		break;
+	default:
+		memcpy(&value, bytes, sizeof(value));
+		break;
+	}
+
+	return true;
+}
+
+/*
+ *	ParsePlyHeader()
+ *	brief: Reads the header up to "end_header" and leaves the pointer at the first byte of the body.
+ */
+static bool ParsePlyHeader(const char*& p, const char* end, PlyFormat& format, std::vector<PlyElement>& elements)
+{
+	std::string line, keyword, value;
+	const char* lineEnd;
+	bool formatFound = false;
+
+	for (int lineNumber = 0; p < end; lineNumber++)
+	{
+		lineEnd = p;
+		while (lineEnd < end && *lineEnd != '\n')
+		{
+			lineEnd++;
+		}
+		line.assign(p, lineEnd);
+		p = lineEnd < end ? lineEnd + 1 : end;
+
+		std::istringstream tokens(line);
+		tokens >> keyword;
+
+		if (lineNumber == 0)
+		{
+			if (keyword != "ply")
+			{
+				return false;
+			}
+		}
+		else if (keyword == "format")
+		{
+			tokens >> value;
+			if (value == "ascii") format = PLY_FORMAT_ASCII;
+			else if (value == "binary_little_endian") format = PLY_FORMAT_BINARY_LITTLE_ENDIAN;
+			else if (value == "binary_big_endian") format = PLY_FORMAT_BINARY_BIG_ENDIAN;
+			else return false;
+			formatFound = true;
+		}
+		else if (keyword == "element")
+		{
+			PlyElement element;
+
+			if (!(tokens >> element.name >> element.count))
+			{
+				return false;
+			}
+			elements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			PlyProperty property;
+
+			if (elements.empty() || !(tokens >> value))
+			{
+				return false;
+			}
+
+			property.isList = value == "list";
+			if (property.isList)
+			{
+				tokens >> value;
+				property.countType = ParsePlyType(value);
+				tokens >> value;
+			}
+			else
+			{
+				property.countType = PLY_TYPE_INVALID;
+			}
+			property.type = ParsePlyType(value);
+
+			if (!(tokens >> property.name) || property.type == PLY_TYPE_INVALID ||
+				(property.isList && property.countType == PLY_TYPE_INVALID))
+			{
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		}
+		else if (keyword == "end_header")
+		{
+			return formatFound;
+		}
+	}
+
+	return false;
+}
+
+static int FindPlyProperty(const PlyElement& element, const char* name)
+{
+	for (size_t i = 0; i < element.properties.size(); i++)
+	{
+		if (element.properties[i].name == name)
+		{
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+/*
+ *	ImportPly()
+ *	brief: Reads the "vertex" and "face" elements of an ASCII or binary PLY file. Vertices take the x, y, z, red,
+ *		   green, blue and alpha properties; colors stored as integers are normalized. The rest is skipped.
+ */
+static bool ImportPly(const char* text, unsigned long long size, std::vector<MeshVertex>& vertices,
+					  std::vector<unsigned int>& indices)
+{
+	const char* p = text;
+	const char* end = text + size;
+	const char* colorNames[4] = { "red", "green", "blue", "alpha" };
+	std::vector<PlyElement> elements;
+	std::vector<double> values;
+	std::vector<unsigned int> polygon;
+	PlyFormat format = PLY_FORMAT_ASCII;
+	MeshVertex vertex;
+	double value, itemCount, colorScale[4];
+	int positionProperty[3], colorProperty[4], indexProperty;
+	float color[4];
+
+	if (!ParsePlyHeader(p, end, format, elements))
+	{
+		return false;
+	}
+
+	for (size_t e = 0; e < elements.size(); e++)
+	{
+		const PlyElement& element = elements[e];
+		bool isVertex = element.name == "vertex";
+		bool isFace = element.name == "face";
+
+		positionProperty[0] = FindPlyProperty(element, "x");
+		positionProperty[1] = FindPlyProperty(element, "y");
+		positionProperty[2] = FindPlyProperty(element, "z");
+		for (int c = 0; c < 4; c++)
+		{
+			colorProperty[c] = FindPlyProperty(element, colorNames[c]);
+			colorScale[c] = 1.0;
+			if (colorProperty[c] >= 0)
+			{
+				switch (element.properties[colorProperty[c]].type)
+				{
+				case PLY_TYPE_UINT8:
+					colorScale[c] = 1.0 / 255.0;
+					break;
+				case PLY_TYPE_UINT16:
+					colorScale[c] = 1.0 / 65535.0;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+		indexProperty = FindPlyProperty(element, "vertex_indices");
+		if (indexProperty < 0)
+		{
+			indexProperty = FindPlyProperty(element, "vertex_index");
+		}
+
+		if (isVertex && (positionProperty[0] < 0 || positionProperty[1] < 0 || positionProperty[2] < 0))
+		{
+			return false;
+		}
+
+		values.resize(element.properties.size());
+		for (unsigned long long item = 0; item < element.count; item++)
+		{
+			polygon.clear();
+
+			for (size_t i = 0; i < element.properties.size(); i++)
+			{
+				const PlyProperty& property = element.properties[i];
+
+				if (!property.isList)
+				{
+					if (!ReadPlyValue(p, end, format, property.type, values[i]))
+					{
+						return false;
+					}
+					continue;
+				}
+
+				if (!ReadPlyValue(p, end, format, property.countType, itemCount) || itemCount < 0.0)
+				{
+					return false;
+				}
+
+				for (long long j = 0; j < (long long)itemCount; j++)
+				{
+					if (!ReadPlyValue(p, end, format, property.type, value))
+					{
+						return false;
+					}
+
+					if (isFace && (int)i == indexProperty)
+					{
+						if (value < 0.0 || value >= (double)vertices.size())
+						{
+							return false;
+						}
+						polygon.push_back((unsigned int)value);
+					}
+				}
+			}
+
+			if (isVertex)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					color[c] = colorProperty[c] >= 0 ? (float)(values[colorProperty[c]] * colorScale[c]) : 1.0f;
+				}
+
+				vertex.position = XMFLOAT3((float)values[positionProperty[0]], (float)values[positionProperty[1]],
+										   -(float)values[positionProperty[2]]);
+				vertex.color = XMFLOAT4(color[0], color[1], color[2], color[3]);
+				vertices.push_back(vertex);
+			}
+			else if (isFace)
+			{
+				AddPolygon(polygon, indices);
+			}
+		}
+	}
+
+	return true;
+}
+
+/************************************************************************/
+/* MESH LOADER                                                          */
+/************************************************************************/
+static bool HasExtension(const char* filename, const char* extension)
+{
+	const char* dot = strrchr(filename, '.');
+
+	if (!dot || strlen(dot) != strlen(extension))
+	{
+		return false;
+	}
+
+	for (; *dot; dot++, extension++)
+	{
+		if (tolower((unsigned char)*dot) != *extension)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static unsigned long long AlignCacheOffset(unsigned long long offset)
+{
+	return (offset + MESH_CACHE_ALIGNMENT - 1) / MESH_CACHE_ALIGNMENT * MESH_CACHE_ALIGNMENT;
+}
+
+MeshLoaderClass::MeshLoaderClass()
+{
+	m_vertices = nullptr;
+	m_indices = nullptr;
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_boundsMin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	m_boundsMax = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	memset(&m_optimization, 0, sizeof(m_optimization));
+	m_fromCache = false;
+}
+
+MeshLoaderClass::MeshLoaderClass(const MeshLoaderClass &)
+{
+}
+
+
+MeshLoaderClass::~MeshLoaderClass()
+{
+}
+
+/*
+ *	Load()
+ *	brief: Loads a mesh from its cache if it is up to date, or else imports the OBJ or PLY file and writes the cache.
+ *		   A cache without its source file is loaded as it is, so meshes can be shipped only as caches.
+ *	param filename: The OBJ or PLY file. The cache is the same name plus MESH_CACHE_EXTENSION.
+ */
+bool MeshLoaderClass::Load(const char* filename)
+{
+	std::string cacheFilename;
+	unsigned long long sourceSize, sourceTime;
+	bool sourceFound;
+
+	Unload();
+
+	cacheFilename = std::string(filename) + MESH_CACHE_EXTENSION;
+	sourceFound = GetFileInfo(filename, sourceSize, sourceTime);
+
+	if (OpenCache(cacheFilename.c_str(), sourceFound, sourceSize, sourceTime))
+	{
+		m_fromCache = true;
+		return true;
+	}
+
+	if (!sourceFound || !Import(filename))
+	{
+		Unload();
+		return false;
+	}
+
+	//Read the mesh back from the new cache, so it is in the same memory in both cases. If the cache can't be
+	//written (a read only folder) the imported arrays are used instead.
+	if (WriteCache(cacheFilename.c_str(), sourceSize, sourceTime) &&
+		OpenCache(cacheFilename.c_str(), true, sourceSize, sourceTime))
+	{
+		std::vector<MeshVertex>().swap(m_importedVertices);
+		std::vector<unsigned int>().swap(m_importedIndices);
+	}
+
+	return true;
+}
+
+void MeshLoaderClass::Unload()
+{
+	m_cacheFile.Close();
+	std::vector<MeshVertex>().swap(m_importedVertices);
+	std::vector<unsigned int>().swap(m_importedIndices);
+
+	m_vertices = nullptr;
+	m_indices = nullptr;
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_fromCache = false;
+}
+
+const MeshVertex* MeshLoaderClass::GetVertices()
+{
+	return m_vertices;
+}
+
+const unsigned int* MeshLoaderClass::GetIndices()
+{
+	return m_indices;
+}
+
+unsigned int MeshLoaderClass::GetVertexCount()
+{
+	return m_vertexCount;
+}
+
+unsigned int MeshLoaderClass::GetIndexCount()
+{
+	return m_indexCount;
+}
+
+void MeshLoaderClass::GetBounds(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax)
+{
+	boundsMin = m_boundsMin;
+	boundsMax = m_boundsMax;
+}
+
+void MeshLoaderClass::GetOptimizationReport(MeshOptimizationReport& report)
+{
+	report = m_optimization;
+}
+
+//Whether the last Load() found an up to date cache instead of importing the file.
+bool MeshLoaderClass::IsFromCache()
+{
+	return m_fromCache;
+}
+
+/*
+ *	OpenCache()
+ *	brief: Maps a cache file and points the vertices and indices to its blocks after checking they fit in it.
+ *	param checkSource: Whether the cache has to be made from a source file with that size and modification time.
+ */
+bool MeshLoaderClass::OpenCache(const char* cacheFilename, bool checkSource, unsigned long long sourceSize,
+								unsigned long long sourceTime)
+{
+	const MeshCacheHeader* header;
+	unsigned long long fileSize;
+
+	if (!m_cacheFile.Open(cacheFilename))
+	{
+		return false;
+	}
+
+	fileSize = m_cacheFile.GetSize();
+	header = (const MeshCacheHeader*)m_cacheFile.GetData();
+
+	if (fileSize < sizeof(MeshCacheHeader) || memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0 ||
+		header->version != MESH_CACHE_VERSION || header->vertexStride != sizeof(MeshVertex) ||
+		header->indexSize != sizeof(unsigned int) || (checkSource && (header->sourceSize != sourceSize ||
+		header->sourceTime != sourceTime)) || header->vertexOffset % MESH_CACHE_ALIGNMENT != 0 ||
+		header->indexOffset % MESH_CACHE_ALIGNMENT != 0 ||
+		header->vertexOffset + (unsigned long long)header->vertexCount * header->vertexStride > fileSize ||
+		header->indexOffset + (unsigned long long)header->indexCount * header->indexSize > fileSize)
+	{
+		m_cacheFile.Close();
+		return false;
+	}
+
+	m_vertices = (const MeshVertex*)(m_cacheFile.GetData() + header->vertexOffset);
+	m_indices = (const unsigned int*)(m_cacheFile.GetData() + header->indexOffset);
+	m_vertexCount = header->vertexCount;
+	m_indexCount = header->indexCount;
+	m_boundsMin = header->boundsMin;
+	m_boundsMax = header->boundsMax;
+	m_optimization = header->optimization;
+	return true;
+}
+
+/*
+ *	Import()
+ *	brief: Parses the OBJ or PLY file, chosen by its extension, into the imported arrays and computes the bounds.
+ */
+bool MeshLoaderClass::Import(const char* filename)
+{
+	MappedFileClass sourceFile;
+	bool bResult;
+
+	if (!sourceFile.Open(filename))
+	{
+		return false;
+	}
+
+	if (HasExtension(filename, ".obj"))
+	{
+		bResult = ImportObj((const char*)sourceFile.GetData(), sourceFile.GetSize(), m_importedVertices, m_importedIndices);
+	}
+	else if (HasExtension(filename, ".ply"))
+	{
+		bResult = ImportPly((const char*)sourceFile.GetData(), sourceFile.GetSize(), m_importedVertices, m_importedIndices);
+	}
+	else
+	{
+		bResult = false;
+	}
+
+	sourceFile.Close();
+
+	//Meshes without triangles, or too big for 32 bit indices, can't be drawn.
+	if (!bResult || m_importedIndices.empty() || m_importedVertices.size() > 0xffffffffULL ||
+		m_importedIndices.size() > 0xffffffffULL)
+	{
+		return false;
+	}
+
+	//Reorder once here so every load from the cache gets the optimized mesh.
+	m_importedVertices.resize(OptimizeMesh(&m_importedVertices[0], &m_importedIndices[0], (unsigned int)m_importedIndices.size(),
+										   (unsigned int)m_importedVertices.size(), sizeof(MeshVertex), m_optimization));
+
+	m_boundsMin = m_importedVertices[0].position;
+	m_boundsMax = m_importedVertices[0].position;
+	for (size_t i = 1; i < m_importedVertices.size(); i++)
+	{
+		const XMFLOAT3& position = m_importedVertices[i].position;
+
+		m_boundsMin = XMFLOAT3(std::min(m_boundsMin.x, position.x), std::min(m_boundsMin.y, position.y), std::min(m_boundsMin.z, position.z));
+		m_boundsMax = XMFLOAT3(std::max(m_boundsMax.x, position.x), std::max(m_boundsMax.y, position.y), std::max(m_boundsMax.z, position.z));
+	}
+
+	m_vertices = &m_importedVertices[0];
+	m_indices = &m_importedIndices[0];
+	m_vertexCount = (unsigned int)m_importedVertices.size();
+	m_indexCount = (unsigned int)m_importedIndices.size();
+	return true;
+}
+
+/*
+ *	WriteCache()
+ *	brief: Saves the imported mesh as a cache file. It is written to a temporary file first and then renamed, so a
+ *		   crash halfway never leaves a broken cache behind.
+ */
+bool MeshLoaderClass::WriteCache(const char* cacheFilename, unsigned long long sourceSize, unsigned long long sourceTime)
+{
+	MeshCacheHeader header = {};
+	std::string temporaryFilename;
+	std::ofstream fout;
+	char padding[MESH_CACHE_ALIGNMENT];
+
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.vertexCount = m_vertexCount;
+	header.indexCount = m_indexCount;
+	header.vertexStride = sizeof(MeshVertex);
+	header.indexSize = sizeof(unsigned int);
+	header.vertexOffset = AlignCacheOffset(sizeof(MeshCacheHeader));
+	header.indexOffset = AlignCacheOffset(header.vertexOffset + (unsigned long long)m_vertexCount * sizeof(MeshVertex));
+	header.boundsMin = m_boundsMin;
+	header.boundsMax = m_boundsMax;
+	header.optimization = m_optimization;
+
+	memset(padding, 0, sizeof(padding));
+	temporaryFilename = std::string(cacheFilename) + ".tmp";
+
+	fout.open(temporaryFilename.c_str(), std::ios::binary);
+	if (!fout)
+	{
+		return false;
+	}
+
+	fout.write((const char*)&header, sizeof(header));
+	fout.write(padding, header.vertexOffset - sizeof(header));
+	fout.write((const char*)m_vertices, (std::streamsize)m_vertexCount * sizeof(MeshVertex));
+	fout.write(padding, header.indexOffset - header.vertexOffset - (unsigned long long)m_vertexCount * sizeof(MeshVertex));
+	fout.write((const char*)m_indices, (std::streamsize)m_indexCount * sizeof(unsigned int));
+	fout.close();
+
+	if (!fout)
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	//Replace the old cache, if there was one.
+	remove(cacheFilename);
+	if (rename(temporaryFilename.c_str(), cacheFilename) != 0)
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef MESH_LOADER
+#define MESH_LOADER
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include <DirectXMath.h>
+#include <vector>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const char		   MESH_CACHE_EXTENSION[] = ".meshcache";	//Appended to the name of the source file.
+const unsigned int MESH_CACHE_VERSION = 2;
+const unsigned int MESH_CACHE_ALIGNMENT = 64;				//Of the vertex and index blocks inside the file.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//The vertex of the imported meshes. It is the layout ModelClass uploads and ColorShader reads.
+struct MeshVertex
+{
+	XMFLOAT3 position;
+	XMFLOAT4 color;
+};
+
+/*First bytes of a cache file. The vertices and indices follow in blocks aligned to MESH_CACHE_ALIGNMENT, already
+  in the layout of the vertex and index buffers.*/
+struct MeshCacheHeader
+{
+	char			   magic[4];		//"GEMC"
+	unsigned int	   version;
+	unsigned long long sourceSize;		//Size and modification time of the OBJ or PLY file it was made from.
+	unsigned long long sourceTime;
+	unsigned int	   vertexCount;
+	unsigned int	   indexCount;
+	unsigned int	   vertexStride;
+	unsigned int	   indexSize;
+	unsigned long long vertexOffset;
+	unsigned long long indexOffset;
+	XMFLOAT3		   boundsMin;
+	XMFLOAT3		   boundsMax;
+	MeshOptimizationReport optimization;	//Vertex cache statistics of the indices before and after the import.
+};
+
+/*
+ *	MeshLoaderClass
+ *	brief: Loads triangle meshes from OBJ and PLY files. The first time a file is loaded it is parsed and saved
+ *		   next to it as a binary cache. The next times the cache is memory mapped and its vertices and indices
+ *		   are handed out as they are in the file, without parsing or copying them.
+ *		   The imported triangles are reordered for the vertex cache and overdraw, and the vertices for fetching,
+		   before the cache is written.
+		   Both formats are right handed with counter clockwise front faces, so z is negated and the winding
+ *		   reversed to get the left handed, clockwise front faces of the engine.
+ */
+class MeshLoaderClass
+{
+public:
+	MeshLoaderClass();
+	MeshLoaderClass(const MeshLoaderClass&);
+	~MeshLoaderClass();
+
+	bool Load(const char* filename);
+	void Unload();
+
+	//Valid until Unload().
+	const MeshVertex* GetVertices();
+	const unsigned int* GetIndices();
+	unsigned int GetVertexCount();
+	unsigned int GetIndexCount();
+	void GetBounds(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax);
+	void GetOptimizationReport(MeshOptimizationReport& report);
+	bool IsFromCache();
+
+private:
+	bool OpenCache(const char* cacheFilename, bool checkSource, unsigned long long sourceSize,
+				   unsigned long long sourceTime);
+	bool Import(const char* filename);
+	bool WriteCache(const char* cacheFilename, unsigned long long sourceSize, unsigned long long sourceTime);
+
+private:
+	MappedFileClass			  m_cacheFile;
+	std::vector<MeshVertex>	  m_importedVertices;	//Only used when the cache couldn't be written.
+	std::vector<unsigned int> m_importedIndices;
+	const MeshVertex*		  m_vertices;
+	const unsigned int*		  m_indices;
+	unsigned int			  m_vertexCount, m_indexCount;
+	XMFLOAT3				  m_boundsMin, m_boundsMax;
+	MeshOptimizationReport	  m_optimization;
+	bool					  m_fromCache;
+};
+
+#endif
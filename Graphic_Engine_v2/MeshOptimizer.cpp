@@ -0,0 +1,473 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/* Scoring of the vertex cache optimization, from Tom Forsyth's "Linear-*/
+/* Speed Vertex Cache Optimisation".                                    */
+/************************************************************************/
+static const int   FORSYTH_CACHE_SIZE = 32;			//Cache modeled by the scores, bigger than the real one on purpose.
+static const float FORSYTH_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;	//Vertices of the last triangle, which are scored lower so the
+														//next triangle doesn't just walk back over them.
+static const float FORSYTH_VALENCE_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_POWER = 0.5f;
+static const unsigned int FORSYTH_VALENCE_TABLE_SIZE = 64;		//Valences scored from a table instead of powf().
+
+/************************************************************************/
+/* VERTEX CACHE                                                         */
+/************************************************************************/
+
+/*
+ *	UpdateFifoCache()
+ *	brief: Simulates a FIFO cache with timestamps: a vertex is cached while less than cacheSize misses happened
+ *		   after its own one.
+ *	return: The number of misses of the triangle.
+ */
+static unsigned int UpdateFifoCache(const unsigned int* triangle, unsigned int cacheSize, unsigned int* timestamps,
+									unsigned int& timestamp)
+{
+	unsigned int misses = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (timestamp - timestamps[triangle[i]] > cacheSize)
+		{
+			timestamps[triangle[i]] = timestamp++;
+			misses++;
+		}
+	}
+
+	return misses;
+}
+
+void AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+						unsigned int cacheSize, VertexCacheStatistics& statistics)
+{
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int timestamp = cacheSize + 1;
+	unsigned int usedVertices = 0;
+
+	statistics.transformedVertices = 0;
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		statistics.transformedVertices += UpdateFifoCache(&indices[i], cacheSize, &timestamps[0], timestamp);
+	}
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		if (!used[indices[i]])
+		{
+			used[indices[i]] = true;
+			usedVertices++;
+		}
+	}
+
+	statistics.acmr = indexCount >= 3 ? (float)statistics.transformedVertices / (float)(indexCount / 3) : 0.0f;
+	statistics.atvr = usedVertices ? (float)statistics.transformedVertices / (float)usedVertices : 0.0f;
+}
+
+//Scores of the positions in the modeled cache and of the common valences, filled once.
+struct ForsythScoreTables
+{
+	float position[FORSYTH_CACHE_SIZE + 1];		//Entry 0 is for the vertices outside the cache.
+	float valence[FORSYTH_VALENCE_TABLE_SIZE];
+
+	ForsythScoreTables()
+	{
+		position[0] = 0.0f;
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+		{
+			if (i < 3)
+			{
+				position[i + 1] = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else
+			{
+				position[i + 1] = powf(1.0f - (float)(i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), FORSYTH_DECAY_POWER);
+			}
+		}
+
+		valence[0] = 0.0f;
+		for (unsigned int i = 1; i < FORSYTH_VALENCE_TABLE_SIZE; i++)
+		{
+			valence[i] = FORSYTH_VALENCE_SCALE * powf((float)i, -FORSYTH_VALENCE_POWER);
+		}
+	}
+};
+
+/*
+ *	ForsythVertexScore()
+ *	brief: Scores a vertex from its position in the modeled cache, or -1 if it isn't there, and its live triangles.
+ */
+static float ForsythVertexScore(int cachePosition, unsigned int liveTriangles)
+{
+	static const ForsythScoreTables tables;
+	float score;
+
+	//Vertices without triangles left must never be chosen again.
+	if (liveTriangles == 0)
+	{
+		return -1.0f;
+	}
+
+	score = tables.position[cachePosition + 1];
+
+	//Boost the vertices with few triangles left, to finish them off instead of leaving lone triangles behind.
+	if (liveTriangles < FORSYTH_VALENCE_TABLE_SIZE)
+	{
+		score += tables.valence[liveTriangles];
+	}
+	else
+	{
+		score += FORSYTH_VALENCE_SCALE * powf((float)liveTriangles, -FORSYTH_VALENCE_POWER);
+	}
+	return score;
+}
+
+/*
+ *	OptimizeVertexCache()
+ *	brief: Reorders the triangles so they reuse the vertices transformed by the ones before them. The triangle whose
+ *		   vertices score best is drawn next; only the triangles of the vertices in the modeled cache are rescored,
+ *		   which keeps it linear in the number of triangles.
+ */
+void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	unsigned int triangleCount = indexCount / 3;
+	std::vector<unsigned int> liveTriangles(vertexCount, 0), adjacencyOffsets(vertexCount + 1, 0), adjacency(triangleCount * 3);
+	std::vector<float> vertexScores(vertexCount);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<unsigned int> output(triangleCount * 3);
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3], newCache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0, newCacheCount, cursor = 0, vertex;
+	int bestTriangle = -1;
+	float bestScore, score;
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	//Build the list of triangles of every vertex.
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		liveTriangles[indices[i]]++;
+	}
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		adjacencyOffsets[i + 1] = adjacencyOffsets[i] + liveTriangles[i];
+	}
+	std::vector<unsigned int> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (unsigned int i = 0; i < triangleCount * 3; i++)
+	{
+		adjacency[adjacencyFill[indices[i]]++] = i / 3;
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		vertexScores[i] = ForsythVertexScore(-1, liveTriangles[i]);
+	}
+
+	bestScore = -1.0f;
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		score = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestTriangle = (int)i;
+		}
+	}
+
+	for (unsigned int emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		//When none of the cached vertices has triangles left, go on with the next triangle in the original order.
+		if (bestTriangle < 0)
+		{
+			while (emitted[cursor])
+			{
+				cursor++;
+			}
+			bestTriangle = (int)cursor;
+		}
+
+		const unsigned int* triangle = &indices[bestTriangle * 3];
+		memcpy(&output[emittedCount * 3], triangle, 3 * sizeof(unsigned int));
+		emitted[bestTriangle] = true;
+
+		//Take the triangle out of the lists of its vertices and put them at the front of the cache.
+		newCacheCount = 0;
+		for (int i = 0; i < 3; i++)
+		{
+			vertex = triangle[i];
+
+			unsigned int* triangles = &adjacency[adjacencyOffsets[vertex]];
+			for (unsigned int j = 0; j < liveTriangles[vertex]; j++)
+			{
+				if (triangles[j] == (unsigned int)bestTriangle)
+				{
+					triangles[j] = triangles[liveTriangles[vertex] - 1];
+					break;
+				}
+			}
+			liveTriangles[vertex]--;
+
+			newCache[newCacheCount++] = vertex;
+		}
+
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			vertex = cache[i];
+			if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2])
+			{
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+
+		//Rescore the cached vertices. The ones pushed out of the cache lose their position score.
+		for (unsigned int i = 0; i < newCacheCount; i++)
+		{
+			vertex = newCache[i];
+			vertexScores[vertex] = ForsythVertexScore(i < FORSYTH_CACHE_SIZE ? (int)i : -1, liveTriangles[vertex]);
+		}
+
+		cacheCount = std::min(newCacheCount, (unsigned int)FORSYTH_CACHE_SIZE);
+		memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+		//Rescore the triangles left of the cached vertices and pick the best one.
+		bestTriangle = -1;
+		bestScore = -1.0f;
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			vertex = cache[i];
+			const unsigned int* triangles = &adjacency[adjacencyOffsets[vertex]];
+
+			for (unsigned int j = 0; j < liveTriangles[vertex]; j++)
+			{
+				const unsigned int* candidate = &indices[triangles[j] * 3];
+				score = vertexScores[candidate[0]] + vertexScores[candidate[1]] + vertexScores[candidate[2]];
+
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = (int)triangles[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, &output[0], triangleCount * 3 * sizeof(unsigned int));
+}
+
+/************************************************************************/
+/* OVERDRAW                                                             */
+/************************************************************************/
+
+/*
+ *	OptimizeOverdraw()
+ *	brief: Reorders clusters of the triangles so the ones facing out of the mesh are drawn first and hide the ones
+ *		   behind them, after "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al.).
+ *		   The indices have to be optimized for the vertex cache first: the clusters are split where the cache
+ *		   starts over, and then wherever their ACMR so far is within the threshold of the whole cluster, so
+ *		   moving them around costs at most that much.
+ *	param threshold: How much worse the ACMR may get, OVERDRAW_THRESHOLD is a good default.
+ */
+void OptimizeOverdraw(unsigned int* indices, unsigned int indexCount, const void* vertices, unsigned int vertexCount,
+					  unsigned int vertexSize, float threshold)
+{
+	unsigned int triangleCount = indexCount / 3;
+	std::vector<unsigned int> timestamps(vertexCount, 0), hardBoundaries, clusters, order;
+	std::vector<float> sortKeys;
+	std::vector<unsigned int> output;
+	unsigned int timestamp = VERTEX_CACHE_SIZE + 1;
+	unsigned int misses, runningMisses, runningTriangles;
+	float meshCenter[3] = { 0.0f, 0.0f, 0.0f }, meshArea = 0.0f;
+
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	//Triangles with all their vertices missing in the cache usually start a new patch of the mesh.
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		misses = UpdateFifoCache(&indices[i * 3], VERTEX_CACHE_SIZE, &timestamps[0], timestamp);
+		if (i == 0 || misses == 3)
+		{
+			hardBoundaries.push_back(i);
+		}
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	for (size_t c = 0; c + 1 < hardBoundaries.size(); c++)
+	{
+		unsigned int start = hardBoundaries[c], end = hardBoundaries[c + 1];
+		float clusterThreshold;
+
+		//ACMR of the whole cluster, from a cold cache.
+		misses = 0;
+		timestamp += VERTEX_CACHE_SIZE + 1;
+		for (unsigned int i = start; i < end; i++)
+		{
+			misses += UpdateFifoCache(&indices[i * 3], VERTEX_CACHE_SIZE, &timestamps[0], timestamp);
+		}
+		clusterThreshold = threshold * (float)misses / (float)(end - start);
+
+		clusters.push_back(start);
+		runningMisses = 0;
+		runningTriangles = 0;
+		timestamp += VERTEX_CACHE_SIZE + 1;
+		for (unsigned int i = start; i < end; i++)
+		{
+			runningMisses += UpdateFifoCache(&indices[i * 3], VERTEX_CACHE_SIZE, &timestamps[0], timestamp);
+			runningTriangles++;
+
+			if (i + 1 < end && (float)runningMisses / (float)runningTriangles <= clusterThreshold)
+			{
+				clusters.push_back(i + 1);
+				runningMisses = 0;
+				runningTriangles = 0;
+				timestamp += VERTEX_CACHE_SIZE + 1;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	//Area weighted center of the mesh.
+	const unsigned char* bytes = (const unsigned char*)vertices;
+	std::vector<float> triangleData(triangleCount * 7);
+	for (unsigned int i = 0; i < triangleCount; i++)
+	{
+		float p[3][3], e1[3], e2[3], normal[3], area;
+
+		for (int v = 0; v < 3; v++)
+		{
+			memcpy(p[v], bytes + (size_t)indices[i * 3 + v] * vertexSize, 3 * sizeof(float));
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			e1[k] = p[1][k] - p[0][k];
+			e2[k] = p[2][k] - p[0][k];
+		}
+		normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+		//Keep the center times the area and the normal, whose length is already twice the area.
+		for (int k = 0; k < 3; k++)
+		{
+			triangleData[i * 7 + k] = (p[0][k] + p[1][k] + p[2][k]) / 3.0f * area;
+			triangleData[i * 7 + 3 + k] = normal[k];
+			meshCenter[k] += triangleData[i * 7 + k];
+		}
+		triangleData[i * 7 + 6] = area;
+		meshArea += area;
+	}
+	for (int k = 0; k < 3; k++)
+	{
+		meshCenter[k] = meshArea > 0.0f ? meshCenter[k] / meshArea : 0.0f;
+	}
+
+	//The more a cluster faces away from the center, the more likely it hides the rest, so the sooner it is drawn.
+	sortKeys.resize(clusters.size() - 1);
+	order.resize(clusters.size() - 1);
+	for (size_t c = 0; c + 1 < clusters.size(); c++)
+	{
+		float center[3] = { 0.0f, 0.0f, 0.0f }, normal[3] = { 0.0f, 0.0f, 0.0f }, area = 0.0f, length;
+
+		for (unsigned int i = clusters[c]; i < clusters[c + 1]; i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				center[k] += triangleData[i * 7 + k];
+				normal[k] += triangleData[i * 7 + 3 + k];
+			}
+			area += triangleData[i * 7 + 6];
+		}
+
+		length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		sortKeys[c] = 0.0f;
+		if (area > 0.0f && length > 0.0f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				sortKeys[c] += (center[k] / area - meshCenter[k]) * normal[k] / length;
+			}
+		}
+		order[c] = (unsigned int)c;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](unsigned int a, unsigned int b)
+	{
+		return sortKeys[a] > sortKeys[b];
+	});
+
+	output.reserve(triangleCount * 3);
+	for (size_t c = 0; c < order.size(); c++)
+	{
+		output.insert(output.end(), indices + clusters[order[c]] * 3, indices + clusters[order[c] + 1] * 3);
+	}
+	memcpy(indices, &output[0], triangleCount * 3 * sizeof(unsigned int));
+}
+
+/************************************************************************/
+/* VERTEX FETCH                                                         */
+/************************************************************************/
+
+/*
+ *	OptimizeVertexFetch()
+ *	brief: Sorts the vertices in the order the indices first use them, so the input assembler reads the vertex buffer
+ *		   forwards, and remaps the indices. Vertices no index uses are dropped.
+ *	return: The number of vertices left.
+ */
+unsigned int OptimizeVertexFetch(void* vertices, unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+								 unsigned int vertexSize)
+{
+	const unsigned int unused = 0xffffffff;
+	std::vector<unsigned int> remap(vertexCount, unused);
+	std::vector<unsigned char> sorted((size_t)vertexCount * vertexSize);
+	unsigned char* bytes = (unsigned char*)vertices;
+	unsigned int newVertexCount = 0;
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int& newIndex = remap[indices[i]];
+
+		if (newIndex == unused)
+		{
+			newIndex = newVertexCount++;
+			memcpy(&sorted[(size_t)newIndex * vertexSize], bytes + (size_t)indices[i] * vertexSize, vertexSize);
+		}
+		indices[i] = newIndex;
+	}
+
+	if (newVertexCount)
+	{
+		memcpy(vertices, &sorted[0], (size_t)newVertexCount * vertexSize);
+	}
+	return newVertexCount;
+}
+
+/*
+ *	OptimizeMesh()
+ *	brief: Runs the vertex cache, overdraw and vertex fetch optimizations in that order, and measures the vertex
+ *		   cache before and after.
+ *	return: The number of vertices left.
+ */
+unsigned int OptimizeMesh(void* vertices, unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+						  unsigned int vertexSize, MeshOptimizationReport& report)
+{
+	AnalyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE, report.before);
+
+	OptimizeVertexCache(indices, indexCount, vertexCount);
+	OptimizeOverdraw(indices, indexCount, vertices, vertexCount, vertexSize, OVERDRAW_THRESHOLD);
+	vertexCount = OptimizeVertexFetch(vertices, indices, indexCount, vertexCount, vertexSize);
+
+	AnalyzeVertexCache(indices, indexCount, vertexCount, VERTEX_CACHE_SIZE, report.after);
+	return vertexCount;
+}
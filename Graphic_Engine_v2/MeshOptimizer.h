@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef MESH_OPTIMIZER
+#define MESH_OPTIMIZER
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int VERTEX_CACHE_SIZE = 16;		//Entries of the FIFO post transform cache the statistics simulate.
+const float		   OVERDRAW_THRESHOLD = 1.05f;	//How much worse the ACMR may get to reorder triangles against overdraw.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*	How many times the vertex shader runs for an index buffer on a FIFO post transform cache.
+	ACMR is the average per triangle, 0.5 at best on big regular meshes and 3 at worst.
+	ATVR is the average per vertex, 1 at best.												*/
+struct VertexCacheStatistics
+{
+	unsigned int transformedVertices;
+	float		 acmr;
+	float		 atvr;
+};
+
+struct MeshOptimizationReport
+{
+	VertexCacheStatistics before;
+	VertexCacheStatistics after;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/* Every function works on triangle lists with 32 bit indices. The     */
+/* vertices are only seen as bytes of vertexSize, with the position as */
+/* three floats at the start.                                           */
+/************************************************************************/
+void AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+						unsigned int cacheSize, VertexCacheStatistics& statistics);
+void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+void OptimizeOverdraw(unsigned int* indices, unsigned int indexCount, const void* vertices, unsigned int vertexCount,
+					  unsigned int vertexSize, float threshold);
+unsigned int OptimizeVertexFetch(void* vertices, unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+								 unsigned int vertexSize);
+unsigned int OptimizeMesh(void* vertices, unsigned int* indices, unsigned int indexCount, unsigned int vertexCount,
+						  unsigned int vertexSize, MeshOptimizationReport& report);
+
+#endif
@@ -1,13 +1,29 @@
 #include "ModelClass.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 
 
 ModelClass::ModelClass()
 {
+	m_device = nullptr;
 	m_vertexBuffer = nullptr;
 	m_indexBuffer = nullptr;
+	m_instanceBuffer = nullptr;
 	m_indexCount = 0;
 	m_vertexCount = 0;
+	m_instanceCount = 0;
+	m_instanceCapacity = 0;
+	m_vertexFormat = VERTEX_FORMAT_FULL;
+	m_indexFormat = INDEX_FORMAT_UINT32;
+	XMStoreFloat4x4(&m_positionMatrix, XMMatrixIdentity());
+	ComputeBoundingVolume(nullptr, 0, sizeof(VertexType), m_bounds);
+}
+
+
+ModelClass::ModelClass(const ModelClass &)
+{
 }
 
 
@@ -15,12 +31,33 @@ ModelClass::~ModelClass()
 {
 }
 
-bool ModelClass::Initialize(ID3D11Device* device)
+/*
+ *	Initialize()
+ *	brief: Creates the vertex and index buffers of the model.
+ *	param modelFilename: OBJ or PLY file to load through MeshLoaderClass, or nullptr for the built in triangle.
+ *	param vertexFormat: Layout of the vertex buffer. The packed one takes less than half the memory, but its
+ *		  positions are rounded to 1/65535 of the size of the mesh.
+ *	param scratch: Where the data converted for the buffers is staged, freed back to where it was once they are
+ *		  created. If null, or if the data doesn't fit, it goes to the heap.
+ */
+bool ModelClass::Initialize(RenderDevice* device, const char* modelFilename, VertexFormat vertexFormat,
+							LinearAllocatorClass* scratch)
 {
 	bool bResult;
 
+	//Keep the device that owns the buffers so they can be released on shutdown.
+	m_device = device;
+	m_vertexFormat = vertexFormat;
+
 	//Initialize vertex and index buffers.
-	bResult = InitializeBuffers(device);
+	if (modelFilename)
+	{
+		bResult = LoadModel(device, modelFilename, scratch);
+	}
+	else
+	{
+		bResult = InitializeBuffers(device);
+	}
 
 	if (!bResult)
 	{
@@ -36,9 +73,93 @@ void ModelClass::Shutdown()
 	ShutdownBuffers();
 }
 
-void ModelClass::Render(ID3D11DeviceContext* deviceContext)
+void ModelClass::Render(RenderContext* context)
+{
+	RenderBuffers(context);
+}
+
+/*
+ *	SetInstances()
+ *	brief: Fills the instance buffer with the copies of the model to draw with RenderInstanced(). The buffer only
+ *		   grows, so setting the same amount or less every frame just rewrites it.
+ *	param instances: The world matrix and color of every copy.
+ *	param instanceCount: The number of copies.
+ */
+bool ModelClass::SetInstances(RenderDevice* device, const InstanceType* instances, int instanceCount)
+{
+	BufferDesc instanceBufferDesc;
+	InstanceType* bufferData;
+	bool bResult;
+
+	if (instanceCount > m_instanceCapacity)
+	{
+		// Release the old instance buffer, it is too small.
+		if (m_instanceBuffer)
+		{
+			m_device->ReleaseBuffer(m_instanceBuffer);
+			m_instanceBuffer = nullptr;
+		}
+		m_instanceCapacity = 0;
+
+		// Set up the description of the dynamic instance buffer.
+		instanceBufferDesc.bindType = BUFFER_BIND_VERTEX;
+		instanceBufferDesc.byteWidth = sizeof(InstanceType) * instanceCount;
+		instanceBufferDesc.dynamic = true;
+
+		bResult = device->CreateBuffer(instanceBufferDesc, NULL, &m_instanceBuffer);
+		if (!bResult)
+		{
+			m_instanceCount = 0;
+			return false;
+		}
+		m_instanceCapacity = instanceCount;
+	}
+
+	m_instanceCount = instanceCount;
+	if (instanceCount == 0)
+	{
+		return true;
+	}
+
+	// Lock the instance buffer and copy the instances into it.
+	bufferData = (InstanceType*)device->MapBuffer(m_instanceBuffer);
+	if (!bufferData)
+	{
+		m_instanceCount = 0;
+		return false;
+	}
+
+	// Packed positions have to be taken back to object space before the world matrix of every copy.
+	if (m_vertexFormat == VERTEX_FORMAT_PACKED)
+	{
+		XMMATRIX positionMatrix = XMLoadFloat4x4(&m_positionMatrix);
+
+		for (int i = 0; i < instanceCount; i++)
+		{
+			XMStoreFloat4x4(&bufferData[i].world, XMMatrixMultiply(positionMatrix, XMLoadFloat4x4(&instances[i].world)));
+			bufferData[i].color = instances[i].color;
+		}
+	}
+	else
+	{
+		memcpy(bufferData, instances, sizeof(InstanceType) * instanceCount);
+	}
+
+	device->UnmapBuffer(m_instanceBuffer);
+
+	return true;
+}
+
+/*
+ *	RenderInstanced()
+ *	brief: Puts the vertex, index and instance buffers on the pipeline to draw every copy of the model at once.
+ */
+void ModelClass::RenderInstanced(RenderContext* context)
 {
-	RenderBuffers(deviceContext);
+	RenderBuffers(context);
+
+	// The instances go in the second slot, after the vertices.
+	context->SetVertexBuffer(1, m_instanceBuffer, sizeof(InstanceType), 0);
 }
 
 int ModelClass::GetIndexCount()
@@ -46,13 +167,45 @@ int ModelClass::GetIndexCount()
 	return m_indexCount;
 }
 
-bool ModelClass::InitializeBuffers(ID3D11Device* device)
+int ModelClass::GetInstanceCount()
+{
+	return m_instanceCount;
+}
+
+VertexFormat ModelClass::GetVertexFormat()
 {
-	VertexType* vertices;
-	unsigned long* indices;
-	D3D11_BUFFER_DESC vertexBufferDesc, indexBufferDesc;
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-	HRESULT hResult;
+	return m_vertexFormat;
+}
+
+//Bytes taken by the vertex and index buffers.
+unsigned int ModelClass::GetBufferMemory()
+{
+	return m_vertexCount * (m_vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertexType) : sizeof(VertexType)) +
+		   m_indexCount * (m_indexFormat == INDEX_FORMAT_UINT16 ? sizeof(unsigned short) : sizeof(unsigned int));
+}
+
+//Bounds of the model in object space, to test against the view with a FrustumClass.
+void ModelClass::GetBoundingVolume(BoundingVolume& bounds)
+{
+	bounds = m_bounds;
+}
+
+/*
+ *	GetPositionMatrix()
+ *	brief: Gets the matrix that takes the positions in the vertex buffer to object space. It has to go before the
+ *		   world matrix. It is the identity unless the vertices are packed.
+ */
+void ModelClass::GetPositionMatrix(XMMATRIX& positionMatrix)
+{
+	positionMatrix = XMLoadFloat4x4(&m_positionMatrix);
+}
+
+bool ModelClass::InitializeBuffers(RenderDevice* device)
+{
+	//The triangle is small enough to build on the stack.
+	VertexType vertices[3];
+	unsigned int indices[3];
+	bool bResult;
 
 	//Set the number of vertices in the vertex array.
 	m_vertexCount = 3;
@@ -60,20 +213,6 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 	//Set the number of indices in the index array.
 	m_indexCount = 3;
 
-	//Create vertex array.
-	vertices = new VertexType[m_vertexCount];
-	if (!vertices)
-	{
-		return false;
-	}
-
-	//Create index array.
-	indices = new unsigned long[m_indexCount];
-	if (!indices)
-	{
-		return false;
-	}
-
 	// Load the vertex array with data.
 	vertices[0].position = XMFLOAT3(-1.0f, -1.0f, 0.0f);  // Bottom left.
 	vertices[0].color = XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
@@ -89,90 +228,207 @@ bool ModelClass::InitializeBuffers(ID3D11Device* device)
 	indices[1] = 1;  // Top middle.
 	indices[2] = 2;  // Bottom right.
 
+	//It is copied to the buffers, so there is nothing to stage.
+	bResult = CreateBuffers(device, vertices, indices, nullptr);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ *	LoadModel()
+ *	brief: Loads a mesh file and creates the buffers straight from the memory the loader hands out, which is the
+ *		   mapped cache file once the mesh has been imported.
+ */
+bool ModelClass::LoadModel(RenderDevice* device, const char* modelFilename, LinearAllocatorClass* scratch)
+{
+	MeshLoaderClass meshLoader;
+	size_t marker;
+	bool bResult;
+
+	bResult = meshLoader.Load(modelFilename);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	m_vertexCount = (int)meshLoader.GetVertexCount();
+	m_indexCount = (int)meshLoader.GetIndexCount();
+
+	//What is staged for the buffers is only needed until they are created.
+	marker = scratch ? scratch->GetMarker() : 0;
+	bResult = CreateBuffers(device, meshLoader.GetVertices(), meshLoader.GetIndices(), scratch);
+	if (scratch)
+	{
+		scratch->FreeToMarker(marker);
+	}
+
+	meshLoader.Unload();
+
+	return bResult;
+}
+
+/*
+ *	CreateBuffers()
+ *	brief: Creates the vertex buffer in the vertex format of the model and the index buffer with 16 bit indices
+ *		   when every vertex fits in them, or else 32 bit ones. The converted vertices and indices are staged in
+ *		   the scratch allocator, and left there for the caller to free.
+ */
+bool ModelClass::CreateBuffers(RenderDevice* device, const VertexType* vertices, const unsigned int* indices,
+							   LinearAllocatorClass* scratch)
+{
+	BufferDesc vertexBufferDesc, indexBufferDesc;
+	std::vector<PackedVertexType> heapVertices;
+	std::vector<unsigned short> heapIndices;
+	PackedVertexType* packedVertices;
+	unsigned short* shortIndices;
+	const void* vertexData;
+	const void* indexData;
+	XMFLOAT3 boundsMin;
+	float extent[3];
+	bool bResult;
+
+	vertexData = vertices;
+	vertexBufferDesc.byteWidth = sizeof(VertexType) * m_vertexCount;
+	XMStoreFloat4x4(&m_positionMatrix, XMMatrixIdentity());
+
+	// Keep the bounds of the mesh to cull it.
+	ComputeBoundingVolume(vertices, m_vertexCount, sizeof(VertexType), m_bounds);
+
+	if (m_vertexFormat == VERTEX_FORMAT_PACKED)
+	{
+		// Quantize the positions inside the bounds of the mesh, and keep the matrix that undoes it.
+		boundsMin = XMFLOAT3(m_bounds.center.x - m_bounds.extent.x, m_bounds.center.y - m_bounds.extent.y,
+							 m_bounds.center.z - m_bounds.extent.z);
+
+		//Flat meshes still need a scale to divide by.
+		extent[0] = m_bounds.extent.x > 0.0f ? 2.0f * m_bounds.extent.x : 1.0f;
+		extent[1] = m_bounds.extent.y > 0.0f ? 2.0f * m_bounds.extent.y : 1.0f;
+		extent[2] = m_bounds.extent.z > 0.0f ? 2.0f * m_bounds.extent.z : 1.0f;
+
+		packedVertices = scratch ? (PackedVertexType*)scratch->Allocate(sizeof(PackedVertexType) * m_vertexCount, 16) : nullptr;
+		if (!packedVertices)
+		{
+			heapVertices.resize(m_vertexCount);
+			packedVertices = &heapVertices[0];
+		}
+
+		for (int i = 0; i < m_vertexCount; i++)
+		{
+			const float* position = &vertices[i].position.x;
+			const float* color = &vertices[i].color.x;
+			const float* origin = &boundsMin.x;
+
+			for (int j = 0; j < 3; j++)
+			{
+				float quantized = (position[j] - origin[j]) / extent[j] * 65535.0f + 0.5f;
+				packedVertices[i].position[j] = (unsigned short)std::min(std::max(quantized, 0.0f), 65535.0f);
+			}
+			packedVertices[i].position[3] = 0;
+
+			for (int j = 0; j < 4; j++)
+			{
+				packedVertices[i].color[j] = (unsigned char)(std::min(std::max(color[j], 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+
+		XMStoreFloat4x4(&m_positionMatrix, XMMatrixMultiply(XMMatrixScaling(extent[0], extent[1], extent[2]),
+															XMMatrixTranslation(boundsMin.x, boundsMin.y, boundsMin.z)));
+		vertexData = packedVertices;
+		vertexBufferDesc.byteWidth = sizeof(PackedVertexType) * m_vertexCount;
+	}
+
 	// Set up the description of the static vertex buffer.
-	vertexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vertexBufferDesc.ByteWidth = sizeof(VertexType) * m_vertexCount;
-	vertexBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	vertexBufferDesc.CPUAccessFlags = 0;
-	vertexBufferDesc.MiscFlags = 0;
-	vertexBufferDesc.StructureByteStride = 0;
-
-	// Give the subresource structure a pointer to the vertex data.
-	vertexData.pSysMem = vertices;
-	vertexData.SysMemPitch = 0;
-	vertexData.SysMemSlicePitch = 0;
+	vertexBufferDesc.bindType = BUFFER_BIND_VERTEX;
+	vertexBufferDesc.dynamic = false;
 
 	// Now create the vertex buffer.
-	hResult = device->CreateBuffer(&vertexBufferDesc, &vertexData, &m_vertexBuffer);
-	if (FAILED(hResult))
+	bResult = device->CreateBuffer(vertexBufferDesc, vertexData, &m_vertexBuffer);
+	if (!bResult)
 	{
 		return false;
 	}
 
+	// Halve the index buffer when the indices fit in 16 bits.
+	if (m_vertexCount <= 65536)
+	{
+		shortIndices = scratch ? (unsigned short*)scratch->Allocate(sizeof(unsigned short) * m_indexCount, 16) : nullptr;
+		if (!shortIndices)
+		{
+			heapIndices.resize(m_indexCount);
+			shortIndices = &heapIndices[0];
+		}
+
+		std::copy(indices, indices + m_indexCount, shortIndices);
+		m_indexFormat = INDEX_FORMAT_UINT16;
+		indexData = shortIndices;
+		indexBufferDesc.byteWidth = sizeof(unsigned short) * m_indexCount;
+	}
+	else
+	{
+		m_indexFormat = INDEX_FORMAT_UINT32;
+		indexData = indices;
+		indexBufferDesc.byteWidth = sizeof(unsigned int) * m_indexCount;
+	}
+
 	// Set up the description of the static index buffer.
-	indexBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	indexBufferDesc.ByteWidth = sizeof(unsigned long) * m_indexCount;
-	indexBufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	indexBufferDesc.CPUAccessFlags = 0;
-	indexBufferDesc.MiscFlags = 0;
-	indexBufferDesc.StructureByteStride = 0;
-
-	// Give the subresource structure a pointer to the index data.
-	indexData.pSysMem = indices;
-	indexData.SysMemPitch = 0;
-	indexData.SysMemSlicePitch = 0;
+	indexBufferDesc.bindType = BUFFER_BIND_INDEX;
+	indexBufferDesc.dynamic = false;
 
 	// Create the index buffer.
-	hResult = device->CreateBuffer(&indexBufferDesc, &indexData, &m_indexBuffer);
-	if (FAILED(hResult))
+	bResult = device->CreateBuffer(indexBufferDesc, indexData, &m_indexBuffer);
+	if (!bResult)
 	{
 		return false;
 	}
-	//After the vertex buffer and index buffer have been created you can delete the vertex and index arrays as they are no longer needed since the data was copied into the buffers.
-
-		// Release the arrays now that the vertex and index buffers have been created and loaded.
-	delete[] vertices;
-	vertices = nullptr;
-
-	delete[] indices;
-	indices = nullptr;
-
 	return true;
 }
 
 void ModelClass::ShutdownBuffers()
 {
+	// Release the instance buffer.
+	if (m_instanceBuffer)
+	{
+		m_device->ReleaseBuffer(m_instanceBuffer);
+		m_instanceBuffer = nullptr;
+	}
+	m_instanceCount = 0;
+	m_instanceCapacity = 0;
+
 	// Release the index buffer.
 	if (m_indexBuffer)
 	{
-		m_indexBuffer->Release();
+		m_device->ReleaseBuffer(m_indexBuffer);
 		m_indexBuffer = nullptr;
 	}
 
 	// Release the vertex buffer.
 	if (m_vertexBuffer)
 	{
-		m_vertexBuffer->Release();
+		m_device->ReleaseBuffer(m_vertexBuffer);
 		m_vertexBuffer = nullptr;
 	}
 }
 
-void ModelClass::RenderBuffers(ID3D11DeviceContext* deviceContext)
+void ModelClass::RenderBuffers(RenderContext* context)
 {
 	unsigned int stride;
 	unsigned int offset;
 
 
 	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType);
+	stride = m_vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertexType) : sizeof(VertexType);
 	offset = 0;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+	context->SetVertexBuffer(0, m_vertexBuffer, stride, offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	context->SetIndexBuffer(m_indexBuffer, m_indexFormat, 0);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	context->SetPrimitiveTopology(PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
\ No newline at end of file
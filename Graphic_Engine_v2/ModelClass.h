@@ -6,19 +6,48 @@
 /************************************************************************/
 /* INCLUDES                                                             */
 /************************************************************************/
-#include <d3d11.h>
+#include "RenderDevice.h"
+#include "Allocators.h"
+#include "FrustumClass.h"
+#include "MeshLoader.h"
 #include <DirectXMath.h>
 using namespace DirectX;
 
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//Layout of the vertex buffer of a model. The shaders need a matching input layout for each one.
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,		//Float3 position and float4 color, 28 bytes.
+	VERTEX_FORMAT_PACKED,	//16 bit positions inside the bounds of the mesh and a RGBA8 color, 12 bytes.
+	VERTEX_FORMAT_COUNT
+};
+
 class ModelClass
 {
 private:
 	/*	Definition of the vertex type that will be used by the vertex buffer. 
-		This one has to match the layout in the ColorShader class.			 */
-	struct VertexType
+		This one has to match the layout in the ColorShader class, and it is the one of the mesh caches too,
+		so they are uploaded without converting them.														 */
+	typedef MeshVertex VertexType;
+
+	/*	The packed vertex. The position is quantized to the bounds of the mesh; the matrix from GetPositionMatrix()
+		takes it back to object space. The fourth component only pads it to the R16G16B16A16_UNORM format.	*/
+	struct PackedVertexType
+	{
+		unsigned short position[4];
+		unsigned char  color[4];
+	};
+
+public:
+	/*	Data of every copy of the model in instanced draws, read from the second vertex buffer.
+		This one has to match the instanced layout in the ColorShader class.	*/
+	struct InstanceType
 	{
-		XMFLOAT3 position;
-		XMFLOAT4 color;
+		XMFLOAT4X4 world;		//Not transposed, the shader builds the matrix from its rows.
+		XMFLOAT4   color;
 	};
 
 public:
@@ -26,21 +55,39 @@ public:
 	ModelClass(const ModelClass&);
 	~ModelClass();
 
-	bool Initialize(ID3D11Device* device);
+	bool Initialize(RenderDevice* device, const char* modelFilename, VertexFormat vertexFormat,
+					LinearAllocatorClass* scratch);
 	void Shutdown();
-	void Render(ID3D11DeviceContext* deviceContext);
+	void Render(RenderContext* context);
+
+	bool SetInstances(RenderDevice* device, const InstanceType* instances, int instanceCount);
+	void RenderInstanced(RenderContext* context);
 
 	int GetIndexCount();
+	int GetInstanceCount();
+	VertexFormat GetVertexFormat();
+	unsigned int GetBufferMemory();
+	void GetBoundingVolume(BoundingVolume& bounds);
+	void GetPositionMatrix(XMMATRIX& positionMatrix);
 
 private:
-	bool InitializeBuffers(ID3D11Device* device);
+	bool InitializeBuffers(RenderDevice* device);
+	bool LoadModel(RenderDevice* device, const char* modelFilename, LinearAllocatorClass* scratch);
+	bool CreateBuffers(RenderDevice* device, const VertexType* vertices, const unsigned int* indices,
+					   LinearAllocatorClass* scratch);
 	void ShutdownBuffers();
-	void RenderBuffers(ID3D11DeviceContext* deviceContext);
+	void RenderBuffers(RenderContext* context);
 
 private:
 
-	ID3D11Buffer *m_vertexBuffer, *m_indexBuffer;
+	RenderDevice *m_device;
+	RenderBuffer *m_vertexBuffer, *m_indexBuffer, *m_instanceBuffer;
 	int m_vertexCount, m_indexCount;
+	VertexFormat m_vertexFormat;
+	IndexFormat m_indexFormat;
+	XMFLOAT4X4 m_positionMatrix;
+	BoundingVolume m_bounds;		//In object space, before the position matrix.
+	int m_instanceCount, m_instanceCapacity;
 };
 #endif
 
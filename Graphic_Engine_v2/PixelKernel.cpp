@@ -0,0 +1,470 @@
+#include "PixelKernel.h"
+#include <algorithm>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*Shades the covered pixels of one 8x8 block with ColorPS: depth test with LESS, perspective correct color, fog if
+  the kernel was instantiated with it, and the write of the visible pixels. The pixels are shaded in 2x2 quads,
+  every lane of a register holding one pixel (structure of arrays), as many quads at once as the registers fit.
+  Returns how many pixels were written.*/
+typedef unsigned int (*ColorBlockFunction)(const PixelPlane* planes, unsigned long long mask, const float* fogColor,
+										   const PixelBlockTarget& target);
+
+/************************************************************************/
+/* KERNELS                                                              */
+/* Every kernel evaluates the planes as (base + stepX * column) +      */
+/* stepY * row and does the rest in the same order as the scalar one,  */
+/* so all of them write the same image.                                */
+/************************************************************************/
+static unsigned int CountBits(unsigned int bits)
+{
+	unsigned int count = 0;
+
+	for (; bits; bits &= bits - 1)
+	{
+		count++;
+	}
+	return count;
+}
+
+static unsigned int PackColorChannel(float value)
+{
+	return (unsigned int)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+template <bool Fog>
+static unsigned int ColorQuadsScalar(const PixelPlane* planes, unsigned long long mask, const float* fogColor,
+									 const PixelBlockTarget& target)
+{
+	float column, row, depth, w, fog, color[4];
+	unsigned int pixels = 0;
+	int x, y;
+
+	for (int quadY = 0; quadY < 8; quadY += 2)
+	{
+		for (int quadX = 0; quadX < 8; quadX += 2)
+		{
+			for (int lane = 0; lane < 4; lane++)
+			{
+				x = quadX + (lane & 1);
+				y = quadY + (lane >> 1);
+				if (!(mask & (1ULL << (y * 8 + x))))
+				{
+					continue;
+				}
+
+				column = (float)x;
+				row = (float)y;
+				depth = (planes[PIXEL_PLANE_DEPTH].base + planes[PIXEL_PLANE_DEPTH].stepX * column) +
+						planes[PIXEL_PLANE_DEPTH].stepY * row;
+				if (!(depth < target.depth[y * target.pitch + x]))
+				{
+					continue;
+				}
+
+				w = 1.0f / ((planes[PIXEL_PLANE_INV_W].base + planes[PIXEL_PLANE_INV_W].stepX * column) +
+							planes[PIXEL_PLANE_INV_W].stepY * row);
+				for (int c = 0; c < 4; c++)
+				{
+					const PixelPlane& plane = planes[PIXEL_PLANE_VARYINGS + c];
+					color[c] = ((plane.base + plane.stepX * column) + plane.stepY * row) * w;
+				}
+
+				if (Fog)
+				{
+					const PixelPlane& plane = planes[PIXEL_PLANE_VARYINGS + 4];
+					fog = ((plane.base + plane.stepX * column) + plane.stepY * row) * w;
+					for (int c = 0; c < 4; c++)
+					{
+						color[c] = fogColor[c] + (color[c] - fogColor[c]) * fog;
+					}
+				}
+
+				target.depth[y * target.pitch + x] = depth;
+				target.color[y * target.pitch + x] = PackColorChannel(color[0]) | (PackColorChannel(color[1]) << 8) |
+													 (PackColorChannel(color[2]) << 16) |
+													 (PackColorChannel(color[3]) << 24);
+				pixels++;
+			}
+		}
+	}
+
+	return pixels;
+}
+
+#ifdef SIMD_X86
+
+static __m128 InterpolateSSE2(const PixelPlane& plane, __m128 column, __m128 row)
+{
+	return _mm_add_ps(_mm_add_ps(_mm_set1_ps(plane.base), _mm_mul_ps(_mm_set1_ps(plane.stepX), column)),
+					  _mm_mul_ps(_mm_set1_ps(plane.stepY), row));
+}
+
+static __m128i PackChannelSSE2(__m128 value)
+{
+	value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+//One quad per register: the lanes are its top-left, top-right, bottom-left and bottom-right pixels.
+template <bool Fog>
+static unsigned int ColorQuadsSSE2(const PixelPlane* planes, unsigned long long mask, const float* fogColor,
+								   const PixelBlockTarget& target)
+{
+	__m128 laneX, laneY, column, row, depth, oldDepth, w, fog, visible, color[4], fogColors[4];
+	__m128i laneBits, packed, oldColor, visibleBits;
+	unsigned int bits, visibleMask, pixels = 0;
+	float* depthRow;
+	unsigned int* colorRow;
+
+	laneX = _mm_setr_ps(0.0f, 1.0f, 0.0f, 1.0f);
+	laneY = _mm_setr_ps(0.0f, 0.0f, 1.0f, 1.0f);
+	laneBits = _mm_setr_epi32(1, 2, 4, 8);
+	for (int c = 0; c < 4; c++)
+	{
+		fogColors[c] = Fog ? _mm_set1_ps(fogColor[c]) : _mm_setzero_ps();
+	}
+
+	for (int quadY = 0; quadY < 8; quadY += 2)
+	{
+		for (int quadX = 0; quadX < 8; quadX += 2)
+		{
+			bits = (unsigned int)((mask >> (quadY * 8 + quadX)) & 3) |
+				   ((unsigned int)((mask >> ((quadY + 1) * 8 + quadX)) & 3) << 2);
+			if (!bits)
+			{
+				continue;
+			}
+
+			column = _mm_add_ps(_mm_set1_ps((float)quadX), laneX);
+			row = _mm_add_ps(_mm_set1_ps((float)quadY), laneY);
+			depthRow = target.depth + quadY * target.pitch + quadX;
+			colorRow = target.color + quadY * target.pitch + quadX;
+
+			//Covered and in front of what is already drawn.
+			depth = InterpolateSSE2(planes[PIXEL_PLANE_DEPTH], column, row);
+			oldDepth = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)depthRow), (const __m64*)(depthRow + target.pitch));
+			visibleBits = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(bits), laneBits), laneBits);
+			visible = _mm_and_ps(_mm_castsi128_ps(visibleBits), _mm_cmplt_ps(depth, oldDepth));
+			visibleMask = _mm_movemask_ps(visible);
+			if (!visibleMask)
+			{
+				continue;
+			}
+
+			w = _mm_div_ps(_mm_set1_ps(1.0f), InterpolateSSE2(planes[PIXEL_PLANE_INV_W], column, row));
+			for (int c = 0; c < 4; c++)
+			{
+				color[c] = _mm_mul_ps(InterpolateSSE2(planes[PIXEL_PLANE_VARYINGS + c], column, row), w);
+			}
+
+			if (Fog)
+			{
+				fog = _mm_mul_ps(InterpolateSSE2(planes[PIXEL_PLANE_VARYINGS + 4], column, row), w);
+				for (int c = 0; c < 4; c++)
+				{
+					color[c] = _mm_add_ps(fogColors[c], _mm_mul_ps(_mm_sub_ps(color[c], fogColors[c]), fog));
+				}
+			}
+
+			packed = _mm_or_si128(_mm_or_si128(PackChannelSSE2(color[0]), _mm_slli_epi32(PackChannelSSE2(color[1]), 8)),
+								  _mm_or_si128(_mm_slli_epi32(PackChannelSSE2(color[2]), 16),
+											   _mm_slli_epi32(PackChannelSSE2(color[3]), 24)));
+
+			//Keep what was there in the lanes that aren't written.
+			depth = _mm_or_ps(_mm_and_ps(visible, depth), _mm_andnot_ps(visible, oldDepth));
+			_mm_storel_pi((__m64*)depthRow, depth);
+			_mm_storeh_pi((__m64*)(depthRow + target.pitch), depth);
+
+			visibleBits = _mm_castps_si128(visible);
+			oldColor = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)colorRow),
+										  _mm_loadl_epi64((const __m128i*)(colorRow + target.pitch)));
+			packed = _mm_or_si128(_mm_and_si128(visibleBits, packed), _mm_andnot_si128(visibleBits, oldColor));
+			_mm_storel_epi64((__m128i*)colorRow, packed);
+			_mm_storel_epi64((__m128i*)(colorRow + target.pitch), _mm_srli_si128(packed, 8));
+
+			pixels += CountBits(visibleMask);
+		}
+	}
+
+	return pixels;
+}
+
+SIMD_TARGET_AVX2 static __m256 InterpolateAVX2(const PixelPlane& plane, __m256 column, __m256 row)
+{
+	return _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(plane.base), _mm256_mul_ps(_mm256_set1_ps(plane.stepX), column)),
+						 _mm256_mul_ps(_mm256_set1_ps(plane.stepY), row));
+}
+
+SIMD_TARGET_AVX2 static __m256i PackChannelAVX2(__m256 value)
+{
+	value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+//Two quads side by side per register: the low half is 4 pixels of the top row and the high half the 4 below.
+template <bool Fog>
+SIMD_TARGET_AVX2 static unsigned int ColorQuadsAVX2(const PixelPlane* planes, unsigned long long mask,
+													const float* fogColor, const PixelBlockTarget& target)
+{
+	__m256 laneX, laneY, column, row, depth, oldDepth, w, fog, visible, color[4], fogColors[4];
+	__m256i laneBits, packed, oldColor;
+	unsigned int bits, visibleMask, pixels = 0;
+	float* depthRow;
+	unsigned int* colorRow;
+
+	laneX = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 0.0f, 1.0f, 2.0f, 3.0f);
+	laneY = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f);
+	laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+	for (int c = 0; c < 4; c++)
+	{
+		fogColors[c] = Fog ? _mm256_set1_ps(fogColor[c]) : _mm256_setzero_ps();
+	}
+
+	for (int quadY = 0; quadY < 8; quadY += 2)
+	{
+		for (int quadX = 0; quadX < 8; quadX += 4)
+		{
+			bits = (unsigned int)((mask >> (quadY * 8 + quadX)) & 15) |
+				   ((unsigned int)((mask >> ((quadY + 1) * 8 + quadX)) & 15) << 4);
+			if (!bits)
+			{
+				continue;
+			}
+
+			column = _mm256_add_ps(_mm256_set1_ps((float)quadX), laneX);
+			row = _mm256_add_ps(_mm256_set1_ps((float)quadY), laneY);
+			depthRow = target.depth + quadY * target.pitch + quadX;
+			colorRow = target.color + quadY * target.pitch + quadX;
+
+			depth = InterpolateAVX2(planes[PIXEL_PLANE_DEPTH], column, row);
+			oldDepth = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(depthRow)), _mm_loadu_ps(depthRow + target.pitch), 1);
+			visible = _mm256_and_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), laneBits), laneBits)),
+									_mm256_cmp_ps(depth, oldDepth, _CMP_LT_OQ));
+			visibleMask = _mm256_movemask_ps(visible);
+			if (!visibleMask)
+			{
+				continue;
+			}
+
+			w = _mm256_div_ps(_mm256_set1_ps(1.0f), InterpolateAVX2(planes[PIXEL_PLANE_INV_W], column, row));
+			for (int c = 0; c < 4; c++)
+			{
+				color[c] = _mm256_mul_ps(InterpolateAVX2(planes[PIXEL_PLANE_VARYINGS + c], column, row), w);
+			}
+
+			if (Fog)
+			{
+				fog = _mm256_mul_ps(InterpolateAVX2(planes[PIXEL_PLANE_VARYINGS + 4], column, row), w);
+				for (int c = 0; c < 4; c++)
+				{
+					color[c] = _mm256_add_ps(fogColors[c], _mm256_mul_ps(_mm256_sub_ps(color[c], fogColors[c]), fog));
+				}
+			}
+
+			packed = _mm256_or_si256(_mm256_or_si256(PackChannelAVX2(color[0]), _mm256_slli_epi32(PackChannelAVX2(color[1]), 8)),
+									 _mm256_or_si256(_mm256_slli_epi32(PackChannelAVX2(color[2]), 16),
+													 _mm256_slli_epi32(PackChannelAVX2(color[3]), 24)));
+
+			depth = _mm256_blendv_ps(oldDepth, depth, visible);
+			_mm_storeu_ps(depthRow, _mm256_castps256_ps128(depth));
+			_mm_storeu_ps(depthRow + target.pitch, _mm256_extractf128_ps(depth, 1));
+
+			oldColor = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)colorRow)),
+											   _mm_loadu_si128((const __m128i*)(colorRow + target.pitch)), 1);
+			packed = _mm256_blendv_epi8(oldColor, packed, _mm256_castps_si256(visible));
+			_mm_storeu_si128((__m128i*)colorRow, _mm256_castsi256_si128(packed));
+			_mm_storeu_si128((__m128i*)(colorRow + target.pitch), _mm256_extracti128_si256(packed, 1));
+
+			pixels += CountBits(visibleMask);
+		}
+	}
+
+	return pixels;
+}
+
+#ifdef SIMD_HAS_AVX512
+
+//GCC 12 warns about the undefined source the plain forms of some AVX-512 intrinsics pass on. Their zero masked forms
+//with every lane kept are the same instruction, so those are used instead.
+static const __mmask16 AVX512_ALL_FLOATS = 0xffff;
+static const __mmask8  AVX512_ALL_DOUBLES = 0xff;
+
+SIMD_TARGET_AVX512 static __m512 InterpolateAVX512(const PixelPlane& plane, __m512 column, __m512 row)
+{
+	return _mm512_add_ps(_mm512_add_ps(_mm512_set1_ps(plane.base), _mm512_mul_ps(_mm512_set1_ps(plane.stepX), column)),
+						 _mm512_mul_ps(_mm512_set1_ps(plane.stepY), row));
+}
+
+SIMD_TARGET_AVX512 static __m512i PackChannelAVX512(__m512 value)
+{
+	value = _mm512_maskz_min_ps(AVX512_ALL_FLOATS, _mm512_maskz_max_ps(AVX512_ALL_FLOATS, value, _mm512_setzero_ps()),
+								_mm512_set1_ps(1.0f));
+	return _mm512_maskz_cvttps_epi32(AVX512_ALL_FLOATS,
+									 _mm512_add_ps(_mm512_mul_ps(value, _mm512_set1_ps(255.0f)), _mm512_set1_ps(0.5f)));
+}
+
+//Four quads per register, two whole rows of the block. The coverage of the two rows is already the lane mask.
+template <bool Fog>
+SIMD_TARGET_AVX512 static unsigned int ColorQuadsAVX512(const PixelPlane* planes, unsigned long long mask,
+														const float* fogColor, const PixelBlockTarget& target)
+{
+	__m512 laneX, laneY, column, row, depth, oldDepth, w, fog, color[4], fogColors[4];
+	__m512i packed, oldColor;
+	__mmask16 covered, visible;
+	unsigned int pixels = 0;
+	float* depthRow;
+	unsigned int* colorRow;
+
+	laneX = _mm512_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	laneY = _mm512_setr_ps(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f);
+	for (int c = 0; c < 4; c++)
+	{
+		fogColors[c] = Fog ? _mm512_set1_ps(fogColor[c]) : _mm512_setzero_ps();
+	}
+
+	column = laneX;
+	for (int quadY = 0; quadY < 8; quadY += 2)
+	{
+		covered = (__mmask16)(mask >> (quadY * 8));
+		if (!covered)
+		{
+			continue;
+		}
+
+		row = _mm512_add_ps(_mm512_set1_ps((float)quadY), laneY);
+		depthRow = target.depth + quadY * target.pitch;
+		colorRow = target.color + quadY * target.pitch;
+
+		depth = InterpolateAVX512(planes[PIXEL_PLANE_DEPTH], column, row);
+		oldDepth = _mm512_castpd_ps(_mm512_maskz_insertf64x4(AVX512_ALL_DOUBLES,
+															 _mm512_castpd256_pd512(_mm256_castps_pd(_mm256_loadu_ps(depthRow))),
+															 _mm256_castps_pd(_mm256_loadu_ps(depthRow + target.pitch)), 1));
+		visible = _mm512_mask_cmp_ps_mask(covered, depth, oldDepth, _CMP_LT_OQ);
+		if (!visible)
+		{
+			continue;
+		}
+
+		w = _mm512_div_ps(_mm512_set1_ps(1.0f), InterpolateAVX512(planes[PIXEL_PLANE_INV_W], column, row));
+		for (int c = 0; c < 4; c++)
+		{
+			color[c] = _mm512_mul_ps(InterpolateAVX512(planes[PIXEL_PLANE_VARYINGS + c], column, row), w);
+		}
+
+		if (Fog)
+		{
+			fog = _mm512_mul_ps(InterpolateAVX512(planes[PIXEL_PLANE_VARYINGS + 4], column, row), w);
+			for (int c = 0; c < 4; c++)
+			{
+				color[c] = _mm512_add_ps(fogColors[c], _mm512_mul_ps(_mm512_sub_ps(color[c], fogColors[c]), fog));
+			}
+		}
+
+		packed = _mm512_or_si512(_mm512_or_si512(PackChannelAVX512(color[0]),
+												 _mm512_maskz_slli_epi32(AVX512_ALL_FLOATS, PackChannelAVX512(color[1]), 8)),
+								 _mm512_or_si512(_mm512_maskz_slli_epi32(AVX512_ALL_FLOATS, PackChannelAVX512(color[2]), 16),
+												 _mm512_maskz_slli_epi32(AVX512_ALL_FLOATS, PackChannelAVX512(color[3]), 24)));
+
+		//The first row is in the low 8 lanes, stored with a mask, and the second one in the high half.
+		depth = _mm512_mask_blend_ps(visible, oldDepth, depth);
+		_mm512_mask_storeu_ps(depthRow, 0xff, depth);
+		_mm256_storeu_ps(depthRow + target.pitch,
+						 _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(AVX512_ALL_DOUBLES, _mm512_castps_pd(depth), 1)));
+
+		oldColor = _mm512_maskz_inserti64x4(AVX512_ALL_DOUBLES,
+											_mm512_castsi256_si512(_mm256_loadu_si256((const __m256i*)colorRow)),
+											_mm256_loadu_si256((const __m256i*)(colorRow + target.pitch)), 1);
+		packed = _mm512_mask_blend_epi32(visible, oldColor, packed);
+		_mm512_mask_storeu_epi32(colorRow, 0xff, packed);
+		_mm256_storeu_si256((__m256i*)(colorRow + target.pitch),
+							_mm512_maskz_extracti64x4_epi64(AVX512_ALL_DOUBLES, packed, 1));
+
+		pixels += CountBits(visible);
+	}
+
+	return pixels;
+}
+
+#endif
+#endif
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static ColorBlockFunction SelectColorBlock(SimdLevel level, bool fog)
+{
+	switch (level)
+	{
+#ifdef SIMD_X86
+#ifdef SIMD_HAS_AVX512
+	case SIMD_LEVEL_AVX512:
+		return fog ? ColorQuadsAVX512<true> : ColorQuadsAVX512<false>;
+#endif
+	case SIMD_LEVEL_AVX2:
+		return fog ? ColorQuadsAVX2<true> : ColorQuadsAVX2<false>;
+	case SIMD_LEVEL_SSE2:
+		return fog ? ColorQuadsSSE2<true> : ColorQuadsSSE2<false>;
+#endif
+	default:
+		return fog ? ColorQuadsScalar<true> : ColorQuadsScalar<false>;
+	}
+}
+
+static SimdLevel		  g_supportedLevel = DetectSimdLevel();
+static SimdLevel		  g_pixelLevel = g_supportedLevel;
+static ColorBlockFunction g_colorBlock = SelectColorBlock(g_pixelLevel, false);
+static ColorBlockFunction g_foggedColorBlock = SelectColorBlock(g_pixelLevel, true);
+
+/*
+ *	ShadeColorBlock()
+ *	brief: Runs ColorPS without fog on the covered pixels of an 8x8 block with the SIMD kernel of the CPU.
+ *	param planes: The depth, 1 / w and the varyings of ColorVS divided by w, in the PIXEL_PLANE_ order.
+ *	param mask: The coverage of the block, bit (row * 8 + column) for every pixel.
+ *	param target: The block in the buffers. The whole block has to be inside them.
+ *	return: How many pixels passed the depth test and were written.
+ */
+unsigned int ShadeColorBlock(const PixelPlane* planes, unsigned long long mask, const PixelBlockTarget& target)
+{
+	return g_colorBlock(planes, mask, nullptr, target);
+}
+
+/*
+ *	ShadeFoggedColorBlock()
+ *	brief: Runs ColorPS with fog on the covered pixels of an 8x8 block with the SIMD kernel of the CPU.
+ *	param planes: The depth, 1 / w and the varyings of ColorVS divided by w, the color and then the fog factor, in
+ *		  the PIXEL_PLANE_ order.
+ *	param fogColor: The 4 floats of the fog color.
+ *	param mask, target: Like ShadeColorBlock().
+ *	return: How many pixels passed the depth test and were written.
+ */
+unsigned int ShadeFoggedColorBlock(const PixelPlane* planes, unsigned long long mask, const float* fogColor,
+								   const PixelBlockTarget& target)
+{
+	return g_foggedColorBlock(planes, mask, fogColor, target);
+}
+
+SimdLevel GetPixelKernelSimdLevel()
+{
+	return g_pixelLevel;
+}
+
+/*
+ *	SetPixelKernelSimdLevel()
+ *	brief: Forces the kernels of a narrower instruction set, to compare them. It must not be called while rendering.
+ *	return: False if the CPU doesn't support that instruction set.
+ */
+bool SetPixelKernelSimdLevel(SimdLevel level)
+{
+	if (level > g_supportedLevel)
+	{
+		return false;
+	}
+
+	g_pixelLevel = level;
+	g_colorBlock = SelectColorBlock(level, false);
+	g_foggedColorBlock = SelectColorBlock(level, true);
+	return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef PIXEL_KERNEL
+#define PIXEL_KERNEL
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "SimdSupport.h"
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+
+//Order of the planes of a triangle handed to the kernels: the depth, 1 / w and then the varyings divided by w.
+const unsigned int PIXEL_PLANE_DEPTH = 0;
+const unsigned int PIXEL_PLANE_INV_W = 1;
+const unsigned int PIXEL_PLANE_VARYINGS = 2;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*A value of a triangle that is linear in screen space, over one 8x8 block: value = base + stepX * column +
+  stepY * row, with base at the center of the top-left pixel of the block.*/
+struct PixelPlane
+{
+	float base;
+	float stepX;
+	float stepY;
+};
+
+//Where a block is drawn: its top-left pixel in the color and depth buffers, and their width in pixels.
+struct PixelBlockTarget
+{
+	unsigned int* color;
+	float*		  depth;
+	int			  pitch;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+unsigned int ShadeColorBlock(const PixelPlane* planes, unsigned long long mask, const PixelBlockTarget& target);
+unsigned int ShadeFoggedColorBlock(const PixelPlane* planes, unsigned long long mask, const float* fogColor,
+								   const PixelBlockTarget& target);
+
+SimdLevel GetPixelKernelSimdLevel();
+bool SetPixelKernelSimdLevel(SimdLevel level);
+
+#endif
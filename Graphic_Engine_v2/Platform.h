@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/* The engine core only needs a couple of Win32 types. When it is built */
+/* for a headless node without the Windows SDK they are replaced by the */
+/* minimal equivalents below, so the software backend can still run.   */
+/************************************************************************/
+#ifdef _WIN32
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#else
+
+#include <cstdio>
+#include <cwchar>
+
+typedef void*	HWND;
+typedef wchar_t WCHAR;
+
+const unsigned int MB_OK = 0;
+
+//Without a desktop there is nowhere to pop a message box, so the message goes to the error output instead.
+inline int MessageBox(HWND /*hwnd*/, const WCHAR* text, const WCHAR* caption, unsigned int /*type*/)
+{
+	fwprintf(stderr, L"%ls: %ls\n", caption, text);
+	return 0;
+}
+
+#endif
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+#include <cstdlib>
+
+//Allocates memory aligned for SIMD loads and stores. It has to be released with AlignedFree(). Both are defined with
+//the heap counters, in Allocators.cpp.
+void* AlignedAlloc(size_t size, size_t alignment);
+void AlignedFree(void* memory);
+
+#endif
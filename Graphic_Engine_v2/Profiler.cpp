@@ -0,0 +1,591 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned int PROFILER_CALIBRATION_MILLISECONDS = 10;	//Measured at the start to convert the ticks.
+
+//The names of the zones, shared by every profiler. Zones are only added, so a zone index is valid forever.
+static std::mutex s_zoneMutex;
+static const char* s_zoneNames[PROFILER_MAX_ZONES];
+static std::atomic<unsigned int> s_zoneCount(0);
+
+//The profiler running and how many times one was started, which tells a thread its buffer is from one before.
+static std::atomic<ProfilerClass*> s_profiler(nullptr);
+static std::atomic<unsigned int> s_generation(0);
+static thread_local void* t_profilerBuffer = nullptr;
+static thread_local unsigned int t_profilerGeneration = 0;
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+//The histogram bucket of a time in nanoseconds.
+static unsigned int GetHistogramBucket(unsigned int nanoseconds)
+{
+	unsigned int bucket;
+
+	for (bucket = 0; nanoseconds > 1 && bucket < PROFILER_HISTOGRAM_BUCKETS - 1; bucket++)
+	{
+		nanoseconds >>= 1;
+	}
+
+	return bucket;
+}
+
+//Writes a string as a JSON string, in quotes.
+static void WriteJsonString(std::ofstream& fout, const char* text)
+{
+	fout << '"';
+	for (; *text; text++)
+	{
+		if (*text == '"' || *text == '\\')
+		{
+			fout << '\\';
+		}
+		fout << ((unsigned char)*text < 0x20 ? ' ' : *text);
+	}
+	fout << '"';
+}
+
+//Writes counters as a JSON object of their values.
+static void WriteJsonCounters(std::ofstream& fout, const ProfileCounter* counters, unsigned int counterCount)
+{
+	fout << '{';
+	for (unsigned int i = 0; i < counterCount; i++)
+	{
+		WriteJsonString(fout, counters[i].name);
+		fout << ':' << counters[i].value << (i + 1 < counterCount ? "," : "");
+	}
+	fout << '}';
+}
+
+/*
+ *	RegisterProfileZone()
+ *	brief: Finds the index of the zone with the name, or adds it. PROFILE_ZONE() calls it once per zone in the
+ *		   code, the first time it runs. Zones with the same name are the same zone.
+ */
+unsigned int RegisterProfileZone(const char* name)
+{
+	std::lock_guard<std::mutex> lock(s_zoneMutex);
+	unsigned int count;
+
+	count = s_zoneCount.load(std::memory_order_relaxed);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (strcmp(s_zoneNames[i], name) == 0)
+		{
+			return i;
+		}
+	}
+
+	if (count >= PROFILER_MAX_ZONES - 1)
+	{
+		s_zoneNames[PROFILER_MAX_ZONES - 1] = "(other zones)";
+		s_zoneCount.store(PROFILER_MAX_ZONES, std::memory_order_release);
+		return PROFILER_MAX_ZONES - 1;
+	}
+
+	s_zoneNames[count] = name;
+	s_zoneCount.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+const char* GetProfileZoneName(unsigned int zone)
+{
+	return zone < GetProfileZoneCount() ? s_zoneNames[zone] : nullptr;
+}
+
+unsigned int GetProfileZoneCount()
+{
+	return s_zoneCount.load(std::memory_order_acquire);
+}
+
+ProfilerClass::ProfilerClass()
+{
+	memset(m_threads, 0, sizeof(m_threads));
+	m_threadCount = 0;
+	m_traceCount = 0;
+	m_trackCount = 0;
+	m_trackEventCount = 0;
+	m_frames = 0;
+	m_events = 0;
+	m_startTicks = 0;
+	m_ticksPerSecond = 0.0;
+}
+
+ProfilerClass::ProfilerClass(const ProfilerClass &)
+{
+}
+
+
+ProfilerClass::~ProfilerClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Allocates the trace and the histograms and starts recording the zones of every thread.
+ *	return: False if another profiler is running.
+ */
+bool ProfilerClass::Initialize()
+{
+	ProfilerClass* running;
+
+	m_trace.resize(PROFILER_TRACE_EVENTS);
+	m_trackEvents.resize(PROFILER_TRACK_EVENTS);
+	m_zones.resize(PROFILER_MAX_ZONES);
+	for (unsigned int i = 0; i < PROFILER_MAX_ZONES; i++)
+	{
+		m_zones[i].samples.assign(PROFILER_HISTORY_SAMPLES, 0);
+		m_zones[i].next = 0;
+		m_zones[i].totalCount = 0;
+		memset(m_zones[i].histogram, 0, sizeof(m_zones[i].histogram));
+		m_zones[i].counterCount = 0;
+	}
+	m_traceCount = 0;
+	m_trackCount = 0;
+	m_trackEventCount = 0;
+	m_frames = 0;
+	m_events = 0;
+
+	//The time stamp counter doesn't say its rate, so it is measured against the clock, and again every frame.
+	m_startTicks = ReadProfilerTicks();
+	m_startTime = std::chrono::steady_clock::now();
+#ifdef SIMD_X86
+	std::this_thread::sleep_for(std::chrono::milliseconds(PROFILER_CALIBRATION_MILLISECONDS));
+	UpdateClock();
+#else
+	m_ticksPerSecond = 1e9;
+#endif
+
+	s_generation.fetch_add(1, std::memory_order_relaxed);
+	running = nullptr;
+	return s_profiler.compare_exchange_strong(running, this, std::memory_order_release);
+}
+
+//Stops recording and releases the buffers of the threads.
+void ProfilerClass::Shutdown()
+{
+	ProfilerClass* running;
+
+	running = this;
+	s_profiler.compare_exchange_strong(running, nullptr);
+	s_generation.fetch_add(1, std::memory_order_relaxed);
+
+	for (unsigned int i = 0; i < m_threadCount; i++)
+	{
+		delete m_threads[i];
+		m_threads[i] = nullptr;
+	}
+	m_threadCount = 0;
+
+	m_trace.clear();
+	m_trackEvents.clear();
+	m_zones.clear();
+}
+
+/*
+ *	EndFrame()
+ *	brief: Moves the zones the threads recorded since the last call into the trace and the histograms. Called
+ *		   once a frame, so the buffers of the threads only need to hold the zones of a frame.
+ */
+void ProfilerClass::EndFrame()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	Collect();
+	UpdateClock();
+	m_frames++;
+}
+
+//Adds a row to the trace for zones timed off the threads. Returns PROFILER_MAX_TRACKS when there is no room left.
+unsigned int ProfilerClass::AddTrack(const char* name)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_trackCount == PROFILER_MAX_TRACKS)
+	{
+		return PROFILER_MAX_TRACKS;
+	}
+
+	snprintf(m_trackNames[m_trackCount], sizeof(m_trackNames[m_trackCount]), "%s", name);
+	return m_trackCount++;
+}
+
+/*
+ *	RecordTrackZone()
+ *	brief: Adds a zone that ran on a track from start to end, seconds of the steady clock, with what was counted
+ *		   during it. It goes into the trace and the histogram of the zone like the zones of the threads, but takes
+ *		   the lock, so it is meant for a few zones a frame.
+ */
+void ProfilerClass::RecordTrackZone(unsigned int track, unsigned int zone, double start, double end,
+									const ProfileCounter* counters, unsigned int counterCount)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	double startSeconds;
+
+	if (track >= m_trackCount || m_trackEvents.empty())
+	{
+		return;
+	}
+
+	startSeconds = std::chrono::duration<double>(m_startTime.time_since_epoch()).count();
+	counterCount = std::min(counterCount, PROFILER_MAX_COUNTERS);
+
+	ProfileTrackEvent& event = m_trackEvents[m_trackEventCount % PROFILER_TRACK_EVENTS];
+	event.start = start - startSeconds;
+	event.end = end - startSeconds;
+	event.zone = zone;
+	event.track = track;
+	std::copy(counters, counters + counterCount, event.counters);
+	event.counterCount = counterCount;
+	m_trackEventCount++;
+	m_events++;
+
+	AddSample(zone, (unsigned int)std::min(std::max(end - start, 0.0) * 1e9, (double)UINT_MAX));
+	std::copy(counters, counters + counterCount, m_zones[zone].counters);
+	m_zones[zone].counterCount = counterCount;
+}
+
+//The times of a zone over its last runs, see ProfileZoneStatistics. False if there is no such zone.
+bool ProfilerClass::GetZoneStatistics(unsigned int zone, ProfileZoneStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<unsigned int> samples;
+	unsigned long long sum;
+
+	if (zone >= GetProfileZoneCount() || zone >= m_zones.size())
+	{
+		return false;
+	}
+
+	const ZoneHistory& history = m_zones[zone];
+	memset(&statistics, 0, sizeof(statistics));
+	statistics.name = GetProfileZoneName(zone);
+	statistics.totalCount = history.totalCount;
+	statistics.sampleCount = (unsigned int)std::min(history.totalCount, (unsigned long long)PROFILER_HISTORY_SAMPLES);
+	memcpy(statistics.histogram, history.histogram, sizeof(statistics.histogram));
+	memcpy(statistics.counters, history.counters, sizeof(statistics.counters));
+	statistics.counterCount = history.counterCount;
+	if (statistics.sampleCount == 0)
+	{
+		return true;
+	}
+
+	samples.assign(history.samples.begin(), history.samples.begin() + statistics.sampleCount);
+	std::sort(samples.begin(), samples.end());
+	sum = 0;
+	for (unsigned int i = 0; i < samples.size(); i++)
+	{
+		sum += samples[i];
+	}
+
+	statistics.mean = sum / (double)samples.size() / 1000.0;
+	statistics.minimum = samples.front() / 1000.0;
+	statistics.median = samples[(samples.size() - 1) / 2] / 1000.0;
+	statistics.percentile95 = samples[(samples.size() - 1) * 95 / 100] / 1000.0;
+	statistics.percentile99 = samples[(samples.size() - 1) * 99 / 100] / 1000.0;
+	statistics.maximum = samples.back() / 1000.0;
+
+	return true;
+}
+
+void ProfilerClass::GetStatistics(ProfilerStatistics& statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	statistics.frames = m_frames;
+	statistics.events = m_events;
+	statistics.droppedEvents = 0;
+	statistics.threads = m_threadCount;
+	for (unsigned int i = 0; i < statistics.threads; i++)
+	{
+		statistics.droppedEvents += m_threads[i]->dropped.load(std::memory_order_relaxed);
+	}
+	statistics.tracks = m_trackCount;
+	statistics.zones = GetProfileZoneCount();
+	statistics.ticksPerSecond = m_ticksPerSecond;
+}
+
+/*
+ *	WriteChromeTrace()
+ *	brief: Writes the zones kept in the trace as a Chrome trace event file, which chrome://tracing, Perfetto and
+ *		   Speedscope open as a timeline with a row per thread and the zones nested inside each other. The tracks
+ *		   get rows after the threads, their zones carry their counters, which are also drawn as graphs.
+ */
+bool ProfilerClass::WriteChromeTrace(const char* filename)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::ofstream fout;
+	unsigned long long first;
+	double microsecondsPerTick;
+
+	fout.open(filename);
+	if (!fout)
+	{
+		return false;
+	}
+
+	microsecondsPerTick = 1e6 / m_ticksPerSecond;
+	fout << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (unsigned int i = 0; i < m_threadCount; i++)
+	{
+		fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+		WriteJsonString(fout, m_threads[i]->name);
+		fout << "}},\n";
+	}
+
+	for (unsigned int i = 0; i < m_trackCount; i++)
+	{
+		fout << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << PROFILER_MAX_THREADS + i
+			 << ",\"args\":{\"name\":";
+		WriteJsonString(fout, m_trackNames[i]);
+		fout << "}},\n";
+	}
+
+	first = m_traceCount > PROFILER_TRACE_EVENTS ? m_traceCount - PROFILER_TRACE_EVENTS : 0;
+	for (unsigned long long i = first; i < m_traceCount; i++)
+	{
+		const ProfileEvent& event = m_trace[i % PROFILER_TRACE_EVENTS];
+
+		fout << "{\"name\":";
+		WriteJsonString(fout, GetProfileZoneName(event.zone));
+		fout << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			 << ",\"ts\":" << (long long)(event.start - m_startTicks) * microsecondsPerTick
+			 << ",\"dur\":" << (event.end - event.start) * microsecondsPerTick << "},\n";
+	}
+
+	first = m_trackEventCount > PROFILER_TRACK_EVENTS ? m_trackEventCount - PROFILER_TRACK_EVENTS : 0;
+	for (unsigned long long i = first; i < m_trackEventCount; i++)
+	{
+		const ProfileTrackEvent& event = m_trackEvents[i % PROFILER_TRACK_EVENTS];
+
+		fout << "{\"name\":";
+		WriteJsonString(fout, GetProfileZoneName(event.zone));
+		fout << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << PROFILER_MAX_THREADS + event.track
+			 << ",\"ts\":" << event.start * 1e6 << ",\"dur\":" << (event.end - event.start) * 1e6 << ",\"args\":";
+		WriteJsonCounters(fout, event.counters, event.counterCount);
+		fout << "},\n";
+
+		if (event.counterCount > 0)
+		{
+			fout << "{\"name\":";
+			WriteJsonString(fout, GetProfileZoneName(event.zone));
+			fout << ",\"ph\":\"C\",\"pid\":1,\"ts\":" << event.start * 1e6 << ",\"args\":";
+			WriteJsonCounters(fout, event.counters, event.counterCount);
+			fout << "},\n";
+		}
+	}
+
+	//A last event without a comma after it.
+	fout << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Graphic Engine\"}}\n]}\n";
+
+	return (bool)fout;
+}
+
+//Writes the statistics and the histogram of every zone as text.
+bool ProfilerClass::WriteReport(const char* filename)
+{
+	ProfilerStatistics profilerStatistics;
+	ProfileZoneStatistics statistics;
+	std::ofstream fout;
+
+	fout.open(filename);
+	if (!fout)
+	{
+		return false;
+	}
+
+	GetStatistics(profilerStatistics);
+	fout << "Profile: " << profilerStatistics.frames << " frames, " << profilerStatistics.events << " zones recorded on "
+		 << profilerStatistics.threads << " threads and " << profilerStatistics.tracks << " tracks, "
+		 << profilerStatistics.droppedEvents << " dropped\n"
+		 << "Times in microseconds, of the last " << PROFILER_HISTORY_SAMPLES << " runs of every zone.\n\n";
+
+	fout << std::fixed << std::setprecision(2) << std::left << std::setw(40) << "zone" << std::right << std::setw(10)
+		 << "runs" << std::setw(10) << "mean" << std::setw(10) << "min" << std::setw(10) << "median" << std::setw(10)
+		 << "95%" << std::setw(10) << "99%" << std::setw(10) << "max" << "\n";
+	for (unsigned int zone = 0; GetZoneStatistics(zone, statistics); zone++)
+	{
+		fout << std::left << std::setw(40) << statistics.name << std::right << std::setw(10) << statistics.totalCount
+			 << std::setw(10) << statistics.mean << std::setw(10) << statistics.minimum << std::setw(10)
+			 << statistics.median << std::setw(10) << statistics.percentile95 << std::setw(10) << statistics.percentile99
+			 << std::setw(10) << statistics.maximum << "\n";
+
+		for (unsigned int bucket = 0; bucket < PROFILER_HISTOGRAM_BUCKETS; bucket++)
+		{
+			if (statistics.histogram[bucket] > 0)
+			{
+				fout << "    " << std::setw(12) << (1ull << bucket) / 1000.0 << " - " << std::setw(12)
+					 << (2ull << bucket) / 1000.0 << ": " << statistics.histogram[bucket] << "\n";
+			}
+		}
+
+		for (unsigned int i = 0; i < statistics.counterCount; i++)
+		{
+			fout << "    " << statistics.counters[i].name << ": " << statistics.counters[i].value << "\n";
+		}
+	}
+
+	return (bool)fout;
+}
+
+//Whether a profiler is running. Zones started while it isn't aren't recorded.
+bool ProfilerClass::IsRecording()
+{
+	return s_profiler.load(std::memory_order_relaxed) != nullptr;
+}
+
+/*
+ *	Record()
+ *	brief: Adds a finished zone to the buffer of the calling thread. It only stores the zone and publishes it; if
+ *		   the buffer is full because the frame hasn't ended for too long the zone is dropped and counted.
+ */
+void ProfilerClass::Record(unsigned int zone, unsigned long long start, unsigned long long end)
+{
+	ThreadBuffer* buffer;
+	unsigned int write;
+
+	buffer = GetThreadBuffer();
+	if (!buffer)
+	{
+		return;
+	}
+
+	write = buffer->write.load(std::memory_order_relaxed);
+	if (write - buffer->read.load(std::memory_order_acquire) >= PROFILER_THREAD_EVENTS)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ProfileEvent& event = buffer->events[write & (PROFILER_THREAD_EVENTS - 1)];
+	event.start = start;
+	event.end = end;
+	event.zone = zone;
+	buffer->write.store(write + 1, std::memory_order_release);
+}
+
+//Names the row of the calling thread in the trace.
+void ProfilerClass::SetThreadName(const char* name)
+{
+	ProfilerClass* profiler;
+	ThreadBuffer* buffer;
+
+	buffer = GetThreadBuffer();
+	profiler = s_profiler.load(std::memory_order_acquire);
+	if (!buffer || !profiler)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(profiler->m_mutex);
+	snprintf(buffer->name, sizeof(buffer->name), "%s", name);
+}
+
+//The buffer of the calling thread in the profiler running, made the first time the thread records a zone in it.
+ProfilerClass::ThreadBuffer* ProfilerClass::GetThreadBuffer()
+{
+	ProfilerClass* profiler;
+	ThreadBuffer* buffer;
+	unsigned int generation, index;
+
+	generation = s_generation.load(std::memory_order_relaxed);
+	if (t_profilerGeneration == generation)
+	{
+		return (ThreadBuffer*)t_profilerBuffer;
+	}
+
+	profiler = s_profiler.load(std::memory_order_acquire);
+	if (!profiler)
+	{
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(profiler->m_mutex);
+	buffer = nullptr;
+	index = profiler->m_threadCount.load(std::memory_order_relaxed);
+	if (index < PROFILER_MAX_THREADS)
+	{
+		buffer = new ThreadBuffer();
+		buffer->write = 0;
+		buffer->read = 0;
+		buffer->dropped = 0;
+		snprintf(buffer->name, sizeof(buffer->name), "thread %u", index);
+		profiler->m_threads[index] = buffer;
+		profiler->m_threadCount.store(index + 1, std::memory_order_release);
+	}
+
+	//A thread past the limit remembers it has no buffer, so it doesn't try again every zone.
+	t_profilerBuffer = buffer;
+	t_profilerGeneration = generation;
+	return buffer;
+}
+
+//Moves the zones out of the buffers of the threads. Only called with the mutex held.
+void ProfilerClass::Collect()
+{
+	unsigned int threadCount, read, write, nanoseconds;
+	double nanosecondsPerTick;
+
+	nanosecondsPerTick = 1e9 / m_ticksPerSecond;
+	threadCount = m_threadCount.load(std::memory_order_acquire);
+	for (unsigned int thread = 0; thread < threadCount; thread++)
+	{
+		ThreadBuffer* buffer = m_threads[thread];
+
+		read = buffer->read.load(std::memory_order_relaxed);
+		write = buffer->write.load(std::memory_order_acquire);
+		for (; read != write; read++)
+		{
+			ProfileEvent& event = m_trace[m_traceCount % PROFILER_TRACE_EVENTS];
+			event = buffer->events[read & (PROFILER_THREAD_EVENTS - 1)];
+			event.thread = thread;
+			m_traceCount++;
+			m_events++;
+
+			nanoseconds = (unsigned int)std::min((event.end - event.start) * nanosecondsPerTick, (double)UINT_MAX);
+			AddSample(event.zone, nanoseconds);
+		}
+		buffer->read.store(read, std::memory_order_release);
+	}
+}
+
+//Adds a time to the history of a zone. The oldest time leaves the histogram as the new one comes in.
+void ProfilerClass::AddSample(unsigned int zone, unsigned int nanoseconds)
+{
+	ZoneHistory& history = m_zones[zone];
+
+	if (history.totalCount >= PROFILER_HISTORY_SAMPLES)
+	{
+		history.histogram[GetHistogramBucket(history.samples[history.next])]--;
+	}
+	history.samples[history.next] = nanoseconds;
+	history.histogram[GetHistogramBucket(nanoseconds)]++;
+	history.next = (history.next + 1) % PROFILER_HISTORY_SAMPLES;
+	history.totalCount++;
+}
+
+//Measures the rate of the ticks again, over all the time since the start so it gets more precise.
+void ProfilerClass::UpdateClock()
+{
+#ifdef SIMD_X86
+	unsigned long long ticks;
+	double seconds;
+
+	ticks = ReadProfilerTicks();
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+	if (seconds > 0.0 && ticks > m_startTicks)
+	{
+		m_ticksPerSecond = (ticks - m_startTicks) / seconds;
+	}
+#endif
+}
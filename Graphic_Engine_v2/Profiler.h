@@ -0,0 +1,247 @@
+#pragma once
+
+#ifndef PROFILER
+#define PROFILER
+
+/************************************************************************/
+/* PREPROCESSING DIRECTIVES                                             */
+/* PROFILE_ZONE() marks a scope to time. Building with PROFILER_ENABLED */
+/* set to 0 removes every zone from the code; otherwise a zone costs    */
+/* two reads of the time stamp counter and a store into a buffer of its */
+/* thread, and nothing at all while no profiler is running.            */
+/************************************************************************/
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 1
+#endif
+
+#define PROFILER_CONCATENATE_LINE(name, line) name##line
+#define PROFILER_CONCATENATE(name, line) PROFILER_CONCATENATE_LINE(name, line)
+
+#if PROFILER_ENABLED
+#define PROFILE_ZONE(name)																						\
+	static const unsigned int PROFILER_CONCATENATE(profileZone, __LINE__) = RegisterProfileZone(name);			\
+	ProfileScope PROFILER_CONCATENATE(profileScope, __LINE__)(PROFILER_CONCATENATE(profileZone, __LINE__))
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "SimdSupport.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(SIMD_X86)
+#include <x86intrin.h>
+#endif
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int PROFILER_MAX_ZONES = 256;			//Different zones in the program. The ones after share the last.
+const unsigned int PROFILER_MAX_THREADS = 64;			//Threads that record zones. The ones after aren't recorded.
+const unsigned int PROFILER_THREAD_EVENTS = 16384;		//Zones a thread can record between two frames. A power of 2.
+const unsigned int PROFILER_TRACE_EVENTS = 262144;		//Last zones kept for the trace.
+const unsigned int PROFILER_HISTORY_SAMPLES = 1024;		//Last times of every zone kept for its histogram.
+const unsigned int PROFILER_HISTOGRAM_BUCKETS = 32;		//Bucket b counts times from 2^b up to 2^(b+1) nanoseconds.
+const unsigned int PROFILER_MAX_TRACKS = 4;				//Rows of work timed off the threads, like the video card.
+const unsigned int PROFILER_TRACK_EVENTS = 16384;		//Last zones of the tracks kept for the trace.
+const unsigned int PROFILER_MAX_COUNTERS = 6;			//Counters a zone of a track can carry.
+const char PROFILER_TRACE_FILE[] = "profile.json";
+const char PROFILER_REPORT_FILE[] = "profile.txt";
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//A zone a thread finished, in ticks of ReadProfilerTicks().
+struct ProfileEvent
+{
+	unsigned long long start;
+	unsigned long long end;
+	unsigned int	   zone;
+	unsigned int	   thread;
+};
+
+//A value counted during a zone, like the pixels a pass shaded. The name has to live as long as the program.
+struct ProfileCounter
+{
+	const char*		   name;
+	unsigned long long value;
+};
+
+//A zone of a track, in seconds since the profiler started.
+struct ProfileTrackEvent
+{
+	double		   start;
+	double		   end;
+	unsigned int   zone;
+	unsigned int   track;
+	ProfileCounter counters[PROFILER_MAX_COUNTERS];
+	unsigned int   counterCount;
+};
+
+//The times of a zone over its last PROFILER_HISTORY_SAMPLES runs, in microseconds.
+struct ProfileZoneStatistics
+{
+	const char*		   name;
+	unsigned long long totalCount;		//Runs since the profiler started.
+	unsigned int	   sampleCount;		//Runs the rest are over.
+	double			   mean;
+	double			   minimum;
+	double			   median;
+	double			   percentile95;
+	double			   percentile99;
+	double			   maximum;
+	unsigned int	   histogram[PROFILER_HISTOGRAM_BUCKETS];
+	ProfileCounter	   counters[PROFILER_MAX_COUNTERS];	//Of its last run, for zones of tracks.
+	unsigned int	   counterCount;
+};
+
+struct ProfilerStatistics
+{
+	unsigned long long frames;
+	unsigned long long events;			//Zones recorded.
+	unsigned long long droppedEvents;	//Lost because a thread filled its buffer before the frame ended.
+	unsigned int	   threads;
+	unsigned int	   tracks;
+	unsigned int	   zones;
+	double			   ticksPerSecond;
+};
+
+/*
+ *	ProfilerClass
+ *	brief: Collects the zones every thread records into a timeline. Each thread writes its zones into a ring of
+ *		   its own that only it writes and only EndFrame() reads, so recording takes no lock; EndFrame() moves them
+ *		   into the trace, which keeps the last PROFILER_TRACE_EVENTS zones for WriteChromeTrace(), and into the
+ *		   rolling histogram of every zone. Only one profiler runs at a time, and no zone can be running on any
+ *		   thread while it starts or shuts down.
+ *		   Work that doesn't run on a thread, like the passes of the video card, goes into tracks: rows of the
+ *		   trace its zones are given to already timed, with the counters of each.
+ */
+class ProfilerClass
+{
+private:
+	//The ring a thread records into. The writer only moves write and the reader only moves read.
+	struct ThreadBuffer
+	{
+		ProfileEvent			 events[PROFILER_THREAD_EVENTS];
+		std::atomic<unsigned int> write;
+		std::atomic<unsigned int> read;
+		std::atomic<unsigned long long> dropped;
+		char					 name[32];
+	};
+
+	//The last times of a zone, in nanoseconds, and their histogram.
+	struct ZoneHistory
+	{
+		std::vector<unsigned int> samples;
+		unsigned int			  next;
+		unsigned long long		  totalCount;
+		unsigned int			  histogram[PROFILER_HISTOGRAM_BUCKETS];
+		ProfileCounter			  counters[PROFILER_MAX_COUNTERS];
+		unsigned int			  counterCount;
+	};
+
+public:
+	ProfilerClass();
+	ProfilerClass(const ProfilerClass&);
+	~ProfilerClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	void EndFrame();
+
+	unsigned int AddTrack(const char* name);
+	void RecordTrackZone(unsigned int track, unsigned int zone, double start, double end,
+						 const ProfileCounter* counters, unsigned int counterCount);
+
+	bool GetZoneStatistics(unsigned int zone, ProfileZoneStatistics& statistics);
+	void GetStatistics(ProfilerStatistics& statistics);
+	bool WriteChromeTrace(const char* filename);
+	bool WriteReport(const char* filename);
+
+	static bool IsRecording();
+	static void Record(unsigned int zone, unsigned long long start, unsigned long long end);
+	static void SetThreadName(const char* name);
+
+private:
+	static ThreadBuffer* GetThreadBuffer();
+	void Collect();
+	void UpdateClock();
+	void AddSample(unsigned int zone, unsigned int nanoseconds);
+
+private:
+	ThreadBuffer*				m_threads[PROFILER_MAX_THREADS];
+	std::atomic<unsigned int>	m_threadCount;
+	std::mutex					m_mutex;			//Of everything EndFrame() fills.
+	std::vector<ProfileEvent>	m_trace;			//Ring of the last zones.
+	unsigned long long			m_traceCount;
+	char						m_trackNames[PROFILER_MAX_TRACKS][32];
+	unsigned int				m_trackCount;
+	std::vector<ProfileTrackEvent> m_trackEvents;	//Ring of the last zones of the tracks.
+	unsigned long long			m_trackEventCount;
+	std::vector<ZoneHistory>	m_zones;
+	unsigned long long			m_frames;
+	unsigned long long			m_events;
+	unsigned long long			m_startTicks;
+	std::chrono::steady_clock::time_point m_startTime;
+	double						m_ticksPerSecond;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+
+//Gives a zone name its index, the same one every time. Names have to live as long as the program.
+unsigned int RegisterProfileZone(const char* name);
+const char* GetProfileZoneName(unsigned int zone);
+unsigned int GetProfileZoneCount();
+
+//The time the zones are recorded in: the time stamp counter on x86, which every core of current CPUs runs at a
+//constant rate, and the steady clock in nanoseconds elsewhere.
+inline unsigned long long ReadProfilerTicks()
+{
+#ifdef SIMD_X86
+	return __rdtsc();
+#else
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/*
+ *	ProfileScope
+ *	brief: Times the scope it lives in as a zone, see PROFILE_ZONE().
+ */
+class ProfileScope
+{
+public:
+	explicit ProfileScope(unsigned int zone)
+	{
+		m_zone = zone;
+		m_start = ProfilerClass::IsRecording() ? ReadProfilerTicks() : 0;
+	}
+
+	~ProfileScope()
+	{
+		if (m_start)
+		{
+			ProfilerClass::Record(m_zone, m_start, ReadProfilerTicks());
+		}
+	}
+
+private:
+	ProfileScope(const ProfileScope&);
+
+private:
+	unsigned long long m_start;
+	unsigned int	   m_zone;
+};
+
+#endif
@@ -0,0 +1,353 @@
+#include "RasterizerKernel.h"
+#include <algorithm>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*Computes the coverage of one 8x8 block. blockEdge has the value of every edge function at the center of the
+  top-left pixel of the block and stepX / stepY how much it changes from one pixel to the next. Edges that cover
+  the whole block come with everything set to 0, so they never reject a pixel.*/
+typedef unsigned long long (*BlockCoverageFunction)(const int* blockEdge, const int* stepX, const int* stepY);
+
+/************************************************************************/
+/* KERNELS                                                              */
+/************************************************************************/
+static unsigned long long BlockCoverageScalar(const int* blockEdge, const int* stepX, const int* stepY)
+{
+	unsigned long long mask = 0;
+	int rowEdge[3], edge[3];
+
+	rowEdge[0] = blockEdge[0];
+	rowEdge[1] = blockEdge[1];
+	rowEdge[2] = blockEdge[2];
+
+	for (int row = 0; row < RASTER_BLOCK_SIZE; row++)
+	{
+		edge[0] = rowEdge[0];
+		edge[1] = rowEdge[1];
+		edge[2] = rowEdge[2];
+
+		for (int column = 0; column < RASTER_BLOCK_SIZE; column++)
+		{
+			//The pixel is covered when no edge is negative, that is, when the sign bit of the three OR'ed is clear.
+			if ((edge[0] | edge[1] | edge[2]) >= 0)
+			{
+				mask |= 1ULL << (row * RASTER_BLOCK_SIZE + column);
+			}
+
+			edge[0] += stepX[0];
+			edge[1] += stepX[1];
+			edge[2] += stepX[2];
+		}
+
+		rowEdge[0] += stepY[0];
+		rowEdge[1] += stepY[1];
+		rowEdge[2] += stepY[2];
+	}
+
+	return mask;
+}
+
+#ifdef SIMD_X86
+
+//4 pixels at once: every row of the block is two vectors.
+static unsigned long long BlockCoverageSSE2(const int* blockEdge, const int* stepX, const int* stepY)
+{
+	__m128i left[3], right[3], rowStep[3];
+	__m128i leftOr, rightOr;
+	unsigned int negative;
+	unsigned long long mask = 0;
+
+	for (int i = 0; i < 3; i++)
+	{
+		left[i] = _mm_setr_epi32(blockEdge[i], blockEdge[i] + stepX[i], blockEdge[i] + 2 * stepX[i], blockEdge[i] + 3 * stepX[i]);
+		right[i] = _mm_add_epi32(left[i], _mm_set1_epi32(4 * stepX[i]));
+		rowStep[i] = _mm_set1_epi32(stepY[i]);
+	}
+
+	for (int row = 0; row < RASTER_BLOCK_SIZE; row++)
+	{
+		leftOr = _mm_or_si128(_mm_or_si128(left[0], left[1]), left[2]);
+		rightOr = _mm_or_si128(_mm_or_si128(right[0], right[1]), right[2]);
+
+		negative = _mm_movemask_ps(_mm_castsi128_ps(leftOr)) | (_mm_movemask_ps(_mm_castsi128_ps(rightOr)) << 4);
+		mask |= (unsigned long long)(~negative & 0xff) << (row * RASTER_BLOCK_SIZE);
+
+		for (int i = 0; i < 3; i++)
+		{
+			left[i] = _mm_add_epi32(left[i], rowStep[i]);
+			right[i] = _mm_add_epi32(right[i], rowStep[i]);
+		}
+	}
+
+	return mask;
+}
+
+//8 pixels at once: one vector per row.
+SIMD_TARGET_AVX2 static unsigned long long BlockCoverageAVX2(const int* blockEdge, const int* stepX, const int* stepY)
+{
+	__m256i edge[3], rowStep[3];
+	__m256i lane, edgeOr;
+	unsigned int negative;
+	unsigned long long mask = 0;
+
+	lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (int i = 0; i < 3; i++)
+	{
+		edge[i] = _mm256_add_epi32(_mm256_set1_epi32(blockEdge[i]), _mm256_mullo_epi32(_mm256_set1_epi32(stepX[i]), lane));
+		rowStep[i] = _mm256_set1_epi32(stepY[i]);
+	}
+
+	for (int row = 0; row < RASTER_BLOCK_SIZE; row++)
+	{
+		edgeOr = _mm256_or_si256(_mm256_or_si256(edge[0], edge[1]), edge[2]);
+
+		negative = _mm256_movemask_ps(_mm256_castsi256_ps(edgeOr));
+		mask |= (unsigned long long)(~negative & 0xff) << (row * RASTER_BLOCK_SIZE);
+
+		edge[0] = _mm256_add_epi32(edge[0], rowStep[0]);
+		edge[1] = _mm256_add_epi32(edge[1], rowStep[1]);
+		edge[2] = _mm256_add_epi32(edge[2], rowStep[2]);
+	}
+
+	return mask;
+}
+
+#ifdef SIMD_HAS_AVX512
+
+//16 pixels at once: one vector covers two rows.
+SIMD_TARGET_AVX512 static unsigned long long BlockCoverageAVX512(const int* blockEdge, const int* stepX, const int* stepY)
+{
+	__m512i edge[3], rowStep[3];
+	__m512i column, row, edgeOr;
+	unsigned int negative;
+	unsigned long long mask = 0;
+
+	column = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7);
+	row = _mm512_setr_epi32(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+	for (int i = 0; i < 3; i++)
+	{
+		edge[i] = _mm512_add_epi32(_mm512_set1_epi32(blockEdge[i]),
+								   _mm512_add_epi32(_mm512_mullo_epi32(_mm512_set1_epi32(stepX[i]), column),
+													_mm512_mullo_epi32(_mm512_set1_epi32(stepY[i]), row)));
+		rowStep[i] = _mm512_set1_epi32(2 * stepY[i]);
+	}
+
+	for (int pair = 0; pair < RASTER_BLOCK_SIZE / 2; pair++)
+	{
+		edgeOr = _mm512_or_si512(_mm512_or_si512(edge[0], edge[1]), edge[2]);
+
+		negative = _mm512_cmplt_epi32_mask(edgeOr, _mm512_setzero_si512());
+		mask |= (unsigned long long)(~negative & 0xffff) << (pair * 2 * RASTER_BLOCK_SIZE);
+
+		edge[0] = _mm512_add_epi32(edge[0], rowStep[0]);
+		edge[1] = _mm512_add_epi32(edge[1], rowStep[1]);
+		edge[2] = _mm512_add_epi32(edge[2], rowStep[2]);
+	}
+
+	return mask;
+}
+
+#endif
+#endif
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static BlockCoverageFunction SelectBlockCoverage(SimdLevel level)
+{
+	switch (level)
+	{
+#ifdef SIMD_X86
+#ifdef SIMD_HAS_AVX512
+	case SIMD_LEVEL_AVX512:
+		return BlockCoverageAVX512;
+#endif
+	case SIMD_LEVEL_AVX2:
+		return BlockCoverageAVX2;
+	case SIMD_LEVEL_SSE2:
+		return BlockCoverageSSE2;
+#endif
+	default:
+		return BlockCoverageScalar;
+	}
+}
+
+static SimdLevel			 g_supportedLevel = DetectSimdLevel();
+static SimdLevel			 g_rasterizerLevel = g_supportedLevel;
+static BlockCoverageFunction g_blockCoverage = SelectBlockCoverage(g_rasterizerLevel);
+
+/*
+ *	SetupRasterEdges()
+ *	brief: Computes the edge functions of a triangle snapped to the sub-pixel grid.
+ *	param x: The x coordinates of the three vertices in sub-pixel units.
+ *	param y: The y coordinates of the three vertices in sub-pixel units, pointing down.
+ *	param edges: Receives the edge functions.
+ *	return: Twice the area of the triangle. It is positive for clockwise triangles, the front faces.
+ */
+long long SetupRasterEdges(const int* x, const int* y, RasterEdges& edges)
+{
+	int a, b;
+
+	for (int i = 0; i < 3; i++)
+	{
+		a = (i + 1) % 3;
+		b = (i + 2) % 3;
+
+		edges.edgeA[i] = y[a] - y[b];
+		edges.edgeB[i] = x[b] - x[a];
+		edges.edgeC[i] = -((long long)edges.edgeA[i] * x[a] + (long long)edges.edgeB[i] * y[a]);
+
+		//Top-left fill rule: pixels exactly on an edge only belong to the triangle if it is a top or a left edge.
+		if (!(edges.edgeA[i] > 0 || (edges.edgeA[i] == 0 && edges.edgeB[i] > 0)))
+		{
+			edges.edgeC[i] -= 1;
+		}
+	}
+
+	return (long long)(x[1] - x[0]) * (y[2] - y[0]) - (long long)(y[1] - y[0]) * (x[2] - x[0]);
+}
+
+/*
+ *	RasterizeBlocks()
+ *	brief: Finds the pixels of a rectangle covered by a triangle. The rectangle is walked in 8x8 blocks aligned to
+ *		   the screen. Each block is first tested as a whole with the edge functions at its corners: blocks outside
+ *		   an edge are skipped and blocks inside all of them are fully covered without looking at their pixels.
+ *		   Only the blocks crossed by an edge are evaluated pixel by pixel, with the SIMD kernel of the CPU, and
+ *		   only against the edges that cross them.
+ *	param edges: The edge functions of the triangle.
+ *	param minX, minY, maxX, maxY: The rectangle in pixels, inclusive. It can't have negative coordinates.
+ *	param blocks: Receives the blocks with some pixel covered. It needs room for every block of the rectangle.
+ *	return: The number of blocks written.
+ */
+int RasterizeBlocks(const RasterEdges& edges, int minX, int minY, int maxX, int maxY, CoverageBlock* blocks)
+{
+	long long rowEdge[3], edge[3], blockStepX[3], blockStepY[3], minOffset[3], maxOffset[3];
+	long long pixelX, pixelY, reach;
+	int blockEdge[3], stepX[3], stepY[3];
+	int blockMinX, blockMinY, firstRow, lastRow, firstColumn, lastColumn;
+	unsigned long long rowMask, rectMask, mask;
+	unsigned int columnBits;
+	bool rejected, partial;
+	int count;
+
+	if (minX > maxX || minY > maxY)
+	{
+		return 0;
+	}
+
+	blockMinX = minX & ~(RASTER_BLOCK_SIZE - 1);
+	blockMinY = minY & ~(RASTER_BLOCK_SIZE - 1);
+	reach = (RASTER_BLOCK_SIZE - 1) << RASTER_SUBPIXEL_BITS;
+
+	//Edge values at the center of the top-left pixel of the first block, and how they change between blocks.
+	pixelX = ((long long)blockMinX << RASTER_SUBPIXEL_BITS) + (1 << (RASTER_SUBPIXEL_BITS - 1));
+	pixelY = ((long long)blockMinY << RASTER_SUBPIXEL_BITS) + (1 << (RASTER_SUBPIXEL_BITS - 1));
+	for (int i = 0; i < 3; i++)
+	{
+		rowEdge[i] = edges.edgeA[i] * pixelX + edges.edgeB[i] * pixelY + edges.edgeC[i];
+		blockStepX[i] = ((long long)edges.edgeA[i] * RASTER_BLOCK_SIZE) << RASTER_SUBPIXEL_BITS;
+		blockStepY[i] = ((long long)edges.edgeB[i] * RASTER_BLOCK_SIZE) << RASTER_SUBPIXEL_BITS;
+
+		//The lowest and highest value of the edge inside a block are in two of its corners.
+		minOffset[i] = std::min(edges.edgeA[i] * reach, 0LL) + std::min(edges.edgeB[i] * reach, 0LL);
+		maxOffset[i] = std::max(edges.edgeA[i] * reach, 0LL) + std::max(edges.edgeB[i] * reach, 0LL);
+	}
+
+	count = 0;
+	for (int blockY = blockMinY; blockY <= maxY; blockY += RASTER_BLOCK_SIZE)
+	{
+		//Rows of this block row inside the rectangle.
+		firstRow = std::max(minY - blockY, 0);
+		lastRow = std::min(maxY - blockY, RASTER_BLOCK_SIZE - 1);
+		rowMask = (lastRow == RASTER_BLOCK_SIZE - 1) ? ~0ULL : ((1ULL << ((lastRow + 1) * RASTER_BLOCK_SIZE)) - 1);
+		rowMask &= ~((1ULL << (firstRow * RASTER_BLOCK_SIZE)) - 1);
+
+		edge[0] = rowEdge[0];
+		edge[1] = rowEdge[1];
+		edge[2] = rowEdge[2];
+
+		for (int blockX = blockMinX; blockX <= maxX; blockX += RASTER_BLOCK_SIZE)
+		{
+			rejected = false;
+			partial = false;
+
+			for (int i = 0; i < 3; i++)
+			{
+				if (edge[i] + maxOffset[i] < 0)
+				{
+					rejected = true;
+					break;
+				}
+
+				if (edge[i] + minOffset[i] < 0)
+				{
+					//The edge crosses the block, so its values inside are small enough for 32 bits.
+					blockEdge[i] = (int)edge[i];
+					stepX[i] = edges.edgeA[i] << RASTER_SUBPIXEL_BITS;
+					stepY[i] = edges.edgeB[i] << RASTER_SUBPIXEL_BITS;
+					partial = true;
+				}
+				else
+				{
+					blockEdge[i] = 0;
+					stepX[i] = 0;
+					stepY[i] = 0;
+				}
+			}
+
+			if (!rejected)
+			{
+				//Columns of this block inside the rectangle, repeated for every row.
+				firstColumn = std::max(minX - blockX, 0);
+				lastColumn = std::min(maxX - blockX, RASTER_BLOCK_SIZE - 1);
+				columnBits = ((1u << (lastColumn + 1)) - 1) & ~((1u << firstColumn) - 1);
+				rectMask = rowMask & (columnBits * 0x0101010101010101ULL);
+
+				mask = partial ? g_blockCoverage(blockEdge, stepX, stepY) : ~0ULL;
+				mask &= rectMask;
+
+				if (mask)
+				{
+					blocks[count].x = blockX;
+					blocks[count].y = blockY;
+					blocks[count].mask = mask;
+					count++;
+				}
+			}
+
+			edge[0] += blockStepX[0];
+			edge[1] += blockStepX[1];
+			edge[2] += blockStepX[2];
+		}
+
+		rowEdge[0] += blockStepY[0];
+		rowEdge[1] += blockStepY[1];
+		rowEdge[2] += blockStepY[2];
+	}
+
+	return count;
+}
+
+SimdLevel GetRasterizerSimdLevel()
+{
+	return g_rasterizerLevel;
+}
+
+/*
+ *	SetRasterizerSimdLevel()
+ *	brief: Forces the kernel of a narrower instruction set, to compare them. It must not be called while rendering.
+ *	return: False if the CPU doesn't support that instruction set.
+ */
+bool SetRasterizerSimdLevel(SimdLevel level)
+{
+	if (level > g_supportedLevel)
+	{
+		return false;
+	}
+
+	g_rasterizerLevel = level;
+	g_blockCoverage = SelectBlockCoverage(level);
+	return true;
+}
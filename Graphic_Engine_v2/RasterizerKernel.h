@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef RASTERIZER_KERNEL
+#define RASTERIZER_KERNEL
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "SimdSupport.h"
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const int RASTER_SUBPIXEL_BITS = 4;		//Fixed point precision of the snapped screen positions.
+const int RASTER_BLOCK_SIZE = 8;		//Width and height in pixels of the blocks tested as a whole.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*The three edge functions of a triangle, E(x, y) = A * x + B * y + C, with x and y in sub-pixel units. Edge i is
+  the one in front of vertex i, so E divided by the doubled area is the barycentric weight of that vertex. A pixel
+  is covered when its center gives E >= 0 for the three edges; the top-left rule is already folded into C.*/
+struct RasterEdges
+{
+	int		  edgeA[3];
+	int		  edgeB[3];
+	long long edgeC[3];
+};
+
+//The coverage of one 8x8 block. Bit (row * 8 + column) is set for every covered pixel.
+struct CoverageBlock
+{
+	int				   x;
+	int				   y;
+	unsigned long long mask;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+long long SetupRasterEdges(const int* x, const int* y, RasterEdges& edges);
+int RasterizeBlocks(const RasterEdges& edges, int minX, int minY, int maxX, int maxY, CoverageBlock* blocks);
+
+SimdLevel GetRasterizerSimdLevel();
+bool SetRasterizerSimdLevel(SimdLevel level);
+
+#endif
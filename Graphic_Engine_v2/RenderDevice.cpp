@@ -0,0 +1,94 @@
+#include "RenderDevice.h"
+#include <chrono>
+
+RenderDevice::RenderDevice()
+{
+	m_executedCommandLists = 0;
+	m_passResultFirst = 0;
+	m_passResultCount = 0;
+}
+
+/*
+ *	InitializeMatrices()
+ *	brief: Builds the projection, world and orthographic matrices. They are the same for every backend.
+ *	param screenWidth: The render target width.
+ *	param screenHeight: The render target height.
+ *	param screenFar: The setting to know how far our 3D environment will render.
+ *	param screenNear: The setting to know how near our 3D environment will render.
+ */
+void RenderDevice::InitializeMatrices(int screenWidth, int screenHeight, float screenFar, float screenNear)
+{
+	float fieldOfView, screenAspect;
+
+	//Setup the projection matrix.
+	fieldOfView = 3.141592654f / 4.0f; //This here is a fixed number. It may be good to play with it to see what happens.
+	screenAspect = (float)screenWidth / (float)screenHeight;
+
+	//Create the projection matrix for 3D rendering.
+	m_projectionMatrix = XMMatrixPerspectiveFovLH(fieldOfView, screenAspect, screenNear, screenFar);
+
+	//Setup the world matrix.
+	m_worldMatrix = XMMatrixIdentity();
+
+	/*Here would be the view matrix, but because it is the matrix which will determine our point of view
+	  it seems to be better in the camera class.*/
+
+	/*The last thing to set is the orthographic matrix. This matrix will be used
+	  to render the 2D elements (like the GUI) on the screens.*/
+
+	//Create an orthographic projection matrix for 2D rendering.
+	m_orthographicMatrix = XMMatrixOrthographicLH((float)screenWidth, (float)screenHeight, screenNear, screenFar);
+}
+
+void RenderDevice::GetProjectionMatrix(XMMATRIX &projectionMatrix)
+{
+	projectionMatrix = m_projectionMatrix;
+}
+
+void RenderDevice::GetOrthographicMatrix(XMMATRIX &orthographicMatrix)
+{
+	orthographicMatrix = m_orthographicMatrix;
+}
+
+void RenderDevice::GetWorldMatrix(XMMATRIX &worldMatrix)
+{
+	worldMatrix = m_worldMatrix;
+}
+
+unsigned int RenderDevice::GetExecutedCommandLists()
+{
+	return m_executedCommandLists;
+}
+
+//Takes the statistics of the oldest pass done. False if no pass is done since the last call.
+bool RenderDevice::GetPassStatistics(RenderPassStatistics& statistics)
+{
+	if (m_passResultCount == 0)
+	{
+		return false;
+	}
+
+	statistics = m_passResults[m_passResultFirst];
+	m_passResultFirst = (m_passResultFirst + 1) % RENDER_PASS_RESULTS;
+	m_passResultCount--;
+	return true;
+}
+
+//Queues the statistics of a pass the device is done with. When nobody reads them the oldest ones are dropped.
+void RenderDevice::AddPassStatistics(const RenderPassStatistics& statistics)
+{
+	if (m_passResultCount == RENDER_PASS_RESULTS)
+	{
+		m_passResultFirst = (m_passResultFirst + 1) % RENDER_PASS_RESULTS;
+		m_passResultCount--;
+	}
+
+	m_passResults[(m_passResultFirst + m_passResultCount) % RENDER_PASS_RESULTS] = statistics;
+	m_passResultCount++;
+}
+
+//The time the passes are given in, seconds of the steady clock.
+double RenderDevice::ReadPassClock()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#ifndef RENDER_DEVICE
+#define RENDER_DEVICE
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "Platform.h"
+#include <DirectXMath.h>
+using namespace DirectX;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*Opaque handles to the resources created by a render device. Each backend decides what is behind them, so
+  ModelClass and ColorShader never see a D3D11 object directly.*/
+struct RenderBuffer;
+struct RenderProgram;
+struct RenderCommandList;
+struct RenderTarget;
+struct RenderReadback;
+
+enum RenderBackend
+{
+	RENDER_BACKEND_HARDWARE,	//Direct3D 11 on the primary video card.
+	RENDER_BACKEND_SOFTWARE		//Multithreaded CPU rasterizer that renders into memory. Doesn't need a window.
+};
+
+enum BufferBindType
+{
+	BUFFER_BIND_VERTEX,
+	BUFFER_BIND_INDEX,
+	BUFFER_BIND_CONSTANT
+};
+
+enum ElementFormat
+{
+	ELEMENT_FORMAT_FLOAT3,
+	ELEMENT_FORMAT_FLOAT4,
+	ELEMENT_FORMAT_UNORM16X4,	//Four unsigned shorts read as floats from 0 to 1.
+	ELEMENT_FORMAT_UNORM8X4		//Four bytes read as floats from 0 to 1, like a RGBA color.
+};
+
+enum IndexFormat
+{
+	INDEX_FORMAT_UINT16,
+	INDEX_FORMAT_UINT32
+};
+
+enum PrimitiveTopology
+{
+	PRIMITIVE_TOPOLOGY_TRIANGLELIST
+};
+
+enum InputClassification
+{
+	INPUT_PER_VERTEX_DATA,		//The element advances with every vertex.
+	INPUT_PER_INSTANCE_DATA		//The element advances every instanceDataStepRate instances.
+};
+
+//Use it as alignedByteOffset to place an element right after the previous one, like D3D11_APPEND_ALIGNED_ELEMENT.
+const unsigned int APPEND_ALIGNED_ELEMENT = 0xffffffff;
+
+//Bytes of the ring buffer the constants of the draws are suballocated from. It holds several frames on the GPU.
+const unsigned int CONSTANT_RING_SIZE = 16 * 1024 * 1024;
+
+//Passes a frame can be timed in, and timed passes kept until they are read.
+const unsigned int RENDER_MAX_PASSES = 8;
+const unsigned int RENDER_PASS_RESULTS = 64;
+
+enum RenderTargetFormat
+{
+	RENDER_TARGET_FORMAT_RGBA8,		//8 bits per channel, red in the lowest byte, like the screen.
+	RENDER_TARGET_FORMAT_BGRA8,		//The same with red and blue swapped, like Windows bitmaps.
+	RENDER_TARGET_FORMAT_RGBA16F	//A half float per channel.
+};
+
+struct BufferDesc
+{
+	BufferBindType bindType;
+	unsigned int   byteWidth;
+	bool		   dynamic;		//Dynamic buffers are rewritten by the CPU with MapBuffer() / UnmapBuffer().
+};
+
+struct InputElementDesc
+{
+	const char*			semanticName;
+	unsigned int		semanticIndex;
+	ElementFormat		format;
+	unsigned int		inputSlot;
+	unsigned int		alignedByteOffset;
+	InputClassification inputSlotClass;
+	unsigned int		instanceDataStepRate;	//0 for per vertex elements.
+};
+
+//An offscreen image frames can be drawn into instead of the screen, with its own depth buffer.
+struct RenderTargetDesc
+{
+	int				   width;
+	int				   height;
+	RenderTargetFormat format;
+};
+
+//The image of a render target a readback took, top row first.
+struct ReadbackImage
+{
+	const void*		   data;
+	unsigned int	   rowPitch;		//Bytes from the start of a row to the next one.
+	int				   width;
+	int				   height;
+	RenderTargetFormat format;
+	unsigned long long tag;				//What it was queued with.
+};
+
+/*What the device did in a pass and when. Both backends count the same things: the video card reads them from its
+  pipeline statistics, the software device counts them as it renders.*/
+struct RenderPassStatistics
+{
+	const char*		   name;
+	unsigned long long frame;			//Frames the device ended before the one of the pass.
+	bool			   timed;			//False when the device couldn't time the pass, like a video card changing its
+										//clock in the middle of the frame.
+	double			   start;			//Seconds of std::chrono::steady_clock, the clock of the CPU.
+	double			   end;
+	unsigned long long verticesShaded;
+	unsigned long long trianglesIn;		//Drawn.
+	unsigned long long trianglesOut;	//Left after clipping and culling, the ones rasterized.
+	unsigned long long pixelsShaded;
+	unsigned long long tilesTouched;	//Screen tiles drawn into. Video cards don't say, 0 there.
+};
+
+//A macro a shader is compiled with, like D3D_SHADER_MACRO.
+struct ShaderDefine
+{
+	const char* name;
+	const char* definition;
+};
+
+struct ShaderDesc
+{
+	const WCHAR*			vsFilename;
+	const char*				vsEntryPoint;
+	const WCHAR*			psFilename;
+	const char*				psEntryPoint;
+	const InputElementDesc* inputLayout;
+	unsigned int			numElements;
+	const ShaderDefine*		defines;		//Select the variant of the shaders to compile. Can be null.
+	unsigned int			numDefines;
+	unsigned int			permutation;	//The ShaderFeature bits the defines turn on, for backends that have every
+											//variant built in instead of compiling the files.
+};
+
+/*
+ *	RenderContext
+ *	brief: What binds state and draws. The device is the immediate context, which draws on the calling thread in the
+ *		   order of the calls. Deferred contexts, one per thread, record the same calls into command lists that the
+ *		   device executes later, so the cost of issuing the draws of a frame is split between threads.
+ */
+class RenderContext
+{
+public:
+	virtual ~RenderContext() {}
+
+	//Dynamic buffers. On a deferred context only constant buffers can be mapped, and the content written is what the
+	//draws recorded after it read.
+	virtual void* MapBuffer(RenderBuffer* buffer) = 0;
+	virtual void UnmapBuffer(RenderBuffer* buffer) = 0;
+
+	//Pipeline state and drawing.
+	virtual void SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset) = 0;
+	virtual void SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset) = 0;
+	virtual void SetPrimitiveTopology(PrimitiveTopology topology) = 0;
+	virtual void SetConstantBuffer(unsigned int slot, RenderBuffer* buffer) = 0;
+	virtual void SetShader(RenderProgram* shader) = 0;
+	virtual void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) = 0;
+	virtual void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex,
+									  int baseVertex, unsigned int startInstance) = 0;
+
+	//Binds byteSize bytes of the constant ring of the device, from an offset given by RenderDevice::MapConstantRing(),
+	//as the constant buffer of a slot. Deferred contexts can bind it too.
+	virtual void SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize) = 0;
+};
+
+/*
+ *	RenderDevice
+ *	brief: The interface every render backend implements. It follows the same BeginScene / draw indexed / EndScene
+ *		   flow the engine always had with D3D11, so the rest of the engine doesn't care where the pixels end up.
+ */
+class RenderDevice : public RenderContext
+{
+public:
+	RenderDevice();
+	virtual ~RenderDevice() {}
+
+	virtual bool Initialize(int screenWidth, int screenHeight, bool vsync, HWND hwnd, bool fullscreen,
+							float screenFar, float screenNear) = 0;
+	virtual void Shutdown() = 0;
+
+	virtual void BeginScene(float red, float green, float blue, float alpha) = 0;
+	virtual void EndScene() = 0;
+
+	//Resource creation.
+	virtual bool CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer) = 0;
+	virtual void ReleaseBuffer(RenderBuffer* buffer) = 0;
+
+	virtual bool CreateShader(const ShaderDesc& desc, RenderProgram** shader) = 0;
+	virtual void ReleaseShader(RenderProgram* shader) = 0;
+
+	//Creates many shaders at once, like the variants of a shader, so the backend can compile them in parallel. If
+	//any of them fails none is created.
+	virtual bool CreateShaders(const ShaderDesc* descs, unsigned int count, RenderProgram** shaders) = 0;
+
+	/*Deferred contexts. Each one is used by a single thread at a time. A deferred context starts with no state bound,
+	  FinishCommandList() takes what it recorded and leaves it empty again, and ExecuteCommandList() runs a list on
+	  the device, after which the device has no state bound either. The lists have to be executed in the frame they
+	  were recorded in, and the buffers they draw from are read as they were when the draws were recorded.*/
+	virtual bool CreateDeferredContext(RenderContext** context) = 0;
+	virtual void ReleaseDeferredContext(RenderContext* context) = 0;
+	virtual bool FinishCommandList(RenderContext* context, RenderCommandList** commandList) = 0;
+	virtual void ExecuteCommandList(RenderCommandList* commandList) = 0;
+	virtual void ReleaseCommandList(RenderCommandList* commandList) = 0;
+
+	/*The constant ring. MapConstantRing() reserves the constants of count draws, blocks of byteSize bytes that are
+	  stride bytes apart, and returns where to write the first one. The memory is never in use by a frame still
+	  rendering, so it is written without the copy a discard makes, and one map can fill the constants of a whole
+	  frame. It has to be unmapped before drawing. Returns null if the backend has no ring or it has no room left,
+	  in which case the draws fall back to their own constant buffers.*/
+	virtual void* MapConstantRing(unsigned int byteSize, unsigned int count, unsigned int& offset,
+								  unsigned int& stride) = 0;
+	virtual void UnmapConstantRing() = 0;
+
+	/*Offscreen render targets. Frames are drawn into the target set, or into the screen with null, the default. It
+	  is only changed between EndScene() and BeginScene(), and the matrices stay the ones of the screen. Not every
+	  backend can draw every format, creating a target in one it can't fails.*/
+	virtual bool CreateRenderTarget(const RenderTargetDesc& desc, RenderTarget** target) = 0;
+	virtual void ReleaseRenderTarget(RenderTarget* target) = 0;
+	virtual void SetRenderTarget(RenderTarget* target) = 0;
+
+	/*Readback of a render target without waiting for it, through a ring of depth images. QueueReadback() takes the
+	  image the last frame left in the target and returns at once, or fails if depth images are waiting already.
+	  MapReadback() gives the oldest one waiting when it is ready, or if wait is set blocks until it is, and the
+	  image stays valid until UnmapReadback() frees its place in the ring. The readbacks of a target are released
+	  before it.*/
+	virtual bool CreateReadback(RenderTarget* target, unsigned int depth, RenderReadback** readback) = 0;
+	virtual void ReleaseReadback(RenderReadback* readback) = 0;
+	virtual bool QueueReadback(RenderReadback* readback, unsigned long long tag) = 0;
+	virtual bool MapReadback(RenderReadback* readback, bool wait, ReadbackImage& image) = 0;
+	virtual void UnmapReadback(RenderReadback* readback) = 0;
+
+	/*Timing of the passes of a frame. BeginPass() and EndPass() go around the draws of a pass, between BeginScene()
+	  and EndScene(), without nesting and at most RENDER_MAX_PASSES a frame; the name has to live as long as the
+	  program. The statistics of the passes come out of GetPassStatistics() in the order they were drawn once the
+	  device is done with them, without waiting for it: on the video card that is a few frames later.*/
+	virtual void BeginPass(const char* name) = 0;
+	virtual void EndPass() = 0;
+	bool GetPassStatistics(RenderPassStatistics& statistics);
+
+	virtual void GetVideoCardInfo(char* cardName, int& memory) = 0;
+
+	void GetProjectionMatrix(XMMATRIX& projectionMatrix);
+	void GetOrthographicMatrix(XMMATRIX& orthographicMatrix);
+	void GetWorldMatrix(XMMATRIX& worldMatrix);
+
+	//Grows with every command list executed, since a list can leave other content in the buffers it mapped.
+	unsigned int GetExecutedCommandLists();
+
+protected:
+	void InitializeMatrices(int screenWidth, int screenHeight, float screenFar, float screenNear);
+	void AddPassStatistics(const RenderPassStatistics& statistics);
+	static double ReadPassClock();
+
+protected:
+	XMMATRIX	 m_projectionMatrix;
+	XMMATRIX	 m_worldMatrix;
+	XMMATRIX	 m_orthographicMatrix;
+	unsigned int m_executedCommandLists;
+
+	//Passes done and not read yet, a queue from the oldest.
+	RenderPassStatistics m_passResults[RENDER_PASS_RESULTS];
+	unsigned int		 m_passResultFirst;
+	unsigned int		 m_passResultCount;
+};
+
+#endif
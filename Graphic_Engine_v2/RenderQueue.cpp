@@ -0,0 +1,458 @@
+#include "RenderQueue.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+//The upper 32 bits of the address times the 64 bit golden ratio, which every bit of the address is mixed into.
+static unsigned int HashState(const void* state)
+{
+	return (unsigned int)(((unsigned long long)(uintptr_t)state * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+RenderQueueClass::RenderQueueClass()
+{
+	m_device = nullptr;
+	m_jobSystem = nullptr;
+	m_shaderIds.count = 0;
+	m_materialIds.count = 0;
+	m_stamp = 0;
+	m_constantsInRing = false;
+	m_ringOffset = 0;
+	m_ringStride = 0;
+	memset(&m_statistics, 0, sizeof(m_statistics));
+}
+
+RenderQueueClass::RenderQueueClass(const RenderQueueClass &)
+{
+}
+
+
+RenderQueueClass::~RenderQueueClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Prepares the queue to submit to a device, creating a deferred context for every thread of the job system.
+ *	param jobSystem: The threads that record the draws. Can be null, and backends without deferred contexts
+ *		  record on the calling thread too.
+ */
+bool RenderQueueClass::Initialize(RenderDevice* device, JobSystemClass* jobSystem)
+{
+	RenderContext* context;
+
+	m_device = device;
+	m_jobSystem = jobSystem;
+
+	if (m_jobSystem && m_jobSystem->GetThreadCount() > 1)
+	{
+		for (unsigned int i = 0; i < m_jobSystem->GetThreadCount(); i++)
+		{
+			if (!m_device->CreateDeferredContext(&context))
+			{
+				break;
+			}
+			m_contexts.push_back(context);
+		}
+
+		if (m_contexts.size() < m_jobSystem->GetThreadCount())
+		{
+			for (unsigned int i = 0; i < m_contexts.size(); i++)
+			{
+				m_device->ReleaseDeferredContext(m_contexts[i]);
+			}
+			m_contexts.clear();
+		}
+	}
+
+	Begin();
+	return true;
+}
+
+void RenderQueueClass::Shutdown()
+{
+	for (unsigned int i = 0; i < m_contexts.size(); i++)
+	{
+		m_device->ReleaseDeferredContext(m_contexts[i]);
+	}
+	m_contexts.clear();
+	std::vector<RenderCommandList*>().swap(m_commandLists);
+	std::vector<RenderQueueStatistics>().swap(m_rangeStatistics);
+	std::vector<unsigned char>().swap(m_rangeResults);
+
+	std::vector<RenderCommand>().swap(m_commands);
+	std::vector<SortEntry>().swap(m_entries);
+	std::vector<SortEntry>().swap(m_sortBuffer);
+	std::vector<StateSlot>().swap(m_shaderIds.slots);
+	std::vector<StateSlot>().swap(m_materialIds.slots);
+}
+
+//Empties the queue to record a new frame. The memory is kept for the next one.
+void RenderQueueClass::Begin()
+{
+	m_commands.clear();
+	m_entries.clear();
+
+	//A new stamp empties the state tables without touching them. When it wraps around the old stamps are cleared.
+	m_shaderIds.count = 0;
+	m_materialIds.count = 0;
+	if (++m_stamp == 0)
+	{
+		for (unsigned int i = 0; i < m_shaderIds.slots.size(); i++)
+		{
+			m_shaderIds.slots[i].stamp = 0;
+		}
+		for (unsigned int i = 0; i < m_materialIds.slots.size(); i++)
+		{
+			m_materialIds.slots[i].stamp = 0;
+		}
+		m_stamp = 1;
+	}
+}
+
+/*
+ *	AddDraw()
+ *	brief: Records a draw of a model with the color shader.
+ *	param worldViewProjectionMatrix: The matrix the shader gets for this draw.
+ *	param depth: Distance of the model from the camera along the view direction, to order the draws of a material.
+ */
+void RenderQueueClass::AddDraw(RenderPass pass, ColorShader* shader, ModelClass* model,
+							   const XMMATRIX& worldViewProjectionMatrix, float depth)
+{
+	RenderCommand command;
+	SortEntry entry;
+	unsigned int depthBits;
+
+	command.shader = shader;
+	command.program = shader->GetProgram(model->GetVertexFormat());
+	command.model = model;
+	XMStoreFloat4x4(&command.worldViewProjection, worldViewProjectionMatrix);
+
+	//Positive floats keep their order when their bits are compared as integers; the ones behind the camera go first.
+	depth = std::max(depth, 0.0f);
+	memcpy(&depthBits, &depth, sizeof(depthBits));
+	if (pass == RENDER_PASS_TRANSPARENT)
+	{
+		depthBits = ~depthBits;
+	}
+
+	entry.key = (unsigned long long)pass << (RENDER_KEY_SHADER_BITS + RENDER_KEY_MATERIAL_BITS + RENDER_KEY_DEPTH_BITS);
+	entry.key |= (unsigned long long)GetStateId(m_shaderIds, command.program, RENDER_KEY_SHADER_BITS)
+				 << (RENDER_KEY_MATERIAL_BITS + RENDER_KEY_DEPTH_BITS);
+	entry.key |= (unsigned long long)GetStateId(m_materialIds, model, RENDER_KEY_MATERIAL_BITS) << RENDER_KEY_DEPTH_BITS;
+	entry.key |= depthBits;
+	entry.command = (unsigned int)m_commands.size();
+
+	m_commands.push_back(command);
+	m_entries.push_back(entry);
+}
+
+/*
+ *	Submit()
+ *	brief: Sorts the recorded draws and issues them, binding the program and the buffers only when they differ from
+ *		   the previous draw. With enough draws the ranges are recorded by every thread and executed in order.
+ */
+bool RenderQueueClass::Submit()
+{
+	const RenderProgram* lastProgram = nullptr;
+	const ModelClass* lastModel = nullptr;
+	unsigned int count, rangeSize, rangeCount;
+	bool bResult;
+
+	PROFILE_ZONE("RenderQueueClass::Submit");
+
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	count = (unsigned int)m_entries.size();
+	m_statistics.draws = count;
+
+	//What binding only the changes would have cost in the order the draws came.
+	for (unsigned int i = 0; i < m_commands.size(); i++)
+	{
+		m_statistics.unsortedShaderChanges += m_commands[i].program != lastProgram ? 1 : 0;
+		m_statistics.unsortedBufferChanges += m_commands[i].model != lastModel ? 1 : 0;
+		lastProgram = m_commands[i].program;
+		lastModel = m_commands[i].model;
+	}
+
+	SortEntries();
+	WriteConstants();
+
+	//Few draws aren't worth the command lists.
+	if (m_contexts.empty() || count < 2 * RENDER_QUEUE_RECORD_BATCH)
+	{
+		return RecordDraws(m_device, 0, count, m_statistics);
+	}
+
+	//A range per thread, unless that leaves them too small.
+	rangeSize = std::max(RENDER_QUEUE_RECORD_BATCH, (count + (unsigned int)m_contexts.size() - 1) / (unsigned int)m_contexts.size());
+	rangeCount = (count + rangeSize - 1) / rangeSize;
+
+	m_commandLists.assign(rangeCount, nullptr);
+	m_rangeStatistics.resize(rangeCount);
+	m_rangeResults.assign(rangeCount, 0);
+
+	//Recording doesn't wait for other jobs, so a thread runs one range at a time and can record all of its ranges
+	//with its own context.
+	m_jobSystem->ParallelFor(rangeCount, 1, [this, rangeSize, count](unsigned int index, unsigned int threadIndex)
+	{
+		RenderContext* context = m_contexts[threadIndex];
+		bool bRecorded;
+
+		memset(&m_rangeStatistics[index], 0, sizeof(RenderQueueStatistics));
+		bRecorded = RecordDraws(context, index * rangeSize, std::min(count, (index + 1) * rangeSize), m_rangeStatistics[index]);
+
+		//The list is finished even if a draw failed, to leave the context empty for the next range.
+		if (m_device->FinishCommandList(context, &m_commandLists[index]))
+		{
+			m_rangeResults[index] = bRecorded ? 1 : 0;
+		}
+	});
+
+	bResult = true;
+	for (unsigned int i = 0; i < rangeCount; i++)
+	{
+		if (m_rangeResults[i] && bResult)
+		{
+			m_device->ExecuteCommandList(m_commandLists[i]);
+			m_statistics.shaderChanges += m_rangeStatistics[i].shaderChanges;
+			m_statistics.bufferChanges += m_rangeStatistics[i].bufferChanges;
+		}
+		else
+		{
+			bResult = false;
+		}
+
+		if (m_commandLists[i])
+		{
+			m_device->ReleaseCommandList(m_commandLists[i]);
+		}
+	}
+
+	return bResult;
+}
+
+//Draws and state changes of the last Submit().
+void RenderQueueClass::GetStatistics(RenderQueueStatistics& statistics)
+{
+	statistics = m_statistics;
+}
+
+/*
+ *	GetStateId()
+ *	brief: Numbers the states in the order they are first seen in the frame, to fit them in a few bits of the key.
+ *		   If there are more than fit, the extra ones share numbers; the draws are still correct, only grouped worse.
+ */
+unsigned int RenderQueueClass::GetStateId(StateTable& table, const void* state, unsigned int bits)
+{
+	unsigned int mask, slot;
+
+	if ((table.count + 1) * 2 > table.slots.size())
+	{
+		GrowStateTable(table);
+	}
+
+	mask = (unsigned int)table.slots.size() - 1;
+	slot = HashState(state) & mask;
+	while (table.slots[slot].stamp == m_stamp)
+	{
+		if (table.slots[slot].state == state)
+		{
+			return table.slots[slot].id;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	table.slots[slot].state = state;
+	table.slots[slot].id = table.count & ((1 << bits) - 1);
+	table.slots[slot].stamp = m_stamp;
+	table.count++;
+
+	return table.slots[slot].id;
+}
+
+//Doubles the slots of a state table, moving the states of the frame to the new ones.
+void RenderQueueClass::GrowStateTable(StateTable& table)
+{
+	std::vector<StateSlot> oldSlots;
+	unsigned int mask, slot;
+
+	oldSlots.swap(table.slots);
+	table.slots.resize(std::max<size_t>(64, oldSlots.size() * 2));
+	for (unsigned int i = 0; i < table.slots.size(); i++)
+	{
+		table.slots[i].stamp = m_stamp - 1;
+	}
+
+	mask = (unsigned int)table.slots.size() - 1;
+	for (unsigned int i = 0; i < oldSlots.size(); i++)
+	{
+		if (oldSlots[i].stamp != m_stamp)
+		{
+			continue;
+		}
+
+		slot = HashState(oldSlots[i].state) & mask;
+		while (table.slots[slot].stamp == m_stamp)
+		{
+			slot = (slot + 1) & mask;
+		}
+		table.slots[slot] = oldSlots[i];
+	}
+}
+
+/*
+ *	SortEntries()
+ *	brief: Sorts the entries by key with a least significant digit radix sort, a byte per pass. The histograms of
+ *		   every byte are counted in one read, and the bytes that are the same in every key, like the pass of a
+ *		   frame with only opaque draws, are skipped.
+ */
+void RenderQueueClass::SortEntries()
+{
+	unsigned int histograms[8][256], offsets[256], count, shift, sum;
+	SortEntry *source, *destination;
+
+	count = (unsigned int)m_entries.size();
+	if (count < RENDER_QUEUE_RADIX_MIN)
+	{
+		std::sort(m_entries.begin(), m_entries.end(), CompareEntries);
+		return;
+	}
+
+	memset(histograms, 0, sizeof(histograms));
+	for (unsigned int i = 0; i < count; i++)
+	{
+		for (int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit][(m_entries[i].key >> (digit * 8)) & 0xff]++;
+		}
+	}
+
+	m_sortBuffer.resize(count);
+	source = &m_entries[0];
+	destination = &m_sortBuffer[0];
+	for (int digit = 0; digit < 8; digit++)
+	{
+		shift = digit * 8;
+		if (histograms[digit][(source[0].key >> shift) & 0xff] == count)
+		{
+			continue;
+		}
+
+		sum = 0;
+		for (int value = 0; value < 256; value++)
+		{
+			offsets[value] = sum;
+			sum += histograms[digit][value];
+		}
+
+		//Stable, so the order of the lower bytes is kept.
+		for (unsigned int i = 0; i < count; i++)
+		{
+			destination[offsets[(source[i].key >> shift) & 0xff]++] = source[i];
+		}
+		std::swap(source, destination);
+	}
+
+	if (source != &m_entries[0])
+	{
+		memcpy(&m_entries[0], source, sizeof(SortEntry) * count);
+	}
+}
+
+/*
+ *	WriteConstants()
+ *	brief: Writes the parameters of every draw to the constant ring of the device in one map, in the order they are
+ *		   drawn, instead of each draw mapping its shader buffer with discard. If the ring has no room the draws
+ *		   map their own buffers as before.
+ */
+void RenderQueueClass::WriteConstants()
+{
+	unsigned char* constants;
+	unsigned int count;
+
+	count = (unsigned int)m_entries.size();
+	m_constantsInRing = false;
+	m_statistics.constantMaps = count;
+	if (count == 0)
+	{
+		return;
+	}
+
+	//Every draw has the same parameters for now, so they all take blocks of the same size.
+	constants = (unsigned char*)m_device->MapConstantRing(m_commands[0].shader->GetParameterSize(), count,
+														  m_ringOffset, m_ringStride);
+	if (!constants)
+	{
+		return;
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const RenderCommand& command = m_commands[m_entries[i].command];
+
+		command.shader->WriteShaderParameters(constants + (size_t)i * m_ringStride, XMLoadFloat4x4(&command.worldViewProjection));
+	}
+
+	m_device->UnmapConstantRing();
+	m_constantsInRing = true;
+	m_statistics.constantMaps = 1;
+}
+
+bool RenderQueueClass::CompareEntries(const SortEntry& a, const SortEntry& b)
+{
+	return a.key < b.key;
+}
+
+/*
+ *	RecordDraws()
+ *	brief: Issues a range of the sorted draws on a context, which starts with nothing bound.
+ *	param statistics: Gets the shader and buffer changes added.
+ */
+bool RenderQueueClass::RecordDraws(RenderContext* context, unsigned int first, unsigned int last,
+								   RenderQueueStatistics& statistics)
+{
+	const RenderProgram* lastProgram = nullptr;
+	const ModelClass* lastModel = nullptr;
+	bool bResult;
+
+	PROFILE_ZONE("RenderQueueClass::RecordDraws");
+
+	for (unsigned int i = first; i < last; i++)
+	{
+		const RenderCommand& command = m_commands[m_entries[i].command];
+
+		//Put the model vertex and index buffers on the graphics pipeline.
+		if (command.model != lastModel)
+		{
+			command.model->Render(context);
+			lastModel = command.model;
+			statistics.bufferChanges++;
+		}
+
+		//Set the vertex input layout and the vertex and pixel shaders.
+		if (command.program != lastProgram)
+		{
+			context->SetShader(command.program);
+			lastProgram = command.program;
+			statistics.shaderChanges++;
+		}
+
+		if (m_constantsInRing)
+		{
+			command.shader->SetShaderParameterRange(context, m_ringOffset + i * m_ringStride);
+		}
+		else
+		{
+			bResult = command.shader->SetShaderParameters(context, XMLoadFloat4x4(&command.worldViewProjection));
+			if (!bResult)
+			{
+				return false;
+			}
+		}
+
+		context->DrawIndexed(command.model->GetIndexCount(), 0, 0);
+	}
+
+	return true;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#ifndef RENDER_QUEUE
+#define RENDER_QUEUE
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "RenderDevice.h"
+#include "ModelClass.h"
+#include "ColorShader.h"
+#include "JobSystem.h"
+#include <DirectXMath.h>
+#include <vector>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+
+/*	Bits of the 64 bit sort key, from the most significant down: the pass, the shader program, the material (for
+	now the buffers of the model) and the depth. Draws are submitted in key order, so the draws sharing a program
+	and buffers end up together.																				*/
+const unsigned int RENDER_KEY_PASS_BITS = 4;
+const unsigned int RENDER_KEY_SHADER_BITS = 12;
+const unsigned int RENDER_KEY_MATERIAL_BITS = 16;
+const unsigned int RENDER_KEY_DEPTH_BITS = 32;
+
+const unsigned int RENDER_QUEUE_RADIX_MIN = 256;	//Smaller queues are sorted by comparison.
+const unsigned int RENDER_QUEUE_RECORD_BATCH = 1024;	//Fewest draws recorded into a command list by one thread.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE,			//Front to back inside every material, so the depth test rejects the most pixels.
+	RENDER_PASS_TRANSPARENT		//Back to front, to blend in the right order.
+};
+
+struct RenderQueueStatistics
+{
+	unsigned int draws;
+	unsigned int shaderChanges;			//Input layout, vertex and pixel shader bound.
+	unsigned int bufferChanges;			//Vertex and index buffers bound.
+	unsigned int unsortedShaderChanges;	//The same in the order the draws were added, without sorting.
+	unsigned int unsortedBufferChanges;
+	unsigned int constantMaps;			//Constant buffers mapped to write the draw parameters.
+};
+
+/*
+ *	RenderQueueClass
+ *	brief: Collects the draws of a frame as sort keys plus the data to draw them, sorts the keys with a radix sort
+ *		   and submits the draws binding only the state that changed from the previous one. Before it, every draw
+ *		   bound its buffers, input layout and shaders.
+ *		   Large queues are split in consecutive ranges recorded in parallel into command lists, one deferred context
+ *		   per thread, which the device then executes in order. Every range binds its state again from scratch.
+ */
+class RenderQueueClass
+{
+private:
+	//What a draw needs besides its state.
+	struct RenderCommand
+	{
+		ColorShader*	shader;
+		RenderProgram*	program;
+		ModelClass*		model;
+		XMFLOAT4X4		worldViewProjection;
+	};
+
+	struct SortEntry
+	{
+		unsigned long long key;
+		unsigned int	   command;
+	};
+
+	struct StateSlot
+	{
+		const void*	 state;
+		unsigned int id;
+		unsigned int stamp;			//Frame the slot was filled in. The ones of other frames count as empty.
+	};
+
+	//Numbers of the states seen in the frame, in an open addressing table that is never cleared, so numbering the
+	//states doesn't allocate once the table has grown to the most states a frame has had.
+	struct StateTable
+	{
+		std::vector<StateSlot> slots;	//A power of two, more than twice the states numbered.
+		unsigned int		   count;
+	};
+
+public:
+	RenderQueueClass();
+	RenderQueueClass(const RenderQueueClass&);
+	~RenderQueueClass();
+
+	bool Initialize(RenderDevice* device, JobSystemClass* jobSystem);
+	void Shutdown();
+
+	void Begin();
+	void AddDraw(RenderPass pass, ColorShader* shader, ModelClass* model, const XMMATRIX& worldViewProjectionMatrix,
+				 float depth);
+	bool Submit();
+
+	void GetStatistics(RenderQueueStatistics& statistics);
+
+private:
+	unsigned int GetStateId(StateTable& table, const void* state, unsigned int bits);
+	void GrowStateTable(StateTable& table);
+	void SortEntries();
+	void WriteConstants();
+	static bool CompareEntries(const SortEntry& a, const SortEntry& b);
+	bool RecordDraws(RenderContext* context, unsigned int first, unsigned int last, RenderQueueStatistics& statistics);
+
+private:
+	RenderDevice*					   m_device;
+	JobSystemClass*					   m_jobSystem;			//Null to record every draw on the calling thread.
+	std::vector<RenderContext*>		   m_contexts;			//A deferred context per thread of the job system.
+	std::vector<RenderCommandList*>	   m_commandLists;		//One per range of the current Submit().
+	std::vector<RenderQueueStatistics> m_rangeStatistics;
+	std::vector<unsigned char>		   m_rangeResults;
+	std::vector<RenderCommand>		   m_commands;
+	std::vector<SortEntry>			   m_entries;
+	std::vector<SortEntry>			   m_sortBuffer;		//Second buffer of the radix sort.
+	StateTable						   m_shaderIds;			//Numbered in the order seen this frame.
+	StateTable						   m_materialIds;
+	unsigned int					   m_stamp;				//Of the current frame in the state tables.
+	bool							   m_constantsInRing;	//The parameters of the sorted draws are in the ring,
+	unsigned int					   m_ringOffset;		//from this offset and a block every m_ringStride bytes.
+	unsigned int					   m_ringStride;
+	RenderQueueStatistics			   m_statistics;
+};
+
+#endif
@@ -0,0 +1,434 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <cmath>
+
+/************************************************************************/
+/* FUNCTIONS                                                            */
+/************************************************************************/
+
+//Moves every value to its place in the new order, where order holds the old index of every new one.
+static void PermuteValues(std::vector<float>& values, const std::vector<unsigned int>& order)
+{
+	std::vector<float> permuted(values.size());
+
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		permuted[i] = values[order[i]];
+	}
+	values.swap(permuted);
+}
+
+SceneGraphClass::SceneGraphClass()
+{
+	m_jobSystem = nullptr;
+	m_sorted = true;
+	m_updatedCount = 0;
+}
+
+SceneGraphClass::SceneGraphClass(const SceneGraphClass &)
+{
+}
+
+
+SceneGraphClass::~SceneGraphClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Starts an empty scene.
+ *	param jobSystem: The threads to update big changes with, or null to update on the calling thread.
+ */
+bool SceneGraphClass::Initialize(JobSystemClass* jobSystem)
+{
+	m_jobSystem = jobSystem;
+	m_sorted = true;
+	return true;
+}
+
+void SceneGraphClass::Shutdown()
+{
+	std::vector<unsigned int>().swap(m_parents);
+	std::vector<unsigned int>().swap(m_subtreeEnds);
+	std::vector<float>().swap(m_positionX);
+	std::vector<float>().swap(m_positionY);
+	std::vector<float>().swap(m_positionZ);
+	std::vector<float>().swap(m_rotationX);
+	std::vector<float>().swap(m_rotationY);
+	std::vector<float>().swap(m_rotationZ);
+	std::vector<float>().swap(m_rotationW);
+	std::vector<float>().swap(m_scaleX);
+	std::vector<float>().swap(m_scaleY);
+	std::vector<float>().swap(m_scaleZ);
+	std::vector<XMFLOAT4X4>().swap(m_worldMatrices);
+	std::vector<unsigned char>().swap(m_dirty);
+	std::vector<unsigned int>().swap(m_handles);
+	std::vector<unsigned int>().swap(m_indices);
+	std::vector<unsigned int>().swap(m_dirtyNodes);
+	std::vector<unsigned int>().swap(m_ranges);
+	std::vector<unsigned int>().swap(m_batches);
+
+	m_jobSystem = nullptr;
+	m_sorted = true;
+}
+
+/*
+ *	AddNode()
+ *	brief: Adds a node with an identity local transform. Adding the nodes of a subtree right after its root keeps
+ *		   the arrays in order; otherwise they are sorted again by the next Update().
+ *	param parent: The handle of the parent, or SCENE_NO_PARENT for a root.
+ *	return: The handle of the node.
+ */
+unsigned int SceneGraphClass::AddNode(unsigned int parent)
+{
+	const unsigned int index = (unsigned int)m_parents.size();
+	const unsigned int handle = (unsigned int)m_indices.size();
+	unsigned int parentIndex = parent == SCENE_NO_PARENT ? SCENE_NO_PARENT : m_indices[parent];
+
+	//The node stays in depth first order if its parent's subtree ends at the end of the arrays.
+	if (m_sorted && parentIndex != SCENE_NO_PARENT && m_subtreeEnds[parentIndex] != index)
+	{
+		m_sorted = false;
+	}
+	if (m_sorted)
+	{
+		for (unsigned int ancestor = parentIndex; ancestor != SCENE_NO_PARENT; ancestor = m_parents[ancestor])
+		{
+			m_subtreeEnds[ancestor]++;
+		}
+	}
+
+	m_parents.push_back(parentIndex);
+	m_subtreeEnds.push_back(index + 1);
+	m_positionX.push_back(0.0f);
+	m_positionY.push_back(0.0f);
+	m_positionZ.push_back(0.0f);
+	m_rotationX.push_back(0.0f);
+	m_rotationY.push_back(0.0f);
+	m_rotationZ.push_back(0.0f);
+	m_rotationW.push_back(1.0f);
+	m_scaleX.push_back(1.0f);
+	m_scaleY.push_back(1.0f);
+	m_scaleZ.push_back(1.0f);
+	m_worldMatrices.push_back(XMFLOAT4X4());
+	m_dirty.push_back(0);
+	m_handles.push_back(handle);
+	m_indices.push_back(index);
+
+	MarkDirty(index);
+	return handle;
+}
+
+void SceneGraphClass::SetLocalPosition(unsigned int node, float x, float y, float z)
+{
+	const unsigned int index = m_indices[node];
+
+	m_positionX[index] = x;
+	m_positionY[index] = y;
+	m_positionZ[index] = z;
+	MarkDirty(index);
+}
+
+/*
+ *	SetLocalRotation()
+ *	brief: Sets the rotation relative to the parent, in radians, applied like XMMatrixRotationRollPitchYaw(): roll
+ *		   around z first, then pitch around x and yaw around y.
+ */
+void SceneGraphClass::SetLocalRotation(unsigned int node, float pitch, float yaw, float roll)
+{
+	const unsigned int index = m_indices[node];
+	const float sinPitch = sinf(pitch * 0.5f), cosPitch = cosf(pitch * 0.5f);
+	const float sinYaw = sinf(yaw * 0.5f), cosYaw = cosf(yaw * 0.5f);
+	const float sinRoll = sinf(roll * 0.5f), cosRoll = cosf(roll * 0.5f);
+
+	m_rotationX[index] = sinPitch * cosYaw * cosRoll + cosPitch * sinYaw * sinRoll;
+	m_rotationY[index] = cosPitch * sinYaw * cosRoll - sinPitch * cosYaw * sinRoll;
+	m_rotationZ[index] = cosPitch * cosYaw * sinRoll - sinPitch * sinYaw * cosRoll;
+	m_rotationW[index] = cosPitch * cosYaw * cosRoll + sinPitch * sinYaw * sinRoll;
+	MarkDirty(index);
+}
+
+void SceneGraphClass::SetLocalScale(unsigned int node, float x, float y, float z)
+{
+	const unsigned int index = m_indices[node];
+
+	m_scaleX[index] = x;
+	m_scaleY[index] = y;
+	m_scaleZ[index] = z;
+	MarkDirty(index);
+}
+
+/*
+ *	Update()
+ *	brief: Recomputes the world matrices of the changed nodes and everything under them. Big subtrees are split
+ *		   at their root into the subtrees of its children, which don't depend on each other, and these are
+ *		   spread over the threads.
+ *	return: The number of world matrices recomputed, 0 if nothing changed.
+ */
+unsigned int SceneGraphClass::Update()
+{
+	unsigned int end, batchSize;
+
+	m_updatedCount = 0;
+	if (m_dirtyNodes.empty())
+	{
+		return 0;
+	}
+
+	if (!m_sorted)
+	{
+		SortNodes();
+	}
+
+	//Only the changed nodes without a changed ancestor start a subtree to update, the rest are inside one.
+	for (unsigned int i = 0; i < m_dirtyNodes.size(); i++)
+	{
+		m_dirtyNodes[i] = m_indices[m_dirtyNodes[i]];
+	}
+	std::sort(m_dirtyNodes.begin(), m_dirtyNodes.end());
+
+	m_ranges.clear();
+	end = 0;
+	for (unsigned int i = 0; i < m_dirtyNodes.size(); i++)
+	{
+		if (m_dirtyNodes[i] >= end)
+		{
+			end = m_subtreeEnds[m_dirtyNodes[i]];
+			CollectRanges(m_dirtyNodes[i]);
+		}
+	}
+	m_dirtyNodes.clear();
+
+	//Group the subtrees into tasks of about SCENE_UPDATE_BATCH nodes.
+	m_batches.clear();
+	batchSize = SCENE_UPDATE_BATCH;
+	for (unsigned int i = 0; i < m_ranges.size(); i++)
+	{
+		if (batchSize >= SCENE_UPDATE_BATCH)
+		{
+			m_batches.push_back(i);
+			batchSize = 0;
+		}
+		batchSize += m_subtreeEnds[m_ranges[i]] - m_ranges[i];
+		m_updatedCount += m_subtreeEnds[m_ranges[i]] - m_ranges[i];
+	}
+	m_batches.push_back((unsigned int)m_ranges.size());
+
+	if (m_jobSystem && m_batches.size() > 2)
+	{
+		m_jobSystem->ParallelFor((unsigned int)m_batches.size() - 1, 1, [this](unsigned int index, unsigned int /*threadIndex*/)
+		{
+			for (unsigned int i = m_batches[index]; i < m_batches[index + 1]; i++)
+			{
+				UpdateRange(m_ranges[i], m_subtreeEnds[m_ranges[i]]);
+			}
+		});
+	}
+	else
+	{
+		for (unsigned int i = 0; i < m_ranges.size(); i++)
+		{
+			UpdateRange(m_ranges[i], m_subtreeEnds[m_ranges[i]]);
+		}
+	}
+
+	return m_updatedCount;
+}
+
+void SceneGraphClass::GetWorldMatrix(unsigned int node, XMMATRIX& worldMatrix)
+{
+	worldMatrix = XMLoadFloat4x4(&m_worldMatrices[m_indices[node]]);
+	return;
+}
+
+//The world matrix as of the last Update().
+const XMFLOAT4X4& SceneGraphClass::GetWorldMatrix(unsigned int node)
+{
+	return m_worldMatrices[m_indices[node]];
+}
+
+unsigned int SceneGraphClass::GetNodeCount()
+{
+	return (unsigned int)m_parents.size();
+}
+
+void SceneGraphClass::MarkDirty(unsigned int index)
+{
+	if (!m_dirty[index])
+	{
+		m_dirty[index] = 1;
+		m_dirtyNodes.push_back(m_handles[index]);
+	}
+}
+
+/*
+ *	SortNodes()
+ *	brief: Puts the nodes back in depth first order after nodes were added out of it. Siblings keep the order they
+ *		   were added in.
+ */
+void SceneGraphClass::SortNodes()
+{
+	const unsigned int count = (unsigned int)m_parents.size();
+	std::vector<unsigned int> childStarts(count + 1, 0), children(count), order, stack, newIndices(count);
+	std::vector<unsigned int> parents(count), handles(count);
+	std::vector<XMFLOAT4X4> worldMatrices(count);
+	std::vector<unsigned char> dirty(count);
+	unsigned int node;
+
+	//Children of every node, in the order they were added.
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (m_parents[i] != SCENE_NO_PARENT)
+		{
+			childStarts[m_parents[i] + 1]++;
+		}
+	}
+	for (unsigned int i = 0; i < count; i++)
+	{
+		childStarts[i + 1] += childStarts[i];
+	}
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (m_parents[i] != SCENE_NO_PARENT)
+		{
+			children[childStarts[m_parents[i]]++] = i;
+		}
+	}
+	for (unsigned int i = count; i > 0; i--)
+	{
+		childStarts[i] = childStarts[i - 1];
+	}
+	childStarts[0] = 0;
+
+	//Walk down from the roots.
+	order.reserve(count);
+	for (unsigned int i = count; i-- > 0;)
+	{
+		if (m_parents[i] == SCENE_NO_PARENT)
+		{
+			stack.push_back(i);
+		}
+	}
+	while (!stack.empty())
+	{
+		node = stack.back();
+		stack.pop_back();
+
+		newIndices[node] = (unsigned int)order.size();
+		order.push_back(node);
+		for (unsigned int i = childStarts[node + 1]; i-- > childStarts[node];)
+		{
+			stack.push_back(children[i]);
+		}
+	}
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		parents[i] = m_parents[order[i]] == SCENE_NO_PARENT ? SCENE_NO_PARENT : newIndices[m_parents[order[i]]];
+		worldMatrices[i] = m_worldMatrices[order[i]];
+		dirty[i] = m_dirty[order[i]];
+		handles[i] = m_handles[order[i]];
+		m_indices[handles[i]] = i;
+	}
+	m_parents.swap(parents);
+	m_handles.swap(handles);
+	m_worldMatrices.swap(worldMatrices);
+	m_dirty.swap(dirty);
+	PermuteValues(m_positionX, order);
+	PermuteValues(m_positionY, order);
+	PermuteValues(m_positionZ, order);
+	PermuteValues(m_rotationX, order);
+	PermuteValues(m_rotationY, order);
+	PermuteValues(m_rotationZ, order);
+	PermuteValues(m_rotationW, order);
+	PermuteValues(m_scaleX, order);
+	PermuteValues(m_scaleY, order);
+	PermuteValues(m_scaleZ, order);
+
+	//Children come after their parent, so walking backwards finishes every subtree before its parent's.
+	for (unsigned int i = 0; i < count; i++)
+	{
+		m_subtreeEnds[i] = i + 1;
+	}
+	for (unsigned int i = count; i-- > 0;)
+	{
+		if (m_parents[i] != SCENE_NO_PARENT)
+		{
+			m_subtreeEnds[m_parents[i]] = std::max(m_subtreeEnds[m_parents[i]], m_subtreeEnds[i]);
+		}
+	}
+
+	m_sorted = true;
+}
+
+/*
+ *	CollectRanges()
+ *	brief: Adds the subtree of a node to the work of the update. With threads, a subtree too big for one task has
+ *		   its root updated right away and its children's subtrees added instead.
+ */
+void SceneGraphClass::CollectRanges(unsigned int index)
+{
+	const unsigned int end = m_subtreeEnds[index];
+
+	if (!m_jobSystem || end - index <= SCENE_UPDATE_BATCH)
+	{
+		m_ranges.push_back(index);
+		return;
+	}
+
+	UpdateRange(index, index + 1);
+	m_updatedCount++;
+
+	for (unsigned int child = index + 1; child < end; child = m_subtreeEnds[child])
+	{
+		CollectRanges(child);
+	}
+}
+
+/*
+ *	UpdateRange()
+ *	brief: Recomputes the world matrices of the nodes in [first, last), which must hold whole subtrees whose
+ *		   parents are up to date.
+ */
+void SceneGraphClass::UpdateRange(unsigned int first, unsigned int last)
+{
+	float x, y, z, w;
+	XMFLOAT4X4 local;
+
+	for (unsigned int i = first; i < last; i++)
+	{
+		//Scale, then rotate, then translate, like XMMatrixAffineTransformation().
+		x = m_rotationX[i];
+		y = m_rotationY[i];
+		z = m_rotationZ[i];
+		w = m_rotationW[i];
+
+		local.m[0][0] = (1.0f - 2.0f * (y * y + z * z)) * m_scaleX[i];
+		local.m[0][1] = 2.0f * (x * y + w * z) * m_scaleX[i];
+		local.m[0][2] = 2.0f * (x * z - w * y) * m_scaleX[i];
+		local.m[0][3] = 0.0f;
+		local.m[1][0] = 2.0f * (x * y - w * z) * m_scaleY[i];
+		local.m[1][1] = (1.0f - 2.0f * (x * x + z * z)) * m_scaleY[i];
+		local.m[1][2] = 2.0f * (y * z + w * x) * m_scaleY[i];
+		local.m[1][3] = 0.0f;
+		local.m[2][0] = 2.0f * (x * z + w * y) * m_scaleZ[i];
+		local.m[2][1] = 2.0f * (y * z - w * x) * m_scaleZ[i];
+		local.m[2][2] = (1.0f - 2.0f * (x * x + y * y)) * m_scaleZ[i];
+		local.m[2][3] = 0.0f;
+		local.m[3][0] = m_positionX[i];
+		local.m[3][1] = m_positionY[i];
+		local.m[3][2] = m_positionZ[i];
+		local.m[3][3] = 1.0f;
+
+		if (m_parents[i] == SCENE_NO_PARENT)
+		{
+			m_worldMatrices[i] = local;
+		}
+		else
+		{
+			XMStoreFloat4x4(&m_worldMatrices[i], XMMatrixMultiply(XMLoadFloat4x4(&local),
+																	 XMLoadFloat4x4(&m_worldMatrices[m_parents[i]])));
+		}
+		m_dirty[i] = 0;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef SCENE_GRAPH
+#define SCENE_GRAPH
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "JobSystem.h"
+#include <DirectXMath.h>
+#include <vector>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int SCENE_NO_PARENT = 0xffffffff;
+const unsigned int SCENE_UPDATE_BATCH = 1024;	//Nodes per task of a parallel update; smaller subtrees are grouped.
+
+/*
+ *	SceneGraphClass
+ *	brief: Hierarchy of transforms. Every node has a local transform relative to its parent, and its world matrix
+ *		   is the local one times the world matrix of the parent.
+ *		   The local transforms are kept as a structure of arrays in depth first order, so every parent comes before
+ *		   its children and every subtree is a contiguous range. Only the subtrees under a changed node are updated,
+ *		   independent subtrees in parallel, so a scene where nothing moves costs nothing.
+ *		   Nodes are named by the handle AddNode() returns, which stays valid when the arrays are reordered.
+ */
+class SceneGraphClass
+{
+public:
+	SceneGraphClass();
+	SceneGraphClass(const SceneGraphClass&);
+	~SceneGraphClass();
+
+	bool Initialize(JobSystemClass* jobSystem);
+	void Shutdown();
+
+	unsigned int AddNode(unsigned int parent);
+	void SetLocalPosition(unsigned int node, float x, float y, float z);
+	void SetLocalRotation(unsigned int node, float pitch, float yaw, float roll);
+	void SetLocalScale(unsigned int node, float x, float y, float z);
+
+	unsigned int Update();
+
+	void GetWorldMatrix(unsigned int node, XMMATRIX& worldMatrix);
+	const XMFLOAT4X4& GetWorldMatrix(unsigned int node);
+	unsigned int GetNodeCount();
+
+private:
+	void MarkDirty(unsigned int index);
+	void SortNodes();
+	void CollectRanges(unsigned int index);
+	void UpdateRange(unsigned int first, unsigned int last);
+
+private:
+	JobSystemClass* m_jobSystem;		//Null to update on the calling thread only.
+
+	//Per node, in depth first order.
+	std::vector<unsigned int>  m_parents;			//Index of the parent, or SCENE_NO_PARENT.
+	std::vector<unsigned int>  m_subtreeEnds;		//One past the last node of the subtree.
+	std::vector<float>		   m_positionX, m_positionY, m_positionZ;
+	std::vector<float>		   m_rotationX, m_rotationY, m_rotationZ, m_rotationW;	//Quaternion.
+	std::vector<float>		   m_scaleX, m_scaleY, m_scaleZ;
+	std::vector<XMFLOAT4X4>	   m_worldMatrices;
+	std::vector<unsigned char> m_dirty;
+	std::vector<unsigned int>  m_handles;			//Handle of every node.
+
+	std::vector<unsigned int>  m_indices;			//Index of every handle.
+	std::vector<unsigned int>  m_dirtyNodes;		//Handles changed since the last update, in any order.
+	bool					   m_sorted;			//False after adding nodes, until the next update sorts them.
+
+	//Work of the current update.
+	std::vector<unsigned int>  m_ranges;			//First node of every subtree to update.
+	std::vector<unsigned int>  m_batches;			//First range of every task, and one past the last range.
+	unsigned int			   m_updatedCount;
+};
+
+#endif
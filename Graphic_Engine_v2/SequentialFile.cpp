@@ -0,0 +1,233 @@
+#include "SequentialFile.h"
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SequentialFileClass::SequentialFileClass()
+{
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	m_file = -1;
+#endif
+	m_buffer = nullptr;
+	m_bufferUsed = 0;
+	m_size = 0;
+	m_unbuffered = false;
+	m_failed = false;
+}
+
+SequentialFileClass::SequentialFileClass(const SequentialFileClass &)
+{
+}
+
+
+SequentialFileClass::~SequentialFileClass()
+{
+}
+
+//Allocates the block the writes are gathered in, used by every file opened after.
+bool SequentialFileClass::Initialize()
+{
+	m_buffer = (unsigned char*)AlignedAlloc(SEQUENTIAL_FILE_BUFFER_SIZE, SEQUENTIAL_FILE_ALIGNMENT);
+
+	return m_buffer != nullptr;
+}
+
+void SequentialFileClass::Shutdown()
+{
+	Close();
+
+	AlignedFree(m_buffer);
+	m_buffer = nullptr;
+}
+
+/*
+ *	Open()
+ *	brief: Creates the file, or empties it if it exists.
+ *	param unbuffered: Writes it around the file cache if the file system allows it.
+ */
+bool SequentialFileClass::Open(const char* filename, bool unbuffered)
+{
+	Close();
+
+	m_bufferUsed = 0;
+	m_size = 0;
+	m_failed = false;
+	m_unbuffered = false;
+
+#ifdef _WIN32
+	if (unbuffered)
+	{
+		m_file = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+							 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN | FILE_FLAG_NO_BUFFERING, NULL);
+		m_unbuffered = m_file != INVALID_HANDLE_VALUE;
+	}
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		m_file = CreateFileA(filename, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+							 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	}
+
+	return m_file != INVALID_HANDLE_VALUE;
+#else
+#ifdef O_DIRECT
+	//Some file systems, like tmpfs, refuse O_DIRECT when opening.
+	if (unbuffered)
+	{
+		m_file = open(filename, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+		m_unbuffered = m_file >= 0;
+	}
+#endif
+	if (m_file < 0)
+	{
+		m_file = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	return m_file >= 0;
+#endif
+}
+
+//Adds the data to the file, writing out every block that fills.
+bool SequentialFileClass::Write(const void* data, size_t size)
+{
+	const unsigned char* bytes;
+	size_t copySize;
+
+	bytes = (const unsigned char*)data;
+	while (size > 0 && !m_failed)
+	{
+		copySize = SEQUENTIAL_FILE_BUFFER_SIZE - m_bufferUsed < size ? SEQUENTIAL_FILE_BUFFER_SIZE - m_bufferUsed : size;
+		memcpy(m_buffer + m_bufferUsed, bytes, copySize);
+		m_bufferUsed += copySize;
+		m_size += copySize;
+		bytes += copySize;
+		size -= copySize;
+
+		if (m_bufferUsed == SEQUENTIAL_FILE_BUFFER_SIZE)
+		{
+			m_failed = !WriteBlock(m_bufferUsed);
+			m_bufferUsed = 0;
+		}
+	}
+
+	return !m_failed;
+}
+
+/*
+ *	Close()
+ *	brief: Writes what is left and closes the file. Unbuffered, the last block is written padded to the alignment
+ *		   and the file is cut back to its size.
+ *	return: False if any write failed.
+ */
+bool SequentialFileClass::Close()
+{
+	size_t blockSize;
+	bool bPadded = false;
+
+#ifdef _WIN32
+	FILE_END_OF_FILE_INFO endOfFile;
+
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+#else
+	if (m_file < 0)
+	{
+		return false;
+	}
+#endif
+
+	if (m_bufferUsed > 0 && !m_failed)
+	{
+		blockSize = m_bufferUsed;
+		if (m_unbuffered)
+		{
+			blockSize = (m_bufferUsed + SEQUENTIAL_FILE_ALIGNMENT - 1) / SEQUENTIAL_FILE_ALIGNMENT * SEQUENTIAL_FILE_ALIGNMENT;
+			memset(m_buffer + m_bufferUsed, 0, blockSize - m_bufferUsed);
+			bPadded = blockSize != m_bufferUsed;
+		}
+		m_failed = !WriteBlock(blockSize);
+		m_bufferUsed = 0;
+	}
+
+#ifdef _WIN32
+	if (bPadded && !m_failed)
+	{
+		endOfFile.EndOfFile.QuadPart = (LONGLONG)m_size;
+		m_failed = !SetFileInformationByHandle(m_file, FileEndOfFileInfo, &endOfFile, sizeof(endOfFile));
+	}
+	CloseHandle(m_file);
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (bPadded && !m_failed)
+	{
+		m_failed = ftruncate(m_file, (off_t)m_size) != 0;
+	}
+	m_failed = close(m_file) != 0 || m_failed;
+	m_file = -1;
+#endif
+
+	return !m_failed;
+}
+
+//Whether the file opened last is written around the file cache.
+bool SequentialFileClass::IsUnbuffered()
+{
+	return m_unbuffered;
+}
+
+//Writes the start of the buffer, all of it unless it is the last block.
+bool SequentialFileClass::WriteBlock(size_t size)
+{
+	size_t offset;
+
+#ifdef _WIN32
+	DWORD written;
+
+	for (offset = 0; offset < size; offset += written)
+	{
+		if (!WriteFile(m_file, m_buffer + offset, (DWORD)(size - offset), &written, NULL) || written == 0)
+		{
+			return false;
+		}
+	}
+#else
+	ssize_t written;
+	int flags;
+
+	for (offset = 0; offset < size; offset += (size_t)written)
+	{
+		written = write(m_file, m_buffer + offset, size - offset);
+#ifdef O_DIRECT
+		//Opened with O_DIRECT but refused when writing: go on through the cache.
+		if (written < 0 && errno == EINVAL && m_unbuffered)
+		{
+			flags = fcntl(m_file, F_GETFL);
+			if (flags == -1 || fcntl(m_file, F_SETFL, flags & ~O_DIRECT) == -1)
+			{
+				return false;
+			}
+			m_unbuffered = false;
+			written = 0;
+			continue;
+		}
+#endif
+		if (written < 0 && errno == EINTR)
+		{
+			written = 0;
+			continue;
+		}
+		if (written <= 0)
+		{
+			return false;
+		}
+	}
+#endif
+
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef SEQUENTIAL_FILE
+#define SEQUENTIAL_FILE
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "Platform.h"
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const size_t SEQUENTIAL_FILE_ALIGNMENT = 4096;				//Of the memory, offsets and sizes of unbuffered writes.
+const size_t SEQUENTIAL_FILE_BUFFER_SIZE = 4 * 1024 * 1024;	//Bytes gathered before each write.
+
+/*
+ *	SequentialFileClass
+ *	brief: Writes a file from start to end in large aligned blocks. Unbuffered, the blocks go from our memory to the
+ *		   disk without being copied into the file cache (O_DIRECT, FILE_FLAG_NO_BUFFERING), which is what long
+ *		   image sequences want: they are never read back, and evicting the cache for them costs more than the
+ *		   write. Where the file system doesn't take unbuffered writes it falls back to buffered ones.
+ */
+class SequentialFileClass
+{
+public:
+	SequentialFileClass();
+	SequentialFileClass(const SequentialFileClass&);
+	~SequentialFileClass();
+
+	bool Initialize();
+	void Shutdown();
+
+	bool Open(const char* filename, bool unbuffered);
+	bool Write(const void* data, size_t size);
+	bool Close();
+
+	bool IsUnbuffered();
+
+private:
+	bool WriteBlock(size_t size);
+
+private:
+#ifdef _WIN32
+	HANDLE			   m_file;
+#else
+	int				   m_file;
+#endif
+	unsigned char*	   m_buffer;		//Aligned to SEQUENTIAL_FILE_ALIGNMENT.
+	size_t			   m_bufferUsed;
+	unsigned long long m_size;			//Bytes written so far, without the padding of the last block.
+	bool			   m_unbuffered;
+	bool			   m_failed;
+};
+
+#endif
@@ -0,0 +1,323 @@
+#include "ShaderCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const char SHADER_CACHE_MAGIC[4] = { 'G', 'E', 'S', 'C' };
+static const unsigned long long FNV_OFFSET_BASIS = 14695981039346656037ULL;
+static const unsigned long long FNV_PRIME = 1099511628211ULL;
+
+//Adds bytes to a 64 bit FNV-1a hash.
+static unsigned long long HashBytes(unsigned long long hash, const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+//Adds a string with its terminating zero, so "ab" + "c" and "a" + "bc" hash differently.
+static unsigned long long HashString(unsigned long long hash, const char* text)
+{
+	return HashBytes(hash, text ? text : "", text ? strlen(text) + 1 : 1);
+}
+
+static unsigned long long AlignCacheOffset(unsigned long long offset)
+{
+	return (offset + SHADER_CACHE_ALIGNMENT - 1) / SHADER_CACHE_ALIGNMENT * SHADER_CACHE_ALIGNMENT;
+}
+
+static bool CompareEntries(const ShaderCacheEntry& a, const ShaderCacheEntry& b)
+{
+	return a.key < b.key;
+}
+
+ShaderCacheClass::ShaderCacheClass()
+{
+	m_fileEntries = nullptr;
+	m_fileEntryCount = 0;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+ShaderCacheClass::ShaderCacheClass(const ShaderCacheClass &)
+{
+}
+
+
+ShaderCacheClass::~ShaderCacheClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Opens the cache file. A missing or broken file only leaves the cache empty, to be filled and saved.
+ */
+bool ShaderCacheClass::Initialize(const char* filename)
+{
+	m_filename = filename;
+	m_addedShaders.clear();
+	m_hits = 0;
+	m_misses = 0;
+
+	OpenFile();
+	return true;
+}
+
+//Closes the file. The shaders added since the last Save() are lost.
+void ShaderCacheClass::Shutdown()
+{
+	m_file.Close();
+	m_fileEntries = nullptr;
+	m_fileEntryCount = 0;
+	m_addedShaders.clear();
+}
+
+/*
+ *	Find()
+ *	brief: Looks for a compiled shader.
+ *	param key: The hash of the shader, see HashShader().
+ *	param bytecode: Receives the compiled shader. It stays valid until Save() or Shutdown().
+ *	return: Whether it was found. Either way it counts in the statistics.
+ */
+bool ShaderCacheClass::Find(unsigned long long key, const void*& bytecode, unsigned int& bytecodeSize,
+							ShaderReflection& reflection)
+{
+	const ShaderCacheEntry* entry;
+	ShaderCacheEntry search;
+
+	search.key = key;
+	entry = std::lower_bound(m_fileEntries, m_fileEntries + m_fileEntryCount, search, CompareEntries);
+	if (entry != m_fileEntries + m_fileEntryCount && entry->key == key)
+	{
+		bytecode = m_file.GetData() + entry->bytecodeOffset;
+		bytecodeSize = entry->bytecodeSize;
+		reflection = entry->reflection;
+		m_hits++;
+		return true;
+	}
+
+	//Few shaders are compiled in a run, so they are just searched.
+	for (unsigned int i = 0; i < m_addedShaders.size(); i++)
+	{
+		if (m_addedShaders[i].key == key)
+		{
+			bytecode = &m_addedShaders[i].bytecode[0];
+			bytecodeSize = (unsigned int)m_addedShaders[i].bytecode.size();
+			reflection = m_addedShaders[i].reflection;
+			m_hits++;
+			return true;
+		}
+	}
+
+	m_misses++;
+	return false;
+}
+
+//Keeps a copy of a shader just compiled, to find it from now on and save it with the next Save().
+bool ShaderCacheClass::Add(unsigned long long key, const void* bytecode, unsigned int bytecodeSize,
+						   const ShaderReflection& reflection)
+{
+	AddedShader shader;
+
+	if (!bytecode || bytecodeSize == 0)
+	{
+		return false;
+	}
+
+	shader.key = key;
+	shader.bytecode.assign((const unsigned char*)bytecode, (const unsigned char*)bytecode + bytecodeSize);
+	shader.reflection = reflection;
+	m_addedShaders.push_back(shader);
+
+	return true;
+}
+
+/*
+ *	Save()
+ *	brief: Writes the shaders of the file and the ones added into a new file and maps it in place of the old one.
+ *		   It is written to a temporary file first and then renamed, so a crash halfway never leaves a broken cache
+ *		   behind. Nothing is written if no shader was added.
+ */
+bool ShaderCacheClass::Save()
+{
+	std::vector<ShaderCacheEntry> entries;
+	std::vector<const unsigned char*> bytecodes;
+	std::vector<unsigned int> order;
+	ShaderCacheHeader header;
+	ShaderCacheEntry entry;
+	std::string temporaryFilename;
+	std::ofstream fout;
+	char padding[SHADER_CACHE_ALIGNMENT];
+	unsigned long long offset;
+	bool bResult;
+
+	if (m_addedShaders.empty())
+	{
+		return true;
+	}
+
+	//The entries of the file and the added ones, with where their bytecode is now.
+	for (unsigned int i = 0; i < m_fileEntryCount; i++)
+	{
+		entries.push_back(m_fileEntries[i]);
+		bytecodes.push_back(m_file.GetData() + m_fileEntries[i].bytecodeOffset);
+	}
+	for (unsigned int i = 0; i < m_addedShaders.size(); i++)
+	{
+		memset(&entry, 0, sizeof(entry));
+		entry.key = m_addedShaders[i].key;
+		entry.bytecodeSize = (unsigned int)m_addedShaders[i].bytecode.size();
+		entry.reflection = m_addedShaders[i].reflection;
+		entries.push_back(entry);
+		bytecodes.push_back(&m_addedShaders[i].bytecode[0]);
+	}
+
+	//Sort them by key, keeping the first one of a key added twice.
+	for (unsigned int i = 0; i < entries.size(); i++)
+	{
+		order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(),
+					 [&entries](unsigned int a, unsigned int b) { return entries[a].key < entries[b].key; });
+	order.erase(std::unique(order.begin(), order.end(),
+							[&entries](unsigned int a, unsigned int b) { return entries[a].key == entries[b].key; }),
+				order.end());
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC));
+	header.version = SHADER_CACHE_VERSION;
+	header.entryCount = (unsigned int)order.size();
+
+	offset = AlignCacheOffset(sizeof(ShaderCacheHeader) + sizeof(ShaderCacheEntry) * (unsigned long long)order.size());
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		entries[order[i]].bytecodeOffset = offset;
+		offset = AlignCacheOffset(offset + entries[order[i]].bytecodeSize);
+	}
+
+	memset(padding, 0, sizeof(padding));
+	temporaryFilename = m_filename + ".tmp";
+
+	fout.open(temporaryFilename.c_str(), std::ios::binary);
+	if (!fout)
+	{
+		return false;
+	}
+
+	fout.write((const char*)&header, sizeof(header));
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		fout.write((const char*)&entries[order[i]], sizeof(ShaderCacheEntry));
+	}
+
+	offset = sizeof(ShaderCacheHeader) + sizeof(ShaderCacheEntry) * (unsigned long long)order.size();
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		fout.write(padding, entries[order[i]].bytecodeOffset - offset);
+		fout.write((const char*)bytecodes[order[i]], entries[order[i]].bytecodeSize);
+		offset = entries[order[i]].bytecodeOffset + entries[order[i]].bytecodeSize;
+	}
+	fout.close();
+
+	if (!fout)
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+
+	//The old file can't be replaced while it is mapped.
+	m_file.Close();
+	m_fileEntries = nullptr;
+	m_fileEntryCount = 0;
+
+	remove(m_filename.c_str());
+	bResult = rename(temporaryFilename.c_str(), m_filename.c_str()) == 0;
+	if (!bResult)
+	{
+		remove(temporaryFilename.c_str());
+	}
+
+	//Whatever happened, the added shaders are in the file now or lost with the old one.
+	m_addedShaders.clear();
+	OpenFile();
+
+	return bResult;
+}
+
+void ShaderCacheClass::GetStatistics(ShaderCacheStatistics& statistics)
+{
+	statistics.hits = m_hits;
+	statistics.misses = m_misses;
+	statistics.fileShaders = m_fileEntryCount;
+	statistics.addedShaders = (unsigned int)m_addedShaders.size();
+}
+
+/*
+ *	HashShader()
+ *	brief: The key of a compiled shader: everything that changes what the compiler makes of it.
+ *	param defines: The macros it is compiled with, as text, or null.
+ *	param flags: The compile flags.
+ */
+unsigned long long ShaderCacheClass::HashShader(const void* source, size_t sourceSize, const char* defines,
+												const char* entryPoint, const char* profile, unsigned int flags)
+{
+	unsigned long long hash;
+
+	hash = HashBytes(FNV_OFFSET_BASIS, &sourceSize, sizeof(sourceSize));
+	hash = HashBytes(hash, source, sourceSize);
+	hash = HashString(hash, defines);
+	hash = HashString(hash, entryPoint);
+	hash = HashString(hash, profile);
+	hash = HashBytes(hash, &flags, sizeof(flags));
+
+	return hash;
+}
+
+//Maps the cache file and points the entries to it after checking they and their bytecode fit in it.
+bool ShaderCacheClass::OpenFile()
+{
+	const ShaderCacheHeader* header;
+	const ShaderCacheEntry* entries;
+	unsigned long long fileSize;
+
+	m_fileEntries = nullptr;
+	m_fileEntryCount = 0;
+
+	if (!m_file.Open(m_filename.c_str()))
+	{
+		return false;
+	}
+
+	fileSize = m_file.GetSize();
+	header = (const ShaderCacheHeader*)m_file.GetData();
+	entries = (const ShaderCacheEntry*)(m_file.GetData() + sizeof(ShaderCacheHeader));
+
+	if (fileSize < sizeof(ShaderCacheHeader) || memcmp(header->magic, SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC)) != 0 ||
+		header->version != SHADER_CACHE_VERSION ||
+		sizeof(ShaderCacheHeader) + sizeof(ShaderCacheEntry) * (unsigned long long)header->entryCount > fileSize)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	for (unsigned int i = 0; i < header->entryCount; i++)
+	{
+		if (entries[i].bytecodeOffset + entries[i].bytecodeSize > fileSize || (i > 0 && entries[i - 1].key >= entries[i].key))
+		{
+			m_file.Close();
+			return false;
+		}
+	}
+
+	m_fileEntries = entries;
+	m_fileEntryCount = header->entryCount;
+	return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#ifndef SHADER_CACHE
+#define SHADER_CACHE
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const char		   SHADER_CACHE_FILENAME[] = "Shaders.shadercache";
+const unsigned int SHADER_CACHE_VERSION = 1;
+const unsigned int SHADER_CACHE_ALIGNMENT = 16;				//Of the bytecode blocks inside the file.
+const unsigned int SHADER_REFLECTION_MAX_CONSTANT_BUFFERS = 8;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//What the compiler reports about a shader, kept so it doesn't have to be reflected again at startup.
+struct ShaderReflection
+{
+	unsigned int constantBufferCount;
+	unsigned int constantBufferSizes[SHADER_REFLECTION_MAX_CONSTANT_BUFFERS];
+	unsigned int inputParameterCount;
+	unsigned int instructionCount;
+};
+
+/*First bytes of a cache file. The entries follow sorted by key, and then the bytecode of every shader in blocks
+  aligned to SHADER_CACHE_ALIGNMENT.*/
+struct ShaderCacheHeader
+{
+	char		 magic[4];			//"GESC"
+	unsigned int version;
+	unsigned int entryCount;
+	unsigned int reserved;
+};
+
+struct ShaderCacheEntry
+{
+	unsigned long long key;				//See HashShader().
+	unsigned long long bytecodeOffset;
+	unsigned int	   bytecodeSize;
+	unsigned int	   reserved;
+	ShaderReflection   reflection;
+};
+
+struct ShaderCacheStatistics
+{
+	unsigned int hits;
+	unsigned int misses;
+	unsigned int fileShaders;			//Shaders in the file that was opened.
+	unsigned int addedShaders;			//Compiled since then, written by the next Save().
+};
+
+/*
+ *	ShaderCacheClass
+ *	brief: Compiled shaders saved in one file, found by a hash of everything that goes into compiling them. The
+ *		   file is memory mapped once when the cache is opened and its bytecode is handed out as it is in the
+ *		   file, so a startup with nothing changed reads one file and never runs the compiler. Shaders compiled
+ *		   afterwards are kept in memory until Save() writes them with the rest.
+ *		   The includes of a source file aren't followed, so a change in them alone isn't noticed.
+ */
+class ShaderCacheClass
+{
+private:
+	//A shader compiled after the file was opened.
+	struct AddedShader
+	{
+		unsigned long long		   key;
+		std::vector<unsigned char> bytecode;
+		ShaderReflection		   reflection;
+	};
+
+public:
+	ShaderCacheClass();
+	ShaderCacheClass(const ShaderCacheClass&);
+	~ShaderCacheClass();
+
+	bool Initialize(const char* filename);
+	void Shutdown();
+
+	bool Find(unsigned long long key, const void*& bytecode, unsigned int& bytecodeSize, ShaderReflection& reflection);
+	bool Add(unsigned long long key, const void* bytecode, unsigned int bytecodeSize, const ShaderReflection& reflection);
+	bool Save();
+
+	void GetStatistics(ShaderCacheStatistics& statistics);
+
+	static unsigned long long HashShader(const void* source, size_t sourceSize, const char* defines,
+										 const char* entryPoint, const char* profile, unsigned int flags);
+
+private:
+	bool OpenFile();
+
+private:
+	std::string				 m_filename;
+	MappedFileClass			 m_file;
+	const ShaderCacheEntry*	 m_fileEntries;		//In the mapped file, sorted by key.
+	unsigned int			 m_fileEntryCount;
+	std::vector<AddedShader> m_addedShaders;
+	unsigned int			 m_hits;
+	unsigned int			 m_misses;
+};
+
+#endif
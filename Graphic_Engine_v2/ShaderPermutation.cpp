@@ -0,0 +1,29 @@
+#include "ShaderPermutation.h"
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const char* const g_shaderFeatureDefines[SHADER_FEATURE_COUNT] = { "INSTANCING", "FOG" };
+
+/*
+ *	GetShaderPermutationDefines()
+ *	brief: Makes the defines the HLSL files check to compile a permutation, one set to 1 for every feature in it.
+ *	param defines: Receives them. It needs room for SHADER_FEATURE_COUNT.
+ *	return: How many there are.
+ */
+unsigned int GetShaderPermutationDefines(unsigned int permutation, ShaderDefine* defines)
+{
+	unsigned int count = 0;
+
+	for (unsigned int i = 0; i < SHADER_FEATURE_COUNT; i++)
+	{
+		if (permutation & (1 << i))
+		{
+			defines[count].name = g_shaderFeatureDefines[i];
+			defines[count].definition = "1";
+			count++;
+		}
+	}
+
+	return count;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef SHADER_PERMUTATION
+#define SHADER_PERMUTATION
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "RenderDevice.h"
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*Features a shader can be compiled with. A permutation is a mask of them, and every permutation is a variant of its
+  own: the HLSL is compiled with a define per feature and the CPU version is instantiated for the mask, so no variant
+  checks at run time for the features it doesn't have.*/
+enum ShaderFeature
+{
+	SHADER_FEATURE_INSTANCING = 1 << 0,		//A world matrix and a tint per instance.
+	SHADER_FEATURE_FOG = 1 << 1				//Blends toward the fog color with the view depth.
+};
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int SHADER_FEATURE_COUNT = 2;
+const unsigned int SHADER_PERMUTATION_COUNT = 1 << SHADER_FEATURE_COUNT;
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+unsigned int GetShaderPermutationDefines(unsigned int permutation, ShaderDefine* defines);
+
+#endif
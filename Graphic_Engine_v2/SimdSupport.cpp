@@ -0,0 +1,83 @@
+#include "SimdSupport.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/*
+ *	DetectSimdLevel()
+ *	brief: Finds the widest instruction set both the CPU and the operating system support. The operating system
+ *		   has to save the wide registers on context switches, which is what the XGETBV check is about.
+ */
+SimdLevel DetectSimdLevel()
+{
+#if defined(SIMD_X86) && defined(_MSC_VER)
+	int info[4];
+	unsigned long long enabledState;
+	bool osSavesAvx, osSavesAvx512;
+
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return SIMD_LEVEL_SSE2;
+	}
+
+	//Leaf 1: OSXSAVE (bit 27) and AVX (bit 28) in ECX.
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+	{
+		return SIMD_LEVEL_SSE2;
+	}
+
+	enabledState = _xgetbv(0);
+	osSavesAvx = (enabledState & 0x06) == 0x06;
+	osSavesAvx512 = (enabledState & 0xe6) == 0xe6;
+
+	//Leaf 7: AVX2 (bit 5) and AVX-512F (bit 16) in EBX.
+	__cpuidex(info, 7, 0);
+#ifdef SIMD_HAS_AVX512
+	if (osSavesAvx512 && (info[1] & (1 << 16)))
+	{
+		return SIMD_LEVEL_AVX512;
+	}
+#endif
+	if (osSavesAvx && (info[1] & (1 << 5)))
+	{
+		return SIMD_LEVEL_AVX2;
+	}
+
+	return SIMD_LEVEL_SSE2;
+#elif defined(SIMD_X86)
+	//GCC and Clang already check the operating system support for us.
+	__builtin_cpu_init();
+#ifdef SIMD_HAS_AVX512
+	if (__builtin_cpu_supports("avx512f"))
+	{
+		return SIMD_LEVEL_AVX512;
+	}
+#endif
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return SIMD_LEVEL_AVX2;
+	}
+
+	return SIMD_LEVEL_SSE2;
+#else
+	return SIMD_LEVEL_SCALAR;
+#endif
+}
+
+const char* GetSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SIMD_LEVEL_SSE2:
+		return "SSE2";
+	case SIMD_LEVEL_AVX2:
+		return "AVX2";
+	case SIMD_LEVEL_AVX512:
+		return "AVX-512";
+	default:
+		return "Scalar";
+	}
+}
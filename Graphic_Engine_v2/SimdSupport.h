@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef SIMD_SUPPORT
+#define SIMD_SUPPORT
+
+/************************************************************************/
+/* PREPROCESSING DIRECTIVES                                             */
+/* The SIMD kernels are compiled for every instruction set in the same  */
+/* build and chosen when the program starts. GCC and Clang need to be   */
+/* told per function which instructions they may use; MSVC doesn't.     */
+/************************************************************************/
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define SIMD_X86 1
+#endif
+
+#if defined(__clang__)
+#define SIMD_TARGET_AVX2   __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f")))
+#elif defined(__GNUC__)
+//AVX-512 brings FMA, and GCC would fuse the products and sums of the kernels into it, rounding differently from the
+//narrower ones. Every kernel has to write the same results, so they stay separate.
+#define SIMD_TARGET_AVX2   __attribute__((target("avx2")))
+#define SIMD_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#else
+#define SIMD_TARGET_AVX2
+#define SIMD_TARGET_AVX512
+#endif
+
+//The AVX-512 intrinsics are only complete from Visual Studio 2017 on.
+#if defined(SIMD_X86) && (!defined(_MSC_VER) || defined(__clang__) || _MSC_VER >= 1910)
+#define SIMD_HAS_AVX512 1
+#endif
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+enum SimdLevel
+{
+	SIMD_LEVEL_SCALAR,	//Plain C++, for CPUs without any of the below.
+	SIMD_LEVEL_SSE2,	//4 lanes of 32 bits.
+	SIMD_LEVEL_AVX2,	//8 lanes of 32 bits.
+	SIMD_LEVEL_AVX512	//16 lanes of 32 bits.
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+SimdLevel DetectSimdLevel();
+const char* GetSimdLevelName(SimdLevel level);
+
+#endif
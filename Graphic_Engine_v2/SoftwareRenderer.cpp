@@ -0,0 +1,2349 @@
+#include "SoftwareRenderer.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static const unsigned int UNUSED_FRAME = 0xffffffff;
+static const unsigned int NO_CONSTANTS = 0xffffffff;
+static const unsigned int RING_CONSTANTS = 0x80000000;		//Set on the constant offsets of a draw that are in the ring.
+static const int		  CLIP_PLANE_COUNT = 6;
+static const float		  DEPTH_BOUNDS_EPSILON = 1.0f / 65536.0f;	//Margin of the depth bounds of a triangle over the
+																	//rounding of the depth interpolated at its pixels.
+
+/*
+ *	PackColor()
+ *	brief: Converts a float color to the R8G8B8A8_UNORM layout of the color buffer, red in the lowest byte.
+ */
+static unsigned int PackColor(const XMFLOAT4& color)
+{
+	unsigned int red, green, blue, alpha;
+
+	red = (unsigned int)(std::min(std::max(color.x, 0.0f), 1.0f) * 255.0f + 0.5f);
+	green = (unsigned int)(std::min(std::max(color.y, 0.0f), 1.0f) * 255.0f + 0.5f);
+	blue = (unsigned int)(std::min(std::max(color.z, 0.0f), 1.0f) * 255.0f + 0.5f);
+	alpha = (unsigned int)(std::min(std::max(color.w, 0.0f), 1.0f) * 255.0f + 0.5f);
+
+	return red | (green << 8) | (blue << 16) | (alpha << 24);
+}
+
+/*
+ *	ClipDistance()
+ *	brief: Signed distance of a clip space position to one of the clipping planes. Negative means outside.
+ *		   The planes are near, far and the four sides of the guard band, in the order of the CLIP_OUTCODE_ bits.
+ */
+static float ClipDistance(const XMFLOAT4& position, int plane, float guardBandX, float guardBandY)
+{
+	switch (plane)
+	{
+	case 0:
+		return position.z;
+	case 1:
+		return position.w - position.z;
+	case 2:
+		return position.x + guardBandX * position.w;
+	case 3:
+		return guardBandX * position.w - position.x;
+	case 4:
+		return position.y + guardBandY * position.w;
+	default:
+		return guardBandY * position.w - position.y;
+	}
+}
+
+static unsigned int ClipOutcode(const XMFLOAT4& position, float guardBandX, float guardBandY)
+{
+	unsigned int outcode = 0;
+
+	for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++)
+	{
+		if (ClipDistance(position, plane, guardBandX, guardBandY) < 0.0f)
+		{
+			outcode |= 1 << plane;
+		}
+	}
+
+	return outcode;
+}
+
+static unsigned int CountBits(unsigned long long mask)
+{
+	unsigned int count = 0;
+
+	while (mask)
+	{
+		mask &= mask - 1;
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ *	InterpolateDepth()
+ *	brief: The depth of a triangle at a point, its vertices weighed by the edge functions there over the area. The
+ *		   depth bounds of the blocks rely on it staying between the depths of the vertices, so the weights have to
+ *		   add up to 1: the top-left fill rule bias of SetupRasterEdges() is taken out, which is a large part of the
+ *		   area of a thin triangle. It is done in double because at the top-left pixel of a block, a triangle
+ *		   smaller than the block can have weights much larger than 1, and rounding them to float there would move
+ *		   the depth of its pixels out of the bounds too.
+ */
+static float InterpolateDepth(const RasterEdges& edges, const float* z, float invArea, long long pixelX, long long pixelY)
+{
+	double depth = 0.0;
+	long long edge;
+
+	for (int k = 0; k < 3; k++)
+	{
+		edge = edges.edgeA[k] * pixelX + edges.edgeB[k] * pixelY + edges.edgeC[k];
+		if (!(edges.edgeA[k] > 0 || (edges.edgeA[k] == 0 && edges.edgeB[k] > 0)))
+		{
+			edge += 1;
+		}
+		depth += (double)edge * z[k];
+	}
+
+	return (float)(depth * invArea);
+}
+
+//How much the depth of a triangle changes with one of the steps of its edge functions, in double like the depth.
+static float InterpolateDepthStep(const int* edgeSteps, const float* z, float invArea)
+{
+	return (float)(((double)edgeSteps[0] * z[0] + (double)edgeSteps[1] * z[1] + (double)edgeSteps[2] * z[2]) *
+				   (1 << RASTER_SUBPIXEL_BITS) * invArea);
+}
+
+//A plane at a pixel of its block, in the order of the block shaders: (base + stepX * column) + stepY * row.
+static float EvaluatePlane(const PixelPlane& plane, int column, int row)
+{
+	return (plane.base + plane.stepX * (float)column) + plane.stepY * (float)row;
+}
+
+static unsigned int ElementSize(ElementFormat format)
+{
+	switch (format)
+	{
+	case ELEMENT_FORMAT_FLOAT3:
+		return 3 * sizeof(float);
+	case ELEMENT_FORMAT_UNORM16X4:
+		return 4 * sizeof(unsigned short);
+	case ELEMENT_FORMAT_UNORM8X4:
+		return 4;
+	default:
+		return 4 * sizeof(float);
+	}
+}
+
+SoftwareRendererClass::SoftwareRendererClass()
+{
+	m_screen.colorBuffer = nullptr;
+	m_screen.depthBuffer = nullptr;
+	m_screen.readbackImage = nullptr;
+	m_target = nullptr;
+	m_width = 0;
+	m_height = 0;
+	m_tilesX = 0;
+	m_tilesY = 0;
+	m_blocksX = 0;
+	m_blocksY = 0;
+	m_guardBandX = 1.0f;
+	m_guardBandY = 1.0f;
+	m_colorBuffer = nullptr;
+	m_depthBuffer = nullptr;
+	m_blockDepth = nullptr;
+	m_tileMaxDepth = nullptr;
+	m_ThreadPool = nullptr;
+	m_blockShading = true;
+	m_hierarchicalDepth = true;
+
+	ResetState(m_state);
+
+	m_frameIndex = 0;
+	m_clearPending = false;
+	m_clearColor = 0;
+	m_triangleBatchCount = 0;
+	m_constantRing = nullptr;
+	m_constantRingHead = 0;
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	m_passCount = 0;
+	m_passOpen = false;
+}
+
+SoftwareRendererClass::SoftwareRendererClass(const SoftwareRendererClass &)
+{
+}
+
+
+SoftwareRendererClass::~SoftwareRendererClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Allocates the color and depth buffers and starts the worker threads. The window handle, vsync and
+ *		   fullscreen settings are ignored since nothing is presented to a screen.
+ *	param screenWidth: The width of the image.
+ *	param screenHeight: The height of the image.
+ *	param screenDepth: The setting to know how far our 3D environment will render.
+ *	param screenNear: The setting to know how near our 3D environment will render.
+ */
+bool SoftwareRendererClass::Initialize(int screenWidth, int screenHeight, bool /*vsync*/, HWND /*hwnd*/,
+									   bool /*fullscreen*/, float screenFar, float screenNear)
+{
+	RenderTargetDesc screenDesc;
+	bool bResult;
+
+	//Create the color and depth buffers of the screen and draw into them.
+	screenDesc.width = screenWidth;
+	screenDesc.height = screenHeight;
+	screenDesc.format = RENDER_TARGET_FORMAT_RGBA8;
+
+	bResult = InitializeTarget(m_screen, screenDesc);
+	if (!bResult)
+	{
+		return false;
+	}
+	BindTarget(&m_screen);
+
+	//Create the constant ring.
+	m_constantRing = (unsigned char*)AlignedAlloc(CONSTANT_RING_SIZE, 64);
+	if (!m_constantRing)
+	{
+		return false;
+	}
+	m_constantRingHead = 0;
+
+	//Create the worker threads, one per core.
+	m_ThreadPool = new ThreadPoolClass();
+	if (!m_ThreadPool)
+	{
+		return false;
+	}
+
+	bResult = m_ThreadPool->Initialize(0);
+	if (!bResult)
+	{
+		return false;
+	}
+
+	//Setup the projection, world and orthographic matrices.
+	InitializeMatrices(screenWidth, screenHeight, screenFar, screenNear);
+
+	return true;
+}
+
+void SoftwareRendererClass::Shutdown()
+{
+	//Stop the worker threads.
+	if (m_ThreadPool)
+	{
+		m_ThreadPool->Shutdown();
+		delete m_ThreadPool;
+		m_ThreadPool = nullptr;
+	}
+
+	//Release the command lists kept for reuse.
+	for (unsigned int i = 0; i < m_freeCommandLists.size(); i++)
+	{
+		delete m_freeCommandLists[i];
+	}
+	m_freeCommandLists.clear();
+
+	//Release the memory of buffers that were rewritten while a frame was using them.
+	for (unsigned int i = 0; i < m_retiredMemory.size(); i++)
+	{
+		AlignedFree(m_retiredMemory[i]);
+	}
+	m_retiredMemory.clear();
+
+	AlignedFree(m_constantRing);
+	m_constantRing = nullptr;
+
+	ShutdownTarget(m_screen);
+	m_target = nullptr;
+	m_colorBuffer = nullptr;
+	m_depthBuffer = nullptr;
+}
+
+/*
+ *	BeginScene()
+ *	brief: Starts recording a new frame. The buffers are cleared by each tile when the frame is rasterized.
+ *	param red: The red value for the render.
+ *	param green: The green value for the render.
+ *	param blue: The blue value for the render.
+ *	param alpha: The alpha value for the render.
+ */
+void SoftwareRendererClass::BeginScene(float red, float green, float blue, float alpha)
+{
+	m_clearColor = PackColor(XMFLOAT4(red, green, blue, alpha));
+	m_clearPending = true;
+}
+
+/*
+ *	EndScene()
+ *	brief: Renders every draw recorded since BeginScene() into the render target set. When it returns the color and
+ *		   depth buffers hold the finished frame.
+ */
+void SoftwareRendererClass::EndScene()
+{
+	unsigned int shadedVertexCount, drawVertexCount, drawTriangleCount;
+	unsigned int tileCount, pass;
+	double start;
+
+	PROFILE_ZONE("SoftwareRendererClass::EndScene");
+
+	EndPass();
+	start = m_passCount > 0 ? ReadPassClock() : 0.0;
+
+	tileCount = (unsigned int)(m_tilesX * m_tilesY);
+
+	//A frame drawn over the image a readback took without clearing it needs it back.
+	if (m_target->readbackImage)
+	{
+		if (m_clearPending)
+		{
+			m_target->readbackImage = nullptr;
+		}
+		else
+		{
+			RestoreTargetImage(*m_target);
+		}
+	}
+
+	//Split the vertices of every draw in batches and shade them.
+	m_vertexBatches.clear();
+	shadedVertexCount = 0;
+	for (unsigned int i = 0; i < m_draws.size(); i++)
+	{
+		drawVertexCount = m_draws[i].vertexCount * m_draws[i].instanceCount;
+
+		m_draws[i].firstShadedVertex = shadedVertexCount;
+		for (unsigned int first = 0; first < drawVertexCount; first += SOFTWARE_VERTEX_BATCH)
+		{
+			VertexBatch batch;
+			batch.drawIndex = i;
+			batch.firstVertex = first;
+			batch.vertexCount = std::min(SOFTWARE_VERTEX_BATCH, drawVertexCount - first);
+			m_vertexBatches.push_back(batch);
+		}
+		shadedVertexCount += drawVertexCount;
+	}
+	m_shadedVertices.resize(shadedVertexCount);
+
+	m_ThreadPool->ParallelFor((unsigned int)m_vertexBatches.size(), [this](unsigned int index, unsigned int /*threadIndex*/)
+	{
+		ShadeVertices(m_vertexBatches[index]);
+	});
+
+	//Split the triangles in batches, clip and set them up, and bin them into the tiles they touch. The passes are
+	//in the order of their draws, so the pass of a draw is found walking them along.
+	m_triangleBatchCount = 0;
+	pass = 0;
+	for (unsigned int i = 0; i < m_draws.size(); i++)
+	{
+		drawTriangleCount = m_draws[i].triangleCount * m_draws[i].instanceCount;
+		while (pass < m_passCount && m_passes[pass].endDraw <= i)
+		{
+			pass++;
+		}
+
+		for (unsigned int first = 0; first < drawTriangleCount; first += SOFTWARE_TRIANGLE_BATCH)
+		{
+			if (m_triangleBatchCount == m_triangleBatches.size())
+			{
+				m_triangleBatches.push_back(TriangleBatch());
+			}
+
+			TriangleBatch& batch = m_triangleBatches[m_triangleBatchCount++];
+			batch.drawIndex = i;
+			batch.pass = pass < m_passCount && m_passes[pass].firstDraw <= i ? pass : RENDER_MAX_PASSES;
+			batch.firstTriangle = first;
+			batch.triangleCount = std::min(SOFTWARE_TRIANGLE_BATCH, drawTriangleCount - first);
+			batch.binStarts.resize(tileCount + 1);
+
+			//Room for the triangles unclipped, each smaller than a tile, so the batches stop growing after a frame
+			//even when their triangles move to other tiles or come into the view.
+			batch.triangles.reserve(batch.triangleCount);
+			batch.binTriangles.reserve(batch.triangleCount * 4);
+		}
+	}
+
+	m_ThreadPool->ParallelFor(m_triangleBatchCount, [this](unsigned int index, unsigned int /*threadIndex*/)
+	{
+		SetupTriangles(m_triangleBatches[index]);
+	});
+
+	//Every tile is owned by a single thread, so the tiles can be rasterized without any locking.
+	m_ThreadPool->ParallelFor(tileCount, [this](unsigned int index, unsigned int /*threadIndex*/)
+	{
+		RasterizeTile(index);
+	});
+
+	//Add up what every tile did.
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	for (unsigned int i = 0; i < m_triangleBatchCount; i++)
+	{
+		m_statistics.triangles += (unsigned int)m_triangleBatches[i].triangles.size();
+	}
+	for (unsigned int i = 0; i < tileCount; i++)
+	{
+		m_statistics.tileTriangles += m_tileStatistics[i].tileTriangles;
+		m_statistics.tileTrianglesRejected += m_tileStatistics[i].tileTrianglesRejected;
+		m_statistics.blocks += m_tileStatistics[i].blocks;
+		m_statistics.blocksRejected += m_tileStatistics[i].blocksRejected;
+		m_statistics.blocksAccepted += m_tileStatistics[i].blocksAccepted;
+		m_statistics.pixelsCovered += m_tileStatistics[i].pixelsCovered;
+		m_statistics.pixelsShaded += m_tileStatistics[i].pixelsShaded;
+	}
+	m_statistics.depthComplexity = (float)((double)m_statistics.pixelsCovered / ((double)m_width * m_height));
+	m_statistics.overdraw = (float)((double)m_statistics.pixelsShaded / ((double)m_width * m_height));
+
+	//Frames drawn without the hierarchy leave it behind the depth buffer.
+	m_target->depthBoundsValid = m_hierarchicalDepth;
+
+	if (m_passCount > 0)
+	{
+		AddFramePasses(start, ReadPassClock());
+	}
+
+	//The frame is done. Forget its draws and release the memory of the buffers rewritten during it. Nothing reads
+	//the constant ring anymore either.
+	m_draws.clear();
+	m_frameConstants.clear();
+	m_constantRingHead = 0;
+	for (unsigned int i = 0; i < m_retiredMemory.size(); i++)
+	{
+		AlignedFree(m_retiredMemory[i]);
+	}
+	m_retiredMemory.clear();
+
+	m_clearPending = false;
+	m_passCount = 0;
+	m_frameIndex++;
+}
+
+/*
+ *	CreateBuffer()
+ *	brief: Creates a buffer in system memory.
+ *	param desc: What the buffer is going to be bound as, its size and whether the CPU rewrites it.
+ *	param initialData: The data to fill the buffer with. Can be null.
+ *	param buffer: Receives the handle of the created buffer.
+ */
+bool SoftwareRendererClass::CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer)
+{
+	SoftwareBuffer* softwareBuffer;
+
+	softwareBuffer = new SoftwareBuffer();
+	if (!softwareBuffer)
+	{
+		return false;
+	}
+
+	softwareBuffer->desc = desc;
+	softwareBuffer->lastFrameUsed = UNUSED_FRAME;
+
+	//The memory is aligned so the constant buffers can be written with aligned XMMATRIX stores.
+	softwareBuffer->data = (unsigned char*)AlignedAlloc(std::max(desc.byteWidth, 16u), 16);
+	if (!softwareBuffer->data)
+	{
+		delete softwareBuffer;
+		return false;
+	}
+
+	if (initialData)
+	{
+		memcpy(softwareBuffer->data, initialData, desc.byteWidth);
+	}
+	else
+	{
+		memset(softwareBuffer->data, 0, desc.byteWidth);
+	}
+
+	*buffer = (RenderBuffer*)softwareBuffer;
+	return true;
+}
+
+void SoftwareRendererClass::ReleaseBuffer(RenderBuffer* buffer)
+{
+	SoftwareBuffer* softwareBuffer = (SoftwareBuffer*)buffer;
+
+	if (!softwareBuffer)
+	{
+		return;
+	}
+
+	//If the frame being recorded reads from the buffer its memory has to live until EndScene().
+	if (softwareBuffer->lastFrameUsed == m_frameIndex)
+	{
+		m_retiredMemory.push_back(softwareBuffer->data);
+	}
+	else
+	{
+		AlignedFree(softwareBuffer->data);
+	}
+
+	delete softwareBuffer;
+}
+
+/*
+ *	MapBuffer()
+ *	brief: Gives the CPU the memory of a buffer to rewrite it. Like D3D11_MAP_WRITE_DISCARD, if a draw of this frame
+ *		   still needs the old content the buffer gets new memory and the old one is kept until EndScene().
+ */
+void* SoftwareRendererClass::MapBuffer(RenderBuffer* buffer)
+{
+	SoftwareBuffer* softwareBuffer = (SoftwareBuffer*)buffer;
+
+	if (softwareBuffer->lastFrameUsed == m_frameIndex && softwareBuffer->desc.bindType != BUFFER_BIND_CONSTANT)
+	{
+		RetireBufferMemory(softwareBuffer);
+	}
+
+	return softwareBuffer->data;
+}
+
+void SoftwareRendererClass::UnmapBuffer(RenderBuffer* /*buffer*/)
+{
+}
+
+/*
+ *	CreateShader()
+ *	brief: Finds the CPU version of the vertex and pixel shaders described and keeps the input layout that
+ *		   tells how to read their input from the vertex buffers. The HLSL files aren't used.
+ *	param desc: The shader files, entry points and input layout.
+ *	param shader: Receives the handle of the created shader.
+ */
+bool SoftwareRendererClass::CreateShader(const ShaderDesc& desc, RenderProgram** shader)
+{
+	SoftwareShader* softwareShader;
+	const SoftwareShaderProgram* program;
+	unsigned int slotOffsets[SOFTWARE_MAX_VERTEX_SLOTS];
+
+	if (desc.numElements > SOFTWARE_MAX_INPUT_ELEMENTS)
+	{
+		return false;
+	}
+
+	program = FindSoftwareShaderProgram(desc.vsEntryPoint, desc.psEntryPoint, desc.permutation);
+	if (!program)
+	{
+		MessageBox(NULL, desc.vsFilename, L"No software version of the shader", MB_OK);
+		return false;
+	}
+
+	softwareShader = new SoftwareShader();
+	if (!softwareShader)
+	{
+		return false;
+	}
+
+	softwareShader->program = program;
+	softwareShader->numElements = desc.numElements;
+
+	//Keep the layout resolving the appended elements to their real offsets.
+	for (unsigned int i = 0; i < SOFTWARE_MAX_VERTEX_SLOTS; i++)
+	{
+		slotOffsets[i] = 0;
+	}
+
+	for (unsigned int i = 0; i < desc.numElements; i++)
+	{
+		InputElementDesc element = desc.inputLayout[i];
+
+		if (element.inputSlot >= SOFTWARE_MAX_VERTEX_SLOTS)
+		{
+			delete softwareShader;
+			return false;
+		}
+
+		if (element.alignedByteOffset == APPEND_ALIGNED_ELEMENT)
+		{
+			element.alignedByteOffset = slotOffsets[element.inputSlot];
+		}
+		slotOffsets[element.inputSlot] = element.alignedByteOffset + ElementSize(element.format);
+
+		softwareShader->elements[i] = element;
+	}
+
+	*shader = (RenderProgram*)softwareShader;
+	return true;
+}
+
+void SoftwareRendererClass::ReleaseShader(RenderProgram* shader)
+{
+	delete (SoftwareShader*)shader;
+}
+
+//The variants are template instances compiled with the program, so there is nothing to do in parallel.
+bool SoftwareRendererClass::CreateShaders(const ShaderDesc* descs, unsigned int count, RenderProgram** shaders)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!CreateShader(descs[i], &shaders[i]))
+		{
+			for (unsigned int j = 0; j < i; j++)
+			{
+				ReleaseShader(shaders[j]);
+				shaders[j] = nullptr;
+			}
+			shaders[i] = nullptr;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void SoftwareRendererClass::SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset)
+{
+	if (slot >= SOFTWARE_MAX_VERTEX_SLOTS)
+	{
+		return;
+	}
+
+	m_state.vertexBuffers[slot] = (SoftwareBuffer*)buffer;
+	m_state.vertexStrides[slot] = stride;
+	m_state.vertexOffsets[slot] = offset;
+}
+
+void SoftwareRendererClass::SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset)
+{
+	m_state.indexBuffer = (SoftwareBuffer*)buffer;
+	m_state.indexFormat = format;
+	m_state.indexOffset = offset;
+}
+
+void SoftwareRendererClass::SetPrimitiveTopology(PrimitiveTopology /*topology*/)
+{
+	//Triangle lists are the only primitive the engine draws for now.
+}
+
+void SoftwareRendererClass::SetConstantBuffer(unsigned int slot, RenderBuffer* buffer)
+{
+	if (slot >= SOFTWARE_MAX_CONSTANT_BUFFERS)
+	{
+		return;
+	}
+
+	m_state.constantBuffers[slot] = (SoftwareBuffer*)buffer;
+	m_state.constantRanges[slot] = NO_CONSTANTS;
+}
+
+void SoftwareRendererClass::SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize)
+{
+	SetStateConstantRange(m_state, slot, offset, byteSize);
+}
+
+/*
+ *	MapConstantRing()
+ *	brief: Reserves the constants of count draws in the ring. The draws of the frame read them in place, so there is
+ *		   nothing to wait for: the whole ring is free again once EndScene() has rendered the frame.
+ *	return: Where to write the first block, or null if the frame has filled the ring.
+ */
+void* SoftwareRendererClass::MapConstantRing(unsigned int byteSize, unsigned int count, unsigned int& offset,
+											 unsigned int& stride)
+{
+	unsigned long long size;
+
+	stride = (byteSize + SOFTWARE_CONSTANT_ALIGNMENT - 1) & ~(SOFTWARE_CONSTANT_ALIGNMENT - 1);
+	size = (unsigned long long)stride * count;
+	if (!m_constantRing || size == 0 || m_constantRingHead + size > CONSTANT_RING_SIZE)
+	{
+		return nullptr;
+	}
+
+	offset = m_constantRingHead;
+	m_constantRingHead += (unsigned int)size;
+
+	return m_constantRing + offset;
+}
+
+//The ring is in system memory, so there is nothing to unlock.
+void SoftwareRendererClass::UnmapConstantRing()
+{
+}
+
+void SoftwareRendererClass::SetShader(RenderProgram* shader)
+{
+	m_state.shader = (SoftwareShader*)shader;
+}
+
+/*
+ *	DrawIndexed()
+ *	brief: Records a draw with the bound state. The constant buffers are copied now, since the caller is free to
+ *		   rewrite them for the next draw, while vertex and index buffers are read when the frame is rendered.
+ *	param indexCount: Number of indices to draw.
+ *	param startIndex: The first index to read from the index buffer.
+ *	param baseVertex: A value added to each index before reading the vertex.
+ */
+void SoftwareRendererClass::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	DrawIndexedInstanced(indexCount, 1, startIndex, baseVertex, 0);
+}
+
+/*
+ *	DrawIndexedInstanced()
+ *	brief: Records a draw of several instances of the same indexed triangles. Per instance input elements advance
+ *		   once every instanceDataStepRate instances, starting at startInstance.
+ */
+void SoftwareRendererClass::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+												 unsigned int startIndex, int baseVertex, unsigned int startInstance)
+{
+	DrawCommand draw;
+
+	if (!BuildDraw(m_state, indexCount, instanceCount, startIndex, baseVertex, startInstance, draw))
+	{
+		return;
+	}
+
+	//Keep the memory of the buffers the draw reads until EndScene().
+	m_state.indexBuffer->lastFrameUsed = m_frameIndex;
+	for (unsigned int i = 0; i < SOFTWARE_MAX_VERTEX_SLOTS; i++)
+	{
+		if (draw.vertexData[i])
+		{
+			m_state.vertexBuffers[i]->lastFrameUsed = m_frameIndex;
+		}
+	}
+
+	//Copy the constant buffers as they are right now. The ring isn't rewritten during the frame, so it is read in place.
+	for (unsigned int i = 0; i < SOFTWARE_MAX_CONSTANT_BUFFERS; i++)
+	{
+		if (m_state.constantBuffers[i])
+		{
+			draw.constantOffset[i] = (unsigned int)m_frameConstants.size();
+			m_frameConstants.insert(m_frameConstants.end(), m_state.constantBuffers[i]->data,
+									m_state.constantBuffers[i]->data + m_state.constantBuffers[i]->desc.byteWidth);
+		}
+		else if (m_state.constantRanges[i] != NO_CONSTANTS)
+		{
+			draw.constantOffset[i] = m_state.constantRanges[i] | RING_CONSTANTS;
+		}
+		else
+		{
+			draw.constantOffset[i] = NO_CONSTANTS;
+		}
+	}
+
+	m_draws.push_back(draw);
+}
+
+bool SoftwareRendererClass::CreateDeferredContext(RenderContext** context)
+{
+	DeferredContext* deferredContext;
+
+	deferredContext = new DeferredContext();
+	if (!deferredContext)
+	{
+		return false;
+	}
+
+	if (!deferredContext->Initialize())
+	{
+		delete deferredContext;
+		return false;
+	}
+
+	*context = deferredContext;
+	return true;
+}
+
+void SoftwareRendererClass::ReleaseDeferredContext(RenderContext* context)
+{
+	delete (DeferredContext*)context;
+}
+
+/*
+ *	FinishCommandList()
+ *	brief: Takes the draws recorded by a deferred context into a command list, leaving the context empty and without
+ *		   state bound, to record the next list. Released lists are reused, so once there are as many as a frame
+ *		   needs this doesn't allocate.
+ *	param commandList: Receives the handle of the list.
+ */
+bool SoftwareRendererClass::FinishCommandList(RenderContext* context, RenderCommandList** commandList)
+{
+	CommandList* softwareList = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(m_commandListMutex);
+		if (!m_freeCommandLists.empty())
+		{
+			softwareList = m_freeCommandLists.back();
+			m_freeCommandLists.pop_back();
+		}
+	}
+
+	if (!softwareList)
+	{
+		softwareList = new CommandList();
+		if (!softwareList)
+		{
+			return false;
+		}
+	}
+
+	((DeferredContext*)context)->Finish(*softwareList);
+
+	*commandList = (RenderCommandList*)softwareList;
+	return true;
+}
+
+/*
+ *	ExecuteCommandList()
+ *	brief: Appends the draws of a command list to the frame, after the ones already drawn. The constant buffers the
+ *		   list mapped keep their last content, and the device is left without state bound.
+ */
+void SoftwareRendererClass::ExecuteCommandList(RenderCommandList* commandList)
+{
+	CommandList* softwareList = (CommandList*)commandList;
+	unsigned int constantBase, firstDraw;
+
+	constantBase = (unsigned int)m_frameConstants.size();
+	m_frameConstants.insert(m_frameConstants.end(), softwareList->constants.begin(), softwareList->constants.end());
+
+	firstDraw = (unsigned int)m_draws.size();
+	m_draws.insert(m_draws.end(), softwareList->draws.begin(), softwareList->draws.end());
+	for (unsigned int i = firstDraw; i < m_draws.size(); i++)
+	{
+		for (unsigned int j = 0; j < SOFTWARE_MAX_CONSTANT_BUFFERS; j++)
+		{
+			if (m_draws[i].constantOffset[j] != NO_CONSTANTS && !(m_draws[i].constantOffset[j] & RING_CONSTANTS))
+			{
+				m_draws[i].constantOffset[j] += constantBase;
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < softwareList->usedBuffers.size(); i++)
+	{
+		softwareList->usedBuffers[i]->lastFrameUsed = m_frameIndex;
+	}
+
+	//The draws already have their constants copied, so the buffers can be overwritten right away.
+	for (unsigned int i = 0; i < softwareList->mappedBuffers.size(); i++)
+	{
+		SoftwareBuffer* buffer = softwareList->mappedBuffers[i].first;
+
+		memcpy(buffer->data, &softwareList->constants[softwareList->mappedBuffers[i].second], buffer->desc.byteWidth);
+	}
+
+	ResetState(m_state);
+	m_executedCommandLists++;
+}
+
+//Empties the list and keeps it, memory included, for a later FinishCommandList().
+void SoftwareRendererClass::ReleaseCommandList(RenderCommandList* commandList)
+{
+	CommandList* softwareList = (CommandList*)commandList;
+
+	softwareList->draws.clear();
+	softwareList->constants.clear();
+	softwareList->usedBuffers.clear();
+	softwareList->mappedBuffers.clear();
+
+	std::lock_guard<std::mutex> lock(m_commandListMutex);
+	m_freeCommandLists.push_back(softwareList);
+}
+
+void SoftwareRendererClass::GetVideoCardInfo(char* cardName, int& memory)
+{
+	snprintf(cardName, 128, "Software rasterizer (%u threads)", m_ThreadPool ? m_ThreadPool->GetThreadCount() : 0);
+	memory = 0;
+}
+
+/*
+ *	CreateRenderTarget()
+ *	brief: Creates a color and a depth buffer of the size given to draw frames into. Only RGBA8, the layout every
+ *		   shader of this backend writes.
+ *	param target: Receives the handle of the created target.
+ */
+bool SoftwareRendererClass::CreateRenderTarget(const RenderTargetDesc& desc, RenderTarget** target)
+{
+	SoftwareTarget* softwareTarget;
+
+	if (desc.format != RENDER_TARGET_FORMAT_RGBA8)
+	{
+		return false;
+	}
+
+	softwareTarget = new SoftwareTarget();
+	if (!InitializeTarget(*softwareTarget, desc))
+	{
+		ShutdownTarget(*softwareTarget);
+		delete softwareTarget;
+		return false;
+	}
+
+	*target = (RenderTarget*)softwareTarget;
+	return true;
+}
+
+void SoftwareRendererClass::ReleaseRenderTarget(RenderTarget* target)
+{
+	if (!target)
+	{
+		return;
+	}
+
+	if (m_target == (SoftwareTarget*)target)
+	{
+		BindTarget(&m_screen);
+	}
+
+	ShutdownTarget(*(SoftwareTarget*)target);
+	delete (SoftwareTarget*)target;
+}
+
+void SoftwareRendererClass::SetRenderTarget(RenderTarget* target)
+{
+	BindTarget(target ? (SoftwareTarget*)target : &m_screen);
+}
+
+/*
+ *	CreateReadback()
+ *	brief: Creates the ring of images of a readback, depth color buffers of the size of the target to swap with it.
+ *	param target: The render target read back. Not the screen.
+ *	param depth: How many images can wait to be mapped.
+ *	param readback: Receives the handle of the created readback.
+ */
+bool SoftwareRendererClass::CreateReadback(RenderTarget* target, unsigned int depth, RenderReadback** readback)
+{
+	SoftwareReadback* softwareReadback;
+	size_t imageSize;
+
+	if (!target || depth == 0)
+	{
+		return false;
+	}
+
+	softwareReadback = new SoftwareReadback();
+	softwareReadback->target = (SoftwareTarget*)target;
+	softwareReadback->images.assign(depth, nullptr);
+	softwareReadback->tags.assign(depth, 0);
+	softwareReadback->first = 0;
+	softwareReadback->count = 0;
+
+	imageSize = sizeof(unsigned int) * softwareReadback->target->desc.width * softwareReadback->target->desc.height;
+	for (unsigned int i = 0; i < depth; i++)
+	{
+		softwareReadback->images[i] = (unsigned int*)AlignedAlloc(imageSize, 64);
+		if (!softwareReadback->images[i])
+		{
+			ReleaseReadback((RenderReadback*)softwareReadback);
+			return false;
+		}
+	}
+
+	*readback = (RenderReadback*)softwareReadback;
+	return true;
+}
+
+void SoftwareRendererClass::ReleaseReadback(RenderReadback* readback)
+{
+	SoftwareReadback* softwareReadback;
+
+	if (!readback)
+	{
+		return;
+	}
+	softwareReadback = (SoftwareReadback*)readback;
+
+	//The target may still have its image in one of the images about to be freed.
+	for (unsigned int i = 0; i < softwareReadback->images.size(); i++)
+	{
+		if (softwareReadback->images[i] && softwareReadback->target->readbackImage == softwareReadback->images[i])
+		{
+			RestoreTargetImage(*softwareReadback->target);
+		}
+		AlignedFree(softwareReadback->images[i]);
+	}
+
+	delete softwareReadback;
+}
+
+/*
+ *	QueueReadback()
+ *	brief: Takes the image of the target by swapping its color buffer with the next free image of the ring. The
+ *		   frame is finished when EndScene() returns, so the image is ready as soon as it is queued. The target
+ *		   only copies it back if the next frame drawn into it doesn't clear it first.
+ *	param tag: Handed back with the image, like the index of the frame.
+ *	return: False if the ring is full.
+ */
+bool SoftwareRendererClass::QueueReadback(RenderReadback* readback, unsigned long long tag)
+{
+	SoftwareReadback* softwareReadback;
+	SoftwareTarget* target;
+	unsigned int slot;
+
+	softwareReadback = (SoftwareReadback*)readback;
+	target = softwareReadback->target;
+	if (softwareReadback->count == softwareReadback->images.size())
+	{
+		return false;
+	}
+
+	//Nothing was drawn since the last readback of the target, so its image is still in that one.
+	if (target->readbackImage)
+	{
+		RestoreTargetImage(*target);
+	}
+
+	slot = (softwareReadback->first + softwareReadback->count) % softwareReadback->images.size();
+	std::swap(softwareReadback->images[slot], target->colorBuffer);
+	softwareReadback->tags[slot] = tag;
+	softwareReadback->count++;
+	target->readbackImage = softwareReadback->images[slot];
+
+	if (m_target == target)
+	{
+		m_colorBuffer = target->colorBuffer;
+	}
+
+	return true;
+}
+
+//Gives the oldest image queued, which is always ready on this backend.
+bool SoftwareRendererClass::MapReadback(RenderReadback* readback, bool /*wait*/, ReadbackImage& image)
+{
+	SoftwareReadback* softwareReadback;
+
+	softwareReadback = (SoftwareReadback*)readback;
+	if (softwareReadback->count == 0)
+	{
+		return false;
+	}
+
+	image.data = softwareReadback->images[softwareReadback->first];
+	image.rowPitch = sizeof(unsigned int) * softwareReadback->target->desc.width;
+	image.width = softwareReadback->target->desc.width;
+	image.height = softwareReadback->target->desc.height;
+	image.format = softwareReadback->target->desc.format;
+	image.tag = softwareReadback->tags[softwareReadback->first];
+	return true;
+}
+
+void SoftwareRendererClass::UnmapReadback(RenderReadback* readback)
+{
+	SoftwareReadback* softwareReadback;
+
+	softwareReadback = (SoftwareReadback*)readback;
+	if (softwareReadback->count > 0)
+	{
+		softwareReadback->first = (softwareReadback->first + 1) % softwareReadback->images.size();
+		softwareReadback->count--;
+	}
+}
+
+/*
+ *	BeginPass()
+ *	brief: Starts a pass at the next draw recorded. Draws are only rendered by EndScene(), all the passes of a frame
+ *		   together, so every pass is timed from the start to the end of EndScene() and only the counters tell the
+ *		   passes apart. The passes after RENDER_MAX_PASSES aren't counted.
+ */
+void SoftwareRendererClass::BeginPass(const char* name)
+{
+	EndPass();
+	if (m_passCount == RENDER_MAX_PASSES)
+	{
+		return;
+	}
+
+	m_passes[m_passCount].name = name;
+	m_passes[m_passCount].firstDraw = (unsigned int)m_draws.size();
+	m_passes[m_passCount].endDraw = (unsigned int)m_draws.size();
+	m_passOpen = true;
+}
+
+void SoftwareRendererClass::EndPass()
+{
+	if (!m_passOpen)
+	{
+		return;
+	}
+
+	m_passes[m_passCount].endDraw = (unsigned int)m_draws.size();
+	m_passCount++;
+	m_passOpen = false;
+}
+
+/*
+ *	SetBlockShading()
+ *	brief: Picks how the programs with a block shader shade: in SIMD quads, the default, or pixel by pixel with the
+ *		   scalar pixel shader, the reference the blocks are checked against. Not while a frame is rendered.
+ */
+void SoftwareRendererClass::SetBlockShading(bool enabled)
+{
+	m_blockShading = enabled;
+}
+
+/*
+ *	SetHierarchicalDepth()
+ *	brief: Turns on or off the depth bounds of the tiles and blocks, on by default. Without them every covered
+ *		   pixel is depth tested. Turned back on, they are rebuilt from the depth buffer by the next frame. Not
+ *		   while a frame is rendered.
+ */
+void SoftwareRendererClass::SetHierarchicalDepth(bool enabled)
+{
+	m_hierarchicalDepth = enabled;
+}
+
+//What the last frame rendered by EndScene() did.
+void SoftwareRendererClass::GetFrameStatistics(SoftwareFrameStatistics& statistics)
+{
+	statistics = m_statistics;
+}
+
+const unsigned int* SoftwareRendererClass::GetColorBuffer()
+{
+	if (m_target->readbackImage)
+	{
+		RestoreTargetImage(*m_target);
+	}
+	return m_colorBuffer;
+}
+
+const float* SoftwareRendererClass::GetDepthBuffer()
+{
+	return m_depthBuffer;
+}
+
+int SoftwareRendererClass::GetWidth()
+{
+	return m_width;
+}
+
+int SoftwareRendererClass::GetHeight()
+{
+	return m_height;
+}
+
+/*
+ *	InitializeTarget()
+ *	brief: Allocates the color and depth buffers of a render target or the screen, cleared to black and to the far
+ *		   plane, and its depth hierarchy.
+ */
+bool SoftwareRendererClass::InitializeTarget(SoftwareTarget& target, const RenderTargetDesc& desc)
+{
+	int blocksX, blocksY, tilesX, tilesY;
+
+	target.desc = desc;
+	target.colorBuffer = nullptr;
+	target.depthBuffer = nullptr;
+	target.depthBoundsValid = true;
+	target.readbackImage = nullptr;
+
+	if (desc.width <= 0 || desc.height <= 0)
+	{
+		return false;
+	}
+
+	target.colorBuffer = (unsigned int*)AlignedAlloc(sizeof(unsigned int) * desc.width * desc.height, 64);
+	target.depthBuffer = (float*)AlignedAlloc(sizeof(float) * desc.width * desc.height, 64);
+	if (!target.colorBuffer || !target.depthBuffer)
+	{
+		return false;
+	}
+	memset(target.colorBuffer, 0, sizeof(unsigned int) * desc.width * desc.height);
+	std::fill(target.depthBuffer, target.depthBuffer + desc.width * desc.height, 1.0f);
+
+	//The depth hierarchy, as empty as the depth buffer.
+	blocksX = (desc.width + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+	blocksY = (desc.height + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+	tilesX = (desc.width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	tilesY = (desc.height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	target.blockDepth.assign(blocksX * blocksY, DepthBounds{ 1.0f, 1.0f });
+	target.tileMaxDepth.assign(tilesX * tilesY, 1.0f);
+
+	return true;
+}
+
+void SoftwareRendererClass::ShutdownTarget(SoftwareTarget& target)
+{
+	if (target.depthBuffer)
+	{
+		AlignedFree(target.depthBuffer);
+		target.depthBuffer = nullptr;
+	}
+
+	if (target.colorBuffer)
+	{
+		AlignedFree(target.colorBuffer);
+		target.colorBuffer = nullptr;
+	}
+
+	target.readbackImage = nullptr;
+}
+
+/*
+ *	BindTarget()
+ *	brief: Makes the frames draw into a target, copying its sizes and buffers to the members the rasterizer reads.
+ */
+void SoftwareRendererClass::BindTarget(SoftwareTarget* target)
+{
+	m_target = target;
+	m_width = target->desc.width;
+	m_height = target->desc.height;
+	m_tilesX = (m_width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	m_tilesY = (m_height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+	m_blocksX = (m_width + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+	m_blocksY = (m_height + RASTER_BLOCK_SIZE - 1) / RASTER_BLOCK_SIZE;
+
+	//The guard band keeps the snapped positions small enough for the fixed point edge functions.
+	m_guardBandX = std::max(1.0f, (float)SOFTWARE_GUARD_BAND / (float)m_width);
+	m_guardBandY = std::max(1.0f, (float)SOFTWARE_GUARD_BAND / (float)m_height);
+
+	m_colorBuffer = target->colorBuffer;
+	m_depthBuffer = target->depthBuffer;
+	m_blockDepth = &target->blockDepth[0];
+	m_tileMaxDepth = &target->tileMaxDepth[0];
+
+	//Only grows, so going back and forth between targets doesn't allocate.
+	if (m_tileStatistics.size() < (size_t)(m_tilesX * m_tilesY))
+	{
+		m_tileStatistics.resize(m_tilesX * m_tilesY);
+		m_tilePassPixels.resize(m_tilesX * m_tilesY * RENDER_MAX_PASSES);
+	}
+}
+
+//Copies the image of a target back from the readback that took it.
+void SoftwareRendererClass::RestoreTargetImage(SoftwareTarget& target)
+{
+	memcpy(target.colorBuffer, target.readbackImage, sizeof(unsigned int) * target.desc.width * target.desc.height);
+	target.readbackImage = nullptr;
+}
+
+/*
+ *	FetchElement()
+ *	brief: Reads one input element of a vertex of an instance. Missing components get the D3D defaults.
+ */
+void SoftwareRendererClass::FetchElement(const DrawCommand& draw, const InputElementDesc& element, unsigned int vertex,
+										 unsigned int instance, XMFLOAT4& value)
+{
+	const unsigned char* source;
+	unsigned short packed[4];
+	float unpacked[4];
+	unsigned int index;
+
+	if (element.inputSlotClass == INPUT_PER_INSTANCE_DATA)
+	{
+		index = draw.startInstance + (element.instanceDataStepRate ? instance / element.instanceDataStepRate : 0);
+	}
+	else
+	{
+		index = vertex;
+	}
+
+	source = draw.vertexData[element.inputSlot] + index * draw.vertexStride[element.inputSlot] + element.alignedByteOffset;
+
+	switch (element.format)
+	{
+	case ELEMENT_FORMAT_UNORM16X4:
+		memcpy(packed, source, sizeof(packed));
+		value = XMFLOAT4(packed[0] / 65535.0f, packed[1] / 65535.0f, packed[2] / 65535.0f, packed[3] / 65535.0f);
+		break;
+	case ELEMENT_FORMAT_UNORM8X4:
+		value = XMFLOAT4(source[0] / 255.0f, source[1] / 255.0f, source[2] / 255.0f, source[3] / 255.0f);
+		break;
+	case ELEMENT_FORMAT_FLOAT3:
+		memcpy(unpacked, source, 3 * sizeof(float));
+		value = XMFLOAT4(unpacked[0], unpacked[1], unpacked[2], 1.0f);
+		break;
+	default:
+		memcpy(unpacked, source, 4 * sizeof(float));
+		value = XMFLOAT4(unpacked[0], unpacked[1], unpacked[2], unpacked[3]);
+		break;
+	}
+}
+
+/*
+ *	ShadeVertices()
+ *	brief: Reads a batch of vertices of a draw through its input layout and runs the vertex shader on them. When the
+ *		   program declares its position matrix, the positions of every instance in the batch are transformed at
+ *		   once as a structure of arrays, with their outcodes, and the vertex shader only computes the rest.
+ */
+void SoftwareRendererClass::ShadeVertices(const VertexBatch& batch)
+{
+	const DrawCommand& draw = m_draws[batch.drawIndex];
+	const SoftwareShader* shader = draw.shader;
+	const SoftwareShaderProgram* program = shader->program;
+	const unsigned char* constantBuffers[SOFTWARE_MAX_CONSTANT_BUFFERS];
+	XMFLOAT4 input[SOFTWARE_MAX_INPUT_ELEMENTS];
+	float objectPosition[3][SOFTWARE_VERTEX_BATCH];
+	float clipPosition[4][SOFTWARE_VERTEX_BATCH];
+	unsigned char outcodes[SOFTWARE_VERTEX_BATCH];
+	PositionStream positionStream;
+	ClipStream clipStream;
+	XMMATRIX positionMatrix, worldViewProjection;
+	XMFLOAT4X4 worldMatrix;
+	unsigned int end, instance, vertex, segmentCount;
+	bool batchedPosition;
+
+	ResolveConstantBuffers(draw, constantBuffers);
+
+	batchedPosition = program->positionMatrixBuffer != SOFTWARE_NO_POSITION_MATRIX &&
+					  constantBuffers[program->positionMatrixBuffer] != nullptr;
+	if (batchedPosition)
+	{
+		//The constant buffer holds it transposed for HLSL.
+		positionMatrix = XMMatrixTranspose(XMLoadFloat4x4((const XMFLOAT4X4*)constantBuffers[program->positionMatrixBuffer]));
+	}
+
+	positionStream.x = objectPosition[0];
+	positionStream.y = objectPosition[1];
+	positionStream.z = objectPosition[2];
+	clipStream.x = clipPosition[0];
+	clipStream.y = clipPosition[1];
+	clipStream.z = clipPosition[2];
+	clipStream.w = clipPosition[3];
+	clipStream.outcodes = outcodes;
+
+	//Go through the batch one instance at a time.
+	end = batch.firstVertex + batch.vertexCount;
+	for (unsigned int first = batch.firstVertex; first < end; first += segmentCount)
+	{
+		instance = first / draw.vertexCount;
+		vertex = first % draw.vertexCount;
+		segmentCount = std::min(end - first, draw.vertexCount - vertex);
+
+		if (batchedPosition)
+		{
+			worldViewProjection = positionMatrix;
+			if (program->instanceMatrixElement != SOFTWARE_NO_INSTANCE_MATRIX)
+			{
+				//The world matrix of the instance comes in four elements, one per row.
+				for (int row = 0; row < 4; row++)
+				{
+					FetchElement(draw, shader->elements[program->instanceMatrixElement + row], vertex, instance, input[0]);
+					worldMatrix.m[row][0] = input[0].x;
+					worldMatrix.m[row][1] = input[0].y;
+					worldMatrix.m[row][2] = input[0].z;
+					worldMatrix.m[row][3] = input[0].w;
+				}
+				worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&worldMatrix), positionMatrix);
+			}
+
+			//Gather the positions into separate x, y and z arrays and transform them all with one matrix.
+			for (unsigned int i = 0; i < segmentCount; i++)
+			{
+				FetchElement(draw, shader->elements[0], vertex + i, instance, input[0]);
+				objectPosition[0][i] = input[0].x;
+				objectPosition[1][i] = input[0].y;
+				objectPosition[2][i] = input[0].z;
+			}
+
+			TransformPositionStream(worldViewProjection, positionStream, clipStream, segmentCount,
+									m_guardBandX, m_guardBandY);
+		}
+
+		for (unsigned int i = 0; i < segmentCount; i++)
+		{
+			ShadedVertex& output = m_shadedVertices[draw.firstShadedVertex + first + i];
+
+			for (unsigned int element = 0; element < shader->numElements; element++)
+			{
+				FetchElement(draw, shader->elements[element], vertex + i, instance, input[element]);
+			}
+
+			//The vertex shader gets the position already transformed, to read it if it needs to.
+			if (batchedPosition)
+			{
+				output.position.x = clipPosition[0][i];
+				output.position.y = clipPosition[1][i];
+				output.position.z = clipPosition[2][i];
+				output.position.w = clipPosition[3][i];
+			}
+
+			program->vertexShader(input, constantBuffers, output.position, output.varyings);
+
+			output.outcode = batchedPosition ? outcodes[i] : ClipOutcode(output.position, m_guardBandX, m_guardBandY);
+		}
+	}
+}
+
+/*
+ *	SetupTriangles()
+ *	brief: Assembles a batch of triangles from the shaded vertices, clips the ones crossing the near, far or
+ *		   guard band planes, and bins the visible ones into the tiles their bounding box touches.
+ */
+void SoftwareRendererClass::SetupTriangles(TriangleBatch& batch)
+{
+	const DrawCommand& draw = m_draws[batch.drawIndex];
+	const ShadedVertex* vertices[3];
+	const ShadedVertex* instanceVertices;
+	unsigned int outcodes[3], instance, localTriangle;
+	long long index;
+	bool valid;
+
+	batch.triangles.clear();
+
+	for (unsigned int triangle = batch.firstTriangle; triangle < batch.firstTriangle + batch.triangleCount; triangle++)
+	{
+		//Every instance reads the same indices, but its own shaded vertices.
+		instance = triangle / draw.triangleCount;
+		localTriangle = triangle % draw.triangleCount;
+		instanceVertices = &m_shadedVertices[draw.firstShadedVertex + instance * draw.vertexCount];
+
+		valid = true;
+		for (unsigned int corner = 0; corner < 3; corner++)
+		{
+			if (draw.indexFormat == INDEX_FORMAT_UINT16)
+			{
+				index = ((const unsigned short*)draw.indexData)[localTriangle * 3 + corner];
+			}
+			else
+			{
+				index = ((const unsigned int*)draw.indexData)[localTriangle * 3 + corner];
+			}
+
+			//Like the hardware, indices outside the vertex buffers don't draw anything.
+			index += draw.baseVertex;
+			if (index < 0 || index >= draw.vertexCount)
+			{
+				valid = false;
+				break;
+			}
+
+			vertices[corner] = &instanceVertices[index];
+			outcodes[corner] = vertices[corner]->outcode;
+		}
+
+		//Skip the triangles with bad indices or completely outside one of the planes.
+		if (!valid || (outcodes[0] & outcodes[1] & outcodes[2]) != 0)
+		{
+			continue;
+		}
+
+		if ((outcodes[0] | outcodes[1] | outcodes[2]) == 0)
+		{
+			EmitTriangle(batch, vertices[0], vertices[1], vertices[2], draw.shader->program);
+		}
+		else
+		{
+			ClipTriangle(batch, vertices[0], vertices[1], vertices[2], draw.shader->program);
+		}
+	}
+
+	BinTriangles(batch);
+}
+
+/*
+ *	BinTriangles()
+ *	brief: Lists the triangles of a batch touching every tile their bounding box touches, counting them per tile
+ *		   first so the lists are packed one after the other. Each list keeps the order of the triangles.
+ */
+void SoftwareRendererClass::BinTriangles(TriangleBatch& batch)
+{
+	unsigned int tileCount, binEntries, count;
+
+	tileCount = (unsigned int)(batch.binStarts.size() - 1);
+	std::fill(batch.binStarts.begin(), batch.binStarts.end(), 0);
+
+	//Count the triangles of every tile, one slot ahead so the starts come out of the running sum.
+	for (unsigned int i = 0; i < batch.triangles.size(); i++)
+	{
+		const RasterTriangle& triangle = batch.triangles[i];
+
+		for (int tileY = triangle.minY / SOFTWARE_TILE_SIZE; tileY <= triangle.maxY / SOFTWARE_TILE_SIZE; tileY++)
+		{
+			for (int tileX = triangle.minX / SOFTWARE_TILE_SIZE; tileX <= triangle.maxX / SOFTWARE_TILE_SIZE; tileX++)
+			{
+				batch.binStarts[tileY * m_tilesX + tileX + 1]++;
+			}
+		}
+	}
+
+	binEntries = 0;
+	for (unsigned int i = 1; i <= tileCount; i++)
+	{
+		count = batch.binStarts[i];
+		batch.binStarts[i] = binEntries;
+		binEntries += count;
+	}
+	batch.binTriangles.resize(binEntries);
+
+	//Fill the lists, moving the start of each tile forward until it ends up at the start of the next.
+	for (unsigned int i = 0; i < batch.triangles.size(); i++)
+	{
+		const RasterTriangle& triangle = batch.triangles[i];
+
+		for (int tileY = triangle.minY / SOFTWARE_TILE_SIZE; tileY <= triangle.maxY / SOFTWARE_TILE_SIZE; tileY++)
+		{
+			for (int tileX = triangle.minX / SOFTWARE_TILE_SIZE; tileX <= triangle.maxX / SOFTWARE_TILE_SIZE; tileX++)
+			{
+				batch.binTriangles[batch.binStarts[tileY * m_tilesX + tileX + 1]++] = i;
+			}
+		}
+	}
+}
+
+/*
+ *	ClipTriangle()
+ *	brief: Clips a triangle against the planes it crosses and emits the resulting polygon as a fan of triangles.
+ */
+void SoftwareRendererClass::ClipTriangle(TriangleBatch& batch, const ShadedVertex* v0, const ShadedVertex* v1,
+										 const ShadedVertex* v2, const SoftwareShaderProgram* program)
+{
+	ShadedVertex polygons[2][3 + CLIP_PLANE_COUNT];
+	unsigned int outcode;
+	int count, source, nextCount;
+	float distance, nextDistance, t;
+
+	polygons[0][0] = *v0;
+	polygons[0][1] = *v1;
+	polygons[0][2] = *v2;
+	count = 3;
+	source = 0;
+
+	outcode = v0->outcode | v1->outcode | v2->outcode;
+
+	for (int plane = 0; plane < CLIP_PLANE_COUNT; plane++)
+	{
+		if (!(outcode & (1 << plane)))
+		{
+			continue;
+		}
+
+		const ShadedVertex* input = polygons[source];
+		ShadedVertex* output = polygons[1 - source];
+		nextCount = 0;
+
+		//Sutherland-Hodgman: keep the inside points and add the crossing points of every edge.
+		for (int i = 0; i < count; i++)
+		{
+			const ShadedVertex& current = input[i];
+			const ShadedVertex& next = input[(i + 1) % count];
+
+			distance = ClipDistance(current.position, plane, m_guardBandX, m_guardBandY);
+			nextDistance = ClipDistance(next.position, plane, m_guardBandX, m_guardBandY);
+
+			if (distance >= 0.0f)
+			{
+				output[nextCount++] = current;
+			}
+
+			if ((distance >= 0.0f) != (nextDistance >= 0.0f))
+			{
+				ShadedVertex& crossing = output[nextCount++];
+
+				t = distance / (distance - nextDistance);
+				crossing.position.x = current.position.x + (next.position.x - current.position.x) * t;
+				crossing.position.y = current.position.y + (next.position.y - current.position.y) * t;
+				crossing.position.z = current.position.z + (next.position.z - current.position.z) * t;
+				crossing.position.w = current.position.w + (next.position.w - current.position.w) * t;
+				for (unsigned int k = 0; k < program->varyingCount; k++)
+				{
+					crossing.varyings[k] = current.varyings[k] + (next.varyings[k] - current.varyings[k]) * t;
+				}
+			}
+		}
+
+		count = nextCount;
+		source = 1 - source;
+		if (count < 3)
+		{
+			return;
+		}
+	}
+
+	for (int i = 1; i + 1 < count; i++)
+	{
+		EmitTriangle(batch, &polygons[source][0], &polygons[source][i], &polygons[source][i + 1], program);
+	}
+}
+
+/*
+ *	EmitTriangle()
+ *	brief: Projects a triangle to the screen, snaps it to the sub-pixel grid, culls back faces (clockwise is the
+ *		   front, like the D3D rasterizer state) and computes the edge functions used to rasterize it.
+ */
+void SoftwareRendererClass::EmitTriangle(TriangleBatch& batch, const ShadedVertex* v0, const ShadedVertex* v1,
+										 const ShadedVertex* v2, const SoftwareShaderProgram* program)
+{
+	const ShadedVertex* vertices[3] = { v0, v1, v2 };
+	RasterTriangle triangle;
+	int x[3], y[3];
+	long long area;
+	float subpixelScale;
+	int minX, minY, maxX, maxY, pixelOffset;
+
+	subpixelScale = (float)(1 << RASTER_SUBPIXEL_BITS);
+
+	for (int i = 0; i < 3; i++)
+	{
+		const XMFLOAT4& position = vertices[i]->position;
+
+		if (position.w <= 0.0f)
+		{
+			return;
+		}
+
+		triangle.invW[i] = 1.0f / position.w;
+		triangle.z[i] = position.z * triangle.invW[i];
+		triangle.minZ = i == 0 ? triangle.z[i] : std::min(triangle.minZ, triangle.z[i]);
+		triangle.maxZ = i == 0 ? triangle.z[i] : std::max(triangle.maxZ, triangle.z[i]);
+
+		//Viewport transform to pixels, then to fixed point.
+		x[i] = (int)floorf((position.x * triangle.invW[i] * 0.5f + 0.5f) * (float)m_width * subpixelScale + 0.5f);
+		y[i] = (int)floorf((0.5f - position.y * triangle.invW[i] * 0.5f) * (float)m_height * subpixelScale + 0.5f);
+
+		for (unsigned int k = 0; k < program->varyingCount; k++)
+		{
+			triangle.varyings[i][k] = vertices[i]->varyings[k] * triangle.invW[i];
+		}
+	}
+
+	//Edge i is the one in front of vertex i, so its value divided by the area is the barycentric weight of that vertex.
+	//With y pointing down a clockwise triangle has a positive area. The rest are back faces or degenerated.
+	area = SetupRasterEdges(x, y, triangle.edges);
+	if (area <= 0)
+	{
+		return;
+	}
+
+	//Bounding box in pixels, taking only the pixels whose centers are inside the box.
+	pixelOffset = 1 << (RASTER_SUBPIXEL_BITS - 1);
+	minX = (std::min(std::min(x[0], x[1]), x[2]) - pixelOffset + (1 << RASTER_SUBPIXEL_BITS) - 1) >> RASTER_SUBPIXEL_BITS;
+	minY = (std::min(std::min(y[0], y[1]), y[2]) - pixelOffset + (1 << RASTER_SUBPIXEL_BITS) - 1) >> RASTER_SUBPIXEL_BITS;
+	maxX = (std::max(std::max(x[0], x[1]), x[2]) - pixelOffset) >> RASTER_SUBPIXEL_BITS;
+	maxY = (std::max(std::max(y[0], y[1]), y[2]) - pixelOffset) >> RASTER_SUBPIXEL_BITS;
+
+	triangle.minX = std::max(minX, 0);
+	triangle.minY = std::max(minY, 0);
+	triangle.maxX = std::min(maxX, m_width - 1);
+	triangle.maxY = std::min(maxY, m_height - 1);
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+	{
+		return;
+	}
+
+	triangle.invArea = 1.0f / (float)area;
+	triangle.program = program;
+
+	//The depth of a pixel rounds a bit more as it gets farther from the top-left pixel of its block.
+	triangle.depthStepX = InterpolateDepthStep(triangle.edges.edgeA, triangle.z, triangle.invArea);
+	triangle.depthStepY = InterpolateDepthStep(triangle.edges.edgeB, triangle.z, triangle.invArea);
+	triangle.depthSlack = DEPTH_BOUNDS_EPSILON * (1.0f + RASTER_BLOCK_SIZE * (fabsf(triangle.depthStepX) +
+																			   fabsf(triangle.depthStepY)));
+
+	//It is binned with the rest of the batch.
+	batch.triangles.push_back(triangle);
+}
+
+//Points to the constants a draw copied or bound in the ring, or null for the slots it had empty.
+void SoftwareRendererClass::ResolveConstantBuffers(const DrawCommand& draw, const unsigned char** constantBuffers)
+{
+	for (unsigned int i = 0; i < SOFTWARE_MAX_CONSTANT_BUFFERS; i++)
+	{
+		if (draw.constantOffset[i] == NO_CONSTANTS)
+		{
+			constantBuffers[i] = nullptr;
+		}
+		else if (draw.constantOffset[i] & RING_CONSTANTS)
+		{
+			constantBuffers[i] = m_constantRing + (draw.constantOffset[i] & ~RING_CONSTANTS);
+		}
+		else
+		{
+			constantBuffers[i] = &m_frameConstants[draw.constantOffset[i]];
+		}
+	}
+}
+
+/*
+ *	RasterizeTile()
+ *	brief: Clears the tile if the frame started with a clear and draws every triangle binned into it, keeping the
+ *		   order they were submitted in. The triangles entirely behind the farthest depth of the tile are skipped.
+ */
+void SoftwareRendererClass::RasterizeTile(unsigned int tileIndex)
+{
+	const unsigned char* constantBuffers[SOFTWARE_MAX_CONSTANT_BUFFERS];
+	SoftwareFrameStatistics statistics;
+	unsigned long long* passPixels;
+	unsigned long long batchPixels;
+	int tileMinX, tileMinY, tileMaxX, tileMaxY;
+	bool boundsChanged;
+
+	tileMinX = (tileIndex % m_tilesX) * SOFTWARE_TILE_SIZE;
+	tileMinY = (tileIndex / m_tilesX) * SOFTWARE_TILE_SIZE;
+	tileMaxX = std::min(tileMinX + SOFTWARE_TILE_SIZE, m_width) - 1;
+	tileMaxY = std::min(tileMinY + SOFTWARE_TILE_SIZE, m_height) - 1;
+
+	if (m_clearPending)
+	{
+		for (int y = tileMinY; y <= tileMaxY; y++)
+		{
+			std::fill(m_colorBuffer + y * m_width + tileMinX, m_colorBuffer + y * m_width + tileMaxX + 1, m_clearColor);
+			std::fill(m_depthBuffer + y * m_width + tileMinX, m_depthBuffer + y * m_width + tileMaxX + 1, 1.0f);
+		}
+	}
+
+	//The blocks of a tile are only ever written by the thread of the tile, like its pixels.
+	if (m_hierarchicalDepth && (m_clearPending || !m_target->depthBoundsValid))
+	{
+		for (int blockY = tileMinY / RASTER_BLOCK_SIZE; blockY <= tileMaxY / RASTER_BLOCK_SIZE; blockY++)
+		{
+			for (int blockX = tileMinX / RASTER_BLOCK_SIZE; blockX <= tileMaxX / RASTER_BLOCK_SIZE; blockX++)
+			{
+				if (m_clearPending)
+				{
+					m_blockDepth[blockY * m_blocksX + blockX] = DepthBounds{ 1.0f, 1.0f };
+				}
+				else
+				{
+					UpdateBlockBounds(blockX, blockY);
+				}
+			}
+		}
+		UpdateTileBounds(tileIndex);
+	}
+
+	memset(&statistics, 0, sizeof(statistics));
+	boundsChanged = false;
+	passPixels = &m_tilePassPixels[tileIndex * RENDER_MAX_PASSES];
+	std::fill(passPixels, passPixels + m_passCount, 0ULL);
+
+	for (unsigned int i = 0; i < m_triangleBatchCount; i++)
+	{
+		const TriangleBatch& batch = m_triangleBatches[i];
+
+		if (batch.binStarts[tileIndex] == batch.binStarts[tileIndex + 1])
+		{
+			continue;
+		}
+
+		ResolveConstantBuffers(m_draws[batch.drawIndex], constantBuffers);
+		batchPixels = statistics.pixelsShaded;
+		for (unsigned int j = batch.binStarts[tileIndex]; j < batch.binStarts[tileIndex + 1]; j++)
+		{
+			const RasterTriangle& triangle = batch.triangles[batch.binTriangles[j]];
+
+			statistics.tileTriangles++;
+			if (m_hierarchicalDepth)
+			{
+				//Only a triangle that wrote something can have brought the farthest depth of the tile closer.
+				if (boundsChanged)
+				{
+					UpdateTileBounds(tileIndex);
+					boundsChanged = false;
+				}
+
+				if (triangle.minZ - triangle.depthSlack >= m_tileMaxDepth[tileIndex])
+				{
+					statistics.tileTrianglesRejected++;
+					continue;
+				}
+			}
+
+			if (RasterizeTriangle(triangle, constantBuffers, tileMinX, tileMinY, tileMaxX, tileMaxY, statistics))
+			{
+				boundsChanged = true;
+			}
+		}
+
+		if (batch.pass != RENDER_MAX_PASSES)
+		{
+			passPixels[batch.pass] += statistics.pixelsShaded - batchPixels;
+		}
+	}
+
+	m_tileStatistics[tileIndex] = statistics;
+}
+
+/*
+ *	AddFramePasses()
+ *	brief: Counts what every pass of the frame just rendered did, like the pipeline statistics of a video card: the
+ *		   vertices and triangles of its draws, the triangles left to rasterize after clipping and culling, and the
+ *		   pixels and tiles it wrote.
+ */
+void SoftwareRendererClass::AddFramePasses(double start, double end)
+{
+	RenderPassStatistics statistics;
+	unsigned int tileCount;
+
+	tileCount = (unsigned int)(m_tilesX * m_tilesY);
+	for (unsigned int pass = 0; pass < m_passCount; pass++)
+	{
+		memset(&statistics, 0, sizeof(statistics));
+		statistics.name = m_passes[pass].name;
+		statistics.frame = m_frameIndex;
+		statistics.timed = true;
+		statistics.start = start;
+		statistics.end = end;
+
+		for (unsigned int i = m_passes[pass].firstDraw; i < m_passes[pass].endDraw; i++)
+		{
+			statistics.verticesShaded += (unsigned long long)m_draws[i].vertexCount * m_draws[i].instanceCount;
+			statistics.trianglesIn += (unsigned long long)m_draws[i].triangleCount * m_draws[i].instanceCount;
+		}
+		for (unsigned int i = 0; i < m_triangleBatchCount; i++)
+		{
+			if (m_triangleBatches[i].pass == pass)
+			{
+				statistics.trianglesOut += m_triangleBatches[i].triangles.size();
+			}
+		}
+		for (unsigned int i = 0; i < tileCount; i++)
+		{
+			statistics.pixelsShaded += m_tilePassPixels[i * RENDER_MAX_PASSES + pass];
+			statistics.tilesTouched += m_tilePassPixels[i * RENDER_MAX_PASSES + pass] > 0 ? 1 : 0;
+		}
+
+		AddPassStatistics(statistics);
+	}
+}
+
+/*
+ *	RasterizeTriangle()
+ *	brief: Finds the pixels of the triangle inside the tile in 8x8 blocks, depth tests them against the depth buffer
+ *		   with the LESS comparison, and shades and writes the visible ones. Programs with a block shader shade
+ *		   whole blocks in SIMD quads from the planes of the triangle; the blocks at the right and bottom borders
+ *		   of the screen, which don't fit in the buffers, and programs without one go pixel by pixel, from the
+ *		   same planes in the same order, so both ways write the same depth and color.
+ *		   Before that, the blocks where the triangle is behind everything already drawn are skipped, and the
+ *		   depth bounds of the blocks written are updated.
+ *	return: Whether it wrote any pixel.
+ */
+bool SoftwareRendererClass::RasterizeTriangle(const RasterTriangle& triangle, const unsigned char* const* constantBuffers,
+											  int tileMinX, int tileMinY, int tileMaxX, int tileMaxY,
+											  SoftwareFrameStatistics& statistics)
+{
+	CoverageBlock blocks[SOFTWARE_TILE_BLOCKS];
+	int minX, minY, maxX, maxY, blockCount, x, y;
+	long long pixelX, pixelY, edge[3];
+	unsigned int rowBits;
+	float weight[3], depth, w, varyings[SOFTWARE_MAX_VARYINGS];
+	float weightStepX[3], weightStepY[3];
+	float depthStepX, depthStepY, blockDepth, nearest = 0.0f, farthest = 1.0f;
+	const float* values[PIXEL_PLANE_VARYINGS + SOFTWARE_MAX_VARYINGS][3];
+	PixelPlane planes[PIXEL_PLANE_VARYINGS + SOFTWARE_MAX_VARYINGS];
+	PixelBlockTarget target;
+	unsigned int pixelIndex, planeCount, written, blockIndex;
+	bool blockShading, wholeBlock, accepted, anyWritten;
+	XMFLOAT4 color;
+
+	minX = std::max(triangle.minX, tileMinX);
+	minY = std::max(triangle.minY, tileMinY);
+	maxX = std::min(triangle.maxX, tileMaxX);
+	maxY = std::min(triangle.maxY, tileMaxY);
+
+	blockCount = RasterizeBlocks(triangle.edges, minX, minY, maxX, maxY, blocks);
+
+	//The values to interpolate are linear in screen space, so across a block they only take a step per pixel.
+	for (int k = 0; k < 3; k++)
+	{
+		weightStepX[k] = (float)(triangle.edges.edgeA[k] << RASTER_SUBPIXEL_BITS) * triangle.invArea;
+		weightStepY[k] = (float)(triangle.edges.edgeB[k] << RASTER_SUBPIXEL_BITS) * triangle.invArea;
+	}
+	//Both the block shaders and the pixels drawn one by one interpolate from these planes, so they draw the same.
+	planeCount = PIXEL_PLANE_VARYINGS + triangle.program->varyingCount;
+	for (unsigned int p = PIXEL_PLANE_INV_W; p < planeCount; p++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			values[p][k] = p == PIXEL_PLANE_INV_W ? &triangle.invW[k] : &triangle.varyings[k][p - PIXEL_PLANE_VARYINGS];
+		}
+		planes[p].stepX = weightStepX[0] * *values[p][0] + weightStepX[1] * *values[p][1] + weightStepX[2] * *values[p][2];
+		planes[p].stepY = weightStepY[0] * *values[p][0] + weightStepY[1] * *values[p][1] + weightStepY[2] * *values[p][2];
+	}
+	depthStepX = triangle.depthStepX;
+	depthStepY = triangle.depthStepY;
+	planes[PIXEL_PLANE_DEPTH].stepX = depthStepX;
+	planes[PIXEL_PLANE_DEPTH].stepY = depthStepY;
+
+	blockShading = m_blockShading && triangle.program->blockShader;
+	target.pitch = m_width;
+
+	anyWritten = false;
+	for (int i = 0; i < blockCount; i++)
+	{
+		statistics.blocks++;
+		statistics.pixelsCovered += CountBits(blocks[i].mask);
+
+		//The planes start at the top-left pixel of the block, from the exact edge functions there.
+		pixelX = ((long long)blocks[i].x << RASTER_SUBPIXEL_BITS) + (1 << (RASTER_SUBPIXEL_BITS - 1));
+		pixelY = ((long long)blocks[i].y << RASTER_SUBPIXEL_BITS) + (1 << (RASTER_SUBPIXEL_BITS - 1));
+		planes[PIXEL_PLANE_DEPTH].base = InterpolateDepth(triangle.edges, triangle.z, triangle.invArea, pixelX, pixelY);
+
+		wholeBlock = blocks[i].x + RASTER_BLOCK_SIZE <= m_width && blocks[i].y + RASTER_BLOCK_SIZE <= m_height;
+		blockIndex = (blocks[i].y / RASTER_BLOCK_SIZE) * m_blocksX + blocks[i].x / RASTER_BLOCK_SIZE;
+		accepted = false;
+		if (m_hierarchicalDepth)
+		{
+			//The depth of the triangle over the block is between the corners of its plane, and its vertices.
+			blockDepth = planes[PIXEL_PLANE_DEPTH].base;
+			nearest = blockDepth + std::min(depthStepX * (RASTER_BLOCK_SIZE - 1), 0.0f) +
+					  std::min(depthStepY * (RASTER_BLOCK_SIZE - 1), 0.0f);
+			farthest = blockDepth + std::max(depthStepX * (RASTER_BLOCK_SIZE - 1), 0.0f) +
+					   std::max(depthStepY * (RASTER_BLOCK_SIZE - 1), 0.0f);
+			nearest = std::max(nearest, triangle.minZ) - triangle.depthSlack;
+			farthest = std::min(farthest, triangle.maxZ) + triangle.depthSlack;
+
+			if (nearest >= m_blockDepth[blockIndex].maxDepth)
+			{
+				statistics.blocksRejected++;
+				continue;
+			}
+
+			//In front of everything in the block, so all its pixels are written and the bounds are the triangle's.
+			accepted = wholeBlock && blocks[i].mask == ~0ULL && farthest < m_blockDepth[blockIndex].minDepth;
+		}
+
+		//The rest of the planes are only needed once the block is going to be drawn.
+		for (int k = 0; k < 3; k++)
+		{
+			edge[k] = triangle.edges.edgeA[k] * pixelX + triangle.edges.edgeB[k] * pixelY + triangle.edges.edgeC[k];
+			weight[k] = (float)edge[k] * triangle.invArea;
+		}
+		for (unsigned int p = PIXEL_PLANE_INV_W; p < planeCount; p++)
+		{
+			planes[p].base = weight[0] * *values[p][0] + weight[1] * *values[p][1] + weight[2] * *values[p][2];
+		}
+
+		written = 0;
+		if (blockShading && wholeBlock)
+		{
+			target.color = m_colorBuffer + blocks[i].y * m_width + blocks[i].x;
+			target.depth = m_depthBuffer + blocks[i].y * m_width + blocks[i].x;
+			written = triangle.program->blockShader(planes, blocks[i].mask, constantBuffers, target);
+		}
+		else
+		{
+			for (int row = 0; row < RASTER_BLOCK_SIZE; row++)
+			{
+				rowBits = (unsigned int)(blocks[i].mask >> (row * RASTER_BLOCK_SIZE)) & 0xff;
+				if (!rowBits)
+				{
+					continue;
+				}
+
+				y = blocks[i].y + row;
+				for (int column = 0; column < RASTER_BLOCK_SIZE; column++)
+				{
+					if (!(rowBits & (1u << column)))
+					{
+						continue;
+					}
+
+					//The depth is linear in screen space, so it is interpolated directly.
+					x = blocks[i].x + column;
+					depth = EvaluatePlane(planes[PIXEL_PLANE_DEPTH], column, row);
+					pixelIndex = y * m_width + x;
+
+					if (depth < m_depthBuffer[pixelIndex])
+					{
+						//The rest of the values are interpolated with perspective correction.
+						w = 1.0f / EvaluatePlane(planes[PIXEL_PLANE_INV_W], column, row);
+						for (unsigned int k = 0; k < triangle.program->varyingCount; k++)
+						{
+							varyings[k] = EvaluatePlane(planes[PIXEL_PLANE_VARYINGS + k], column, row) * w;
+						}
+
+						triangle.program->pixelShader(varyings, constantBuffers, color);
+
+						m_depthBuffer[pixelIndex] = depth;
+						m_colorBuffer[pixelIndex] = PackColor(color);
+						written++;
+					}
+				}
+			}
+		}
+
+		if (!written)
+		{
+			continue;
+		}
+
+		statistics.pixelsShaded += written;
+		anyWritten = true;
+
+		if (accepted)
+		{
+			m_blockDepth[blockIndex] = DepthBounds{ nearest, farthest };
+			statistics.blocksAccepted++;
+		}
+		else if (m_hierarchicalDepth)
+		{
+			UpdateBlockBounds(blocks[i].x / RASTER_BLOCK_SIZE, blocks[i].y / RASTER_BLOCK_SIZE);
+		}
+	}
+
+	return anyWritten;
+}
+
+//Finds the nearest and farthest depth of a block again, of its pixels inside the screen.
+void SoftwareRendererClass::UpdateBlockBounds(int blockX, int blockY)
+{
+	const float* depthRow;
+	DepthBounds bounds;
+	int width, height;
+
+	width = std::min(RASTER_BLOCK_SIZE, m_width - blockX * RASTER_BLOCK_SIZE);
+	height = std::min(RASTER_BLOCK_SIZE, m_height - blockY * RASTER_BLOCK_SIZE);
+	depthRow = m_depthBuffer + blockY * RASTER_BLOCK_SIZE * m_width + blockX * RASTER_BLOCK_SIZE;
+
+	bounds.minDepth = depthRow[0];
+	bounds.maxDepth = depthRow[0];
+	for (int y = 0; y < height; y++, depthRow += m_width)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			bounds.minDepth = std::min(bounds.minDepth, depthRow[x]);
+			bounds.maxDepth = std::max(bounds.maxDepth, depthRow[x]);
+		}
+	}
+
+	m_blockDepth[blockY * m_blocksX + blockX] = bounds;
+}
+
+//Finds the farthest depth of a tile again from the bounds of its blocks.
+void SoftwareRendererClass::UpdateTileBounds(unsigned int tileIndex)
+{
+	int firstBlockX, firstBlockY, lastBlockX, lastBlockY;
+	float maxDepth;
+
+	firstBlockX = (tileIndex % m_tilesX) * (SOFTWARE_TILE_SIZE / RASTER_BLOCK_SIZE);
+	firstBlockY = (tileIndex / m_tilesX) * (SOFTWARE_TILE_SIZE / RASTER_BLOCK_SIZE);
+	lastBlockX = std::min(firstBlockX + SOFTWARE_TILE_SIZE / RASTER_BLOCK_SIZE, m_blocksX) - 1;
+	lastBlockY = std::min(firstBlockY + SOFTWARE_TILE_SIZE / RASTER_BLOCK_SIZE, m_blocksY) - 1;
+
+	maxDepth = m_blockDepth[firstBlockY * m_blocksX + firstBlockX].maxDepth;
+	for (int blockY = firstBlockY; blockY <= lastBlockY; blockY++)
+	{
+		for (int blockX = firstBlockX; blockX <= lastBlockX; blockX++)
+		{
+			maxDepth = std::max(maxDepth, m_blockDepth[blockY * m_blocksX + blockX].maxDepth);
+		}
+	}
+
+	m_tileMaxDepth[tileIndex] = maxDepth;
+}
+
+void SoftwareRendererClass::RetireBufferMemory(SoftwareBuffer* buffer)
+{
+	unsigned char* freshMemory;
+
+	freshMemory = (unsigned char*)AlignedAlloc(std::max(buffer->desc.byteWidth, 16u), 16);
+	if (!freshMemory)
+	{
+		return;
+	}
+
+	m_retiredMemory.push_back(buffer->data);
+	buffer->data = freshMemory;
+}
+
+void SoftwareRendererClass::ResetState(BoundState& state)
+{
+	for (unsigned int i = 0; i < SOFTWARE_MAX_VERTEX_SLOTS; i++)
+	{
+		state.vertexBuffers[i] = nullptr;
+		state.vertexStrides[i] = 0;
+		state.vertexOffsets[i] = 0;
+	}
+	for (unsigned int i = 0; i < SOFTWARE_MAX_CONSTANT_BUFFERS; i++)
+	{
+		state.constantBuffers[i] = nullptr;
+		state.constantRanges[i] = NO_CONSTANTS;
+	}
+	state.indexBuffer = nullptr;
+	state.indexFormat = INDEX_FORMAT_UINT32;
+	state.indexOffset = 0;
+	state.shader = nullptr;
+}
+
+//Binds a block of the constant ring to a slot, in place of its constant buffer. Blocks out of the ring unbind it.
+void SoftwareRendererClass::SetStateConstantRange(BoundState& state, unsigned int slot, unsigned int offset,
+												  unsigned int byteSize)
+{
+	if (slot >= SOFTWARE_MAX_CONSTANT_BUFFERS)
+	{
+		return;
+	}
+
+	state.constantBuffers[slot] = nullptr;
+	state.constantRanges[slot] = (unsigned long long)offset + byteSize <= CONSTANT_RING_SIZE ? offset : NO_CONSTANTS;
+}
+
+/*
+ *	BuildDraw()
+ *	brief: Checks a draw against the bound state and fills everything but its constants. The device and the
+ *		   deferred contexts share it, so a draw is recorded the same on any thread.
+ *	return: False if the draw can't be drawn with the bound state and has to be skipped.
+ */
+bool SoftwareRendererClass::BuildDraw(const BoundState& state, unsigned int indexCount, unsigned int instanceCount,
+									  unsigned int startIndex, int baseVertex, unsigned int startInstance,
+									  DrawCommand& draw)
+{
+	unsigned int indexSize, slot, available, required;
+
+	if (!state.shader || !state.indexBuffer || indexCount < 3 || instanceCount == 0)
+	{
+		return false;
+	}
+
+	//Check the indices are inside the index buffer.
+	indexSize = state.indexFormat == INDEX_FORMAT_UINT16 ? 2 : 4;
+	if (state.indexOffset + ((unsigned long long)startIndex + indexCount) * indexSize > state.indexBuffer->desc.byteWidth)
+	{
+		return false;
+	}
+
+	draw.shader = state.shader;
+	draw.indexData = state.indexBuffer->data + state.indexOffset + startIndex * indexSize;
+	draw.indexFormat = state.indexFormat;
+	draw.triangleCount = indexCount / 3;
+	draw.baseVertex = baseVertex;
+	draw.instanceCount = instanceCount;
+	draw.startInstance = startInstance;
+	draw.firstShadedVertex = 0;
+
+	//Take the vertex buffers read by the input layout. The draw can't use more vertices than the smallest per vertex
+	//one has, and the per instance ones must have data for every instance.
+	draw.vertexCount = 0xffffffff;
+	for (unsigned int i = 0; i < SOFTWARE_MAX_VERTEX_SLOTS; i++)
+	{
+		draw.vertexData[i] = nullptr;
+		draw.vertexStride[i] = 0;
+	}
+
+	for (unsigned int i = 0; i < state.shader->numElements; i++)
+	{
+		const InputElementDesc& element = state.shader->elements[i];
+
+		slot = element.inputSlot;
+		if (!state.vertexBuffers[slot] || state.vertexStrides[slot] == 0 ||
+			state.vertexOffsets[slot] > state.vertexBuffers[slot]->desc.byteWidth)
+		{
+			return false;
+		}
+
+		available = (state.vertexBuffers[slot]->desc.byteWidth - state.vertexOffsets[slot]) / state.vertexStrides[slot];
+		if (element.inputSlotClass == INPUT_PER_INSTANCE_DATA)
+		{
+			required = element.instanceDataStepRate ? (instanceCount - 1) / element.instanceDataStepRate + 1 : 1;
+			if ((unsigned long long)startInstance + required > available)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			draw.vertexCount = std::min(draw.vertexCount, available);
+		}
+
+		draw.vertexData[slot] = state.vertexBuffers[slot]->data + state.vertexOffsets[slot];
+		draw.vertexStride[slot] = state.vertexStrides[slot];
+	}
+
+	//Vertices and triangles of all the instances are numbered with 32 bits.
+	if (draw.vertexCount == 0xffffffff || draw.vertexCount == 0 ||
+		(unsigned long long)draw.vertexCount * instanceCount > 0xffffffff ||
+		(unsigned long long)draw.triangleCount * instanceCount > 0xffffffff)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+SoftwareRendererClass::DeferredContext::DeferredContext()
+{
+	ResetState(m_state);
+	m_maxDraws = 0;
+	m_maxConstants = 0;
+	m_maxUsedBuffers = 0;
+	m_maxMappedBuffers = 0;
+}
+
+SoftwareRendererClass::DeferredContext::~DeferredContext()
+{
+	m_staging.Shutdown();
+}
+
+//Allocates the memory the constant buffers are mapped to.
+bool SoftwareRendererClass::DeferredContext::Initialize()
+{
+	return m_staging.Initialize(SOFTWARE_DEFERRED_STAGING);
+}
+
+/*
+ *	MapBuffer()
+ *	brief: Gives memory of the context to write a constant buffer. The draws recorded after it read that content,
+ *		   without touching the buffer until the list is executed. A buffer mapped again in the same list gets the
+ *		   same memory.
+ *	return: The pointer to write to, or null for the buffers that aren't constant buffers, or when the list has
+ *			mapped more than SOFTWARE_DEFERRED_STAGING bytes of them.
+ */
+void* SoftwareRendererClass::DeferredContext::MapBuffer(RenderBuffer* buffer)
+{
+	SoftwareBuffer* softwareBuffer = (SoftwareBuffer*)buffer;
+	unsigned char* content;
+
+	if (softwareBuffer->desc.bindType != BUFFER_BIND_CONSTANT)
+	{
+		return nullptr;
+	}
+
+	//A list maps few buffers, so they are just searched.
+	for (unsigned int i = 0; i < m_mappedConstants.size(); i++)
+	{
+		if (m_mappedConstants[i].first == softwareBuffer)
+		{
+			return m_mappedConstants[i].second;
+		}
+	}
+
+	content = (unsigned char*)m_staging.Allocate(softwareBuffer->desc.byteWidth, 16);
+	if (!content)
+	{
+		return nullptr;
+	}
+	m_mappedConstants.push_back(std::make_pair(softwareBuffer, content));
+
+	return content;
+}
+
+void SoftwareRendererClass::DeferredContext::UnmapBuffer(RenderBuffer* /*buffer*/)
+{
+}
+
+void SoftwareRendererClass::DeferredContext::SetVertexBuffer(unsigned int slot, RenderBuffer* buffer,
+															 unsigned int stride, unsigned int offset)
+{
+	if (slot >= SOFTWARE_MAX_VERTEX_SLOTS)
+	{
+		return;
+	}
+
+	m_state.vertexBuffers[slot] = (SoftwareBuffer*)buffer;
+	m_state.vertexStrides[slot] = stride;
+	m_state.vertexOffsets[slot] = offset;
+	if (buffer && (m_recording.usedBuffers.empty() || m_recording.usedBuffers.back() != (SoftwareBuffer*)buffer))
+	{
+		m_recording.usedBuffers.push_back((SoftwareBuffer*)buffer);
+	}
+}
+
+void SoftwareRendererClass::DeferredContext::SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset)
+{
+	m_state.indexBuffer = (SoftwareBuffer*)buffer;
+	m_state.indexFormat = format;
+	m_state.indexOffset = offset;
+	if (buffer && (m_recording.usedBuffers.empty() || m_recording.usedBuffers.back() != (SoftwareBuffer*)buffer))
+	{
+		m_recording.usedBuffers.push_back((SoftwareBuffer*)buffer);
+	}
+}
+
+void SoftwareRendererClass::DeferredContext::SetPrimitiveTopology(PrimitiveTopology /*topology*/)
+{
+}
+
+void SoftwareRendererClass::DeferredContext::SetConstantBuffer(unsigned int slot, RenderBuffer* buffer)
+{
+	if (slot >= SOFTWARE_MAX_CONSTANT_BUFFERS)
+	{
+		return;
+	}
+
+	m_state.constantBuffers[slot] = (SoftwareBuffer*)buffer;
+	m_state.constantRanges[slot] = NO_CONSTANTS;
+}
+
+void SoftwareRendererClass::DeferredContext::SetConstantRange(unsigned int slot, unsigned int offset,
+															  unsigned int byteSize)
+{
+	SetStateConstantRange(m_state, slot, offset, byteSize);
+}
+
+void SoftwareRendererClass::DeferredContext::SetShader(RenderProgram* shader)
+{
+	m_state.shader = (SoftwareShader*)shader;
+}
+
+void SoftwareRendererClass::DeferredContext::DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex)
+{
+	DrawIndexedInstanced(indexCount, 1, startIndex, baseVertex, 0);
+}
+
+void SoftwareRendererClass::DeferredContext::DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount,
+																  unsigned int startIndex, int baseVertex,
+																  unsigned int startInstance)
+{
+	const unsigned char* content;
+	DrawCommand draw;
+
+	if (!BuildDraw(m_state, indexCount, instanceCount, startIndex, baseVertex, startInstance, draw))
+	{
+		return;
+	}
+
+	//Copy the constant buffers with what was mapped in this list, or else what they have now.
+	for (unsigned int i = 0; i < SOFTWARE_MAX_CONSTANT_BUFFERS; i++)
+	{
+		if (m_state.constantBuffers[i])
+		{
+			content = m_state.constantBuffers[i]->data;
+			for (unsigned int j = 0; j < m_mappedConstants.size(); j++)
+			{
+				if (m_mappedConstants[j].first == m_state.constantBuffers[i])
+				{
+					content = m_mappedConstants[j].second;
+					break;
+				}
+			}
+
+			draw.constantOffset[i] = (unsigned int)m_recording.constants.size();
+			m_recording.constants.insert(m_recording.constants.end(), content,
+										 content + m_state.constantBuffers[i]->desc.byteWidth);
+		}
+		else if (m_state.constantRanges[i] != NO_CONSTANTS)
+		{
+			draw.constantOffset[i] = m_state.constantRanges[i] | RING_CONSTANTS;
+		}
+		else
+		{
+			draw.constantOffset[i] = NO_CONSTANTS;
+		}
+	}
+
+	m_recording.draws.push_back(draw);
+}
+
+/*
+ *	Finish()
+ *	brief: Moves what was recorded into an empty command list, adding the last content of every mapped constant
+ *		   buffer. The context keeps the memory of the empty list to record the next one.
+ */
+void SoftwareRendererClass::DeferredContext::Finish(CommandList& commandList)
+{
+	for (unsigned int i = 0; i < m_mappedConstants.size(); i++)
+	{
+		SoftwareBuffer* buffer = m_mappedConstants[i].first;
+
+		m_recording.mappedBuffers.push_back(std::make_pair(buffer, (unsigned int)m_recording.constants.size()));
+		m_recording.constants.insert(m_recording.constants.end(), m_mappedConstants[i].second,
+									 m_mappedConstants[i].second + buffer->desc.byteWidth);
+	}
+	m_mappedConstants.clear();
+	m_staging.Reset();
+
+	m_maxDraws = std::max(m_maxDraws, m_recording.draws.size());
+	m_maxConstants = std::max(m_maxConstants, m_recording.constants.size());
+	m_maxUsedBuffers = std::max(m_maxUsedBuffers, m_recording.usedBuffers.size());
+	m_maxMappedBuffers = std::max(m_maxMappedBuffers, m_recording.mappedBuffers.size());
+
+	std::swap(commandList, m_recording);
+	ResetState(m_state);
+
+	//The memory comes from whichever list was released, so it can be smaller than what this context records, and
+	//the next list would grow it draw by draw. Every list ends up as large as the largest one and stops allocating.
+	m_recording.draws.reserve(m_maxDraws);
+	m_recording.constants.reserve(m_maxConstants);
+	m_recording.usedBuffers.reserve(m_maxUsedBuffers);
+	m_recording.mappedBuffers.reserve(m_maxMappedBuffers);
+}
@@ -0,0 +1,379 @@
+#pragma once
+
+#ifndef SOFTWARE_RENDERER
+#define SOFTWARE_RENDERER
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "Allocators.h"
+#include "RasterizerKernel.h"
+#include "RenderDevice.h"
+#include "SoftwareShaders.h"
+#include "ThreadPool.h"
+#include "VertexProcessor.h"
+#include <mutex>
+#include <vector>
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const int		   SOFTWARE_TILE_SIZE = 64;				//Width and height in pixels of the tiles triangles get binned into.
+const int		   SOFTWARE_TILE_BLOCKS = (SOFTWARE_TILE_SIZE / RASTER_BLOCK_SIZE) * (SOFTWARE_TILE_SIZE / RASTER_BLOCK_SIZE);
+const int		   SOFTWARE_GUARD_BAND = 8192;			//Width in pixels of the area triangles are allowed to cover before clipping.
+const unsigned int SOFTWARE_MAX_VERTEX_SLOTS = 4;
+const unsigned int SOFTWARE_MAX_CONSTANT_BUFFERS = 4;
+const unsigned int SOFTWARE_MAX_INPUT_ELEMENTS = 8;
+const unsigned int SOFTWARE_VERTEX_BATCH = 1024;		//Vertices shaded by one thread at a time.
+const unsigned int SOFTWARE_TRIANGLE_BATCH = 2048;		//Triangles set up and binned by one thread at a time.
+const size_t	   SOFTWARE_DEFERRED_STAGING = 64 * 1024;	//Bytes of constant buffers a command list can map.
+const unsigned int SOFTWARE_CONSTANT_ALIGNMENT = 16;		//Of every block of the constant ring, for aligned loads.
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//What the last frame rasterized and how much of it the depth bounds of the tiles and blocks skipped.
+struct SoftwareFrameStatistics
+{
+	unsigned int	   triangles;				//Set up and binned, after clipping and culling.
+	unsigned int	   tileTriangles;			//Triangles binned into a tile, once per tile.
+	unsigned int	   tileTrianglesRejected;	//Skipped whole, behind everything drawn in the tile.
+	unsigned int	   blocks;					//8x8 blocks of the triangles with covered pixels.
+	unsigned int	   blocksRejected;			//Skipped before the depth test, behind everything drawn in the block.
+	unsigned int	   blocksAccepted;			//Fully covered and in front of the whole block, so no rescan after.
+	unsigned long long pixelsCovered;			//Covered by the triangles rasterized, in rejected blocks or not.
+	unsigned long long pixelsShaded;			//Passed the depth test, shaded and written.
+	float			   depthComplexity;			//Pixels covered per pixel of the screen. Less with the tiles
+												//rejecting triangles, since they aren't rasterized.
+	float			   overdraw;				//Pixels shaded per pixel of the screen.
+};
+
+/*
+ *	SoftwareRendererClass
+ *	brief: A render device that rasterizes on the CPU into an RGBA8 color buffer and a float depth buffer in memory.
+ *		   Draws are only recorded while the scene is built. EndScene() runs the frame in three parallel steps:
+ *		   vertex shading in batches, triangle setup and binning into screen tiles, and finally every tile is
+ *		   rasterized by one thread in the same order the triangles were drawn.
+ *		   Every 8x8 block keeps the nearest and farthest depth in it, and every tile the farthest, updated as they
+ *		   are written. A tile skips the triangles behind its farthest depth before rasterizing them, and a block
+ *		   the ones behind its own before depth testing and shading a single pixel.
+ *		   Render targets are drawn exactly like the screen, and a readback takes the image of a target by handing
+ *		   its color buffer over to the ring in exchange for a free one, without copying a pixel.
+ */
+class SoftwareRendererClass : public RenderDevice
+{
+private:
+	//Every depth inside a block of the depth buffer is between these.
+	struct DepthBounds
+	{
+		float minDepth;
+		float maxDepth;
+	};
+
+	//What is behind a RenderTarget handle for this backend, and the screen.
+	struct SoftwareTarget
+	{
+		RenderTargetDesc		 desc;
+		unsigned int*			 colorBuffer;
+		float*					 depthBuffer;
+		std::vector<DepthBounds> blockDepth;		//The depth hierarchy: bounds of every block of the depth buffer,
+		std::vector<float>		 tileMaxDepth;		//and the farthest depth of every tile.
+		bool					 depthBoundsValid;	//False after frames drawn without them, until they are rebuilt.
+		const unsigned int*		 readbackImage;		//Where its image is since a readback took it, until a frame is
+													//drawn. Null when it is in colorBuffer.
+	};
+
+	//What is behind a RenderReadback handle: a ring of images the target hands its color buffer over to.
+	struct SoftwareReadback
+	{
+		SoftwareTarget*					target;
+		std::vector<unsigned int*>		images;
+		std::vector<unsigned long long> tags;
+		unsigned int					first;		//The oldest image waiting to be mapped.
+		unsigned int					count;
+	};
+
+	//What is behind a RenderBuffer handle for this backend.
+	struct SoftwareBuffer
+	{
+		BufferDesc	   desc;
+		unsigned char* data;
+		unsigned int   lastFrameUsed;	//Frame that last drew from the buffer, so its memory isn't reused before EndScene().
+	};
+
+	//What is behind a RenderProgram handle for this backend.
+	struct SoftwareShader
+	{
+		const SoftwareShaderProgram* program;
+		InputElementDesc			 elements[SOFTWARE_MAX_INPUT_ELEMENTS];
+		unsigned int				 numElements;
+	};
+
+	struct DrawCommand
+	{
+		const SoftwareShader* shader;
+		const unsigned char*  vertexData[SOFTWARE_MAX_VERTEX_SLOTS];
+		unsigned int		  vertexStride[SOFTWARE_MAX_VERTEX_SLOTS];
+		unsigned int		  vertexCount;			//Per instance.
+		unsigned int		  instanceCount;
+		unsigned int		  startInstance;
+		const unsigned char*  indexData;
+		IndexFormat			  indexFormat;
+		unsigned int		  triangleCount;		//Per instance.
+		int					  baseVertex;
+		unsigned int		  constantOffset[SOFTWARE_MAX_CONSTANT_BUFFERS];	//In the frame constants, or in the
+																				//ring with RING_CONSTANTS set.
+		unsigned int		  firstShadedVertex;
+	};
+
+	//Pipeline state bound to the device or to a deferred context.
+	struct BoundState
+	{
+		SoftwareBuffer* vertexBuffers[SOFTWARE_MAX_VERTEX_SLOTS];
+		unsigned int	vertexStrides[SOFTWARE_MAX_VERTEX_SLOTS];
+		unsigned int	vertexOffsets[SOFTWARE_MAX_VERTEX_SLOTS];
+		SoftwareBuffer* indexBuffer;
+		IndexFormat		indexFormat;
+		unsigned int	indexOffset;
+		SoftwareBuffer* constantBuffers[SOFTWARE_MAX_CONSTANT_BUFFERS];
+		unsigned int	constantRanges[SOFTWARE_MAX_CONSTANT_BUFFERS];	//Offset in the ring of the slots bound to it.
+		SoftwareShader* shader;
+	};
+
+	//What is behind a RenderCommandList handle: draws ready to be appended to the frame, like the device records them.
+	struct CommandList
+	{
+		std::vector<DrawCommand>	 draws;			//Constant offsets relative to the constants of the list.
+		std::vector<unsigned char>	 constants;
+		std::vector<SoftwareBuffer*> usedBuffers;	//Vertex and index buffers the draws read.
+		std::vector<std::pair<SoftwareBuffer*, unsigned int> > mappedBuffers;	//Constant buffers mapped, and where
+																				//their last content is in constants.
+	};
+
+	/*
+	 *	DeferredContext
+	 *	brief: Records draws on another thread exactly as the device would, validating them and copying their
+	 *		   constants, so executing the list only appends it to the frame.
+	 */
+	class DeferredContext final : public RenderContext
+	{
+	public:
+		DeferredContext();
+		~DeferredContext();
+
+		bool Initialize();
+
+		void* MapBuffer(RenderBuffer* buffer) override;
+		void UnmapBuffer(RenderBuffer* buffer) override;
+
+		void SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset) override;
+		void SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset) override;
+		void SetPrimitiveTopology(PrimitiveTopology topology) override;
+		void SetConstantBuffer(unsigned int slot, RenderBuffer* buffer) override;
+		void SetShader(RenderProgram* shader) override;
+		void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+		void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex,
+								  int baseVertex, unsigned int startInstance) override;
+		void SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize) override;
+
+		void Finish(CommandList& commandList);
+
+	private:
+		BoundState			 m_state;
+		CommandList			 m_recording;
+		size_t				 m_maxDraws, m_maxConstants, m_maxUsedBuffers, m_maxMappedBuffers;	//Largest list recorded.
+		LinearAllocatorClass m_staging;			//Holds the content mapped in this list.
+		std::vector<std::pair<SoftwareBuffer*, unsigned char*> > m_mappedConstants;
+	};
+
+	struct ShadedVertex
+	{
+		XMFLOAT4	 position;
+		float		 varyings[SOFTWARE_MAX_VARYINGS];
+		unsigned int outcode;							//CLIP_OUTCODE_ bits against the near, far and guard band planes.
+	};
+
+	//A triangle ready to be rasterized: edge functions in fixed point and the values to interpolate.
+	struct RasterTriangle
+	{
+		RasterEdges					 edges;
+		int							 minX, minY, maxX, maxY;
+		float						 invArea;
+		float						 z[3];
+		float						 minZ, maxZ;
+		float						 depthStepX, depthStepY;				//Of the depth per pixel.
+		float						 depthSlack;							//Margin of the depth bounds.
+		float						 invW[3];
+		float						 varyings[3][SOFTWARE_MAX_VARYINGS];	//Already divided by w.
+		const SoftwareShaderProgram* program;
+	};
+
+	//Vertices and triangles of a draw are numbered instance after instance, so a batch can span several instances.
+	struct VertexBatch
+	{
+		unsigned int drawIndex;
+		unsigned int firstVertex;
+		unsigned int vertexCount;
+	};
+
+	struct TriangleBatch
+	{
+		unsigned int							drawIndex;
+		unsigned int							pass;			//RENDER_MAX_PASSES outside of every pass.
+		unsigned int							firstTriangle;
+		unsigned int							triangleCount;
+		std::vector<RasterTriangle>				triangles;
+
+		//Triangles of this batch touching each tile, the ones of tile i from binStarts[i] to binStarts[i + 1]. Flat,
+		//so the memory kept between frames fits whatever tiles the triangles land on.
+		std::vector<unsigned int>				binStarts;
+		std::vector<unsigned int>				binTriangles;
+	};
+
+	//The draws recorded between BeginPass() and EndPass().
+	struct PassRange
+	{
+		const char*  name;
+		unsigned int firstDraw;
+		unsigned int endDraw;
+	};
+
+public:
+	SoftwareRendererClass();
+	SoftwareRendererClass(const SoftwareRendererClass&);
+	~SoftwareRendererClass();
+
+	bool Initialize(int screenWidth, int screenHeight, bool vsync, HWND hwnd, bool fullscreen,
+					float screenFar, float screenNear) override;
+	void Shutdown() override;
+
+	void BeginScene(float red, float green, float blue, float alpha) override;
+	void EndScene() override;
+
+	bool CreateBuffer(const BufferDesc& desc, const void* initialData, RenderBuffer** buffer) override;
+	void ReleaseBuffer(RenderBuffer* buffer) override;
+	void* MapBuffer(RenderBuffer* buffer) override;
+	void UnmapBuffer(RenderBuffer* buffer) override;
+
+	bool CreateShader(const ShaderDesc& desc, RenderProgram** shader) override;
+	void ReleaseShader(RenderProgram* shader) override;
+	bool CreateShaders(const ShaderDesc* descs, unsigned int count, RenderProgram** shaders) override;
+
+	void SetVertexBuffer(unsigned int slot, RenderBuffer* buffer, unsigned int stride, unsigned int offset) override;
+	void SetIndexBuffer(RenderBuffer* buffer, IndexFormat format, unsigned int offset) override;
+	void SetPrimitiveTopology(PrimitiveTopology topology) override;
+	void SetConstantBuffer(unsigned int slot, RenderBuffer* buffer) override;
+	void SetShader(RenderProgram* shader) override;
+	void DrawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) override;
+	void DrawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex,
+							  int baseVertex, unsigned int startInstance) override;
+	void SetConstantRange(unsigned int slot, unsigned int offset, unsigned int byteSize) override;
+
+	void* MapConstantRing(unsigned int byteSize, unsigned int count, unsigned int& offset, unsigned int& stride) override;
+	void UnmapConstantRing() override;
+
+	bool CreateDeferredContext(RenderContext** context) override;
+	void ReleaseDeferredContext(RenderContext* context) override;
+	bool FinishCommandList(RenderContext* context, RenderCommandList** commandList) override;
+	void ExecuteCommandList(RenderCommandList* commandList) override;
+	void ReleaseCommandList(RenderCommandList* commandList) override;
+
+	bool CreateRenderTarget(const RenderTargetDesc& desc, RenderTarget** target) override;
+	void ReleaseRenderTarget(RenderTarget* target) override;
+	void SetRenderTarget(RenderTarget* target) override;
+
+	bool CreateReadback(RenderTarget* target, unsigned int depth, RenderReadback** readback) override;
+	void ReleaseReadback(RenderReadback* readback) override;
+	bool QueueReadback(RenderReadback* readback, unsigned long long tag) override;
+	bool MapReadback(RenderReadback* readback, bool wait, ReadbackImage& image) override;
+	void UnmapReadback(RenderReadback* readback) override;
+
+	void BeginPass(const char* name) override;
+	void EndPass() override;
+
+	void GetVideoCardInfo(char* cardName, int& memory) override;
+
+	void SetBlockShading(bool enabled);
+	void SetHierarchicalDepth(bool enabled);
+	void GetFrameStatistics(SoftwareFrameStatistics& statistics);
+
+	//Access to the image of the last finished frame in the render target set.
+	const unsigned int* GetColorBuffer();
+	const float* GetDepthBuffer();
+	int GetWidth();
+	int GetHeight();
+
+private:
+	bool InitializeTarget(SoftwareTarget& target, const RenderTargetDesc& desc);
+	void ShutdownTarget(SoftwareTarget& target);
+	void BindTarget(SoftwareTarget* target);
+	void RestoreTargetImage(SoftwareTarget& target);
+	void FetchElement(const DrawCommand& draw, const InputElementDesc& element, unsigned int vertex,
+					  unsigned int instance, XMFLOAT4& value);
+	void ShadeVertices(const VertexBatch& batch);
+	void SetupTriangles(TriangleBatch& batch);
+	void BinTriangles(TriangleBatch& batch);
+	void ClipTriangle(TriangleBatch& batch, const ShadedVertex* v0, const ShadedVertex* v1, const ShadedVertex* v2,
+					  const SoftwareShaderProgram* program);
+	void EmitTriangle(TriangleBatch& batch, const ShadedVertex* v0, const ShadedVertex* v1, const ShadedVertex* v2,
+					  const SoftwareShaderProgram* program);
+	void RasterizeTile(unsigned int tileIndex);
+	void AddFramePasses(double start, double end);
+	bool RasterizeTriangle(const RasterTriangle& triangle, const unsigned char* const* constantBuffers, int tileMinX,
+						   int tileMinY, int tileMaxX, int tileMaxY, SoftwareFrameStatistics& statistics);
+	void UpdateBlockBounds(int blockX, int blockY);
+	void UpdateTileBounds(unsigned int tileIndex);
+	void ResolveConstantBuffers(const DrawCommand& draw, const unsigned char** constantBuffers);
+	void RetireBufferMemory(SoftwareBuffer* buffer);
+
+	static void ResetState(BoundState& state);
+	static void SetStateConstantRange(BoundState& state, unsigned int slot, unsigned int offset, unsigned int byteSize);
+	static bool BuildDraw(const BoundState& state, unsigned int indexCount, unsigned int instanceCount,
+						  unsigned int startIndex, int baseVertex, unsigned int startInstance, DrawCommand& draw);
+
+private:
+	SoftwareTarget				m_screen;
+	SoftwareTarget*				m_target;			//Drawn into. Its sizes and buffers are copied below.
+	int							m_width, m_height;
+	int							m_tilesX, m_tilesY;
+	int							m_blocksX, m_blocksY;
+	float						m_guardBandX, m_guardBandY;
+	unsigned int*				m_colorBuffer;
+	float*						m_depthBuffer;
+	DepthBounds*				m_blockDepth;
+	float*						m_tileMaxDepth;
+	ThreadPoolClass*			m_ThreadPool;
+	bool						m_blockShading;
+	bool						m_hierarchicalDepth;
+
+	BoundState					m_state;
+
+	//Frame being recorded.
+	unsigned int				m_frameIndex;
+	bool						m_clearPending;
+	unsigned int				m_clearColor;
+	std::vector<DrawCommand>	m_draws;
+	std::vector<unsigned char>	m_frameConstants;
+	unsigned char*				m_constantRing;		//The draws read it in place, so it is only reused after EndScene().
+	unsigned int				m_constantRingHead;
+	std::vector<unsigned char*> m_retiredMemory;
+	std::vector<ShadedVertex>	m_shadedVertices;
+	std::vector<VertexBatch>	m_vertexBatches;
+	std::vector<TriangleBatch>	m_triangleBatches;
+	unsigned int				m_triangleBatchCount;
+	std::vector<SoftwareFrameStatistics> m_tileStatistics;
+	SoftwareFrameStatistics		m_statistics;
+
+	//Passes of the frame being recorded, and the pixels every tile shaded in each, RENDER_MAX_PASSES per tile.
+	PassRange					m_passes[RENDER_MAX_PASSES];
+	unsigned int				m_passCount;
+	bool						m_passOpen;
+	std::vector<unsigned long long> m_tilePassPixels;
+
+	//Released command lists, kept with their memory for the next ones. Lists are finished on any thread.
+	std::mutex					m_commandListMutex;
+	std::vector<CommandList*>	m_freeCommandLists;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "SoftwareShaders.h"
+#include "ShaderPermutation.h"
+#include <algorithm>
+#include <cstring>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//The fog constants, laid out like FogBuffer in the HLSL files.
+struct SoftwareFogBuffer
+{
+	XMFLOAT4 fogColor;
+	float	 fogStart;
+	float	 fogEnd;
+	float	 fogPadding[2];
+};
+
+/************************************************************************/
+/* COLOR SHADER                                                         */
+/* Mirrors ColorVS.hlsl and ColorPS.hlsl. They are templates on the     */
+/* permutation, so the checks of the features are resolved when every  */
+/* variant is compiled, the same as the #if of the HLSL.               */
+/************************************************************************/
+
+/*
+ *	ColorVertexShader()
+ *	brief: Passes the color down to the pixel shader. The position times the world-view-projection matrix is done
+ *		   by the renderer for the whole batch of vertices, see positionMatrixBuffer.
+ *		   Instanced, it tints the vertex color with the color of the instance; the world matrix of the instance
+ *		   is applied by the renderer too, see instanceMatrixElement.
+ *		   With fog, it computes how much of the color is left at the view depth of the vertex.
+ */
+template <unsigned int Permutation>
+static void ColorVertexShader(const XMFLOAT4* input, const unsigned char* const* constantBuffers,
+							  XMFLOAT4& position, float* varyings)
+{
+	const SoftwareFogBuffer* fog;
+
+	if (Permutation & SHADER_FEATURE_INSTANCING)
+	{
+		//Inputs 2 to 5 are the rows of the world matrix and 6 the instance color.
+		varyings[0] = input[1].x * input[6].x;
+		varyings[1] = input[1].y * input[6].y;
+		varyings[2] = input[1].z * input[6].z;
+		varyings[3] = input[1].w * input[6].w;
+	}
+	else
+	{
+		//Store the input color for the pixel shader to use.
+		varyings[0] = input[1].x;
+		varyings[1] = input[1].y;
+		varyings[2] = input[1].z;
+		varyings[3] = input[1].w;
+	}
+
+	if (Permutation & SHADER_FEATURE_FOG)
+	{
+		//The w of a perspective projection is the view depth. 1 keeps the whole color and 0 is all fog.
+		fog = (const SoftwareFogBuffer*)constantBuffers[1];
+		varyings[4] = std::min(std::max((fog->fogEnd - position.w) / (fog->fogEnd - fog->fogStart), 0.0f), 1.0f);
+	}
+}
+
+template <unsigned int Permutation>
+static void ColorPixelShader(const float* varyings, const unsigned char* const* constantBuffers, XMFLOAT4& color)
+{
+	const SoftwareFogBuffer* fog;
+
+	if (Permutation & SHADER_FEATURE_FOG)
+	{
+		fog = (const SoftwareFogBuffer*)constantBuffers[1];
+		color.x = fog->fogColor.x + (varyings[0] - fog->fogColor.x) * varyings[4];
+		color.y = fog->fogColor.y + (varyings[1] - fog->fogColor.y) * varyings[4];
+		color.z = fog->fogColor.z + (varyings[2] - fog->fogColor.z) * varyings[4];
+		color.w = fog->fogColor.w + (varyings[3] - fog->fogColor.w) * varyings[4];
+	}
+	else
+	{
+		color = XMFLOAT4(varyings[0], varyings[1], varyings[2], varyings[3]);
+	}
+}
+
+//ColorPixelShader() on a block, by the SIMD kernels. Each permutation calls its own kernel, so fog is chosen with the
+//program of the draw and not for every block.
+template <unsigned int Permutation>
+static unsigned int ColorBlockShader(const PixelPlane* planes, unsigned long long mask,
+									 const unsigned char* const* constantBuffers, const PixelBlockTarget& target)
+{
+	const SoftwareFogBuffer* fog;
+
+	if (Permutation & SHADER_FEATURE_FOG)
+	{
+		fog = (const SoftwareFogBuffer*)constantBuffers[1];
+		return ShadeFoggedColorBlock(planes, mask, &fog->fogColor.x, target);
+	}
+	return ShadeColorBlock(planes, mask, target);
+}
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+
+//Every permutation of the pair. Fog adds a varying and instancing reads the world matrix from elements 2 to 5.
+static const SoftwareShaderProgram g_softwareShaderPrograms[] =
+{
+	{ "ColorVertexShader", "ColorPixelShader", 0,
+	  ColorVertexShader<0>, ColorPixelShader<0>, ColorBlockShader<0>, 4, 0, SOFTWARE_NO_INSTANCE_MATRIX },
+	{ "ColorVertexShader", "ColorPixelShader", SHADER_FEATURE_INSTANCING,
+	  ColorVertexShader<SHADER_FEATURE_INSTANCING>, ColorPixelShader<SHADER_FEATURE_INSTANCING>,
+	  ColorBlockShader<SHADER_FEATURE_INSTANCING>, 4, 0, 2 },
+	{ "ColorVertexShader", "ColorPixelShader", SHADER_FEATURE_FOG,
+	  ColorVertexShader<SHADER_FEATURE_FOG>, ColorPixelShader<SHADER_FEATURE_FOG>, ColorBlockShader<SHADER_FEATURE_FOG>,
+	  5, 0, SOFTWARE_NO_INSTANCE_MATRIX },
+	{ "ColorVertexShader", "ColorPixelShader", SHADER_FEATURE_INSTANCING | SHADER_FEATURE_FOG,
+	  ColorVertexShader<SHADER_FEATURE_INSTANCING | SHADER_FEATURE_FOG>,
+	  ColorPixelShader<SHADER_FEATURE_INSTANCING | SHADER_FEATURE_FOG>,
+	  ColorBlockShader<SHADER_FEATURE_INSTANCING | SHADER_FEATURE_FOG>, 5, 0, 2 }
+};
+
+/*
+ *	FindSoftwareShaderProgram()
+ *	brief: Looks for the CPU implementation of the HLSL vertex and pixel shader pair with those entry points.
+ *	param permutation: The ShaderFeature bits of the variant.
+ *	return: The program, or null if there is no CPU version of that variant of the pair.
+ */
+const SoftwareShaderProgram* FindSoftwareShaderProgram(const char* vsEntryPoint, const char* psEntryPoint,
+													   unsigned int permutation)
+{
+	unsigned int programCount = sizeof(g_softwareShaderPrograms) / sizeof(g_softwareShaderPrograms[0]);
+
+	for (unsigned int i = 0; i < programCount; i++)
+	{
+		if (g_softwareShaderPrograms[i].permutation == permutation &&
+			strcmp(g_softwareShaderPrograms[i].vsEntryPoint, vsEntryPoint) == 0 &&
+			strcmp(g_softwareShaderPrograms[i].psEntryPoint, psEntryPoint) == 0)
+		{
+			return &g_softwareShaderPrograms[i];
+		}
+	}
+
+	return nullptr;
+}
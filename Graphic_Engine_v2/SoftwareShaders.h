@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef SOFTWARE_SHADERS
+#define SOFTWARE_SHADERS
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "PixelKernel.h"
+#include <DirectXMath.h>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+const unsigned int SOFTWARE_MAX_VARYINGS = 8;	//Floats a vertex shader can pass down to the pixel shader.
+const int		   SOFTWARE_NO_POSITION_MATRIX = -1;
+const int		   SOFTWARE_NO_INSTANCE_MATRIX = -1;
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+/*CPU version of a vertex shader. It receives the vertex attributes in the order of the input layout (missing
+  components filled like D3D does, with w = 1), the bound constant buffers, and writes the clip space position
+  plus the values to interpolate. Programs with a position matrix get the position already transformed by the
+  renderer for the whole batch, and can read it but leave it alone.*/
+typedef void (*SoftwareVertexShader)(const XMFLOAT4* input, const unsigned char* const* constantBuffers,
+									 XMFLOAT4& position, float* varyings);
+
+//CPU version of a pixel shader. It receives the interpolated values and the bound constant buffers and returns the
+//color.
+typedef void (*SoftwarePixelShader)(const float* varyings, const unsigned char* const* constantBuffers, XMFLOAT4& color);
+
+/*The same pixel shader run on the covered pixels of a whole 8x8 block in SIMD quads, depth test and write included.
+  It receives the planes of the triangle in the PIXEL_PLANE_ order and returns how many pixels it wrote.*/
+typedef unsigned int (*SoftwareBlockShader)(const PixelPlane* planes, unsigned long long mask,
+											const unsigned char* const* constantBuffers, const PixelBlockTarget& target);
+
+//A variant of an HLSL vertex and pixel shader pair, compiled for the ShaderFeature bits of its permutation.
+struct SoftwareShaderProgram
+{
+	const char*			 vsEntryPoint;
+	const char*			 psEntryPoint;
+	unsigned int		 permutation;
+	SoftwareVertexShader vertexShader;
+	SoftwarePixelShader	 pixelShader;
+	SoftwareBlockShader	 blockShader;			//Null if the pixel shader only has the per pixel version.
+	unsigned int		 varyingCount;
+	int					 positionMatrixBuffer;	//Constant buffer starting with the transposed matrix that takes the first
+												//input element to clip space, or SOFTWARE_NO_POSITION_MATRIX.
+	int					 instanceMatrixElement;	//First of the four per instance input elements with the rows of a world
+												//matrix applied before that one, or SOFTWARE_NO_INSTANCE_MATRIX.
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+const SoftwareShaderProgram* FindSoftwareShaderProgram(const char* vsEntryPoint, const char* psEntryPoint,
+													   unsigned int permutation);
+
+#endif
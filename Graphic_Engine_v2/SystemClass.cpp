@@ -46,12 +46,25 @@ bool SystemClass::Initialize()
 	}
 
 	//Initialize the graphics object.
-		rightInit = m_Graphics->Initialize(screenWidth, screenHeight, m_hwnd);
+		rightInit = m_Graphics->Initialize(screenWidth, screenHeight, m_hwnd, RENDER_BACKEND, MODEL_FILENAME);
 	if (!rightInit)
 	{
 		return false;
 	}
 
+	//Name the row of this thread in the profiler timeline.
+	ProfilerClass::SetThreadName("window");
+
+	//Move the frames to their own threads, so rendering and handling the input don't wait for each other.
+	if (FRAME_PIPELINING)
+	{
+		rightInit = m_Graphics->StartPipeline();
+		if (!rightInit)
+		{
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -65,6 +78,15 @@ void SystemClass::Shutdown()
 	//Cleanup of the graphics object.
 	if (m_Graphics)
 	{
+		//Keep the timeline and the times of the zones of the last frames.
+#if PROFILER_ENABLED
+		if (m_Graphics->GetProfiler())
+		{
+			m_Graphics->GetProfiler()->WriteChromeTrace(PROFILER_TRACE_FILE);
+			m_Graphics->GetProfiler()->WriteReport(PROFILER_REPORT_FILE);
+		}
+#endif
+
 		m_Graphics->Shutdown();
 		delete m_Graphics;
 		m_Graphics = nullptr;
@@ -85,6 +107,7 @@ void SystemClass::Shutdown()
 /*
  *	Run()
  *	brief: This function runs the main loop of the application. Here the Frame() function is called each loop to render the changes.
+ *		   When the frames are pipelined on other threads, the loop sleeps until a message comes instead of spinning.
  */
 void SystemClass::Run()
 {
@@ -103,6 +126,10 @@ void SystemClass::Run()
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
+		else if (FRAME_PIPELINING)
+		{
+			MsgWaitForMultipleObjects(0, NULL, FALSE, MESSAGE_WAIT_TIME, QS_ALLINPUT);
+		}
 
 		//If the close signal come from windows, time to close the application.
 		if (msg.message == WM_QUIT)
@@ -130,6 +157,8 @@ bool SystemClass::Frame()
 {
 	bool frameResult = false; //The result of the graphics object Frame() function.
 
+	PROFILE_ZONE("SystemClass::Frame");
+
 	//Check if the user pressed escape and wants to quit the application.
 	if (m_Input->isKeyDown(VK_ESCAPE))
 	{
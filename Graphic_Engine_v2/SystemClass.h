@@ -62,5 +62,6 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT umsg, WPARAM wparam, LPARAM lpar
 /* GLOBALS                                                              */
 /************************************************************************/
 static SystemClass* ApplicationHandle = 0;
+static const DWORD MESSAGE_WAIT_TIME = 10;		//Milliseconds the loop sleeps waiting for a message while the pipeline makes the frames.
 
 #endif
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "ThreadPool.h"
+
+
+
+ThreadPoolClass::ThreadPoolClass()
+{
+	m_function = nullptr;
+	m_count = 0;
+	m_nextIndex = 0;
+	m_busyWorkers = 0;
+	m_generation = 0;
+	m_quit = false;
+}
+
+ThreadPoolClass::ThreadPoolClass(const ThreadPoolClass &)
+{
+}
+
+
+ThreadPoolClass::~ThreadPoolClass()
+{
+}
+
+/*
+ *	Initialize()
+ *	brief: Starts the worker threads.
+ *	param threadCount: How many threads will do the work, counting the caller of ParallelFor(). With 0 it uses
+ *					   one per hardware thread.
+ */
+bool ThreadPoolClass::Initialize(unsigned int threadCount)
+{
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0)
+		{
+			threadCount = 1;
+		}
+	}
+
+	m_quit = false;
+
+	//The calling thread is the first one, so only the rest need to be created.
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		m_threads.push_back(std::thread(&ThreadPoolClass::WorkerThread, this, i));
+	}
+
+	return true;
+}
+
+void ThreadPoolClass::Shutdown()
+{
+	//Wake up every worker telling them to leave and wait for them.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (unsigned int i = 0; i < m_threads.size(); i++)
+	{
+		m_threads[i].join();
+	}
+	m_threads.clear();
+}
+
+/*
+ *	ParallelFor()
+ *	brief: Calls the function once for every index in [0, count) spreading the calls between the threads, and
+ *		   returns when all of them have finished.
+ *	param count: The number of indices.
+ *	param function: What to do for each index. It also receives the index of the thread running it, which is
+ *					always lower than GetThreadCount().
+ */
+void ThreadPoolClass::ParallelFor(unsigned int count, const TaskFunction& function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	//With a single index or no workers there is nothing to split.
+	if (count == 1 || m_threads.empty())
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			function(i, 0);
+		}
+		return;
+	}
+
+	//Publish the new work and wake up the workers.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_function = &function;
+		m_count = count;
+		m_nextIndex = 0;
+		m_busyWorkers = (unsigned int)m_threads.size();
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+
+	//Help with the work instead of just waiting.
+	RunTasks(0);
+
+	//Wait until every worker has run out of indices.
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this] { return m_busyWorkers == 0; });
+	m_function = nullptr;
+}
+
+unsigned int ThreadPoolClass::GetThreadCount()
+{
+	return (unsigned int)m_threads.size() + 1;
+}
+
+void ThreadPoolClass::WorkerThread(unsigned int threadIndex)
+{
+	unsigned long long lastGeneration = 0;
+
+	while (true)
+	{
+		//Sleep until there is new work or the pool is shutting down.
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, lastGeneration] { return m_quit || m_generation != lastGeneration; });
+			if (m_quit)
+			{
+				return;
+			}
+			lastGeneration = m_generation;
+		}
+
+		RunTasks(threadIndex);
+
+		//Tell the caller this worker is done with this round.
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_busyWorkers--;
+			if (m_busyWorkers == 0)
+			{
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+void ThreadPoolClass::RunTasks(unsigned int threadIndex)
+{
+	unsigned int index;
+
+	//Every thread takes the next free index until all of them are taken.
+	index = m_nextIndex.fetch_add(1);
+	while (index < m_count)
+	{
+		(*m_function)(index, threadIndex);
+		index = m_nextIndex.fetch_add(1);
+	}
+}
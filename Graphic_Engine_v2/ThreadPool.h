@@ -0,0 +1,54 @@
+#pragma once
+
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ *	ThreadPoolClass
+ *	brief: A fixed set of worker threads that split ranges of work between them. The thread that calls
+ *		   ParallelFor() works too, so a pool of N threads keeps N cores busy.
+ */
+class ThreadPoolClass
+{
+public:
+	typedef std::function<void(unsigned int index, unsigned int threadIndex)> TaskFunction;
+
+public:
+	ThreadPoolClass();
+	ThreadPoolClass(const ThreadPoolClass&);
+	~ThreadPoolClass();
+
+	bool Initialize(unsigned int threadCount);
+	void Shutdown();
+
+	void ParallelFor(unsigned int count, const TaskFunction& function);
+	unsigned int GetThreadCount();
+
+private:
+	void WorkerThread(unsigned int threadIndex);
+	void RunTasks(unsigned int threadIndex);
+
+private:
+	std::vector<std::thread>  m_threads;
+	std::mutex				  m_mutex;
+	std::condition_variable	  m_wakeCondition;
+	std::condition_variable	  m_doneCondition;
+	const TaskFunction*		  m_function;
+	unsigned int			  m_count;
+	std::atomic<unsigned int> m_nextIndex;
+	unsigned int			  m_busyWorkers;
+	unsigned long long		  m_generation;
+	bool					  m_quit;
+};
+
+#endif
@@ -0,0 +1,320 @@
+#include "VertexProcessor.h"
+#include <cstring>
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//Transforms the positions in [first, count) with a row major matrix (row vectors, like DirectXMath and HLSL).
+typedef void (*TransformFunction)(const XMFLOAT4X4& matrix, const PositionStream& input, const ClipStream& output,
+								  unsigned int first, unsigned int count, float guardBandX, float guardBandY);
+
+/************************************************************************/
+/* KERNELS                                                              */
+/************************************************************************/
+static void TransformScalar(const XMFLOAT4X4& matrix, const PositionStream& input, const ClipStream& output,
+							unsigned int first, unsigned int count, float guardBandX, float guardBandY)
+{
+	float x, y, z, clipX, clipY, clipZ, clipW;
+	unsigned int outcode;
+
+	for (unsigned int i = first; i < count; i++)
+	{
+		x = input.x[i];
+		y = input.y[i];
+		z = input.z[i];
+
+		clipX = x * matrix.m[0][0] + y * matrix.m[1][0] + z * matrix.m[2][0] + matrix.m[3][0];
+		clipY = x * matrix.m[0][1] + y * matrix.m[1][1] + z * matrix.m[2][1] + matrix.m[3][1];
+		clipZ = x * matrix.m[0][2] + y * matrix.m[1][2] + z * matrix.m[2][2] + matrix.m[3][2];
+		clipW = x * matrix.m[0][3] + y * matrix.m[1][3] + z * matrix.m[2][3] + matrix.m[3][3];
+
+		outcode = 0;
+		outcode |= clipZ < 0.0f ? CLIP_OUTCODE_NEAR : 0;
+		outcode |= clipW - clipZ < 0.0f ? CLIP_OUTCODE_FAR : 0;
+		outcode |= clipX + guardBandX * clipW < 0.0f ? CLIP_OUTCODE_LEFT : 0;
+		outcode |= guardBandX * clipW - clipX < 0.0f ? CLIP_OUTCODE_RIGHT : 0;
+		outcode |= clipY + guardBandY * clipW < 0.0f ? CLIP_OUTCODE_BOTTOM : 0;
+		outcode |= guardBandY * clipW - clipY < 0.0f ? CLIP_OUTCODE_TOP : 0;
+
+		output.x[i] = clipX;
+		output.y[i] = clipY;
+		output.z[i] = clipZ;
+		output.w[i] = clipW;
+		output.outcodes[i] = (unsigned char)outcode;
+	}
+}
+
+#ifdef SIMD_X86
+
+//4 vertices at once.
+static void TransformSSE2(const XMFLOAT4X4& matrix, const PositionStream& input, const ClipStream& output,
+						  unsigned int first, unsigned int count, float guardBandX, float guardBandY)
+{
+	__m128 m[4][4];
+	__m128 x, y, z, clipX, clipY, clipZ, clipW, zero, bandX, bandY;
+	__m128i outcode;
+	int packed;
+	unsigned int i;
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			m[row][column] = _mm_set1_ps(matrix.m[row][column]);
+		}
+	}
+	zero = _mm_setzero_ps();
+	bandX = _mm_set1_ps(guardBandX);
+	bandY = _mm_set1_ps(guardBandY);
+
+	for (i = first; i + 4 <= count; i += 4)
+	{
+		x = _mm_loadu_ps(input.x + i);
+		y = _mm_loadu_ps(input.y + i);
+		z = _mm_loadu_ps(input.z + i);
+
+		clipX = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][0]), _mm_mul_ps(y, m[1][0])), _mm_mul_ps(z, m[2][0])), m[3][0]);
+		clipY = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][1]), _mm_mul_ps(y, m[1][1])), _mm_mul_ps(z, m[2][1])), m[3][1]);
+		clipZ = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][2]), _mm_mul_ps(y, m[1][2])), _mm_mul_ps(z, m[2][2])), m[3][2]);
+		clipW = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0][3]), _mm_mul_ps(y, m[1][3])), _mm_mul_ps(z, m[2][3])), m[3][3]);
+
+		_mm_storeu_ps(output.x + i, clipX);
+		_mm_storeu_ps(output.y + i, clipY);
+		_mm_storeu_ps(output.z + i, clipZ);
+		_mm_storeu_ps(output.w + i, clipW);
+
+		//Every comparison gives all ones in the lanes outside its plane; keep the bit of that plane from them.
+		outcode = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(clipZ, zero)), _mm_set1_epi32(CLIP_OUTCODE_NEAR));
+		outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_sub_ps(clipW, clipZ), zero)),
+													  _mm_set1_epi32(CLIP_OUTCODE_FAR)));
+		outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_add_ps(clipX, _mm_mul_ps(bandX, clipW)), zero)),
+													  _mm_set1_epi32(CLIP_OUTCODE_LEFT)));
+		outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_sub_ps(_mm_mul_ps(bandX, clipW), clipX), zero)),
+													  _mm_set1_epi32(CLIP_OUTCODE_RIGHT)));
+		outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_add_ps(clipY, _mm_mul_ps(bandY, clipW)), zero)),
+													  _mm_set1_epi32(CLIP_OUTCODE_BOTTOM)));
+		outcode = _mm_or_si128(outcode, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_sub_ps(_mm_mul_ps(bandY, clipW), clipY), zero)),
+													  _mm_set1_epi32(CLIP_OUTCODE_TOP)));
+
+		//Narrow the four 32 bit outcodes to bytes.
+		outcode = _mm_packs_epi32(outcode, outcode);
+		outcode = _mm_packus_epi16(outcode, outcode);
+		packed = _mm_cvtsi128_si32(outcode);
+		memcpy(output.outcodes + i, &packed, 4);
+	}
+
+	TransformScalar(matrix, input, output, i, count, guardBandX, guardBandY);
+}
+
+//8 vertices at once.
+SIMD_TARGET_AVX2 static void TransformAVX2(const XMFLOAT4X4& matrix, const PositionStream& input, const ClipStream& output,
+										   unsigned int first, unsigned int count, float guardBandX, float guardBandY)
+{
+	__m256 m[4][4];
+	__m256 x, y, z, clipX, clipY, clipZ, clipW, zero, bandX, bandY;
+	__m256i outcode;
+	__m128i packed;
+	unsigned int i;
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			m[row][column] = _mm256_set1_ps(matrix.m[row][column]);
+		}
+	}
+	zero = _mm256_setzero_ps();
+	bandX = _mm256_set1_ps(guardBandX);
+	bandY = _mm256_set1_ps(guardBandY);
+
+	for (i = first; i + 8 <= count; i += 8)
+	{
+		x = _mm256_loadu_ps(input.x + i);
+		y = _mm256_loadu_ps(input.y + i);
+		z = _mm256_loadu_ps(input.z + i);
+
+		clipX = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][0]), _mm256_mul_ps(y, m[1][0])), _mm256_mul_ps(z, m[2][0])), m[3][0]);
+		clipY = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][1]), _mm256_mul_ps(y, m[1][1])), _mm256_mul_ps(z, m[2][1])), m[3][1]);
+		clipZ = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][2]), _mm256_mul_ps(y, m[1][2])), _mm256_mul_ps(z, m[2][2])), m[3][2]);
+		clipW = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0][3]), _mm256_mul_ps(y, m[1][3])), _mm256_mul_ps(z, m[2][3])), m[3][3]);
+
+		_mm256_storeu_ps(output.x + i, clipX);
+		_mm256_storeu_ps(output.y + i, clipY);
+		_mm256_storeu_ps(output.z + i, clipZ);
+		_mm256_storeu_ps(output.w + i, clipW);
+
+		outcode = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(clipZ, zero, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_OUTCODE_NEAR));
+		outcode = _mm256_or_si256(outcode, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(clipW, clipZ), zero, _CMP_LT_OQ)),
+															_mm256_set1_epi32(CLIP_OUTCODE_FAR)));
+		outcode = _mm256_or_si256(outcode, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(clipX, _mm256_mul_ps(bandX, clipW)), zero, _CMP_LT_OQ)),
+															_mm256_set1_epi32(CLIP_OUTCODE_LEFT)));
+		outcode = _mm256_or_si256(outcode, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(_mm256_mul_ps(bandX, clipW), clipX), zero, _CMP_LT_OQ)),
+															_mm256_set1_epi32(CLIP_OUTCODE_RIGHT)));
+		outcode = _mm256_or_si256(outcode, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(clipY, _mm256_mul_ps(bandY, clipW)), zero, _CMP_LT_OQ)),
+															_mm256_set1_epi32(CLIP_OUTCODE_BOTTOM)));
+		outcode = _mm256_or_si256(outcode, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(_mm256_mul_ps(bandY, clipW), clipY), zero, _CMP_LT_OQ)),
+															_mm256_set1_epi32(CLIP_OUTCODE_TOP)));
+
+		//Narrow the eight 32 bit outcodes to bytes.
+		packed = _mm_packs_epi32(_mm256_castsi256_si128(outcode), _mm256_extracti128_si256(outcode, 1));
+		packed = _mm_packus_epi16(packed, packed);
+		_mm_storel_epi64((__m128i*)(output.outcodes + i), packed);
+	}
+
+	TransformScalar(matrix, input, output, i, count, guardBandX, guardBandY);
+}
+
+#ifdef SIMD_HAS_AVX512
+
+//GCC 12 warns about the undefined source the plain form of the narrowing store passes on. The zero masked form with
+//every lane kept is the same instruction.
+static const __mmask16 AVX512_ALL_LANES = 0xffff;
+
+//16 vertices at once. The comparisons give masks, so every outcode bit is set in the lanes of its mask.
+SIMD_TARGET_AVX512 static void TransformAVX512(const XMFLOAT4X4& matrix, const PositionStream& input, const ClipStream& output,
+											   unsigned int first, unsigned int count, float guardBandX, float guardBandY)
+{
+	__m512 m[4][4];
+	__m512 x, y, z, clipX, clipY, clipZ, clipW, zero, bandX, bandY;
+	__m512i outcode, none;
+	unsigned int i;
+
+	for (int row = 0; row < 4; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			m[row][column] = _mm512_set1_ps(matrix.m[row][column]);
+		}
+	}
+	zero = _mm512_setzero_ps();
+	none = _mm512_setzero_si512();
+	bandX = _mm512_set1_ps(guardBandX);
+	bandY = _mm512_set1_ps(guardBandY);
+
+	for (i = first; i + 16 <= count; i += 16)
+	{
+		x = _mm512_loadu_ps(input.x + i);
+		y = _mm512_loadu_ps(input.y + i);
+		z = _mm512_loadu_ps(input.z + i);
+
+		clipX = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, m[0][0]), _mm512_mul_ps(y, m[1][0])), _mm512_mul_ps(z, m[2][0])), m[3][0]);
+		clipY = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, m[0][1]), _mm512_mul_ps(y, m[1][1])), _mm512_mul_ps(z, m[2][1])), m[3][1]);
+		clipZ = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, m[0][2]), _mm512_mul_ps(y, m[1][2])), _mm512_mul_ps(z, m[2][2])), m[3][2]);
+		clipW = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, m[0][3]), _mm512_mul_ps(y, m[1][3])), _mm512_mul_ps(z, m[2][3])), m[3][3]);
+
+		_mm512_storeu_ps(output.x + i, clipX);
+		_mm512_storeu_ps(output.y + i, clipY);
+		_mm512_storeu_ps(output.z + i, clipZ);
+		_mm512_storeu_ps(output.w + i, clipW);
+
+		outcode = _mm512_mask_mov_epi32(none, _mm512_cmp_ps_mask(clipZ, zero, _CMP_LT_OQ), _mm512_set1_epi32(CLIP_OUTCODE_NEAR));
+		outcode = _mm512_mask_or_epi32(outcode, _mm512_cmp_ps_mask(_mm512_sub_ps(clipW, clipZ), zero, _CMP_LT_OQ),
+									   outcode, _mm512_set1_epi32(CLIP_OUTCODE_FAR));
+		outcode = _mm512_mask_or_epi32(outcode, _mm512_cmp_ps_mask(_mm512_add_ps(clipX, _mm512_mul_ps(bandX, clipW)), zero, _CMP_LT_OQ),
+									   outcode, _mm512_set1_epi32(CLIP_OUTCODE_LEFT));
+		outcode = _mm512_mask_or_epi32(outcode, _mm512_cmp_ps_mask(_mm512_sub_ps(_mm512_mul_ps(bandX, clipW), clipX), zero, _CMP_LT_OQ),
+									   outcode, _mm512_set1_epi32(CLIP_OUTCODE_RIGHT));
+		outcode = _mm512_mask_or_epi32(outcode, _mm512_cmp_ps_mask(_mm512_add_ps(clipY, _mm512_mul_ps(bandY, clipW)), zero, _CMP_LT_OQ),
+									   outcode, _mm512_set1_epi32(CLIP_OUTCODE_BOTTOM));
+		outcode = _mm512_mask_or_epi32(outcode, _mm512_cmp_ps_mask(_mm512_sub_ps(_mm512_mul_ps(bandY, clipW), clipY), zero, _CMP_LT_OQ),
+									   outcode, _mm512_set1_epi32(CLIP_OUTCODE_TOP));
+
+		//Narrow the sixteen 32 bit outcodes to bytes.
+		_mm_storeu_si128((__m128i*)(output.outcodes + i), _mm512_maskz_cvtepi32_epi8(AVX512_ALL_LANES, outcode));
+	}
+
+	TransformScalar(matrix, input, output, i, count, guardBandX, guardBandY);
+}
+
+#endif
+#endif
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+static TransformFunction SelectTransform(SimdLevel level)
+{
+	switch (level)
+	{
+#ifdef SIMD_X86
+#ifdef SIMD_HAS_AVX512
+	case SIMD_LEVEL_AVX512:
+		return TransformAVX512;
+#endif
+	case SIMD_LEVEL_AVX2:
+		return TransformAVX2;
+	case SIMD_LEVEL_SSE2:
+		return TransformSSE2;
+#endif
+	default:
+		return TransformScalar;
+	}
+}
+
+static SimdLevel		 g_supportedLevel = DetectSimdLevel();
+static SimdLevel		 g_vertexProcessorLevel = g_supportedLevel;
+static TransformFunction g_transform = SelectTransform(g_vertexProcessorLevel);
+
+/*
+ *	TransformPositionStream()
+ *	brief: Transforms a stream of object space positions to clip space with a single world-view-projection matrix
+ *		   and computes their outcodes in the same pass. The near and far planes are the D3D ones, 0 <= z <= w.
+ *	param worldViewProjection: The matrix, not transposed.
+ *	param input: The positions, w is taken as 1.
+ *	param output: Receives the clip space positions and outcodes. It can't overlap the input.
+ *	param count: The number of positions.
+ *	param guardBandX, guardBandY: How many times the width and height of the viewport the side planes are
+ *		  apart. 1 gives the plain view volume.
+ */
+void TransformPositionStream(const XMMATRIX& worldViewProjection, const PositionStream& input, const ClipStream& output,
+							 unsigned int count, float guardBandX, float guardBandY)
+{
+	XMFLOAT4X4 matrix;
+
+	XMStoreFloat4x4(&matrix, worldViewProjection);
+	g_transform(matrix, input, output, 0, count, guardBandX, guardBandY);
+}
+
+/*
+ *	BuildWorldViewProjections()
+ *	brief: Multiplies the world matrices of many objects by the view-projection matrix of the frame, and transposes
+ *		   the results the way the shaders expect them in their constant buffers.
+ *	param viewProjection: The view matrix times the projection matrix.
+ *	param worldMatrices: The world matrix of every object.
+ *	param count: The number of objects.
+ *	param transposedOutput: Receives the transposed world-view-projection of every object.
+ */
+void BuildWorldViewProjections(const XMMATRIX& viewProjection, const XMFLOAT4X4* worldMatrices, unsigned int count,
+							   XMFLOAT4X4* transposedOutput)
+{
+	XMMATRIX worldViewProjection;
+
+	for (unsigned int i = 0; i < count; i++)
+	{
+		worldViewProjection = XMMatrixMultiply(XMLoadFloat4x4(&worldMatrices[i]), viewProjection);
+		XMStoreFloat4x4(&transposedOutput[i], XMMatrixTranspose(worldViewProjection));
+	}
+}
+
+SimdLevel GetVertexProcessorSimdLevel()
+{
+	return g_vertexProcessorLevel;
+}
+
+/*
+ *	SetVertexProcessorSimdLevel()
+ *	brief: Forces the kernel of a narrower instruction set, to compare them. It must not be called while rendering.
+ *	return: False if the CPU doesn't support that instruction set.
+ */
+bool SetVertexProcessorSimdLevel(SimdLevel level)
+{
+	if (level > g_supportedLevel)
+	{
+		return false;
+	}
+
+	g_vertexProcessorLevel = level;
+	g_transform = SelectTransform(level);
+	return true;
+}
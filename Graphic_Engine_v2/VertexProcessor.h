@@ -0,0 +1,58 @@
+#pragma once
+
+#ifndef VERTEX_PROCESSOR
+#define VERTEX_PROCESSOR
+
+/************************************************************************/
+/* INCLUDES                                                             */
+/************************************************************************/
+#include "SimdSupport.h"
+#include <DirectXMath.h>
+using namespace DirectX;
+
+/************************************************************************/
+/* GLOBALS                                                              */
+/************************************************************************/
+
+//Outcode bits, one per clipping plane, set when the position is outside that plane.
+const unsigned int CLIP_OUTCODE_NEAR = 1 << 0;		//z < 0
+const unsigned int CLIP_OUTCODE_FAR = 1 << 1;		//z > w
+const unsigned int CLIP_OUTCODE_LEFT = 1 << 2;		//x < -guardBandX * w
+const unsigned int CLIP_OUTCODE_RIGHT = 1 << 3;		//x > guardBandX * w
+const unsigned int CLIP_OUTCODE_BOTTOM = 1 << 4;	//y < -guardBandY * w
+const unsigned int CLIP_OUTCODE_TOP = 1 << 5;		//y > guardBandY * w
+
+/************************************************************************/
+/* TYPEDEFS                                                             */
+/************************************************************************/
+
+//Object space positions as three separate arrays (structure of arrays), so SIMD lanes hold consecutive vertices.
+struct PositionStream
+{
+	const float* x;
+	const float* y;
+	const float* z;
+};
+
+//Clip space positions in structure of arrays, with the outcode of every vertex.
+struct ClipStream
+{
+	float*		   x;
+	float*		   y;
+	float*		   z;
+	float*		   w;
+	unsigned char* outcodes;
+};
+
+/************************************************************************/
+/* FUNCTION PROTOTYPES                                                  */
+/************************************************************************/
+void TransformPositionStream(const XMMATRIX& worldViewProjection, const PositionStream& input, const ClipStream& output,
+							 unsigned int count, float guardBandX, float guardBandY);
+void BuildWorldViewProjections(const XMMATRIX& viewProjection, const XMFLOAT4X4* worldMatrices, unsigned int count,
+							   XMFLOAT4X4* transposedOutput);
+
+SimdLevel GetVertexProcessorSimdLevel();
+bool SetVertexProcessorSimdLevel(SimdLevel level);
+
+#endif
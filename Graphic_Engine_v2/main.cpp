@@ -12,15 +12,35 @@
 /************************************************************************/
 /* INCLUDES                                                             */
 /************************************************************************/
+#ifdef _WIN32
 #include "SystemClass.h"
+#endif
+#include "Benchmarks.h"
+#include "BatchRenderer.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
 //#include <vld.h>
 
+#ifdef _WIN32
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline, int iCmdshow)
 {
 	SystemClass* System;
 	bool rightInit;
-	
-	
+
+
+	// Run the benchmarks instead of the engine when asked to in the command line.
+	if (strstr(pScmdline, BENCHMARK_SWITCH))
+	{
+		return RunBenchmarks(pScmdline, BENCHMARK_OUTPUT_FILE) ? 0 : 1;
+	}
+
+	// Render the frames of a job file without a window, also instead of the engine.
+	if (strstr(pScmdline, BATCH_SWITCH))
+	{
+		return RunBatchRender(pScmdline, BATCH_REPORT_FILE) ? 0 : 1;
+	}
+
 	// Create the system object.
 	System = new SystemClass;
 	if(!System)
@@ -41,4 +61,35 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline,
 	System = 0;
 
 	return 0;
-}
\ No newline at end of file
+}
+#else
+/*
+ *	main()
+ *	brief: Without Windows there is no window for the engine to run in, so only the benchmarks and the batch
+ *		   renderer can be run, with the same switches as in WinMain().
+ */
+int main(int argc, char** argv)
+{
+	std::string commandLine;
+
+	// Put the arguments back together like the command line WinMain() gets.
+	for (int i = 1; i < argc; i++)
+	{
+		commandLine += i > 1 ? " " : "";
+		commandLine += argv[i];
+	}
+
+	if (strstr(commandLine.c_str(), BENCHMARK_SWITCH))
+	{
+		return RunBenchmarks(commandLine.c_str(), BENCHMARK_OUTPUT_FILE) ? 0 : 1;
+	}
+
+	if (strstr(commandLine.c_str(), BATCH_SWITCH))
+	{
+		return RunBatchRender(commandLine.c_str(), BATCH_REPORT_FILE) ? 0 : 1;
+	}
+
+	fprintf(stderr, "Usage: %s %s [benchmarks] | %s job.txt\n", argv[0], BENCHMARK_SWITCH, BATCH_SWITCH);
+	return 1;
+}
+#endif